@@ -5,6 +5,7 @@
 #include "core.h"
 #include "graphics.h"
 #include "scene.h"
+#include "task_pool.h"
 #include "postprocess.h"
 
 using namespace gi_lib;
@@ -62,6 +63,8 @@ namespace gi{
 
 		unique_ptr<Scene> scene_;
 
+		TaskPool task_pool_;					///< \brief Pool used to update the scene.
+
 		unique_ptr<Postprocess> postprocess_;
 		
 		const IInput* input_;
@@ -72,6 +75,8 @@ namespace gi{
 
 		bool enable_global_illumination_;		///< \brief Whether the global illumination is enabled.
 
+		bool enable_occlusion_culling_;			///< \brief Whether the software occlusion culling is enabled.
+
 		bool enable_voxel_draw_;				///< \brief Whether to draw voxels or not.
 
 		DebugSHDrawMode debug_sh_draw_mode_;	///< \brief Debug spherical harmonics draw mode.
@@ -15,6 +15,7 @@
 
 #include "deferred_renderer.h"
 #include "sampler.h"
+#include "texture.h"
 
 
 using gi_lib::ObjectPtr;
@@ -24,6 +25,7 @@ using gi_lib::Resources;
 using gi_lib::MeshComponent;
 
 using gi_lib::DeferredRendererMaterial;
+using gi_lib::ITexture2D;
 
 using gi_lib::wavefront::IMtlMaterialImporter;
 using gi_lib::wavefront::IMtlMaterial;
@@ -52,7 +54,9 @@ namespace gi{
 
 	private:
 		
-		bool BindTexture(const wstring& base_directory, const IMtlMaterial& mtl_material, const string& mtl_property, const Tag& semantic, IMaterial& destination) const;
+		/// \brief Bind the texture referenced by a material property, if any.
+		/// The placeholder is bound until the texture is loaded, and stays bound if the load fails.
+		void BindTexture(const wstring& base_directory, const IMtlMaterial& mtl_material, const string& mtl_property, const Tag& semantic, const ObjectPtr<ITexture2D>& placeholder, IMaterial& destination) const;
 
 		template <typename TProperty>
 		bool BindProperty(const IMtlMaterial& mtl_material, const string& mtl_property, TProperty default_value, TProperty& destination);
@@ -63,6 +67,12 @@ namespace gi{
 
 		ObjectPtr<gi_lib::ISampler> sampler_;							///< \brief Basic sampler used by the material.
 
+		ObjectPtr<ITexture2D> diffuse_placeholder_;						///< \brief Diffuse map bound while the actual one is being loaded.
+
+		ObjectPtr<ITexture2D> normal_placeholder_;						///< \brief Normal map bound while the actual one is being loaded.
+
+		ObjectPtr<ITexture2D> specular_placeholder_;					///< \brief Specular map bound while the actual one is being loaded.
+
 	};
 
 	/// \brief Handle the material import from a fbx file.
@@ -12,7 +12,8 @@
 #include "resources.h"
 #include "render_target.h"
 #include "deferred_renderer.h"
-#include "uniform_tree.h"
+#include "loose_octree.h"
+#include "bvh_tree.h"
 #include "component.h"
 #include "range.h"
 #include "scene.h"
@@ -20,6 +21,7 @@
 #include "material_importer.h"
 #include "fly_camera_component.h"
 #include "light_component.h"
+#include "derived_data_cache.h"
 
 #include "texture.h"
 
@@ -43,6 +45,9 @@ const float kDomainSize = 5600.0f;
 /// \brief Number of times the domain is split along each axis.
 const unsigned int kDomainSubdivisions = 2;
 
+/// \brief Maximum size of the imported scenes stored on disk, in bytes.
+const size_t kDerivedDataCapacity = 512 * 1024 * 1024;
+
 FlyCameraComponent* fly_camera;
 
 Window* g_window;
@@ -52,17 +57,17 @@ GILogic::GILogic() :
     input_(nullptr),
     paused_(false){
 
-    scene_ = make_unique<Scene>(make_unique<UniformTree>(AABB{ Vector3f::Zero(),							// Mesh hierarchy
-                                                               kDomainSize * Vector3f::Ones() },
-                                                         kDomainSubdivisions * Vector3i::Ones()),
-                                make_unique<UniformTree>(AABB{ Vector3f::Zero(),							// Light hierarchy
+    scene_ = make_unique<Scene>(make_unique<BVHTree>(),														// Mesh hierarchy
+                                make_unique<LooseOctree>(AABB{ Vector3f::Zero(),							// Light hierarchy
                                                                kDomainSize * Vector3f::Ones() },
-                                                         kDomainSubdivisions * Vector3i::Ones()));
+                                                         kDomainSubdivisions));
 
 }
 
 GILogic::~GILogic(){
 
+    graphics_.GetResources().StopLoaders();     // The resources outlive the application and cannot stop their loaders safely
+
     scene_ = nullptr;
 
     output_ = nullptr;
@@ -111,10 +116,10 @@ void GILogic::Initialize(Window& window){
 
     // Scene import
 
-    auto root = scene_->CreateNode(L"root", 
-                                   Translation3f(Vector3f(0.0f, 0.0f, 0.0f)),
-                                   Quaternionf::Identity(), 
-                                   AlignedScaling3f(Vector3f::Ones() * 3.0f));
+    auto root = scene_->CreateStaticNode(L"root", 
+                                         Translation3f(Vector3f(0.0f, 0.0f, 0.0f)),
+                                         Quaternionf::Identity(), 
+                                         AlignedScaling3f(Vector3f::Ones() * 3.0f));
 
     auto& resources = graphics_.GetResources();
 
@@ -122,10 +127,15 @@ void GILogic::Initialize(Window& window){
 
     MtlMaterialImporter material_importer(resources);
 
-    wavefront::ObjImporter obj_importer(resources);
+    DerivedDataCache derived_data_cache(app.GetDirectory() + L"Cache\\",
+                                        kDerivedDataCapacity);
+
+    wavefront::ObjImporter obj_importer(resources, &derived_data_cache);
         
 #ifdef GI_RELEASE
 
+    // The snapshot is stored inside the cache by the first run and loaded by the following ones, until the OBJ or MTL files change.
+
     obj_importer.ImportScene(app.GetDirectory() + L"Data\\assets\\Sponza\\SponzaNoFlag.obj",
                              *root,
                              material_importer);
@@ -157,6 +167,7 @@ void GILogic::Initialize(Window& window){
     // Commad setup
 
     enable_global_illumination_ = true;
+    enable_occlusion_culling_ = true;
     enable_postprocess_ = true;
     enable_voxel_draw_ = false;
     debug_sh_draw_mode_ = DebugSHDrawMode::kNone;
@@ -258,6 +269,10 @@ void GILogic::SetupLights(Scene& scene, ObjectPtr<IStaticMesh> point_light_mesh)
 
 void GILogic::Update(const Time & time){
 
+    // Bind the resources loaded in background
+
+    graphics_.GetResources().Update();
+
     fly_camera->Update(time);
     
     auto& keyboard = input_->GetKeyboardStatus();
@@ -288,6 +303,16 @@ void GILogic::Update(const Time & time){
         
     deferred_renderer_->EnableGlobalIllumination(enable_global_illumination_);
 
+    // "O": toggle occlusion culling
+
+    if (keyboard.IsPressed(KeyCode::KEY_O)) {
+
+        enable_occlusion_culling_ = !enable_occlusion_culling_;
+
+    }
+
+    deferred_renderer_->EnableOcclusionCulling(enable_occlusion_culling_);
+
     // "V": toggle debug voxel drawing
 
     if (keyboard.IsPressed(KeyCode::KEY_V)) {
@@ -411,6 +436,10 @@ void GILogic::Update(const Time & time){
 
     }
 
+    // Relocate everything that moved during this frame
+
+    scene_->Commit(task_pool_);
+
     // Render the next frame
 
     auto next_frame = deferred_renderer_->Draw(time,
@@ -82,6 +82,12 @@ resources_(resources) {
 
 	sampler_ = resources.Load<ISampler, ISampler::FromDescription>({ TextureMapping::WRAP, TextureFiltering::ANISOTROPIC, 16 });
 
+	diffuse_placeholder_ = resources.Load<ITexture2D, ITexture2D::FromFile>({ app.GetDirectory() + L"Data\\assets\\Placeholder\\diffuse.dds" });
+
+	normal_placeholder_ = resources.Load<ITexture2D, ITexture2D::FromFile>({ app.GetDirectory() + L"Data\\assets\\Placeholder\\normal.dds" });
+
+	specular_placeholder_ = resources.Load<ITexture2D, ITexture2D::FromFile>({ app.GetDirectory() + L"Data\\assets\\Placeholder\\specular.dds" });
+
 }
 
 void MtlMaterialImporter::OnImportMaterial(const wstring& base_directory, const MtlMaterialCollection& material_collection, MeshComponent& mesh){
@@ -101,9 +107,9 @@ void MtlMaterialImporter::OnImportMaterial(const wstring& base_directory, const
 		
 		auto& material = *material_collection[material_index];
 
-		BindTexture(base_directory, material, "map_Kd", IMaterial::kDiffuseMap, *material_instance->GetMaterial());
-		BindTexture(base_directory, material, "map_bump", IMaterial::kNormalMap, *material_instance->GetMaterial());
-		BindTexture(base_directory, material, "map_Ks", IMaterial::kSpecularMap, *material_instance->GetMaterial());
+		BindTexture(base_directory, material, "map_Kd", IMaterial::kDiffuseMap, diffuse_placeholder_, *material_instance->GetMaterial());
+		BindTexture(base_directory, material, "map_bump", IMaterial::kNormalMap, normal_placeholder_, *material_instance->GetMaterial());
+		BindTexture(base_directory, material, "map_Ks", IMaterial::kSpecularMap, specular_placeholder_, *material_instance->GetMaterial());
 
 		BindProperty(material, "Ns", 5.0f, buffer.gShininess);
 		BindProperty(material, "Ke", 0.0f, buffer.gEmissivity);
@@ -127,21 +133,35 @@ void MtlMaterialImporter::OnImportMaterial(const wstring& base_directory, const
 		deferred_component->SetMaterial(material_index,
 										material_instance);
 
-		// Set the mesh flags
+		// Set the subset flags
 
 		string is_shadowcaster;
+		string is_occluder;
 
 		BindProperty<string>(material, "shadowcaster", "true", is_shadowcaster);
+		BindProperty<string>(material, "occluder", "false", is_occluder);
+
+		auto flags = MeshFlags::kNone;
+
+		if (is_shadowcaster == "true") {
+
+			flags |= MeshFlags::kShadowcaster;
 
-		mesh.GetMesh()->SetFlags(is_shadowcaster == "true" ? 
-								 MeshFlags::kShadowcaster : 
-								 MeshFlags::kNone);
+		}
+
+		if (is_occluder == "true") {
+
+			flags |= MeshFlags::kOccluder;
+
+		}
+
+		mesh.GetMesh()->SetFlags(material_index, flags);
 
 	}
 	
 }
 
-bool MtlMaterialImporter::BindTexture(const wstring& base_directory, const IMtlMaterial& mtl_material, const string& mtl_property, const Tag& semantic, IMaterial& destination) const{
+void MtlMaterialImporter::BindTexture(const wstring& base_directory, const IMtlMaterial& mtl_material, const string& mtl_property, const Tag& semantic, const ObjectPtr<ITexture2D>& placeholder, IMaterial& destination) const{
 
 	string texture_name;
 
@@ -150,18 +170,32 @@ bool MtlMaterialImporter::BindTexture(const wstring& base_directory, const IMtlM
 	if (property_map_kd &&
 		property_map_kd->Read(texture_name)) {
 
-		auto texture = resources_.Load<ITexture2D, ITexture2D::FromFile>({ base_directory + to_wstring(texture_name) });
+		// The placeholder is bound until the texture is loaded. Cached textures are bound right away by the continuation.
+
+		auto load = resources_.LoadAsync<ITexture2D, ITexture2D::FromFile>({ base_directory + to_wstring(texture_name) },
+																			placeholder);
 
-		if (texture) {
+		if (!load.IsReady()) {
 
-			return destination.SetInput(semantic,
-										texture);
+			destination.SetInput(semantic,
+								 load.Get());
 
 		}
 
-	}
+		ObjectPtr<IMaterial> material(&destination);
+
+		load.Then([material, semantic](const ObjectPtr<ITexture2D>& texture){
+
+					  if (texture) {
 
-	return false;
+						  material->SetInput(semantic,
+											 texture);
+
+					  }
+
+				  });
+
+	}
 
 }
 
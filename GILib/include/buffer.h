@@ -19,6 +19,13 @@ namespace gi_lib {
 		/// \brief Virtual destructor.
 		virtual ~IHardwareBuffer() {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kBuffer;
+
+		}
+
 		/// \brief Lock the buffer, mapping it to the system memory.
 		/// \return Returns a pointer to the mapped buffer.
 		/// \remarks The buffer is intended for write-only purposes. Reading from it results in undefined behavior.
@@ -108,6 +115,13 @@ namespace gi_lib {
 		/// \brief Virtual destructor.
 		virtual ~IGPStructuredArray() {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kBuffer;
+
+		}
+
 		/// \brief Get the number of elements in the array.
 		virtual size_t GetCount() const = 0;
 
@@ -136,6 +150,13 @@ namespace gi_lib {
 
 		/// \brief Abstract destructor.
 		virtual ~IScratchStructuredArray() = 0 {}
+
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kBuffer;
+
+		}
 		
 		/// \brief Read an element from the structured array.
 		/// \tparam TType Type of the element to read.
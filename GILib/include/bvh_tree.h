@@ -0,0 +1,93 @@
+/// \file bvh_tree.h
+/// \brief Bounding volume hierarchy built via surface area heuristic.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "gimath.h"
+#include "volume_hierarchy.h"
+
+using ::std::unique_ptr;
+
+namespace gi_lib{
+
+	/// \brief Represents a binary bounding volume hierarchy.
+	/// The tree is built top-down using a binned surface area heuristic (SAH), so its shape adapts to the actual distribution of the volumes.
+	/// Whenever a volume is committed after a change, the tree is refitted incrementally without altering its topology.
+	/// Refitting degrades the quality of the tree over time: when the SAH cost grows past a given threshold the tree is rebuilt in background and swapped in as soon as it is ready.
+	/// \author Raffaele D. Facendola
+	class BVHTree : public IVolumeHierarchy
+	{
+
+	public:
+
+		/// \brief Default ratio between the current and the original SAH cost that triggers a rebuild.
+		static const float kDefaultRebuildThreshold;
+
+		/// \brief Create a new empty tree.
+		BVHTree();
+
+		/// \brief Create a new empty tree.
+		/// \param rebuild_threshold Ratio between the current SAH cost and the cost at build time that triggers a background rebuild.
+		BVHTree(float rebuild_threshold);
+
+		/// \brief Destructor.
+		/// Waits for any pending background rebuild.
+		virtual ~BVHTree();
+
+		virtual void AddVolume(VolumeComponent* volume) override;
+
+		virtual void RemoveVolume(VolumeComponent* volume) override;
+
+		virtual void Commit() override;
+
+		virtual HierarchyStats GetStats() const override;
+
+		virtual const VolumeChangeLog& GetChangeLog() const override;
+
+		using IVolumeHierarchy::GetIntersections;
+
+		virtual void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const override;
+
+		virtual bool VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const override;
+
+		/// \brief Rebuild the whole tree synchronously.
+		/// Any pending background rebuild is discarded.
+		void Rebuild();
+
+		/// \brief Get the current SAH cost of the tree, relative to the surface of the root node.
+		/// \return Returns the current SAH cost of the tree.
+		float GetCost() const;
+
+	protected:
+
+		virtual void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const override;
+
+		virtual void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const override;
+
+		virtual void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+	private:
+
+		struct Impl;
+
+		unique_ptr<Impl> pimpl_;						///< \brief Private implementation.
+
+	};
+
+}
@@ -8,58 +8,80 @@
 #include <typeinfo>
 #include <typeindex>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 #include <set>
+#include <map>
+#include <array>
 #include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <new>
 
 #include "macros.h"
 #include "range.h"
 #include "observable.h"
+#include "slab_pool.h"
+#include "scope_guard.h"
 
 using std::type_index;
-using std::unordered_multimap;
+using std::vector;
 using std::set;
+using std::map;
 
 namespace gi_lib{
 
+	class ArchetypeStorage;
+	class ComponentAllocator;
+
+	/// \brief Dense identifier of a component type.
+	/// Identifiers are assigned in sequence starting from zero, the first time each type is used.
+	/// Types may be used for the first time by concurrent threads: a thread losing the race leaves a gap in the sequence.
+	using ComponentTypeId = unsigned int;
+
 	/// \brief Represents a component of a component-based entity.
 	/// A component-based entity is an abstract object which exposes different capabilities through components.
 	/// These components may be accessed, removed or added at runtime seamlessy.
 	/// The entity may have different components of the same type (each of which is a separate object from the others) and may query for components polymorphically.
 	/// If an entity has a component of type Derived derived from Base, the entity will responds to both the type Derived and Base.
+	/// Each entity maps its components in a flat table indexed by component type id, so that looking up a component by type is a constant-time operation.
 	/// Components <b>must<\b> be created via Component::Create<TComponent>(...) and destroyed via Component::Dispose().
+	/// Components and entities are allocated from the pools of a ComponentAllocator: components added to an entity share the allocator of the entity.
 	/// \auhtor Raffaele D. Facendola.
 	class Component{
 
+		friend class ArchetypeStorage;
+		friend class ComponentAllocator;
+
 	public:
 
 		/// \brief Type of the set containing the components.
 		using ComponentSet = set < Component* >;
 
-		/// \brief Type of the multimap associating the components to their type.
-		using ComponentMap = unordered_multimap < type_index, Component* >;
+		/// \brief Type of the table storing the components grouped by type.
+		using ComponentTable = vector < Component* >;
 
-		/// \brief Type of the type set used to determine the type of a component.
-		using TypeSet = set < type_index >;
+		/// \brief Type of the read-only view of the types a component can be safely casted to.
+		/// The view refers to a static list and never allocates.
+		using TypeSet = Range < vector<ComponentTypeId>::const_iterator >;
 
-		/// \brief Functor used to map an entry from the multimap to a component pointer.
+		/// \brief Functor used to map an entry from the component table to a component pointer.
 		template <typename TComponent>
 		struct ComponentMapper{
 
 			/// \brief Maps an iterator to the component pointed by it.
-			/// \param pointer Pointer to the object to map.
+			/// \param component Entry of the table to map.
 			/// \return Returns a pointer to the component.
-			TComponent* operator()(const ComponentMap::iterator::reference component_pair);
+			TComponent* operator()(ComponentTable::iterator::reference component);
 
 		};
 
 		/// \brief Type of the iterator.
 		template <typename TComponent>
-		using iterator = IteratorWrapper < ComponentMap::iterator, TComponent, ComponentMapper<TComponent> >;
+		using iterator = IteratorWrapper < ComponentTable::iterator, TComponent, ComponentMapper<TComponent> >;
 
 		/// \brief Type of the constant iterator.
 		template <typename TComponent>
-		using const_iterator = IteratorWrapper < ComponentMap::iterator, const TComponent, ComponentMapper<TComponent> >;
+		using const_iterator = IteratorWrapper < ComponentTable::iterator, const TComponent, ComponentMapper<TComponent> >;
 
 		/// \brief Range of components.
 		template <typename TComponent>
@@ -69,8 +91,8 @@ namespace gi_lib{
 		template <typename TComponent>
 		using const_range = Range < const_iterator< TComponent > >;
 
-		/// \brief Range of components stored inside the component map.
-		using map_range = Range < ComponentMap::iterator >;
+		/// \brief Range of components stored inside the component table.
+		using table_range = Range < ComponentTable::iterator >;
 
 		/// \brief Arguments of the OnRemoved event.
 		struct OnRemovedEventArgs{
@@ -138,9 +160,16 @@ namespace gi_lib{
 		const_range<TComponent> GetComponents() const;
 
 		/// \brief Get all the component types.
-		/// \return Returns a set of types this component can be safely casted to.
+		/// Derived classes should return DeriveTypes<Derived>(Base::GetTypes()).
+		/// \return Returns a view of the ids of the types this component can be safely casted to.
 		virtual TypeSet GetTypes() const;
 
+		/// \brief Get the id of a component type.
+		/// \tparam TComponent Type of the component.
+		/// \return Returns the dense id associated to the specified type.
+		template <typename TComponent>
+		static ComponentTypeId GetTypeId();
+
 		/// \brief Delete this component and every other component.
 		void Dispose();
 
@@ -149,13 +178,21 @@ namespace gi_lib{
 		/// \return Return the event triggered when this component is being removed from the composite object.
 		Observable<OnRemovedEventArgs>& OnRemoved();
 
-		/// \brief Create a new component.
+		/// \brief Create a new component using the default allocator.
 		/// \tparam TComponent Type of the component to create.
 		/// \tparam TArgs Types of the arguments to pass to the component's constructor.
 		/// \return Returns a pointer to the newly-created component.
 		template <typename TComponent, typename... TArgs>
 		static TComponent* Create(TArgs&&... arguments);
 
+		/// \brief Create a new component using a specific allocator.
+		/// \tparam TComponent Type of the component to create.
+		/// \tparam TArgs Types of the arguments to pass to the component's constructor.
+		/// \param allocator Allocator of the new entity. Must outlive the entity.
+		/// \return Returns a pointer to the newly-created component.
+		template <typename TComponent, typename... TArgs>
+		static TComponent* CreateIn(ComponentAllocator& allocator, TArgs&&... arguments);
+
 	protected:
 
 		/// \brief Initialize the component.
@@ -168,41 +205,145 @@ namespace gi_lib{
 		/// This method is called right before the destructor. AddComponent, RemoveComponent and GetComponents methods are guaranteed to work.
 		virtual void Finalize() = 0;
 
+		/// \brief Extend the types of a base class with a derived type.
+		/// The list is computed once per derived type and never destroyed. Concurrent threads agree on the same list.
+		/// \tparam TComponent Derived type.
+		/// \param base_types Types of the base class.
+		/// \return Returns a view of the base types followed by the derived type.
+		template <typename TComponent>
+		static TypeSet DeriveTypes(TypeSet base_types);
+
 	private:
 
 		class Arbiter;
 
+		/// \brief Type information shared by every component of a given type.
+		/// Members are assigned by compare-and-swap, since function-local statics are not initialized in a thread-safe manner by every compiler.
+		/// \tparam TComponent Type of the component.
+		template <typename TComponent>
+		struct TypeInfo{
+
+			static std::atomic<ComponentTypeId> type_id;				///< \brief Id of the type plus one. Zero if the type has no id yet.
+
+			static std::atomic<const vector<ComponentTypeId>*> types;	///< \brief Types the component can be safely casted to. Null if not computed yet.
+
+		};
+
+		/// \brief Generate a new component type id.
+		static ComponentTypeId MakeTypeId();
+
+		/// \brief Create a list of types from the types of a base class and a derived type.
+		static vector<ComponentTypeId> MakeTypes(TypeSet base_types, ComponentTypeId type);
+
+		/// \brief Construct a new component inside a block of the pool of its type.
+		/// \param allocator Allocator owning the pool.
+		template <typename TComponent, typename... TArgs>
+		static TComponent* Construct(ComponentAllocator& allocator, TArgs&&... arguments);
+
+		/// \brief Destroy a component and return its block to the pool it was allocated from.
+		static void Destroy(Component* component);
+
+		/// \brief Destroy an entity and return its block to the allocator.
+		static void Destroy(Arbiter* arbiter);
+
+		/// \brief Get the allocator of the entity.
+		ComponentAllocator& GetAllocator() const;
+
 		/// \brief Return the first component matching a type.
-		/// \tparam TComponent Type of component to get.
+		/// \param type Id of the type of component to get.
 		/// \return Returns a pointer to the first component that matches the specified type.
-		Component* GetComponent(type_index type) const;
+		Component* GetComponent(ComponentTypeId type) const;
 
 		/// \brief Get the components matching a specified type.
-		/// \param type Type of the components to get.
+		/// \param type Id of the type of the components to get.
 		/// \return Returns a range containing all the components matching the given type.
-		map_range GetComponents(type_index type) const;
+		table_range GetComponents(ComponentTypeId type) const;
 				
 		/// \brief Set the arbiter and call the Initialize method.
 		/// \param arbiter Arbiter associated to the current composite entity.
 		void Setup(Arbiter* arbiter);
 
 		/// \brief Create a new entity and call the Initialize method.
-		void Setup();
+		/// \param allocator Allocator of the new entity.
+		void Setup(ComponentAllocator& allocator);
 
 		Arbiter* arbiter_;								///< \brief Enables intra-component communication.
 
+		SlabPool* pool_;								///< \brief Pool the component was allocated from.
+
 		Event<OnRemovedEventArgs> on_removed_event_;	///< \brief Component remove event.
 		
 	};
 
+	/// \brief Allocates components and entities from pools, one for each component type.
+	/// Components of the same type are packed together inside slabs, which are released all at once when the allocator is destroyed.
+	/// Every entity created from an allocator must be disposed before the allocator is destroyed.
+	/// The allocator is not thread-safe.
+	/// \author Raffaele D. Facendola
+	class ComponentAllocator{
+
+		friend class Component;
+
+	public:
+
+		/// \brief Create an empty allocator.
+		ComponentAllocator();
+
+		/// \brief No copy constructor.
+		ComponentAllocator(const ComponentAllocator&) = delete;
+
+		/// \brief Destructor.
+		/// Releases every slab.
+		~ComponentAllocator();
+
+		/// \brief No assignment operator.
+		ComponentAllocator& operator=(const ComponentAllocator&) = delete;
+
+		/// \brief Get the usage statistics of the pool of a component type.
+		/// \tparam TComponent Exact type of the components.
+		/// \return Returns the statistics of the pool. All zeros if no component of the specified type was ever allocated.
+		template <typename TComponent>
+		PoolStatistics GetStatistics() const;
+
+		/// \brief Get the usage statistics of the pool of the entities.
+		const PoolStatistics& GetEntityStatistics() const;
+
+		/// \brief Get the allocator used by Component::Create.
+		/// The default allocator is never destroyed.
+		static ComponentAllocator& GetDefault();
+
+	private:
+
+		/// \brief Get the pool of a component type, creating it if needed.
+		/// \param type Exact type of the components.
+		/// \param size Size of the components.
+		SlabPool& GetPool(ComponentTypeId type, size_t size);
+
+		/// \brief Get the usage statistics of the pool of a component type.
+		PoolStatistics GetStatistics(ComponentTypeId type) const;
+
+		vector<unique_ptr<SlabPool>> pools_;		///< \brief Pool of each component type, indexed by type id.
+
+		SlabPool entities_;							///< \brief Pool of the entities.
+
+	};
+
 	////////////////// COMPONENT /////////////////////
 
 	template <typename TComponent, typename... TArgs>
 	static TComponent* Component::Create(TArgs&&... arguments){
 
-		TComponent* component = new TComponent(std::forward<TArgs&&>(arguments)...);
+		return CreateIn<TComponent>(ComponentAllocator::GetDefault(),
+									std::forward<TArgs&&>(arguments)...);
+
+	}
+
+	template <typename TComponent, typename... TArgs>
+	TComponent* Component::CreateIn(ComponentAllocator& allocator, TArgs&&... arguments){
+
+		TComponent* component = Construct<TComponent>(allocator, std::forward<TArgs&&>(arguments)...);
 
-		component->Setup();
+		component->Setup(allocator);
 
 		return component;
 
@@ -211,7 +352,7 @@ namespace gi_lib{
 	template <typename TComponent, typename... TArgs>
 	TComponent* Component::AddComponent(TArgs&&... arguments){
 
-		TComponent* component = new TComponent(std::forward<TArgs&&>(arguments)...);
+		TComponent* component = Construct<TComponent>(GetAllocator(), std::forward<TArgs&&>(arguments)...);
 
 		component->Setup(arbiter_);
 
@@ -219,24 +360,47 @@ namespace gi_lib{
 
 	}
 
+	template <typename TComponent, typename... TArgs>
+	TComponent* Component::Construct(ComponentAllocator& allocator, TArgs&&... arguments){
+
+		auto& pool = allocator.GetPool(GetTypeId<TComponent>(), sizeof(TComponent));
+
+		auto block = pool.Allocate();
+
+		auto guard = make_scope_guard([&pool, block](){
+
+			pool.Free(block);		// The constructor threw
+
+		});
+
+		TComponent* component = new (block) TComponent(std::forward<TArgs&&>(arguments)...);
+
+		guard.Dismiss();
+
+		component->pool_ = &pool;
+
+		return component;
+
+	}
+
 	template <typename TComponent>
 	TComponent* Component::GetComponent(){
 
-		return static_cast<TComponent*>(GetComponent(type_index(typeid(TComponent))));
+		return static_cast<TComponent*>(GetComponent(GetTypeId<TComponent>()));
 		
 	}
 
 	template <typename TComponent>
 	const TComponent* Component::GetComponent() const{
 
-		return static_cast<const TComponent*>(GetComponent(type_index(typeid(TComponent))));
+		return static_cast<const TComponent*>(GetComponent(GetTypeId<TComponent>()));
 
 	}
 
 	template <typename TComponent>
 	Component::range<TComponent> Component::GetComponents(){
 
-		auto components = GetComponents(type_index(typeid(TComponent)));
+		auto components = GetComponents(GetTypeId<TComponent>());
 
 		return range<TComponent>(iterator<TComponent>(components.begin()),
 								 iterator<TComponent>(components.end()));
@@ -246,19 +410,296 @@ namespace gi_lib{
 	template <typename TComponent>
 	Component::const_range<TComponent> Component::GetComponents() const{
 
-		auto components = GetComponents(type_index(typeid(TComponent)));
+		auto components = GetComponents(GetTypeId<TComponent>());
 
 		return const_range<TComponent>(const_iterator<TComponent>(components.begin()),
 									   const_iterator<TComponent>(components.end()));
 
 	}
 
+	template <typename TComponent>
+	ComponentTypeId Component::GetTypeId(){
+
+		auto type_id = TypeInfo<TComponent>::type_id.load();
+
+		if (type_id == 0){
+
+			// The first thread to store its id wins, the others adopt it.
+
+			auto new_type_id = MakeTypeId() + 1;
+
+			if (TypeInfo<TComponent>::type_id.compare_exchange_strong(type_id, new_type_id)){
+
+				type_id = new_type_id;
+
+			}
+
+		}
+
+		return type_id - 1;
+
+	}
+
+	template <typename TComponent>
+	Component::TypeSet Component::DeriveTypes(TypeSet base_types){
+
+		auto types = TypeInfo<TComponent>::types.load();
+
+		if (!types){
+
+			// The first thread to store its list wins, the others discard theirs.
+
+			auto new_types = new vector<ComponentTypeId>(MakeTypes(base_types, GetTypeId<TComponent>()));
+
+			if (TypeInfo<TComponent>::types.compare_exchange_strong(types, new_types)){
+
+				types = new_types;
+
+			}
+			else{
+
+				delete new_types;
+
+			}
+
+		}
+
+		return TypeSet(types->cbegin(),
+					   types->cend());
+
+	}
+
+	//////////////////////// COMPONENT::TYPE INFO ///////////////////////
+
+	template <typename TComponent>
+	std::atomic<ComponentTypeId> Component::TypeInfo<TComponent>::type_id;
+
+	template <typename TComponent>
+	std::atomic<const vector<ComponentTypeId>*> Component::TypeInfo<TComponent>::types;
+
+	//////////////////////// COMPONENT ALLOCATOR ///////////////////////
+
+	template <typename TComponent>
+	PoolStatistics ComponentAllocator::GetStatistics() const{
+
+		return GetStatistics(Component::GetTypeId<TComponent>());
+
+	}
+
+	inline const PoolStatistics& ComponentAllocator::GetEntityStatistics() const{
+
+		return entities_.GetStatistics();
+
+	}
+
 	//////////////////////// COMPONENT::COMPONENT MAPPER ///////////////////////
 	
 	template <typename TComponent>
-	TComponent* Component::ComponentMapper<TComponent>::operator()(const ComponentMap::iterator::reference component_pair){
+	TComponent* Component::ComponentMapper<TComponent>::operator()(ComponentTable::iterator::reference component){
+
+		return static_cast<TComponent*>(component);
+
+	}
+
+
+	/// \brief Compile-time sequence of indices, used to expand parameter packs in lockstep.
+	template <size_t... kIndices>
+	struct IndexSequence{};
+
+	/// \brief Build the sequence of indices [0; kCount).
+	template <size_t kCount, size_t... kIndices>
+	struct MakeIndexSequence : MakeIndexSequence < kCount - 1, kCount - 1, kIndices... > {};
+
+	/// \brief Build the sequence of indices [0; kCount).
+	template <size_t... kIndices>
+	struct MakeIndexSequence < 0, kIndices... > {
+
+		using type = IndexSequence < kIndices... >;
+
+	};
+
+	/// \brief Result of a query over the entities of an archetype storage.
+	/// The components are visited one archetype at a time: each archetype stores the components of its entities as packed arrays, one per component type.
+	/// The result is invalidated as soon as any entity of the storage gains or loses a component.
+	/// \tparam TComponents Types of the components each entity must have.
+	/// \author Raffaele D. Facendola
+	template <typename... TComponents>
+	class ComponentQuery{
+
+		friend class ArchetypeStorage;
+
+	public:
+
+		/// \brief Call a function for each entity matching the query.
+		/// When an entity has more than one component of the same type, only the first one is visited.
+		/// \param function Function to call, with signature (TComponents&...) -> void.
+		template <typename TFunction>
+		void ForEach(TFunction function) const;
+
+		/// \brief Get the number of entities matching the query.
+		size_t GetSize() const;
+
+	private:
+
+		/// \brief Entities of an archetype matching the query.
+		struct Chunk{
+
+			size_t size;																	///< \brief Number of entities.
+
+			std::array<Component* const*, sizeof...(TComponents)> columns;				///< \brief Packed array of each component type, in the same order as TComponents.
+
+		};
+
+		/// \brief Call a function for an entity of a chunk.
+		template <typename TFunction, size_t... kIndices>
+		static void Invoke(TFunction& function, const Chunk& chunk, size_t row, IndexSequence<kIndices...>);
+
+		vector<Chunk> chunks_;		///< \brief Chunks matching the query.
+
+	};
+
+	/// \brief Groups entities by archetype, that is by the set of component types they expose.
+	/// The entities of the same archetype store their components inside packed arrays, one per component type, so that queries visit them linearly rather than chasing each entity.
+	/// Entities move to a different archetype as soon as they gain or lose a component.
+	/// \author Raffaele D. Facendola
+	class ArchetypeStorage{
+
+		friend class Component;
+
+	public:
+
+		/// \brief Create an empty storage.
+		ArchetypeStorage();
+
+		/// \brief No copy constructor.
+		ArchetypeStorage(const ArchetypeStorage&) = delete;
+
+		/// \brief Destructor.
+		/// Entities still inside the storage are detached.
+		~ArchetypeStorage();
+
+		/// \brief No assignment operator.
+		ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+		/// \brief Add an entity to the storage.
+		/// The entity is tracked until it is destroyed or the storage is destroyed. An entity can belong to a single storage.
+		/// \param component Any component of the entity.
+		void AddEntity(Component& component);
+
+		/// \brief Get the components of every entity exposing all the specified types.
+		/// \tparam TComponents Types of the components each entity must have.
+		template <typename... TComponents>
+		ComponentQuery<TComponents...> Query() const;
+
+		/// \brief Get the number of archetypes created so far.
+		size_t GetArchetypeCount() const;
+
+	private:
+
+		/// \brief Index of a missing column or archetype.
+		static const unsigned int kNone;
+
+		/// \brief Entities exposing the same set of component types.
+		struct Archetype{
+
+			vector<ComponentTypeId> types;				///< \brief Sorted component types of the archetype.
+
+			vector<unsigned int> columns;				///< \brief Column of each component type id, or kNone if the archetype lacks the type.
+
+			vector<vector<Component*>> components;		///< \brief First component of each type, for each entity.
+
+			vector<Component::Arbiter*> entities;		///< \brief Entities of the archetype.
+
+		};
+
+		/// \brief Move an entity to the archetype matching its current components.
+		void Relocate(Component::Arbiter& entity);
+
+		/// \brief Remove an entity from its archetype.
+		void Remove(Component::Arbiter& entity);
+
+		/// \brief Find the archetype exposing a set of component types, creating it if needed.
+		unsigned int FindArchetype(const vector<ComponentTypeId>& types);
+
+		/// \brief Get the packed array of a component type inside an archetype.
+		/// \return Returns the array of components of the specified type, or nullptr if the archetype lacks the type.
+		static Component* const* GetColumn(const Archetype& archetype, ComponentTypeId type);
+
+		vector<Archetype> archetypes_;								///< \brief Archetypes created so far.
+
+		map<vector<ComponentTypeId>, unsigned int> archetype_map_;	///< \brief Index of the archetype exposing each set of component types.
+
+	};
+
+	//////////////////////// COMPONENT QUERY ///////////////////////
+
+	template <typename... TComponents>
+	template <typename TFunction>
+	void ComponentQuery<TComponents...>::ForEach(TFunction function) const{
+
+		for (auto&& chunk : chunks_){
+
+			for (size_t row = 0; row < chunk.size; ++row){
+
+				Invoke(function, chunk, row, typename MakeIndexSequence<sizeof...(TComponents)>::type());
+
+			}
+
+		}
+
+	}
+
+	template <typename... TComponents>
+	size_t ComponentQuery<TComponents...>::GetSize() const{
+
+		size_t size = 0;
+
+		for (auto&& chunk : chunks_){
+
+			size += chunk.size;
+
+		}
+
+		return size;
+
+	}
+
+	template <typename... TComponents>
+	template <typename TFunction, size_t... kIndices>
+	void ComponentQuery<TComponents...>::Invoke(TFunction& function, const Chunk& chunk, size_t row, IndexSequence<kIndices...>){
+
+		function(*static_cast<TComponents*>(chunk.columns[kIndices][row])...);
+
+	}
+
+	//////////////////////// ARCHETYPE STORAGE ///////////////////////
+
+	template <typename... TComponents>
+	ComponentQuery<TComponents...> ArchetypeStorage::Query() const{
+
+		ComponentQuery<TComponents...> query;
+
+		for (auto&& archetype : archetypes_){
+
+			typename ComponentQuery<TComponents...>::Chunk chunk = { archetype.entities.size(),
+																	 { { GetColumn(archetype, Component::GetTypeId<TComponents>())... } } };
+
+			if (chunk.size > 0 &&
+				std::find(chunk.columns.begin(), chunk.columns.end(), nullptr) == chunk.columns.end()){
+
+				query.chunks_.push_back(chunk);
+
+			}
+
+		}
+
+		return query;
+
+	}
+
+	inline size_t ArchetypeStorage::GetArchetypeCount() const{
 
-		return static_cast<TComponent*>(component_pair.second);
+		return archetypes_.size();
 
 	}
 
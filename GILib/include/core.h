@@ -73,6 +73,16 @@ namespace gi_lib{
 
 	};
 
+	/// \brief Describes a file inside a directory.
+	/// \author Raffaele D. Facendola
+	struct FileEntry{
+
+		wstring name;					///< Name of the file, without directory.
+		unsigned long long size;		///< Size of the file, in bytes.
+		unsigned long long write_time;	///< Time of the last write, in ticks. Only the order of the ticks is meaningful.
+
+	};
+
 	/// \brief Operating system.
 	/// \author Raffaele D. Facendola
 	enum class OperatingSystem{
@@ -137,6 +147,36 @@ namespace gi_lib{
 		/// \return Returns the content of the specified file.
 		virtual wstring Read(const wstring& file_name) const = 0;
 
+		/// \brief Create a directory if it doesn't exist already.
+		/// The parent directory must exist.
+		/// \param directory Path of the directory.
+		/// \return Returns true if the directory exists, returns false otherwise.
+		virtual bool MakeDirectory(const wstring& directory) const = 0;
+
+		/// \brief Enumerate the files inside a directory.
+		/// Subdirectories are not listed.
+		/// \param directory Path of the directory.
+		/// \param extension Extension of the files to enumerate, including the separator.
+		/// \param files Receives the files found inside the directory. Output.
+		virtual void EnumerateFiles(const wstring& directory, const wstring& extension, vector<FileEntry>& files) const = 0;
+
+		/// \brief Rename a file atomically, replacing the destination if it exists already.
+		/// Both files must be on the same volume: readers see either the old destination or the new one, never a partial file.
+		/// \param source Name of the file to rename.
+		/// \param destination New name of the file.
+		/// \return Returns true if the file was renamed, returns false otherwise.
+		virtual bool Rename(const wstring& source, const wstring& destination) const = 0;
+
+		/// \brief Delete a file.
+		/// \param file_name Name of the file to delete.
+		/// \return Returns true if the file was deleted, returns false otherwise.
+		virtual bool Remove(const wstring& file_name) const = 0;
+
+		/// \brief Set the time of the last write of a file to the current time.
+		/// \param file_name Name of the file to touch.
+		/// \return Returns true if the time was updated, returns false otherwise.
+		virtual bool Touch(const wstring& file_name) const = 0;
+
 	};
 
 	/// \brief Manages the application instance.
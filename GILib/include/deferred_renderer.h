@@ -34,6 +34,9 @@ namespace gi_lib{
         /// \brief Virtual destructor.
         virtual ~DeferredRendererMaterial();
 
+        /// \brief Get the category of the memory used by the resource.
+        virtual MemoryCategory GetMemoryCategory() const override;
+
         /// \brief Get the base material.
         /// \return Returns the base material.
         virtual ObjectPtr<IMaterial> GetMaterial() = 0;
@@ -77,6 +80,10 @@ namespace gi_lib{
         /// \brief Enable or disable the global illumination.
         virtual void EnableGlobalIllumination(bool enable = true) = 0;
 
+        /// \brief Enable or disable the software occlusion culling.
+        /// When enabled, the meshes hidden by the occluders are not submitted to the GPU.
+        virtual void EnableOcclusionCulling(bool enable = true) = 0;
+
         /// \brief Overlay the voxel structure on top of a given image.
         virtual ObjectPtr<ITexture2D> DrawVoxels(const ObjectPtr<ITexture2D>& image, int mip = kMIPAuto) = 0;
 
@@ -99,6 +106,12 @@ namespace gi_lib{
 
     inline DeferredRendererMaterial::~DeferredRendererMaterial(){}
 
+    inline MemoryCategory DeferredRendererMaterial::GetMemoryCategory() const{
+
+        return MemoryCategory::kShader;
+
+    }
+
 }
 
 
@@ -0,0 +1,155 @@
+/// \file derived_data_cache.h
+/// \brief Classes and methods to store the outputs of the importers on disk.
+///
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <type_traits>
+
+using ::std::wstring;
+using ::std::string;
+using ::std::vector;
+using ::std::mutex;
+
+namespace gi_lib{
+
+	/// \brief Identifies the output of an importer by the inputs it was derived from.
+	/// The key hashes the name and the version of the importer, followed by every source file and option added by the importer.
+	/// Any change to an input yields a different key, so stale outputs are never found and simply age out of the cache.
+	/// The hash is 128-bit wide but not cryptographic: it guards against accidental collisions only.
+	/// \author Raffaele D. Facendola
+	class DerivedDataKey{
+
+	public:
+
+		/// \brief Create a new key.
+		/// \param importer Name of the importer producing the output.
+		/// \param version Version of the importer. Bump it whenever the output of the importer changes.
+		DerivedDataKey(const string& importer, unsigned int version);
+
+		/// \brief Hash the content of a file.
+		/// \param file_name Name of the file.
+		/// \return Returns true if the file was read, returns false otherwise.
+		bool AddFile(const wstring& file_name);
+
+		/// \brief Hash a memory block.
+		/// \param data Pointer to the memory block.
+		/// \param size Size of the memory block, in bytes.
+		void AddData(const void* data, size_t size);
+
+		/// \brief Hash a plain value, such as an import option.
+		/// \param value Value to hash.
+		template <typename TValue>
+		void AddValue(const TValue& value);
+
+		/// \brief Get the name of the key.
+		/// \return Returns the digest of every input added so far, as an hexadecimal string.
+		wstring GetName() const;
+
+	private:
+
+		/// \brief Hash a single 64-bit word.
+		void AddWord(unsigned long long word);
+
+		unsigned long long lanes_[2];			///< \brief Running state of the two halves of the hash.
+
+		unsigned long long tail_;				///< \brief Bytes which don't fill a whole word yet.
+
+		size_t length_;							///< \brief Number of bytes hashed so far.
+
+	};
+
+	/// \brief Stores the outputs of the importers as binary blobs inside a local directory.
+	/// Each blob is named after its key and written to a temporary file first, then renamed: a blob is either complete or missing, even if the application dies while writing it.
+	/// Reading a blob marks it as used. Whenever the blobs exceed the capacity, the ones used least recently are deleted.
+	/// The cache is safe to use from different threads and different processes.
+	/// \author Raffaele D. Facendola
+	class DerivedDataCache{
+
+	public:
+
+		/// \brief Create a cache.
+		/// The directory is created if it doesn't exist, then trimmed to the capacity.
+		/// \param directory Directory where the blobs are stored.
+		/// \param capacity Maximum size of the blobs, in bytes.
+		DerivedDataCache(const wstring& directory, size_t capacity);
+
+		/// \brief No copy constructor.
+		DerivedDataCache(const DerivedDataCache&) = delete;
+
+		/// \brief No assignment operator.
+		DerivedDataCache& operator=(const DerivedDataCache&) = delete;
+
+		/// \brief Read a blob.
+		/// \param key Key of the blob.
+		/// \param data Receives the content of the blob. Output.
+		/// \return Returns true if the blob was found, returns false otherwise.
+		/// \remarks Malformed blobs are deleted and reported as missing.
+		bool Get(const DerivedDataKey& key, vector<char>& data) const;
+
+		/// \brief Write a blob, replacing any blob with the same key.
+		/// \param key Key of the blob.
+		/// \param data Pointer to the content of the blob.
+		/// \param size Size of the content, in bytes.
+		/// \return Returns true if the blob was written, returns false otherwise.
+		bool Put(const DerivedDataKey& key, const void* data, size_t size);
+
+		/// \brief Delete the blobs used least recently until the cache fits its capacity.
+		/// Temporary files left behind by writers which died are deleted as well, while the ones still being written count towards the capacity.
+		void Trim();
+
+		/// \brief Get the directory where the blobs are stored.
+		const wstring& GetDirectory() const;
+
+		/// \brief Get the maximum size of the blobs, in bytes.
+		size_t GetCapacity() const;
+
+		/// \brief Get the size of the blobs, in bytes.
+		/// \remarks Blobs written by other processes are counted as soon as the cache is trimmed.
+		size_t GetSize() const;
+
+	private:
+
+		/// \brief Get the name of the file storing a blob.
+		wstring GetFileName(const DerivedDataKey& key) const;
+
+		wstring directory_;						///< \brief Directory where the blobs are stored, including the trailing separator.
+
+		size_t capacity_;						///< \brief Maximum size of the blobs, in bytes.
+
+		size_t size_;							///< \brief Size of the blobs, in bytes.
+
+		mutable mutex mutex_;					///< \brief Guards the size and the trimming.
+
+	};
+
+	/////////////////////////////// DERIVED DATA KEY ///////////////////////////////
+
+	template <typename TValue>
+	inline void DerivedDataKey::AddValue(const TValue& value){
+
+		static_assert(std::is_trivially_copyable<TValue>::value, "Only plain values can be hashed.");
+
+		AddData(&value, sizeof(TValue));
+
+	}
+
+	/////////////////////////////// DERIVED DATA CACHE ///////////////////////////////
+
+	inline const wstring& DerivedDataCache::GetDirectory() const{
+
+		return directory_;
+
+	}
+
+	inline size_t DerivedDataCache::GetCapacity() const{
+
+		return capacity_;
+
+	}
+
+}
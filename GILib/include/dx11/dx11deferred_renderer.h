@@ -16,6 +16,8 @@
 #include "dx11buffer.h"
 #include "dx11gpgpu.h"
 #include "buffer.h"
+#include "occlusion_buffer.h"
+#include "temporal_volume_query.h"
 
 #include "dx11deferred_renderer_shared.h"
 #include "dx11deferred_renderer_lighting.h"
@@ -95,6 +97,8 @@ namespace gi_lib{
 			virtual ObjectPtr<ITexture2D> Draw(const Time& time, unsigned int width, unsigned int height) override;
 
 			virtual void EnableGlobalIllumination(bool enable /* = true */) override;
+
+			virtual void EnableOcclusionCulling(bool enable /* = true */) override;
 			
 			Matrix4f GetViewProjectionMatrix(float aspect_ratio) const;
 
@@ -106,6 +110,14 @@ namespace gi_lib{
 
 		private:
 
+			/// \brief Find the visible lights and resolve every query against the mesh hierarchy needed by the frame.
+			/// Mesh queries are batched so that the mesh hierarchy is traversed only once per frame.
+			void ComputeVisibility(const FrameInfo& frame_info);
+
+			/// \brief Rasterize the occluders visible from the camera and discard the meshes they hide.
+			/// The remaining meshes are stored inside the visible meshes list.
+			void ComputeOcclusion(const FrameInfo& frame_info);
+
 			/// \brief Draw the current scene on the GBuffer.
 			/// \param dimensions Dimensions of the GBuffer in pixels.
 			void DrawGBuffer(const FrameInfo& frame_info);
@@ -113,7 +125,7 @@ namespace gi_lib{
 			/// \brief Draws the specified nodes on the GBuffer.
 			/// \param nodes Nodes to draw.
 			/// \param frame_info Information about the frame being rendered.
-			void DrawNodes(const vector<VolumeComponent*>& meshes, const FrameInfo& frame_info);
+			void DrawNodes(const vector<VolumeComponent*>& nodes, const FrameInfo& frame_info);
 			
 			/// \param dimensions Dimensions of the LightBuffer in pixels.
 			/// \param frame_info Information about the frame being rendered.
@@ -131,6 +143,26 @@ namespace gi_lib{
 
 			ObjectPtr<DX11RenderTarget> gbuffer_;								///< \brief GBuffer.
 
+			// Visibility
+
+			vector<VolumeComponent*> visible_lights_;							///< \brief Lights visible from the current camera. Reused across frames.
+
+			VolumeQueryBatch mesh_queries_;										///< \brief Queries traversing the mesh hierarchy during the current frame. Reused across frames.
+
+			TemporalVolumeQuery camera_query_;									///< \brief Meshes visible from the current camera, cached across frames.
+
+			TemporalVolumeQuery voxelization_query_;							///< \brief Meshes inside the voxelization domain, cached across frames.
+
+			// Occlusion culling
+
+			bool enable_occlusion_culling_;										///< \brief Whether to enable the software occlusion culling.
+
+			OcclusionBuffer occlusion_buffer_;									///< \brief Depth of the occluders visible from the camera.
+
+			vector<std::pair<float, VolumeComponent*>> occluders_;				///< \brief Occluders visible from the camera, sorted by distance. Reused across frames.
+
+			vector<VolumeComponent*> visible_meshes_;							///< \brief Meshes visible from the camera and not occluded. Reused across frames.
+
 			// Light accumulation
 
 			std::unique_ptr<DX11DeferredRendererLighting> lighting_;			///< \brief Object used to calculate scene lighting.
@@ -187,6 +219,12 @@ namespace gi_lib{
 
 		}
 
+		inline void DX11DeferredRenderer::EnableOcclusionCulling(bool enable) {
+
+			enable_occlusion_culling_ = enable;
+
+		}
+
 		inline ObjectPtr<ITexture2D> DX11DeferredRenderer::DrawVoxels(const ObjectPtr<ITexture2D>& image, int mip) {
 
 			return voxelization_->DrawVoxels(image, mip);
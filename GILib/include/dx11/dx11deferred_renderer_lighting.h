@@ -7,9 +7,12 @@
 
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 #include "object.h"
 #include "tag.h"
+#include "volume_hierarchy.h"
+#include "temporal_volume_query.h"
 #include "dx11deferred_renderer_shared.h"
 
 #include "dx11\dx11.h"
@@ -28,6 +31,7 @@ namespace gi_lib {
     class PointLightComponent;
     class DirectionalLightComponent;
     class VolumeComponent;
+    class Component;
     
     namespace dx11 {
 
@@ -100,9 +104,20 @@ namespace gi_lib {
             /// \brief No assignment operator.
             DX11DeferredRendererLighting& operator=(DX11DeferredRendererLighting&) = delete;
 
+            /// \brief Update the queries used to find the geometry casting the shadows of the specified lights.
+            /// Each light keeps its own temporal query: only the queries whose cached results are no longer valid are added to the batch.
+            /// \param lights Lights whose contribution needs to be accumulated.
+            /// \param casters Mesh hierarchy the batch will be resolved against.
+            /// \param batch Batch of queries resolved against the mesh hierarchy.
+            void UpdateShadowQueries(const std::vector<VolumeComponent*>& lights, const IVolumeHierarchy& casters, VolumeQueryBatch& batch);
+
+            /// \brief Read the results of the shadow queries added to a batch.
+            /// \param batch Batch passed to UpdateShadowQueries, after being resolved.
+            void ResolveShadowQueries(const VolumeQueryBatch& batch);
+
             /// \brief Accumulate the light from the specified light sources inside the light accumulation buffer.
             /// \param gbuffer GBuffer containing the scene
-            /// \param lights Lights whose contribution needs to be accumulated.
+            /// \param lights Lights whose contribution needs to be accumulated. Must match the lights passed to UpdateShadowQueries.
             /// \param frame_info Information about the frame being rendered.
             ObjectPtr<ITexture2D> AccumulateLight(const ObjectPtr<IRenderTarget>& gbuffer, const std::vector<VolumeComponent*>& lights, const FrameInfo& frame_info);
 
@@ -117,16 +132,18 @@ namespace gi_lib {
 
             /// \brief Write the informations about a point light and its shadow.
             /// \param point_light Source light.
+            /// \param casters Geometry casting the shadow.
             /// \param light Contains the informations of the point light. Output.
             /// \param shadow Contains the informations of the point shadow. Output.
-            void UpdateLight(const Scene& scene, const PointLightComponent& point_light, PointLight& light, PointShadow& shadow, bool light_injection);
+            void UpdateLight(const PointLightComponent& point_light, VolumeQueryBatch::IntersectionRange casters, PointLight& light, PointShadow& shadow, bool light_injection);
 
             /// \brief Write the informations about a directional light and its shadow.
             /// \param directional_light Source light.
+            /// \param casters Geometry casting the shadow.
             /// \param aspect_ratio Aspect ratio of the client viewport.
             /// \param light Contains the informations of the directional light. Output.
             /// \param shadow Contains the informations of the directional shadow. Output.
-            void UpdateLight(const Scene& scene, const DirectionalLightComponent& directional_light, float aspect_ratio, DirectionalLight& light, DirectionalShadow& shadow, bool light_injection);
+            void UpdateLight(const DirectionalLightComponent& directional_light, VolumeQueryBatch::IntersectionRange casters, float aspect_ratio, DirectionalLight& light, DirectionalShadow& shadow, bool light_injection);
             
             /// \brief Accumulate direct lighting.
             void AccumulateDirectLight(const ObjectPtr<IRenderTarget>& gbuffer, const FrameInfo &frame_info);
@@ -194,6 +211,19 @@ namespace gi_lib {
 
             ObjectPtr<DX11StructuredArray> directional_shadows_;				///< \brief Array containing the directional lights.
 
+            /// \brief Caster query of a shadowcasting light.
+            struct ShadowQuery {
+
+                TemporalVolumeQuery casters;									///< \brief Geometry casting the shadow of the light.
+
+                bool used;														///< \brief Whether the light was updated during the current frame.
+
+            };
+
+            std::unordered_map<const Component*, ShadowQuery> shadow_query_cache_;	///< \brief Caster query of each light, kept across frames. Lights which are not updated in a frame lose their query.
+
+            vector<TemporalVolumeQuery*> shadow_queries_;						///< \brief Caster query of each light, in the order the lights are updated.
+
             // Indirect lighting
 
             static const Tag kReflectiveShadowMapTag;							///< \brief Tag associated to the texture containing the albedo and the normal of the reflective shadow map.
@@ -123,10 +123,18 @@ namespace gi_lib{
 			/// \brief No assignment operator.
 			DX11Resources & operator=(const DX11Resources&) = delete;
 
+			/// \brief Destructor.
+			/// The loaders are not stopped here, since the singleton is destroyed during static destruction: the owner must call StopLoaders before exiting.
+			virtual ~DX11Resources();
+
 		protected:
 
 			virtual ObjectPtr<IResource> Load(const type_index& resource_type, const type_index& args_type, const void* args) const override;
 
+			/// \brief Run the part of a load which can be executed by a worker thread.
+			/// Resources whose creation touches the device only are created entirely by the worker, since DirectX 11 devices are free-threaded. Every other resource is created on the thread owning the resources.
+			virtual function<ObjectPtr<IResource>()> PrepareLoad(const type_index& resource_type, const type_index& args_type, const void* args) const override;
+
 		private:
 
 			/// \brief Create a new instance of DirectX11 resource manager.
@@ -47,10 +47,16 @@ namespace gi_lib{
 
 			virtual const AABB& GetBoundingBox() const override;
 
+			virtual const vector<Vector3f>& GetPositions() const override;
+
+			virtual const vector<unsigned int>& GetIndices() const override;
+
 			virtual size_t GetSubsetCount() const override;
 
 			virtual const MeshSubset& GetSubset(unsigned int subset_index) const override;
 
+			virtual size_t GetIndexCount(unsigned int subset_index) const override;
+
 			/// \brief Bind the mesh to the given context.
 			void Bind(ID3D11DeviceContext& context, bool tessellable = false);
 
@@ -75,6 +81,9 @@ namespace gi_lib{
 
 		private:
 
+			/// \brief Keep a system-memory copy of the geometry if any subset is an occluder, release it otherwise.
+			void UpdateGeometryCopy();
+
 			COMPtr<ID3D11Buffer> vertex_buffer_;
 
 			COMPtr<ID3D11Buffer> index_buffer_;
@@ -93,6 +102,10 @@ namespace gi_lib{
 			size_t vertex_stride_;											///< \brief Size of each vertex in bytes
 
 			AABB bounding_box_;
+
+			vector<Vector3f> positions_;									///< \brief Copy of the vertex positions in system memory. Empty unless a subset is an occluder.
+
+			vector<unsigned int> indices_;									///< \brief Copy of the indices in system memory. Empty unless a subset is an occluder.
 			
 			vector<std::wstring> subset_names_;
 
@@ -124,7 +137,9 @@ namespace gi_lib{
 
 		inline size_t DX11Mesh::GetSize() const{
 
-			return size_;
+			return size_ +
+				   positions_.size() * sizeof(Vector3f) +
+				   indices_.size() * sizeof(unsigned int);
 
 		}
 
@@ -134,6 +149,18 @@ namespace gi_lib{
 
 		}
 
+		inline const vector<Vector3f>& DX11Mesh::GetPositions() const{
+
+			return positions_;
+
+		}
+
+		inline const vector<unsigned int>& DX11Mesh::GetIndices() const{
+
+			return indices_;
+
+		}
+
 		inline size_t DX11Mesh::GetSubsetCount() const{
 
 			return subsets_.size();
@@ -146,6 +173,14 @@ namespace gi_lib{
 
 		}
 
+		inline size_t DX11Mesh::GetIndexCount(unsigned int subset_index) const{
+
+			return index_buffer_ ?
+				   subsets_[subset_index].count :
+				   subsets_[subset_index].count * 3;			// Count of non-indexed subsets is expressed in triangles
+
+		}
+
 		inline void DX11Mesh::SetName(const std::wstring& name) {
 
 			name_ = name;
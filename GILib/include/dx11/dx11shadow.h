@@ -6,6 +6,7 @@
 #pragma once
 
 #include "object.h"
+#include "volume_hierarchy.h"
 
 #include "dx11graphics.h"
 #include "dx11sampler.h"
@@ -72,21 +73,31 @@ namespace gi_lib {
 			/// \brief Reset the current status of the shadowmap atlas.
 			void Reset();
 
+			/// \brief Get the region of space containing the geometry casting the shadow of a point light.
+			/// \param point_light Point light casting the shadow.
+			/// \return Returns the sphere used to query the caster geometry.
+			Sphere GetCasterDomain(const PointLightComponent& point_light) const;
+
+			/// \brief Get the region of space containing the geometry casting the shadow of a directional light.
+			/// \param directional_light Directional light casting the shadow.
+			/// \return Returns the sphere used to query the caster geometry.
+			Sphere GetCasterDomain(const DirectionalLightComponent& directional_light) const;
+
 			/// \brief Computes a variance shadowmap.
 			/// \param point_light Point light casting the shadow.
-			/// \param scene Scene containing the caster geometry.
+			/// \param casters Geometry inside the caster domain of the light.
 			/// \param shadow Structure containing the data used to access the shadowmap for the HLSL code.
 			/// \param shadow_map If the method succeeds, it contains the computed VSM prior to the soft shadows stage. Optional.
 			/// \return Returns true if the shadowmap was calculated correctly, returns false otherwise.
-			bool ComputeShadowmap(const PointLightComponent& point_light, const Scene& scene, PointShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map = nullptr);
+			bool ComputeShadowmap(const PointLightComponent& point_light, VolumeQueryBatch::IntersectionRange casters, PointShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map = nullptr);
 			
 			/// \brief Computes a variance shadowmap.
 			/// \param directional_light Point light casting the shadow.
-			/// \param scene Scene containing the caster geometry.
+			/// \param casters Geometry inside the caster domain of the light.
 			/// \param shadow Structure containing the data used to access the shadowmap for the HLSL code.
 			/// \param shadow_map If the method succeeds, it contains the computed VSM prior to the soft shadows stage. Optional.
 			/// \return Returns true if the shadowmap was calculated correctly, returns false otherwise.
-			bool ComputeShadowmap(const DirectionalLightComponent& directional_light, const Scene& scene, DirectionalShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map = nullptr);
+			bool ComputeShadowmap(const DirectionalLightComponent& directional_light, VolumeQueryBatch::IntersectionRange casters, DirectionalShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map = nullptr);
 			
 			/// \brief Get the shadow atlas.
 			ObjectPtr<ITexture2D> GetAtlas();
@@ -96,11 +107,11 @@ namespace gi_lib {
 
 		private:
 						
-			void DrawShadowmap(const PointShadow& shadow, const vector<VolumeComponent*>& nodes, const Matrix4f& light_view_transform, ObjectPtr<IRenderTarget>* shadow_map);
+			void DrawShadowmap(const PointShadow& shadow, VolumeQueryBatch::IntersectionRange nodes, const Matrix4f& light_view_transform, ObjectPtr<IRenderTarget>* shadow_map);
 
-			void DrawShadowmap(const DirectionalShadow& shadow, const vector<VolumeComponent*>& nodes, const Matrix4f& light_proj_transform, ObjectPtr<IRenderTarget>* shadow_map);
+			void DrawShadowmap(const DirectionalShadow& shadow, VolumeQueryBatch::IntersectionRange nodes, const Matrix4f& light_proj_transform, ObjectPtr<IRenderTarget>* shadow_map);
 
-			void DrawShadowmap(const AlignedBox2i& boundaries, unsigned int atlas_page, const vector<VolumeComponent*> nodes, const ObjectPtr<DX11Material>& shadow_material, const Matrix4f& light_transform, ObjectPtr<IRenderTarget>* shadow_map, bool tessellable = false);
+			void DrawShadowmap(const AlignedBox2i& boundaries, unsigned int atlas_page, VolumeQueryBatch::IntersectionRange nodes, const ObjectPtr<DX11Material>& shadow_material, const Matrix4f& light_transform, ObjectPtr<IRenderTarget>* shadow_map, bool tessellable = false);
 
 			COMPtr<ID3D11DeviceContext> immediate_context_;			///< \brief Immediate rendering context.
 
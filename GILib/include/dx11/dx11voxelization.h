@@ -10,6 +10,7 @@
 
 #include "object.h"
 #include "tag.h"
+#include "volume_hierarchy.h"
 
 #include "dx11\dx11.h"
 #include "dx11\dx11graphics.h"
@@ -63,8 +64,14 @@ namespace gi_lib {
 
 			~DX11Voxelization();
 
+			/// \brief Get the region of space covered by the voxel structure.
+			/// \param frame_info Information about the frame being rendered.
+			AABB GetGridDomain(const FrameInfo& frame_info) const;
+
 			/// \brief Update the voxel structure.
-			void Update(const FrameInfo& frame_info);
+			/// \param frame_info Information about the frame being rendered.
+			/// \param nodes Nodes intersecting the grid domain.
+			void Update(const FrameInfo& frame_info, VolumeQueryBatch::IntersectionRange nodes);
 
 			/// \brief Get the total amount of voxels.
 			unsigned int GetVoxelCount() const;
@@ -11,6 +11,12 @@
 #include <algorithm>
 #include <vector>
 
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+#endif
+
 #include "enums.h"
 
 
@@ -75,27 +81,191 @@ namespace gi_lib{
 
 	};
 
+	/// \brief Stream of axis-aligned bounding boxes stored as a structure of arrays.
+	/// The layout allows many boxes to be tested at once using SIMD instructions.
+	class AABBStream{
+
+	public:
+
+		/// \brief Get the number of boxes inside the stream.
+		size_t GetSize() const;
+
+		/// \brief Get a box.
+		/// \param index Index of the box.
+		AABB Get(size_t index) const;
+
+		/// \brief Overwrite a box.
+		/// \param index Index of the box.
+		/// \param aabb New value of the box.
+		void Set(size_t index, const AABB& aabb);
+
+		/// \brief Append a box at the end of the stream.
+		/// \param aabb Box to append.
+		void PushBack(const AABB& aabb);
+
+		/// \brief Remove a box by moving the last box of the stream in its place.
+		/// \param index Index of the box to remove.
+		void SwapPop(size_t index);
+
+		/// \brief Remove a box preserving the order of the remaining ones.
+		/// \param index Index of the box to remove.
+		void Erase(size_t index);
+
+		/// \brief Remove every box from the stream.
+		void Clear();
+
+	private:
+
+		friend class Frustum;
+
+		vector<float> center_[3];				///< \brief Center of each box, one array per axis.
+
+		vector<float> half_extents_[3];			///< \brief Half-extents of each box, one array per axis.
+
+	};
+
+	/// \brief Stream of spheres stored as a structure of arrays.
+	/// The layout allows many spheres to be tested at once using SIMD instructions.
+	class SphereStream{
+
+	public:
+
+		/// \brief Get the number of spheres inside the stream.
+		size_t GetSize() const;
+
+		/// \brief Get a sphere.
+		/// \param index Index of the sphere.
+		Sphere Get(size_t index) const;
+
+		/// \brief Overwrite a sphere.
+		/// \param index Index of the sphere.
+		/// \param sphere New value of the sphere.
+		void Set(size_t index, const Sphere& sphere);
+
+		/// \brief Append a sphere at the end of the stream.
+		/// \param sphere Sphere to append.
+		void PushBack(const Sphere& sphere);
+
+		/// \brief Remove a sphere by moving the last sphere of the stream in its place.
+		/// \param index Index of the sphere to remove.
+		void SwapPop(size_t index);
+
+		/// \brief Remove a sphere preserving the order of the remaining ones.
+		/// \param index Index of the sphere to remove.
+		void Erase(size_t index);
+
+		/// \brief Remove every sphere from the stream.
+		void Clear();
+
+	private:
+
+		friend class Frustum;
+
+		vector<float> center_[3];				///< \brief Center of each sphere, one array per axis.
+
+		vector<float> radius_;					///< \brief Radius of each sphere.
+
+	};
+
 	/// \brief Represents a frustum.
 	class Frustum{
 
 	public:
 
+		/// \brief Mask including every plane of the frustum.
+		static const unsigned int kAllPlanes = 0x3F;
+
+		/// \brief Number of planes of the frustum.
+		static const size_t kFrustumPlanes = 6;
+
+		/// \brief Create an empty frustum, which contains no point at all.
+		Frustum();
+
 		/// \brief Create a new frustum from six planes.
 		/// \param Contains the planes used to initialize the frustum. Must be 6.
 		Frustum(const vector<Vector4f>& planes);
 
+		/// \brief Get a plane of the frustum.
+		/// \param index Index of the plane. Must be less than kFrustumPlanes.
+		/// \return Returns the plane. The normal points towards the center of the frustum and is normalized.
+		const Vector4f& GetPlane(size_t index) const;
+
+		/// \brief Get a copy of the frustum whose planes are moved outwards.
+		/// \param distance Distance each plane is moved by.
+		/// \return Returns a frustum containing every point whose distance from this frustum is at most the specified distance.
+		Frustum Inflate(float distance) const;
+
 		/// \brief Intersection test between the frustum and an axis-aligned bounding box.
 		/// \param aabb The AABB to test against.
+		/// \return Returns kNone if the box is outside the frustum, kIntersect if the box intersects the frustum and kIntersect | kInside if the box is fully inside the frustum.
 		IntersectionType Intersect(const AABB& aabb) const;
 
+		/// \brief Intersection test between the frustum and an axis-aligned bounding box, restricted to a subset of planes.
+		/// Planes that fully contain a box fully contain every volume inside that box as well: the resulting mask can be used to test those volumes.
+		/// \param aabb The AABB to test against.
+		/// \param plane_mask Bitmask of the planes to test. When the box is not outside, the bits of the planes that fully contain the box are cleared.
+		/// \return Returns kNone if the box is outside the frustum, kIntersect if the box intersects the frustum and kIntersect | kInside if the box is fully inside the tested planes.
+		IntersectionType Intersect(const AABB& aabb, unsigned int& plane_mask) const;
+
 		/// \brief Intersection test between the frustum a sphere.
 		/// The test is cheaper than the axis-aligned one.
 		/// \param sphere The sphere to test against.
+		/// \return Returns kNone if the sphere is outside the frustum, kIntersect if the sphere intersects the frustum and kIntersect | kInside if the sphere is fully inside the frustum.
 		IntersectionType Intersect(const Sphere& sphere) const;
 
-	private:
+		/// \brief Intersection test between the frustum and a sphere, restricted to a subset of planes.
+		/// \param sphere The sphere to test against.
+		/// \param plane_mask Bitmask of the planes to test. When the sphere is not outside, the bits of the planes that fully contain the sphere are cleared.
+		/// \return Returns kNone if the sphere is outside the frustum, kIntersect if the sphere intersects the frustum and kIntersect | kInside if the sphere is fully inside the tested planes.
+		IntersectionType Intersect(const Sphere& sphere, unsigned int& plane_mask) const;
+
+		/// \brief Intersection test between the frustum and a stream of axis-aligned bounding boxes.
+		/// Boxes are tested 8 (AVX) or 4 (SSE) at a time, falling back to a scalar test where SIMD instructions are not available.
+		/// \param aabbs Boxes to test against.
+		/// \param visibility Output bitmask. The bit i % 32 of the word i / 32 is set if the i-th box intersects the frustum. Resized to fit the stream.
+		void Intersect(const AABBStream& aabbs, vector<unsigned int>& visibility) const;
+
+		/// \brief Intersection test between the frustum and a stream of axis-aligned bounding boxes, restricted to a subset of planes.
+		/// \param aabbs Boxes to test against.
+		/// \param plane_mask Bitmask of the planes to test.
+		/// \param visibility Output bitmask. The bit i % 32 of the word i / 32 is set if the i-th box intersects the tested planes. Resized to fit the stream.
+		/// \param containment Output bitmask. The bit i % 32 of the word i / 32 is set if the i-th box is fully inside the tested planes. Resized to fit the stream.
+		void Intersect(const AABBStream& aabbs, unsigned int plane_mask, vector<unsigned int>& visibility, vector<unsigned int>& containment) const;
+
+		/// \brief Intersection test between the frustum and a range of a stream of boxes, restricted to a subset of planes.
+		/// This overload never allocates memory.
+		/// \param aabbs Stream containing the boxes to test against.
+		/// \param begin Index of the first box to test.
+		/// \param end Index past the last box to test.
+		/// \param plane_mask Bitmask of the planes to test.
+		/// \param visibility Output bitmask, relative to the first box of the range. Must hold at least (end - begin + 31) / 32 words.
+		/// \param containment Output bitmask, relative to the first box of the range. Must hold at least (end - begin + 31) / 32 words.
+		void Intersect(const AABBStream& aabbs, size_t begin, size_t end, unsigned int plane_mask, unsigned int* visibility, unsigned int* containment) const;
+
+		/// \brief Intersection test between the frustum and a stream of spheres.
+		/// Spheres are tested 8 (AVX) or 4 (SSE) at a time, falling back to a scalar test where SIMD instructions are not available.
+		/// \param spheres Spheres to test against.
+		/// \param visibility Output bitmask. The bit i % 32 of the word i / 32 is set if the i-th sphere intersects the frustum. Resized to fit the stream.
+		void Intersect(const SphereStream& spheres, vector<unsigned int>& visibility) const;
+
+		/// \brief Intersection test between the frustum and a stream of spheres, restricted to a subset of planes.
+		/// \param spheres Spheres to test against.
+		/// \param plane_mask Bitmask of the planes to test.
+		/// \param visibility Output bitmask. The bit i % 32 of the word i / 32 is set if the i-th sphere intersects the tested planes. Resized to fit the stream.
+		/// \param containment Output bitmask. The bit i % 32 of the word i / 32 is set if the i-th sphere is fully inside the tested planes. Resized to fit the stream.
+		void Intersect(const SphereStream& spheres, unsigned int plane_mask, vector<unsigned int>& visibility, vector<unsigned int>& containment) const;
+
+		/// \brief Intersection test between the frustum and a range of a stream of spheres, restricted to a subset of planes.
+		/// This overload never allocates memory.
+		/// \param spheres Stream containing the spheres to test against.
+		/// \param begin Index of the first sphere to test.
+		/// \param end Index past the last sphere to test.
+		/// \param plane_mask Bitmask of the planes to test.
+		/// \param visibility Output bitmask, relative to the first sphere of the range. Must hold at least (end - begin + 31) / 32 words.
+		/// \param containment Output bitmask, relative to the first sphere of the range. Must hold at least (end - begin + 31) / 32 words.
+		void Intersect(const SphereStream& spheres, size_t begin, size_t end, unsigned int plane_mask, unsigned int* visibility, unsigned int* containment) const;
 
-		static const size_t kFrustumPlanes = 6;
+	private:
 
 		Vector4f planes_[kFrustumPlanes];			///< \brief Planes defining the frustum. The normals point towards the center of the frustum and are normalized.
 
@@ -179,6 +349,11 @@ namespace gi_lib{
 		template <typename T>
         static T Lerp(const T& current, const T& target, float alpha);
 
+		/// \brief Get the index of the least significant bit set.
+		/// \param bits Bits to scan. Must not be 0.
+		/// \return Returns the number of trailing zero bits.
+		static unsigned int CountTrailingZeros(unsigned int bits);
+
 	};
 
 	//////////////////////////////// MATH ////////////////////////
@@ -255,6 +430,24 @@ namespace gi_lib{
 
 	}
 
+	inline unsigned int Math::CountTrailingZeros(unsigned int bits){
+
+#ifdef _MSC_VER
+
+		unsigned long index;
+
+		_BitScanForward(&index, bits);
+
+		return static_cast<unsigned int>(index);
+
+#else
+
+		return static_cast<unsigned int>(__builtin_ctz(bits));
+
+#endif
+
+	}
+
 	template <typename T>
 	T Math::Lerp(const T& current, const T& target, float alpha) {
 
@@ -51,6 +51,13 @@ namespace gi_lib{
 
 		/// \brief Virtual destructor.
 		virtual ~IComputation(){};
+
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kShader;
+
+		}
 		
 		/// \brief Set a texture resource as an input for the current computation.
 		/// The GPU may only read from the specified texture.
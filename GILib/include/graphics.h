@@ -11,6 +11,7 @@
 #include <typeindex>
 #include <typeinfo>
 #include <tuple>
+#include <functional>
 
 #include "resources.h"
 #include "render_target.h"
@@ -24,6 +25,7 @@ using ::std::shared_ptr;
 using ::std::unique_ptr;
 using ::std::weak_ptr;
 using ::std::type_index;
+using ::std::function;
 
 using ::Eigen::Vector2f;
 
@@ -201,6 +203,56 @@ namespace gi_lib{
 		
 	};
 
+	/// \brief State of an asynchronous load, shared by every handle to the same resource.
+	/// The state is accessed by the thread owning the resources only.
+	struct AsyncLoad{
+
+		ObjectPtr<IResource> resource;											///< \brief Loaded resource. Null until the load completes or if the load failed.
+
+		bool completed;															///< \brief Whether the load completed.
+
+		vector<function<void(const ObjectPtr<IResource>&)>> continuations;		///< \brief Functors executed when the load completes.
+
+	};
+
+	/// \brief Handle to a resource being loaded asynchronously.
+	/// The handle returns a placeholder until the load is completed by Resources::Update.
+	/// \tparam TResource Type of the resource.
+	/// \author Raffaele D. Facendola.
+	template <typename TResource>
+	class AsyncResource{
+
+	public:
+
+		/// \brief Create an empty handle.
+		AsyncResource();
+
+		/// \brief Create a handle to a load.
+		/// \param load State of the load.
+		/// \param placeholder Resource returned until the load completes.
+		AsyncResource(shared_ptr<AsyncLoad> load, const ObjectPtr<TResource>& placeholder);
+
+		/// \brief Check whether the load completed.
+		/// \return Returns true if the load completed, either successfully or not, returns false otherwise.
+		bool IsReady() const;
+
+		/// \brief Get the resource.
+		/// \return Returns the loaded resource if the load completed successfully, returns the placeholder otherwise.
+		ObjectPtr<TResource> Get() const;
+
+		/// \brief Execute a functor on the thread owning the resources as soon as the load completes.
+		/// If the load completed already the functor is executed immediately.
+		/// \param continuation Functor receiving the loaded resource, or nullptr if the load failed.
+		void Then(function<void(const ObjectPtr<TResource>&)> continuation) const;
+
+	private:
+
+		shared_ptr<AsyncLoad> load_;					///< \brief State of the load.
+
+		ObjectPtr<TResource> placeholder_;				///< \brief Resource returned until the load completes.
+
+	};
+
 	/// \brief Resource manager interface.
 	/// \author Raffaele D. Facendola.
 	class Resources{
@@ -229,9 +281,61 @@ namespace gi_lib{
 		template <typename TResource, typename TArgs, typename no_cache<TArgs>::type* = nullptr>
 		ObjectPtr<TResource> Load(const typename TArgs& args);
 
+		/// \brief Loads a resource asynchronously.
+		/// The resource is prepared by a worker thread and completed on the thread owning the resources during Update. Requests of a resource which is being loaded share the same load.
+		/// \tparam TResource Type of the resource to load. Must derive from IResource.
+		/// \tparam TLoadArgs Type of the load arguments passed to the object. Arguments must expose caching capabilities.
+		/// \param load_args Arguments that will be passed to the resource's constructor. The arguments are copied.
+		/// \param placeholder Resource returned by the handle until the load completes.
+		/// \return Returns a handle to the resource being loaded. If the resource was already loaded, the handle is ready and points to the existing instance.
+		template <typename TResource, typename TArgs, typename use_cache<TArgs>::type* = nullptr>
+		AsyncResource<TResource> LoadAsync(const typename TArgs& args, const ObjectPtr<TResource>& placeholder = nullptr);
+
+		/// \brief Loads a resource asynchronously.
+		/// The resource is prepared by a worker thread and completed on the thread owning the resources during Update.
+		/// \tparam TResource Type of the resource to load. Must derive from IResource.
+		/// \tparam TLoadArgs Type of the load arguments passed to the object.
+		/// \param load_args Arguments that will be passed to the resource's constructor. The arguments are copied.
+		/// \param placeholder Resource returned by the handle until the load completes.
+		/// \return Returns a handle to a new resource instance being loaded.
+		template <typename TResource, typename TArgs, typename no_cache<TArgs>::type* = nullptr>
+		AsyncResource<TResource> LoadAsync(const typename TArgs& args, const ObjectPtr<TResource>& placeholder = nullptr);
+
+		/// \brief Complete the asynchronous loads prepared since the last call.
+		/// Must be called regularly by the thread owning the resources, usually once per frame. The continuations of the completed loads are executed here.
+		/// If a load throws, the exception is rethrown after every other load was completed.
+		void Update();
+
+		/// \brief Wait for every pending asynchronous load and complete it.
+		void Flush();
+
+		/// \brief Get the number of asynchronous loads which were not completed yet.
+		size_t GetPendingCount() const;
+
+		/// \brief Stop the loader threads. Loads which were not prepared yet fail: their resource is null once completed by Update or Flush.
+		/// The loaders are started again by the next asynchronous load.
+		/// The owner must call this method before exiting: the loader threads call PrepareLoad, and resources destroyed during static destruction cannot join them safely.
+		void StopLoaders();
+
 		/// \brief Get the amount of memory used by the loaded resources.
+		/// The size is kept up to date as resources are loaded and destroyed: see MemoryAccounting for the breakdown by category.
 		size_t GetSize() const;
 
+		/// \brief Set the maximum amount of memory used by the cached resources kept alive after their last use.
+		/// The most recently used cached resources are retained even if no other pointer references them, so that they can be loaded again without reaching the disk.
+		/// Least recently used resources are released first. A budget of 0 disables the retention (default).
+		/// Each retained resource is charged at least the size of its bookkeeping, so that resources reporting no size cannot pile up.
+		/// \param budget Maximum size of the retained resources, in bytes.
+		void SetRetentionBudget(size_t budget);
+
+		/// \brief Get the maximum amount of memory used by the cached resources kept alive after their last use.
+		/// \return Returns the retention budget, in bytes.
+		size_t GetRetentionBudget() const;
+
+		/// \brief Get the amount of memory used by the cached resources kept alive after their last use.
+		/// \return Returns the size of the retained resources, in bytes. The resources may still be in use elsewhere.
+		size_t GetRetainedSize() const;
+
 	protected:
 
 		/// \brief Load a resource.
@@ -243,6 +347,14 @@ namespace gi_lib{
 		/// \return Returns a pointer to the loaded resource
 		virtual ObjectPtr<IResource> Load(const type_index& resource_type, const type_index& args_type, const void* load_args) const = 0;
 
+		/// \brief Run the part of a load which can be executed by a worker thread.
+		/// The default implementation does nothing on the worker and loads the whole resource on the thread owning the resources.
+		/// \param resource_type Resource's type index.
+		/// \param load_args_type Bundle's type index.
+		/// \param load_args Pointer to the bundle to be used to load the resource. Valid until the returned functor is executed.
+		/// \return Returns a functor completing the load on the thread owning the resources. The functor returns the loaded resource.
+		virtual function<ObjectPtr<IResource>()> PrepareLoad(const type_index& resource_type, const type_index& args_type, const void* load_args) const;
+
 	private:
 
 		/// \brief Private implementation of the class.
@@ -256,6 +368,14 @@ namespace gi_lib{
 		/// \return Returns the resource loaded.
 		ObjectPtr<IResource> LoadDirect(const type_index& resource_type, const type_index& args_type, const void* args);
 
+		/// \brief Loads a resource asynchronously from cache.
+		/// \return Returns the state of the load, which is completed already if the resource was cached.
+		shared_ptr<AsyncLoad> LoadAsyncFromCache(const type_index& resource_type, const type_index& args_type, shared_ptr<const void> args, size_t cache_key);
+
+		/// \brief Loads a resource instance asynchronously.
+		/// \return Returns the state of the load.
+		shared_ptr<AsyncLoad> LoadAsyncDirect(const type_index& resource_type, const type_index& args_type, shared_ptr<const void> args);
+
 		/// \brief Opaque pointer to the implementation of the class.
 		unique_ptr<Impl> pimpl_;
 
@@ -333,6 +453,59 @@ namespace gi_lib{
 
 	}
 
+	///////////////////////////////// ASYNC RESOURCE ////////////////////////////////////
+
+	template <typename TResource>
+	inline AsyncResource<TResource>::AsyncResource() :
+		load_(std::make_shared<AsyncLoad>()){
+
+		load_->completed = true;
+
+	}
+
+	template <typename TResource>
+	inline AsyncResource<TResource>::AsyncResource(shared_ptr<AsyncLoad> load, const ObjectPtr<TResource>& placeholder) :
+		load_(std::move(load)),
+		placeholder_(placeholder){}
+
+	template <typename TResource>
+	inline bool AsyncResource<TResource>::IsReady() const{
+
+		return load_->completed;
+
+	}
+
+	template <typename TResource>
+	inline ObjectPtr<TResource> AsyncResource<TResource>::Get() const{
+
+		return load_->resource ?
+			   ObjectPtr<TResource>(load_->resource) :
+			   placeholder_;
+
+	}
+
+	template <typename TResource>
+	void AsyncResource<TResource>::Then(function<void(const ObjectPtr<TResource>&)> continuation) const{
+
+		auto resource_continuation = [continuation](const ObjectPtr<IResource>& resource){
+
+			continuation(ObjectPtr<TResource>(resource));
+
+		};
+
+		if (load_->completed){
+
+			resource_continuation(load_->resource);
+
+		}
+		else{
+
+			load_->continuations.push_back(std::move(resource_continuation));
+
+		}
+
+	}
+
 	///////////////////////////////// RESOURCES ////////////////////////////////////
 
 	template <typename TResource, typename TArgs, typename use_cache<TArgs>::type*>
@@ -353,6 +526,27 @@ namespace gi_lib{
 											   &args));
 
 	}
+
+	template <typename TResource, typename TArgs, typename use_cache<TArgs>::type*>
+	AsyncResource<TResource> Resources::LoadAsync(const typename TArgs& args, const ObjectPtr<TResource>& placeholder){
+
+		return AsyncResource<TResource>(LoadAsyncFromCache(type_index(typeid(TResource)),
+														   type_index(typeid(TArgs)),
+														   std::make_shared<TArgs>(args),
+														   args.GetCacheKey()),
+										placeholder);
+
+	}
+
+	template <typename TResource, typename TArgs, typename no_cache<TArgs>::type*>
+	AsyncResource<TResource> Resources::LoadAsync(const typename TArgs& args, const ObjectPtr<TResource>& placeholder){
+
+		return AsyncResource<TResource>(LoadAsyncDirect(type_index(typeid(TResource)),
+														type_index(typeid(TArgs)),
+														std::make_shared<TArgs>(args)),
+										placeholder);
+
+	}
 	
 	///////////////////////////////// GRAPHICS ////////////////////////////////////
 
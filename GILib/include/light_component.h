@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <limits>
+
 #include "component.h"
 
 #include "scene.h"
@@ -61,6 +63,8 @@ namespace gi_lib {
 
 		virtual void Finalize() override;
 
+		virtual void UpdateBounds() override;
+
 		/// \brief Compute the light bounds.
 		/// \param notify Whether the VolumeComponent::OnChanged event should be triggered
 		void ComputeBounds(bool notify);
@@ -78,8 +82,6 @@ namespace gi_lib {
 				
 		TransformComponent* transform_;							///< \brief Pointer to the transform component for faster access.
 
-		unique_ptr<Listener> on_transform_changed_lister_;		///< \brief Listener for the transform changed event.
-
 	};
 
 	/// \brief Represents a single point light.
@@ -118,6 +120,8 @@ namespace gi_lib {
 
 		virtual IntersectionType TestAgainst(const Sphere& sphere) const override;
 
+		virtual AABB GetBoundingBox() const override;
+
 		/// \brief Get the constant factor Kc of the point light.
 		float GetConstantFactor() const;
 
@@ -197,6 +201,8 @@ namespace gi_lib {
 
 		virtual IntersectionType TestAgainst(const Sphere& sphere) const override;
 
+		virtual AABB GetBoundingBox() const override;
+
 		virtual TypeSet GetTypes() const override;
 
 		/// \brief Get the light's world transform.
@@ -245,6 +251,8 @@ namespace gi_lib {
 
 		virtual IntersectionType TestAgainst(const Sphere& sphere) const override;
 
+		virtual AABB GetBoundingBox() const override;
+
 		/// \brief Get the light cone angle in radians.
 		float GetLightConeAngle() const;
 
@@ -392,6 +400,13 @@ namespace gi_lib {
 		return bounds_.Intersect(sphere);
 
 	}
+
+	inline AABB PointLightComponent::GetBoundingBox() const {
+
+		return AABB{ bounds_.center,
+					 Vector3f::Ones() * bounds_.radius };
+
+	}
 	
 	inline float PointLightComponent::GetConstantFactor() const {
 
@@ -491,6 +506,14 @@ namespace gi_lib {
 
 	}
 
+	inline AABB DirectionalLightComponent::GetBoundingBox() const {
+
+		// A directional light is infinite in size and range
+		return AABB{ Vector3f::Zero(),
+					 Vector3f::Ones() * std::numeric_limits<float>::infinity() };
+
+	}
+
 	inline Affine3f DirectionalLightComponent::GetWorldTransform() const {
 
 		return GetTransformComponent().GetWorldTransform();
@@ -0,0 +1,89 @@
+/// \file loose_octree.h
+/// \brief Loose octree volume hierarchy.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "gimath.h"
+#include "volume_hierarchy.h"
+
+using ::std::unique_ptr;
+
+namespace gi_lib{
+
+	/// \brief Represents a loose octree.
+	/// Each cell of the tree has loose bounds which are larger than the region of space it subdivides: a volume is stored inside the deepest cell containing its center whose loose bounds fully enclose it.
+	/// Cells are stored in a flat array and each volume keeps the slot it has been assigned to, so that removals and relocations never scan any container.
+	/// Small movements usually leave a volume inside the same cell and cause no structural change at all.
+	/// Since the slot is stored inside the volume, a volume can belong to one loose octree at a time: adding a volume stored inside another octree throws.
+	/// \author Raffaele D. Facendola
+	class LooseOctree : public IVolumeHierarchy
+	{
+
+	public:
+
+		/// \brief Default ratio between the loose bounds of a cell and the region of space it subdivides.
+		static const float kDefaultLooseness;
+
+		/// \brief Create a new empty octree.
+		/// \param domain Region of space to subdivide. Volumes outside the domain are stored inside the root cell.
+		/// \param depth Number of times the domain is split on each axis.
+		LooseOctree(const AABB& domain, unsigned int depth);
+
+		/// \brief Create a new empty octree.
+		/// \param domain Region of space to subdivide. Volumes outside the domain are stored inside the root cell.
+		/// \param depth Number of times the domain is split on each axis.
+		/// \param looseness Ratio between the loose bounds of a cell and the region of space it subdivides. Must be greater than 1.
+		LooseOctree(const AABB& domain, unsigned int depth, float looseness);
+
+		/// \brief Destructor.
+		virtual ~LooseOctree();
+
+		virtual void AddVolume(VolumeComponent* volume) override;
+
+		virtual void RemoveVolume(VolumeComponent* volume) override;
+
+		virtual void Commit() override;
+
+		virtual HierarchyStats GetStats() const override;
+
+		virtual const VolumeChangeLog& GetChangeLog() const override;
+
+		using IVolumeHierarchy::GetIntersections;
+
+		virtual void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const override;
+
+		virtual bool VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const override;
+
+	protected:
+
+		virtual void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const override;
+
+		virtual void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const override;
+
+		virtual void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+	private:
+
+		struct Impl;
+
+		unique_ptr<Impl> pimpl_;						///< \brief Private implementation.
+
+	};
+
+}
@@ -46,6 +46,13 @@ namespace gi_lib{
 		/// \brief Virtual destructor.
 		virtual ~IMaterial(){};
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kShader;
+
+		}
+
 		/// \brief Set a texture resource as an input for the material.
 		/// The GPU may only read from the specified texture.
 		/// \param tag Tag of the input texture to set.
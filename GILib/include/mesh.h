@@ -19,6 +19,7 @@ namespace gi_lib{
 
 		kNone = 0,
 		kShadowcaster = 1,
+		kOccluder = 2,
 
 	};
 
@@ -73,6 +74,13 @@ namespace gi_lib{
 		/// \brief Virtual destructor.
 		virtual ~IStaticMesh(){}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kMesh;
+
+		}
+
 		/// \brief Get the vertices count.
 		/// \return Returns the vertices count.
 		virtual size_t GetVertexCount() const = 0;
@@ -90,6 +98,18 @@ namespace gi_lib{
 		/// \return Returns the bounding box of the mesh in object space.
 		virtual const AABB& GetBoundingBox() const = 0;
 
+		/// \brief Get the positions of the vertices.
+		/// A copy of the positions is kept in system memory for occlusion culling, but only while a subset of the mesh is flagged as occluder.
+		/// The copy counts towards the size of the mesh.
+		/// \return Returns the object-space position of each vertex.
+		virtual const std::vector<Vector3f>& GetPositions() const = 0;
+
+		/// \brief Get the indices of the mesh triangles.
+		/// A copy of the indices is kept in system memory for occlusion culling, but only while a subset of the mesh is flagged as occluder.
+		/// Meshes built without indices get one index per vertex.
+		/// \return Returns the indices of the mesh triangles, each subset referencing a contiguous range.
+		virtual const std::vector<unsigned int>& GetIndices() const = 0;
+
 		/// \brief Total number of subsets used by this mesh.
 		/// \return Returns the total number of subsets used by this mesh.
 		virtual size_t GetSubsetCount() const = 0;
@@ -99,6 +119,12 @@ namespace gi_lib{
 		/// \return Returns the specified mesh subset.
 		virtual const MeshSubset& GetSubset(unsigned int subset_index) const = 0;
 
+		/// \brief Get the number of indices referenced by a mesh subset.
+		/// The count of a subset of a mesh built without indices is expressed in triangles: this method always returns an index count.
+		/// \param subset_index Index of the subset.
+		/// \return Returns the number of indices of GetIndices() referenced by the subset, starting from its start index.
+		virtual size_t GetIndexCount(unsigned int subset_index) const = 0;
+
 		/// \brief Get a mesh subset's flags.
 		/// \param subset_index Index of the subset to access.
 		/// \return Returns the flags of the specified subset.
@@ -6,6 +6,9 @@
 #pragma once
 
 #include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 
 #include "debug.h"
 
@@ -19,27 +22,43 @@ namespace gi_lib{
 
 	class Object;
 
-	/// \brief Used to count strong and weak references of a shared object.
-	/// Whenever the strong reference count drops to 0, the object is deleted.
+	/// \brief Policy used to count the references of an object.
+	enum class RefCountPolicy{
+
+		kSingleThread,		///< \brief References are counted without synchronization. The object and its pointers must be used by one thread at a time.
+		kAtomic,			///< \brief References are counted atomically. Pointers to the object can be created and destroyed by any thread.
+
+	};
+
+	/// \brief Control block used to count the weak references of a shared object.
+	/// The block is created along with the first weak reference to the object and outlives it: whenever the object is deleted the block is expired.
+	/// The object itself holds a weak reference to the block until it is deleted.
 	/// Whenever the weak reference count drops to 0, this object is deleted.
-	/// The weak reference count is increased by 1 if the strong reference count is greater than 0.
 	/// \author Raffaele D. Facendola.
 	class RefCountObject{
 
+		friend class Object;
+
 	public:
 
-		/// \brief Create a new reference count object with an actual pointer.
+		/// \brief Create a new control block for an object.
+		/// The block starts with the weak reference held by the object.
 		/// \param object The managed object pointer.
-		RefCountObject(Object* object);
+		/// \param policy Policy used to count the references of the object.
+		RefCountObject(Object* object, RefCountPolicy policy);
 
-		/// \brief Get the object.
-		Object* Get() const;
+		/// \brief No copy constructor.
+		RefCountObject(const RefCountObject&) = delete;
 
-		/// \brief Adds a strong reference.
-		void AddRef();
+		/// \brief No assignment operator.
+		RefCountObject& operator=(const RefCountObject&) = delete;
 
-		/// \brief Remove a strong reference.
-		void Release();
+		/// \brief Check whether the object was deleted.
+		bool IsExpired() const;
+
+		/// \brief Add a strong reference to the object unless it is being deleted.
+		/// \return Returns the object if the reference was added, returns nullptr otherwise.
+		Object* Lock();
 
 		/// \brief Add a weak reference.
 		void AddWeakRef();
@@ -49,15 +68,22 @@ namespace gi_lib{
 
 	private:
 
-		size_t ref_count_;		///< \brief Strong reference count.
+		/// \brief Mark the object as deleted and remove its weak reference.
+		void Expire();
 
-		size_t weak_count_;		///< \brief Weak reference count.
+		std::atomic<size_t> weak_count_;		///< \brief Weak reference count.
 
-		Object* object_;		///< \brief Actual object pointer.
+		std::atomic<Object*> object_;			///< \brief Actual object pointer. Null if the object was deleted.
+
+		std::mutex mutex_;						///< \brief Used to expire the object while another thread is locking it. Atomic policy only.
+
+		const bool atomic_;						///< \brief Whether the references are counted atomically.
 
 	};
 
 	/// \brief Base interface for every object whose life cycle is determined by a reference counter.
+	/// The strong reference count is stored inside the object, while weak references are counted by a separate control block which is allocated only when needed.
+	/// Objects shared among threads must be created with the atomic policy.
 	/// \author Raffaele D. Facendola
 	class Object{
 
@@ -67,34 +93,76 @@ namespace gi_lib{
 		template <typename TObject>
 		friend class ObjectWeakPtr;
 
+		friend class RefCountObject;
+
 	public:
 
-		/// \brief Default destructor.
+		/// \brief Create an object whose references are counted without synchronization.
 		Object();
 
+		/// \brief Create an object.
+		/// \param policy Policy used to count the references of the object.
+		Object(RefCountPolicy policy);
+
+		/// \brief Copy constructor.
+		/// The copy has the same policy of the original object, but no reference.
+		Object(const Object& other);
+
 		/// \brief Virtual class.
 		virtual ~Object();
 
 		/// \brief No assignment operator.
-		/// An assignment operator would break the ref counter object.
+		/// An assignment operator would break the reference counter.
 		Object& operator=(const Object&) = delete;
 
+		/// \brief Get the policy used to count the references of the object.
+		RefCountPolicy GetRefCountPolicy() const;
+
 	private:
 
-		RefCountObject* ref_count_object_;			///< \brief Reference counter.
+		/// \brief Increase a counter by one.
+		/// \param atomic Whether the counter has to be increased atomically.
+		/// \return Returns the value of the counter before the increment.
+		static size_t Increment(std::atomic<size_t>& counter, bool atomic);
+
+		/// \brief Decrease a counter by one.
+		/// \param atomic Whether the counter has to be decreased atomically.
+		/// \return Returns the value of the counter after the decrement.
+		static size_t Decrement(std::atomic<size_t>& counter, bool atomic);
+
+		/// \brief Add a strong reference.
+		void AddRef() const;
+
+		/// \brief Add a strong reference unless the object is being deleted.
+		/// \return Returns true if the reference was added, returns false otherwise.
+		bool TryAddRef() const;
+
+		/// \brief Remove a strong reference. The object is deleted along with its last strong reference.
+		void Release() const;
+
+		/// \brief Get the control block of the weak references, creating it if necessary.
+		RefCountObject* GetRefCountObject() const;
+
+		mutable std::atomic<size_t> ref_count_;							///< \brief Strong reference count.
+
+		mutable std::atomic<RefCountObject*> ref_count_object_;			///< \brief Control block of the weak references. Null until the first weak reference is created.
+
+		const bool atomic_;												///< \brief Whether the references are counted atomically.
 
 	};
 
 	/// \brief Strong reference to an object.
 	/// The pointer will add a reference during initialization and remove one during destruction.
-	/// \remarks This class is not thread safe.
-	/// \todo Make this class thread safe.
+	/// \remarks A single pointer is not thread safe. Different pointers to the same object may be used by different threads only if the object uses the atomic policy.
 	template <typename TObject>
 	class ObjectPtr{
 
 		template <typename TFriend>
 		friend class ObjectPtr;
 
+		template <typename TFriend>
+		friend class ObjectWeakPtr;
+
 	public:
 
 		/// \brief Create an empty pointer.
@@ -176,20 +244,21 @@ namespace gi_lib{
 
 	private:
 
+		/// \brief Defines a pointer to an object whose strong reference was added already.
+		/// \param object Object that will be pointed by this pointer.
+		/// \param add_ref Whether to add a reference to the object.
+		ObjectPtr(TObject* object, bool add_ref);
+
 		/// \brief Add a reference to the pointed object.
 		void AddRef();
 
-		/// \brief Get the reference count object.
-		RefCountObject& GetRefCountObject();
-
 		TObject* object_ptr_;			/// \brief Pointer to the object.
 
 	};
 
 	/// \brief Weak reference to an object.
 	/// The pointer will add a weak reference during initialization and remove one during destruction.
-	/// \remarks This class is not thread safe.
-	/// \todo Make this class thread safe.
+	/// \remarks A single pointer is not thread safe. Different pointers to the same object may be used by different threads only if the object uses the atomic policy.
 	template <typename TObject>
 	class ObjectWeakPtr{
 
@@ -286,76 +355,232 @@ namespace gi_lib{
 		/// \brief Add a weak reference to the pointed object.
 		void AddRef();
 
+		/// \brief Get the control block of an object, creating it if necessary.
+		/// \return Returns the control block of the object, or nullptr if the object is null.
+		static RefCountObject* GetRefCountObject(const Object* object);
+
 		RefCountObject* ref_count_object_;			///< \brief Weak reference to the pointed object.
 
 	};
 
 	///////////////////////////////// REF COUNT OBJECT ////////////////////////
 
-	inline RefCountObject::RefCountObject(Object* object) :
+	inline RefCountObject::RefCountObject(Object* object, RefCountPolicy policy) :
+		weak_count_(1),
 		object_(object),
-		ref_count_(0),
-		weak_count_(0){}
+		atomic_(policy == RefCountPolicy::kAtomic){}
 
-	inline Object* RefCountObject::Get() const{
+	inline bool RefCountObject::IsExpired() const{
 
-		return object_;
+		return object_.load(std::memory_order_acquire) == nullptr;
 
 	}
 
-	inline void RefCountObject::AddRef(){
+	inline Object* RefCountObject::Lock(){
 
-		if (ref_count_ == 0){
+		// The mutex prevents the object from being deleted between the check and the new reference: Expire waits for it.
 
-			++weak_count_;
+		std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+
+		if (atomic_){
+
+			lock.lock();
 
 		}
 
-		++ref_count_;
+		auto object = object_.load(std::memory_order_relaxed);
+
+		return (object && object->TryAddRef()) ?
+			   object :
+			   nullptr;
 
 	}
 
-	inline void RefCountObject::Release(){
+	inline void RefCountObject::AddWeakRef(){
 
-		--ref_count_;
+		Object::Increment(weak_count_, atomic_);
 
-		if (ref_count_ == 0){
+	}
 
-			delete object_;
+	inline void RefCountObject::WeakRelease(){
 
-			object_ = nullptr;
+		if (Object::Decrement(weak_count_, atomic_) == 0){
 
-			WeakRelease();
+			delete this;
 
 		}
 
 	}
 
-	inline void RefCountObject::AddWeakRef(){
+	inline void RefCountObject::Expire(){
 
-		++weak_count_;
+		{
+			std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
 
-	}
+			if (atomic_){
 
-	inline void RefCountObject::WeakRelease(){
+				lock.lock();
 
-		--weak_count_;
+			}
 
-		if (weak_count_ == 0){
-
-			delete this;
+			object_.store(nullptr, std::memory_order_release);
 
 		}
 
+		WeakRelease();
+
 	}
 
 	///////////////////////////////// OBJECT //////////////////////////////////
 
 	inline Object::Object() :
-		ref_count_object_(new RefCountObject(this)){}
+		Object(RefCountPolicy::kSingleThread){}
+
+	inline Object::Object(RefCountPolicy policy) :
+		ref_count_(0),
+		ref_count_object_(nullptr),
+		atomic_(policy == RefCountPolicy::kAtomic){}
+
+	inline Object::Object(const Object& other) :
+		ref_count_(0),
+		ref_count_object_(nullptr),
+		atomic_(other.atomic_){}
 
 	inline Object::~Object(){}
 
+	inline RefCountPolicy Object::GetRefCountPolicy() const{
+
+		return atomic_ ?
+			   RefCountPolicy::kAtomic :
+			   RefCountPolicy::kSingleThread;
+
+	}
+
+	inline size_t Object::Increment(std::atomic<size_t>& counter, bool atomic){
+
+		if (atomic){
+
+			return counter.fetch_add(1, std::memory_order_relaxed);
+
+		}
+
+		// Plain load and store: no locked instruction
+
+		auto value = counter.load(std::memory_order_relaxed);
+
+		counter.store(value + 1, std::memory_order_relaxed);
+
+		return value;
+
+	}
+
+	inline size_t Object::Decrement(std::atomic<size_t>& counter, bool atomic){
+
+		if (atomic){
+
+			// Release: every write to the object happens before its deletion. Acquire: the deleting thread sees those writes.
+
+			return counter.fetch_sub(1, std::memory_order_acq_rel) - 1;
+
+		}
+
+		auto value = counter.load(std::memory_order_relaxed) - 1;
+
+		counter.store(value, std::memory_order_relaxed);
+
+		return value;
+
+	}
+
+	inline void Object::AddRef() const{
+
+		Increment(ref_count_, atomic_);
+
+	}
+
+	inline bool Object::TryAddRef() const{
+
+		auto count = ref_count_.load(std::memory_order_relaxed);
+
+		if (!atomic_){
+
+			if (count == 0){
+
+				return false;
+
+			}
+
+			ref_count_.store(count + 1, std::memory_order_relaxed);
+
+			return true;
+
+		}
+
+		// Never resurrect an object whose last strong reference is gone
+
+		while (count > 0){
+
+			if (ref_count_.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)){
+
+				return true;
+
+			}
+
+		}
+
+		return false;
+
+	}
+
+	inline void Object::Release() const{
+
+		if (Decrement(ref_count_, atomic_) == 0){
+
+			if (auto ref_count_object = ref_count_object_.load(std::memory_order_acquire)){
+
+				ref_count_object->Expire();
+
+			}
+
+			delete this;
+
+		}
+
+	}
+
+	inline RefCountObject* Object::GetRefCountObject() const{
+
+		auto ref_count_object = ref_count_object_.load(std::memory_order_acquire);
+
+		if (!ref_count_object){
+
+			auto new_ref_count_object = new RefCountObject(const_cast<Object*>(this),
+														   GetRefCountPolicy());
+
+			if (!atomic_){
+
+				ref_count_object_.store(new_ref_count_object, std::memory_order_relaxed);
+
+				ref_count_object = new_ref_count_object;
+
+			}
+			else if (ref_count_object_.compare_exchange_strong(ref_count_object, new_ref_count_object, std::memory_order_acq_rel)){
+
+				ref_count_object = new_ref_count_object;
+
+			}
+			else{
+
+				delete new_ref_count_object;		// Another thread created the block first.
+
+			}
+
+		}
+
+		return ref_count_object;
+
+	}
+
 	///////////////////////////////// OBJECT PTR //////////////////////////////////
 
 	template <typename TObject>
@@ -383,6 +608,18 @@ namespace gi_lib{
 
 	}
 
+	template <typename TObject>
+	inline ObjectPtr<TObject>::ObjectPtr(TObject* object, bool add_ref) :
+		object_ptr_(object){
+
+		if (add_ref){
+
+			AddRef();
+
+		}
+
+	}
+
 	template <typename TObject>
 	inline ObjectPtr<TObject>::ObjectPtr(const ObjectPtr<TObject>& other) :
 		ObjectPtr(other.Get()){}
@@ -517,7 +754,7 @@ namespace gi_lib{
 
 		if (object_ptr_){
 
-			GetRefCountObject().Release();
+			static_cast<const Object*>(object_ptr_)->Release();
 
 			object_ptr_ = nullptr;
 
@@ -530,19 +767,12 @@ namespace gi_lib{
 
 		if (object_ptr_){
 
-			GetRefCountObject().AddRef();
+			static_cast<const Object*>(object_ptr_)->AddRef();
 
 		}
 
 	}
 
-	template <typename TObject>
-	inline RefCountObject& ObjectPtr<TObject>::GetRefCountObject(){
-
-		return *static_cast<const Object*>(object_ptr_)->ref_count_object_;
-
-	}
-
 	///////////////////////////////// WEAK OBJECT PTR ////////////////////////////////
 
 	template <typename TObject>
@@ -555,7 +785,7 @@ namespace gi_lib{
 
 	template <typename TObject>
 	inline ObjectWeakPtr<TObject>::ObjectWeakPtr(TObject* object) :
-		ref_count_object_(static_cast<const Object*>(object)->ref_count_object_){
+		ref_count_object_(GetRefCountObject(object)){
 
 		AddRef();
 
@@ -564,7 +794,7 @@ namespace gi_lib{
 	template <typename TObject>
 	template <typename TOther>
 	inline ObjectWeakPtr<TObject>::ObjectWeakPtr(TOther* object) :
-		ref_count_object_(static_cast<const Object*>(object)->ref_count_object_){
+		ref_count_object_(GetRefCountObject(object)){
 
 		static_assert(std::is_base_of<TObject, TOther>::value, "TOther must derive from TObject.");
 
@@ -574,12 +804,22 @@ namespace gi_lib{
 
 	template <typename TObject>
 	inline ObjectWeakPtr<TObject>::ObjectWeakPtr(const ObjectWeakPtr<TObject>& other) :
-		ObjectWeakPtr(other.Lock()){}
+		ref_count_object_(other.ref_count_object_){
+
+		AddRef();
+
+	}
 
 	template <typename TObject>
 	template <typename TOther>
 	inline ObjectWeakPtr<TObject>::ObjectWeakPtr(const ObjectWeakPtr<TOther>& other) :
-		ObjectWeakPtr(other.Lock()){}
+		ref_count_object_(other.ref_count_object_){
+
+		static_assert(std::is_base_of<TObject, TOther>::value, "TOther must derive from TObject.");
+
+		AddRef();
+
+	}
 
 	template <typename TObject>
 	inline ObjectWeakPtr<TObject>::ObjectWeakPtr(const ObjectPtr<TObject>& other) :
@@ -619,11 +859,17 @@ namespace gi_lib{
 	template <typename TObject>
 	ObjectWeakPtr<TObject>& ObjectWeakPtr<TObject>::operator=(const ObjectWeakPtr<TObject>& other){
 
-		Release();
+		auto ref_count_object = other.ref_count_object_;		// Self-assignment safe
 
-		ref_count_object_ = other.ref_count_object_;
+		if (ref_count_object){
 
-		AddRef();
+			ref_count_object->AddWeakRef();
+
+		}
+
+		Release();
+
+		ref_count_object_ = ref_count_object;
 
 		return *this;
 
@@ -635,11 +881,17 @@ namespace gi_lib{
 
 		static_assert(std::is_base_of<TObject, TOther>::value, "TOther must derive from TObject.");
 
-		Release();
+		auto ref_count_object = other.ref_count_object_;
 
-		ref_count_object_ = other.ref_count_object_;
+		if (ref_count_object){
 
-		AddRef();
+			ref_count_object->AddWeakRef();
+
+		}
+
+		Release();
+
+		ref_count_object_ = ref_count_object;
 
 		return *this;
 
@@ -675,16 +927,14 @@ namespace gi_lib{
 	template <typename TObject>
 	inline bool ObjectWeakPtr<TObject>::operator==(const ObjectWeakPtr<TObject>& other) const{
 
-		Release();
-
-		return object_ptr_ == other.object_ptr_;
+		return ref_count_object_ == other.ref_count_object_;
 
 	}
 
 	template <typename TObject>
 	inline bool ObjectWeakPtr<TObject>::operator!=(const ObjectWeakPtr<TObject>& other) const{
 
-		return object_ptr_ != other.object_ptr_;
+		return ref_count_object_ != other.ref_count_object_;
 
 	}
 
@@ -699,16 +949,20 @@ namespace gi_lib{
 	inline bool ObjectWeakPtr<TObject>::IsValid() const{
 
 		return ref_count_object_ != nullptr &&
-			   ref_count_object_->Get() != nullptr;
+			   !ref_count_object_->IsExpired();
 
 	}
 
 	template <typename TObject>
 	inline ObjectPtr<TObject> ObjectWeakPtr<TObject>::Lock() const{
 
-		return IsValid() ?
-			   static_cast<TObject*>(ref_count_object_->Get()) :
-			   nullptr;
+		auto object = ref_count_object_ ?
+					  ref_count_object_->Lock() :
+					  nullptr;
+
+		// The strong reference was added by the control block already.
+
+		return ObjectPtr<TObject>(static_cast<TObject*>(object), false);
 
 	}
 
@@ -736,4 +990,13 @@ namespace gi_lib{
 
 	}
 
+	template <typename TObject>
+	inline RefCountObject* ObjectWeakPtr<TObject>::GetRefCountObject(const Object* object){
+
+		return object ?
+			   object->GetRefCountObject() :
+			   nullptr;
+
+	}
+
 }
\ No newline at end of file
@@ -5,14 +5,16 @@
 
 #pragma once
 
-#include <map>
+#include <vector>
 #include <functional>
 #include <memory>
 #include <tuple>
 
 #include "unique.h"
+#include "scope_guard.h"
+#include "slab_pool.h"
 
-using ::std::map;
+using ::std::vector;
 using ::std::function;
 using ::std::unique_ptr;
 using ::std::tuple;
@@ -21,13 +23,15 @@ namespace gi_lib{
 
 	class BaseObservable;
 	class Listener;
+	class EventQueue;
 
 	/// \brief Tag associated to listener's identifiers.
 	struct ListenerTag{};
 	
 	/// \brief Represents a listener-to-subject relationship.
+	/// Listeners allocated on the heap share a single pool, whose blocks are sized after this class: the class cannot be derived.
 	/// \author Raffaele D. Facendola.
-	class Listener{
+	class Listener final{
 
 		friend class BaseObservable;
 
@@ -36,7 +40,9 @@ namespace gi_lib{
 		/// \brief Create a new listener.
 		/// \param observable Subject.
 		/// \param id Unique id.
-		Listener(BaseObservable* observable, Unique<ListenerTag> id);
+		/// \param slot Slot of the listener inside the subject.
+		/// \param generation Generation of the slot when the listener was created.
+		Listener(BaseObservable* observable, Unique<ListenerTag> id, unsigned int slot, unsigned int generation);
 
 		/// \brief Default constructor.
 		Listener();
@@ -57,6 +63,15 @@ namespace gi_lib{
 		/// \return Returns the listener's id.
 		Unique<ListenerTag> GetId();
 
+		/// \brief Allocate a listener from the pool shared by every listener.
+		static void* operator new(size_t size);
+
+		/// \brief Return a listener to the pool shared by every listener.
+		static void operator delete(void* block);
+
+		/// \brief Get the usage statistics of the pool shared by every listener.
+		static PoolStatistics GetStatistics();
+
 	private:
 
 		/// \brief Invalidate the state of the listener.
@@ -66,6 +81,10 @@ namespace gi_lib{
 
 		BaseObservable* subject_;	///< \brief Observed object.
 
+		unsigned int slot_;			///< \brief Slot of the listener inside the subject.
+
+		unsigned int generation_;	///< \brief Generation of the slot when the listener was created.
+
 	};
 
 	/// \brief Base class for observable objects.
@@ -90,14 +109,18 @@ namespace gi_lib{
 		
 	protected:
 
-		/// \brief Unsubscribe a listener by id.
-		virtual void Unsubscribe(Unique<ListenerTag> listener_id) = 0;
+		/// \brief Unsubscribe a listener by slot.
+		/// \param slot Slot of the listener.
+		/// \param generation Generation of the slot when the listener was created. Listeners of older generations were already unsubscribed.
+		virtual void Unsubscribe(unsigned int slot, unsigned int generation) = 0;
 
 		/// \brief Invalidate a listener.
 		virtual void Invalidate(Listener& listener);
 
 		/// \brief Generate a new listener.
-		unique_ptr<Listener> GenerateListener();
+		/// \param slot Slot of the listener.
+		/// \param generation Current generation of the slot.
+		unique_ptr<Listener> GenerateListener(unsigned int slot, unsigned int generation);
 
 	private:
 
@@ -114,7 +137,77 @@ namespace gi_lib{
 	
 	};
 
+	/// \brief Base class for events whose notification can be deferred to an event queue.
+	/// \author Raffaele D. Facendola.
+	class DeferredEvent{
+
+		friend class EventQueue;
+
+	public:
+
+		/// \brief Default constructor.
+		DeferredEvent();
+
+		/// \brief Virtual destructor.
+		virtual ~DeferredEvent(){}
+
+	protected:
+
+		/// \brief Notify the listeners with the last argument enqueued.
+		virtual void Deliver() = 0;
+
+	private:
+
+		size_t queue_index_;		///< \brief Index of the event inside the queue it was last enqueued to.
+
+		size_t flush_;				///< \brief Identifier of the last flush who delivered the event.
+
+	};
+
+	/// \brief Queue of deferred notifications.
+	/// Events bound to a queue do not notify their listeners immediately: each event is enqueued the first time it is notified and delivered once, with its last argument, when the queue is flushed.
+	/// Since each event belongs to a single source, listeners receive at most one callback per source and event for each flush.
+	/// Events are delivered in the order they were first enqueued.
+	/// \author Raffaele D. Facendola.
+	class EventQueue{
+
+	public:
+
+		/// \brief Create an empty queue.
+		EventQueue();
+
+		/// \brief No copy constructor.
+		EventQueue(const EventQueue&) = delete;
+
+		/// \brief No assignment operator.
+		EventQueue& operator=(const EventQueue&) = delete;
+
+		/// \brief Enqueue an event.
+		/// The event must not be enqueued already.
+		void Enqueue(DeferredEvent& event);
+
+		/// \brief Remove an event from the queue.
+		/// Does nothing if the event is not enqueued.
+		void Cancel(DeferredEvent& event);
+
+		/// \brief Deliver every event enqueued.
+		/// Events enqueued by the listeners during the flush are delivered by the same flush, unless they were delivered by this flush already: those are left to the next flush, so that listeners notifying each other cannot keep the flush going forever.
+		void Flush();
+
+		/// \brief Get the number of events waiting to be delivered.
+		size_t GetPendingCount() const;
+
+	private:
+
+		vector<DeferredEvent*> events_;		///< \brief Enqueued events. Canceled and delivered events are nullptr.
+
+		size_t pending_count_;				///< \brief Number of events waiting to be delivered.
+
+	};
+
 	/// \brief Observable object.
+	/// Listeners are stored inside slots tagged with a generation, which is incremented whenever a slot is released, so that stale listeners cannot unsubscribe a newer one.
+	/// Slots released while the listeners are being notified are reclaimed after the notification, so that the callback being executed is never destroyed.
 	/// \tparam TArgument Type of the argument that is sent during notification.
 	/// \author Raffaele D. Facendola.
 	template <typename TArgument = EventArgs>
@@ -136,51 +229,106 @@ namespace gi_lib{
 
 	protected:
 
+		/// \brief Function called when the observable object notifies its listeners.
+		using Callback = function<void(Listener&, TArgument&)>;
+
+		/// \brief Slot of a listener.
 		struct ListenerEntry{
 
-			Listener* listener;
+			Listener* listener;				///< \brief Subscribed listener. nullptr if the slot is free or waiting to be released.
 
-			function<void(Listener&, TArgument&)> callback;
+			unsigned int generation;		///< \brief Incremented each time the slot is released.
+
+			unsigned int next_free;			///< \brief Next free slot, if the slot is free.
 
 		};
 
-		using ListenerMapType = map < Unique<ListenerTag>, ListenerEntry >;
+		/// \brief Index of a missing slot.
+		static const unsigned int kNoSlot = static_cast<unsigned int>(-1);
+
+		virtual void Unsubscribe(unsigned int slot, unsigned int generation) override;
 
-		virtual void Unsubscribe(Unique<ListenerTag> listener_id) override;
+		/// \brief Release the slots unsubscribed while the listeners were being notified.
+		void ReleasePending();
 
-		ListenerMapType listeners_;		///< \brief Map of the listeners.
+		vector<ListenerEntry> listeners_;			///< \brief Slots of the listeners.
+
+		vector<unique_ptr<Callback>> callbacks_;	///< \brief Callback of each slot. Callbacks are not moved when the slots grow, since they may be executing.
+
+		unsigned int free_slot_;					///< \brief First free slot.
+
+		unsigned int dispatch_depth_;				///< \brief Number of notifications being dispatched.
+
+		bool pending_release_;						///< \brief Whether some slot was unsubscribed during a notification and has yet to be released.
 
 	};
 
 	/// \brief Observable event.
+	/// The event notifies its listeners immediately, unless it is bound to an event queue.
 	/// \tparam TArgument Type of the argument that is sent during notification.
 	/// \author Raffaele D. Facendola.
 	template <typename TArgument>
-	class Event : public Observable < TArgument > {
+	class Event : public Observable < TArgument >, public DeferredEvent {
 
 	public:
 
+		/// \brief Default constructor.
+		Event();
+
 		/// \brief Destructor.
 		virtual ~Event();
 
 		/// \brief Notify all the listeners.
+		/// Listeners subscribed during the notification are not notified, listeners unsubscribed during the notification are not notified anymore.
+		/// The notification does not allocate any memory.
+		/// If the event is bound to a queue, the argument is stored and the notification is deferred until the queue is flushed.
 		void Notify(TArgument& argument);
 
+		/// \brief Bind the event to a queue.
+		/// \param queue Queue receiving the notifications. Use nullptr to notify the listeners immediately. Pending notifications are discarded.
+		void SetQueue(EventQueue* queue);
+
+		/// \brief Get the queue the event is bound to.
+		/// \return Returns the queue the event is bound to, or nullptr if the listeners are notified immediately.
+		EventQueue* GetQueue() const;
+
+	protected:
+
+		virtual void Deliver() override;
+
+	private:
+
+		/// \brief Notify all the listeners immediately.
+		void Dispatch(TArgument& argument);
+
+		EventQueue* queue_;					///< \brief Queue receiving the notifications, if any.
+
+		TArgument deferred_argument_;		///< \brief Last argument enqueued.
+
+		bool enqueued_;						///< \brief Whether the event is waiting to be delivered.
+
 	};
 
 	////////////////////// OBSERVABLE ///////////////////////////
 	
 	template <typename TArgument>
-	Observable<TArgument>::Observable(){}
+	Observable<TArgument>::Observable() :
+		free_slot_(kNoSlot),
+		dispatch_depth_(0),
+		pending_release_(false){}
 
 	template <typename TArgument>
 	Observable<TArgument>::~Observable(){
 
 		// Invalidate all the listeners
 
-		for (auto& it : listeners_){
+		for (auto& entry : listeners_){
+
+			if (entry.listener){
 
-			Invalidate(*(it.second.listener));
+				Invalidate(*(entry.listener));
+
+			}
 
 		}
 
@@ -190,24 +338,92 @@ namespace gi_lib{
 	template <typename TListener>
 	unique_ptr<Listener> Observable<TArgument>::Subscribe(TListener listener){
 
-		auto listener_ptr = GenerateListener();
-				
-		listeners_.insert(ListenerMapType::value_type(listener_ptr->GetId(),
-													  ListenerEntry{ listener_ptr.get(),
-																	 std::move(listener) }));
+		// Free slots are not recycled during a notification, otherwise the new listener could be notified by it.
+
+		unsigned int slot;
+
+		if (free_slot_ != kNoSlot &&
+			dispatch_depth_ == 0){
+
+			slot = free_slot_;
+
+			free_slot_ = listeners_[slot].next_free;
+
+			*callbacks_[slot] = std::move(listener);
+
+		}
+		else{
+
+			slot = static_cast<unsigned int>(listeners_.size());
+
+			listeners_.push_back(ListenerEntry{ nullptr, 0, kNoSlot });
+
+			callbacks_.push_back(std::make_unique<Callback>(std::move(listener)));
+
+		}
+
+		auto& entry = listeners_[slot];
+
+		auto listener_ptr = GenerateListener(slot, entry.generation);
+
+		entry.listener = listener_ptr.get();
 
 		return listener_ptr;
 
 	}
 
 	template <typename TArgument>
-	void Observable<TArgument>::Unsubscribe(Unique<ListenerTag> listener_id){
+	void Observable<TArgument>::Unsubscribe(unsigned int slot, unsigned int generation){
 
-		auto it = listeners_.find(listener_id);
+		if (slot >= listeners_.size() ||
+			listeners_[slot].generation != generation ||
+			listeners_[slot].listener == nullptr){
 
-		if (it != listeners_.end()){
+			return;
 
-			listeners_.erase(it);
+		}
+
+		listeners_[slot].listener = nullptr;
+
+		if (dispatch_depth_ > 0){
+
+			pending_release_ = true;		// The callback may be executing right now
+
+			return;
+
+		}
+
+		*callbacks_[slot] = nullptr;
+
+		++listeners_[slot].generation;
+
+		listeners_[slot].next_free = free_slot_;
+
+		free_slot_ = slot;
+
+	}
+
+	template <typename TArgument>
+	void Observable<TArgument>::ReleasePending(){
+
+		pending_release_ = false;
+
+		for (unsigned int slot = 0; slot < listeners_.size(); ++slot){
+
+			auto& entry = listeners_[slot];
+
+			if (entry.listener == nullptr &&
+				*callbacks_[slot]){
+
+				*callbacks_[slot] = nullptr;
+
+				++entry.generation;
+
+				entry.next_free = free_slot_;
+
+				free_slot_ = slot;
+
+			}
 
 		}
 
@@ -216,18 +432,107 @@ namespace gi_lib{
 	////////////////////// EVENT ///////////////////////////
 
 	template <typename TArgument>
-	Event<TArgument>::~Event(){}
+	Event<TArgument>::Event() :
+		queue_(nullptr),
+		deferred_argument_(),
+		enqueued_(false){}
+
+	template <typename TArgument>
+	Event<TArgument>::~Event(){
+
+		SetQueue(nullptr);
+
+	}
 
 	template <typename TArgument>
 	void Event<TArgument>::Notify(TArgument& argument){
 
-		ListenerMapType listeners = ListenerMapType(listeners_);
+		if (!queue_){
+
+			Dispatch(argument);
+
+			return;
+
+		}
+
+		// Only the last notification matters
+
+		deferred_argument_ = argument;
+
+		if (!enqueued_){
+
+			enqueued_ = true;
+
+			queue_->Enqueue(*this);
+
+		}
+
+	}
+
+	template <typename TArgument>
+	void Event<TArgument>::SetQueue(EventQueue* queue){
+
+		if (enqueued_){
+
+			queue_->Cancel(*this);
+
+			enqueued_ = false;
+
+		}
+
+		queue_ = queue;
+
+	}
+
+	template <typename TArgument>
+	EventQueue* Event<TArgument>::GetQueue() const{
+
+		return queue_;
+
+	}
+
+	template <typename TArgument>
+	void Event<TArgument>::Deliver(){
+
+		enqueued_ = false;
+
+		auto argument = deferred_argument_;		// The listeners may enqueue the event again
+
+		Dispatch(argument);
+
+	}
+
+	template <typename TArgument>
+	void Event<TArgument>::Dispatch(TArgument& argument){
+
+		// The callbacks may modify the listener list: slots are accessed by index since they may grow, released slots are reclaimed at the end.
+
+		++this->dispatch_depth_;
+
+		// Restored even if a callback throws, otherwise every later unsubscription would be deferred forever
+
+		auto dispatch_guard = make_scope_guard([this](){
+
+			if (--this->dispatch_depth_ == 0 &&
+				this->pending_release_){
+
+				this->ReleasePending();
+
+			}
+
+		});
+
+		auto count = this->listeners_.size();
+
+		for (size_t slot = 0; slot < count; ++slot){
+
+			auto listener = this->listeners_[slot].listener;
 
-		for (auto& it : listeners){
+			if (listener){
 
-			// The callback may modify the listener list...
+				(*this->callbacks_[slot])(*listener, argument);
 
-			it.second.callback(*(it.second.listener), argument);
+			}
 
 		}
 
@@ -0,0 +1,106 @@
+/// \file occlusion_buffer.h
+/// \brief Software occlusion culling.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+
+#include "gimath.h"
+
+using std::vector;
+
+namespace gi_lib{
+
+	/// \brief Coarse depth buffer rasterized on the CPU and used to cull occluded geometry before it is submitted to the GPU.
+	/// Selected occluder meshes are rasterized first, then the screen-space bounds of the candidate volumes are tested against the resulting depth.
+	/// The depth stored for each pixel is the reciprocal of the view-space depth, so that greater values are closer to the camera and a cleared buffer occludes nothing.
+	/// Pixels are processed 8 (AVX) or 4 (SSE) at a time using coverage masks, falling back to a scalar path where SIMD instructions are not available.
+	/// The buffer does not depend on any graphics API.
+	/// \author Raffaele D. Facendola
+	class OcclusionBuffer{
+
+	public:
+
+		/// \brief Create a new occlusion buffer.
+		/// \param width Width of the buffer in pixels. Rounded up to a multiple of 8.
+		/// \param height Height of the buffer in pixels.
+		OcclusionBuffer(unsigned int width, unsigned int height);
+
+		/// \brief Clear the buffer and set the transformation used by the next occluders and tests.
+		/// \param view_projection Matrix transforming from world space to clip space. The w component of the clip space must be the view-space depth.
+		void Clear(const Matrix4f& view_projection);
+
+		/// \brief Rasterize an occluder.
+		/// Triangles crossing the near plane are skipped: an occluder can only be less effective, never wrong.
+		/// \param positions Object-space positions of the occluder vertices.
+		/// \param indices Indices of the occluder triangles.
+		/// \param start_index Index of the first index to rasterize.
+		/// \param index_count Number of indices to rasterize. Must be a multiple of 3.
+		/// \param world Matrix transforming from object space to world space.
+		void DrawOccluder(const vector<Vector3f>& positions, const vector<unsigned int>& indices, size_t start_index, size_t index_count, const Affine3f& world);
+
+		/// \brief Test whether an axis-aligned bounding box may be visible.
+		/// The test is conservative: boxes crossing the near plane or falling outside the buffer are always visible.
+		/// \param bounds World-space box to test.
+		/// \return Returns false if the box is completely hidden by the rasterized occluders, returns true otherwise.
+		bool IsVisible(const AABB& bounds) const;
+
+		/// \brief Get the width of the buffer in pixels.
+		unsigned int GetWidth() const;
+
+		/// \brief Get the height of the buffer in pixels.
+		unsigned int GetHeight() const;
+
+		/// \brief Get the depth of the buffer.
+		/// Pixels are stored row by row, top to bottom. Each value is the reciprocal of the view-space depth, 0 where nothing was rasterized.
+		const vector<float>& GetDepth() const;
+
+		/// \brief Get the number of triangles rasterized since the last clear.
+		size_t GetTriangleCount() const;
+
+	private:
+
+		/// \brief Rasterize a triangle whose vertices are already in screen space.
+		/// Each vertex stores the pixel coordinates in x and y and the reciprocal of the view-space depth in z.
+		void DrawTriangle(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2);
+
+		unsigned int width_;					///< \brief Width of the buffer in pixels.
+
+		unsigned int height_;					///< \brief Height of the buffer in pixels.
+
+		vector<float> depth_;					///< \brief Reciprocal of the view-space depth of each pixel.
+
+		Matrix4f view_projection_;				///< \brief Matrix transforming from world space to clip space.
+
+		size_t triangle_count_;					///< \brief Number of triangles rasterized since the last clear.
+
+	};
+
+	///////////////////////////////// OCCLUSION BUFFER /////////////////////////////////
+
+	inline unsigned int OcclusionBuffer::GetWidth() const{
+
+		return width_;
+
+	}
+
+	inline unsigned int OcclusionBuffer::GetHeight() const{
+
+		return height_;
+
+	}
+
+	inline const vector<float>& OcclusionBuffer::GetDepth() const{
+
+		return depth_;
+
+	}
+
+	inline size_t OcclusionBuffer::GetTriangleCount() const{
+
+		return triangle_count_;
+
+	}
+
+}
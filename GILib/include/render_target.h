@@ -45,6 +45,13 @@ namespace gi_lib{
 
 		virtual ~IRenderTarget(){};
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kRenderTarget;
+
+		}
+
 		/// \brief Get the number of surfaces in this render target.
 		/// \return Returns the number of surfaces in this render target.
 		virtual size_t GetCount() const = 0;
@@ -149,6 +156,13 @@ namespace gi_lib{
 
 		virtual ~IRenderTargetArray() {};
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kRenderTarget;
+
+		}
+
 		/// \brief Get the number of elements in the array.
 		/// \return Returns the number of elements in the array.
 		virtual size_t GetCount() const = 0;
@@ -7,28 +7,137 @@
 
 #include <string>
 #include <vector>
+#include <typeindex>
 
 #include "object.h"
 
+using ::std::vector;
+using ::std::type_index;
+
 namespace gi_lib{
 
+	class MemoryAccounting;
+
+	/// \brief Categories of the memory used by the resources.
+	enum class MemoryCategory{
+
+		kTexture = 0,			///< \brief Textures, either read-only or writable by the GPU.
+		kMesh,					///< \brief Vertices and indices of the meshes.
+		kBuffer,				///< \brief Structured buffers and arrays.
+		kRenderTarget,			///< \brief Render targets and their depth buffers.
+		kShader,				///< \brief Materials and computations.
+		kOther,					///< \brief Every other resource.
+
+		kCount					///< \brief Number of categories. Not a category.
+
+	};
+
 	/// \brief Base interface for graphical resources.
-	/// Resources are reference counted.
+	/// Resources are reference counted atomically, so that they can be shared with the threads loading them.
 	/// You may improve this class to provide shared functionalities.
 	/// \author Raffaele D. Facendola.
 	class IResource : public Object{
 
 	public:
 
+		/// \brief Create a new resource.
+		IResource();
+
 		/// \brief Virtual destructor.
-		virtual ~IResource() = 0 {};
+		/// Removes the resource from the memory accounting.
+		virtual ~IResource() = 0;
 
 		/// \brief Get the memory footprint of this resource.
 		/// \return Returns the size of the resource, in bytes.
 		virtual size_t GetSize() const = 0;
+
+		/// \brief Get the category of the memory used by this resource.
+		virtual MemoryCategory GetMemoryCategory() const;
+
+	private:
+
+		friend class MemoryAccounting;
+
+		size_t accounted_size_;					///< \brief Size of the resource when it was accounted, in bytes.
+
+		MemoryCategory accounted_category_;		///< \brief Category the resource was accounted in. kCount if the resource is not accounted.
 		
 	};
 
+	/// \brief Memory used by a category of resources.
+	struct MemoryUsage{
+
+		size_t size;							///< \brief Current size, in bytes.
+
+		size_t peak;							///< \brief Highest size ever reached, in bytes.
+
+		size_t count;							///< \brief Number of resources.
+
+	};
+
+	/// \brief Memory used by a single resource.
+	struct MemoryConsumer{
+
+		const IResource* resource;				///< \brief Resource. Identifies the resource only: it may be destroyed after the snapshot was taken.
+
+		type_index type;						///< \brief Concrete type of the resource.
+
+		MemoryCategory category;				///< \brief Category of the resource.
+
+		size_t size;							///< \brief Size of the resource, in bytes.
+
+	};
+
+	/// \brief Snapshot of the memory used by the resources.
+	struct MemorySnapshot{
+
+		MemoryUsage categories[static_cast<size_t>(MemoryCategory::kCount)];	///< \brief Memory used by each category, indexed by category.
+
+		MemoryUsage total;														///< \brief Memory used by every category.
+
+		vector<MemoryConsumer> top_consumers;									///< \brief Largest resources, sorted by decreasing size.
+
+	};
+
+	/// \brief Keeps track of the memory used by the resources.
+	/// Resources are accounted once, when they are loaded, and removed automatically when they are destroyed, possibly on a different thread.
+	/// Resources whose size changes after they were loaded must be refreshed.
+	/// Sizes are kept inside atomic per-category counters, so that querying them costs the same regardless of the number of resources.
+	/// \author Raffaele D. Facendola.
+	class MemoryAccounting{
+
+	public:
+
+		/// \brief Account the memory used by a resource.
+		/// The size of the resource is read once: later changes are ignored until the resource is refreshed. Resources accounted already are ignored.
+		/// \param resource Resource to account.
+		static void Add(IResource& resource);
+
+		/// \brief Account the current size of a resource whose size changed. Resources which were not accounted are ignored.
+		/// \param resource Resource to refresh.
+		static void Refresh(IResource& resource);
+
+		/// \brief Remove a resource from the accounting. Resources which were not accounted are ignored.
+		/// \param resource Resource to remove.
+		static void Remove(IResource& resource);
+
+		/// \brief Get the memory used by a category of resources.
+		/// \param category Category of the resources.
+		/// \return Returns the size of the resources in the category, in bytes.
+		static size_t GetSize(MemoryCategory category);
+
+		/// \brief Get the memory used by every resource.
+		/// \return Returns the size of every accounted resource, in bytes.
+		static size_t GetSize();
+
+		/// \brief Take a snapshot of the memory used by the resources.
+		/// The cost of the snapshot depends on the number of consumers requested only.
+		/// \param top_count Maximum number of consumers to report.
+		/// \return Returns the snapshot of the memory used by the resources.
+		static MemorySnapshot GetSnapshot(size_t top_count);
+
+	};
+
 	/// \brief Macro used to declare that the bundle will use the caching mechanism.
 	#define USE_CACHE \
 	using use_cache = void
@@ -53,5 +162,23 @@ namespace gi_lib{
 
 	};
 
+	///////////////////////////////// IRESOURCE //////////////////////////////////
+
+	inline IResource::IResource() :
+		Object(RefCountPolicy::kAtomic),
+		accounted_size_(0),
+		accounted_category_(MemoryCategory::kCount){}
+
+	inline IResource::~IResource(){
+
+		MemoryAccounting::Remove(*this);
+
+	}
+
+	inline MemoryCategory IResource::GetMemoryCategory() const{
+
+		return MemoryCategory::kOther;
+
+	}
 	
 }
\ No newline at end of file
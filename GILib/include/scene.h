@@ -33,9 +33,228 @@ namespace gi_lib{
 	class NodeComponent;
 	class TransformComponent;
 	class CameraComponent;
+	class VolumeComponent;
+	class TaskPool;
 	
 	class IStaticMesh;
 
+	/// \brief Stores the local and world transforms of every transform component of a scene.
+	/// Transforms are stored as structure of arrays sorted by hierarchy level, so that parents always come before their children.
+	/// Changing a transform only marks it and its subtree dirty: every dirty world matrix is computed by a single linear sweep during Update.
+	/// The update then computes the bounds of the volumes attached to the transforms who changed and finally publishes every change, first to the volume hierarchies and then to the transform listeners.
+	/// World matrices read before the sweep are evaluated lazily, so they are always up-to-date.
+	/// Frozen transforms are moved in front of the others and skipped by the sweep altogether.
+	/// \author Raffaele D. Facendola
+	class TransformSystem{
+
+	public:
+
+		/// \brief Handle of a missing transform.
+		static const unsigned int kNoTransform;
+
+		/// \brief Create an empty system.
+		TransformSystem();
+
+		/// \brief No copy constructor.
+		TransformSystem(const TransformSystem&) = delete;
+
+		/// \brief No assignment operator.
+		TransformSystem& operator=(const TransformSystem&) = delete;
+
+		/// \brief Create a new root transform.
+		/// \param owner Component notified whenever the world transform changes.
+		/// \param translation Local translation.
+		/// \param rotation Local rotation.
+		/// \param scale Local scale.
+		/// \return Returns the handle of the new transform.
+		unsigned int CreateTransform(TransformComponent& owner, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale);
+
+		/// \brief Destroy a transform.
+		/// The transform must have no children.
+		/// \param transform Handle of the transform to destroy.
+		void DestroyTransform(unsigned int transform);
+
+		/// \brief Get the local translation of a transform.
+		const Translation3f& GetTranslation(unsigned int transform) const;
+
+		/// \brief Set the local translation of a transform. The transform is not marked dirty.
+		void SetTranslation(unsigned int transform, const Translation3f& translation);
+
+		/// \brief Get the local rotation of a transform.
+		const Quaternionf& GetRotation(unsigned int transform) const;
+
+		/// \brief Set the local rotation of a transform. The transform is not marked dirty.
+		void SetRotation(unsigned int transform, const Quaternionf& rotation);
+
+		/// \brief Get the local scale of a transform.
+		const AlignedScaling3f& GetScale(unsigned int transform) const;
+
+		/// \brief Set the local scale of a transform. The transform is not marked dirty.
+		void SetScale(unsigned int transform, const AlignedScaling3f& scale);
+
+		/// \brief Get the parent of a transform.
+		/// \return Returns the handle of the parent transform, or kNoTransform if the transform is a root.
+		unsigned int GetParent(unsigned int transform) const;
+
+		/// \brief Set the parent of a transform. The transform is not marked dirty.
+		/// \param parent Handle of the new parent, or kNoTransform to make the transform a root.
+		void SetParent(unsigned int transform, unsigned int parent);
+
+		/// \brief Get the local transform matrix of a transform.
+		/// The reference is valid until a transform is created or destroyed or the system is updated.
+		const Affine3f& GetLocalTransform(unsigned int transform) const;
+
+		/// \brief Get the world transform matrix of a transform, evaluating it if dirty.
+		/// The reference is valid until a transform is created or destroyed or the system is updated.
+		const Affine3f& GetWorldTransform(unsigned int transform) const;
+
+		/// \brief Mark a transform dirty.
+		/// The children of the transform are not marked: the caller is responsible for it.
+		/// While an edit is open the transform is recorded instead and its children are marked when the edit is closed.
+		/// \param transform Handle of the transform.
+		/// \param world_only Whether only the world matrix needs to be computed again, or the local one as well.
+		/// \return Returns true if the world matrix was up-to-date, that is if the children need to be marked dirty as well, returns false otherwise.
+		bool SetDirty(unsigned int transform, bool world_only);
+
+		/// \brief Freeze a transform.
+		/// The world matrix is computed and notified one last time by the next update, after which the transform is excluded from dirty tracking:
+		/// changing the transform, its parent or any of its ancestors has no effect on its world matrix anymore.
+		/// \param transform Handle of the transform.
+		void Freeze(unsigned int transform);
+
+		/// \brief Open an edit.
+		/// Until the edit is closed, changing a transform marks the transform alone: the subtree of each edited transform is marked once, when the edit is closed.
+		/// Edits can be nested: only closing the outermost one marks the subtrees.
+		/// \remarks Reading the world transform of the descendants of an edited transform before the edit is closed returns their old value.
+		/// \see TransformEdit
+		void BeginEdit();
+
+		/// \brief Close an edit opened by BeginEdit.
+		void EndEdit();
+
+		/// \brief Compute every dirty world matrix and notify the owners of the transforms who changed since the last update.
+		/// Call this method once per frame.
+		void Update();
+
+		/// \brief Compute every dirty world matrix and notify the owners of the transforms who changed since the last update.
+		/// The matrices of each hierarchy level and the bounds of the volumes are computed in parallel, the notifications are sent on the calling thread.
+		/// \param pool Pool the work is split across.
+		void Update(TaskPool& pool);
+
+		/// \brief Get the number of transforms inside the system.
+		size_t GetTransformCount() const;
+
+		/// \brief Get the number of world matrices computed by the last update.
+		size_t GetUpdateCount() const;
+
+		/// \brief Get the number of transforms notified by the last update.
+		size_t GetChangeCount() const;
+
+		/// \brief Get the number of frozen transforms skipped by the last update.
+		size_t GetFrozenCount() const;
+
+	private:
+
+		/// \brief Flags of a transform.
+		static const unsigned char kLocalDirty = 1;		///< \brief The local matrix needs to be computed.
+		static const unsigned char kWorldDirty = 2;		///< \brief The world matrix needs to be computed.
+		static const unsigned char kChanged = 4;		///< \brief The owner needs to be notified during the next update.
+		static const unsigned char kEdited = 8;			///< \brief The children need to be marked dirty when the edit is closed.
+		static const unsigned char kFreeze = 16;		///< \brief The transform is frozen as soon as the owner is notified.
+		static const unsigned char kFrozen = 32;		///< \brief The transform is excluded from dirty tracking.
+
+		/// \brief Compute the world matrix of a dirty transform and of its dirty ancestors.
+		void EvaluateWorldTransform(unsigned int slot) const;
+
+		/// \brief Compute the dirty matrices of a range of slots whose parents are up-to-date.
+		/// \return Returns the number of world matrices computed.
+		size_t Sweep(unsigned int begin, unsigned int end);
+
+		/// \brief Collect the transforms who changed since the last update and clear their flags.
+		void CollectChanges();
+
+		/// \brief Compute the bounds of the volumes attached to a transform who changed.
+		/// \param change Index of the change.
+		void UpdateBounds(size_t change);
+
+		/// \brief Notify the changes collected by the current update.
+		void Publish();
+
+		/// \brief Sort the transforms by hierarchy level, after the frozen ones.
+		void Sort();
+
+		/// \brief Move a transform from a slot to another one.
+		void Move(unsigned int source, unsigned int destination);
+
+		vector<unsigned int> slots_;							///< \brief Slot of each transform handle. kNoTransform for free handles.
+
+		vector<unsigned int> free_transforms_;					///< \brief Handles available for recycling.
+
+		vector<unsigned int> transforms_;						///< \brief Handle of the transform stored inside each slot.
+
+		vector<TransformComponent*> owners_;					///< \brief Owner of each slot.
+
+		vector<unsigned int> parents_;							///< \brief Handle of the parent of each slot.
+
+		vector<unsigned int> parent_slots_;						///< \brief Slot of the parent of each slot. Valid only when the slots are sorted.
+
+		vector<Translation3f> translations_;					///< \brief Local translation of each slot.
+
+		vector<Quaternionf> rotations_;							///< \brief Local rotation of each slot.
+
+		vector<AlignedScaling3f> scales_;						///< \brief Local scale of each slot.
+
+		mutable vector<Affine3f> local_transforms_;				///< \brief Local matrix of each slot.
+
+		mutable vector<Affine3f> world_transforms_;				///< \brief World matrix of each slot.
+
+		mutable vector<unsigned char> flags_;					///< \brief Flags of each slot.
+
+		vector<unsigned int> changes_;							///< \brief Transforms being notified by the current update. Reused across updates.
+
+		vector<unsigned int> edits_;							///< \brief Transforms changed since the outermost edit was opened.
+
+		unsigned int edit_depth_;								///< \brief Number of edits currently open.
+
+		vector<unsigned int> levels_;							///< \brief First slot of each hierarchy level, followed by the number of slots. Valid only when the slots are sorted.
+
+		unsigned int frozen_count_;								///< \brief Number of frozen transforms, stored inside the first slots. Valid only when the slots are sorted.
+
+		bool sorted_;											///< \brief Whether the slots are sorted by hierarchy level.
+
+		size_t update_count_;									///< \brief Number of world matrices computed by the last update.
+
+		size_t change_count_;									///< \brief Number of transforms notified by the last update.
+
+	};
+
+	/// \brief Scope of an edit of the transforms of a system.
+	/// Opens an edit when created and closes it when destroyed.
+	/// \see TransformSystem::BeginEdit
+	/// \author Raffaele D. Facendola
+	class TransformEdit{
+
+	public:
+
+		/// \brief Open an edit.
+		/// \param system System whose transforms are going to be edited.
+		TransformEdit(TransformSystem& system);
+
+		/// \brief No copy constructor.
+		TransformEdit(const TransformEdit&) = delete;
+
+		/// \brief Close the edit.
+		~TransformEdit();
+
+		/// \brief No assignment operator.
+		TransformEdit& operator=(const TransformEdit&) = delete;
+
+	private:
+
+		TransformSystem& system_;		///< \brief System being edited.
+
+	};
+
 	/// \brief Represents a scene and all its content.
 	/// \author Raffaele D. Facendola
 	class Scene{
@@ -43,6 +262,9 @@ namespace gi_lib{
 	public:
 
 		/// \brief Default constructor.
+		/// Volumes of static nodes are kept apart, inside a static tree: the specified hierarchies only store the volumes of the other nodes.
+		/// \param mesh_hierarchy Hierarchy storing the meshes of the nodes which are not static.
+		/// \param light_hierarchy Hierarchy storing the lights of the nodes which are not static.
 		Scene(unique_ptr<IVolumeHierarchy> mesh_hierarchy, unique_ptr<IVolumeHierarchy> light_hierarchy);
 
 		/// \brief Scene destructor.
@@ -64,6 +286,16 @@ namespace gi_lib{
 		/// \return Returns a pointer to the created node.
 		TransformComponent* CreateNode(const wstring& name, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale);
 
+		/// \brief Create a new static scene node with a TransformComponent.
+		/// The world matrix and the bounds of the node are frozen by the next commit.
+		/// \param name The name of the node.
+		/// \param translation Node translation.
+		/// \param rotation Node rotation.
+		/// \param scale Node scale.
+		/// \return Returns a pointer to the created node.
+		/// \see NodeComponent::IsStatic
+		TransformComponent* CreateStaticNode(const wstring& name, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale);
+
 		/// \brief Get the main camera of the scene.
 		/// \return Returns the main camera of the scene.
 		CameraComponent* GetMainCamera();
@@ -93,6 +325,38 @@ namespace gi_lib{
 		/// \return Returns the light hierarchy/// \brief Get the light hierarchy.
 		const IVolumeHierarchy& GetLightHierarchy() const;
 
+		/// \brief Get the transform system.
+		/// \return Returns the system storing the transforms of the scene.
+		TransformSystem& GetTransformSystem();
+
+		/// \brief Get the transform system.
+		/// \return Returns the system storing the transforms of the scene.
+		const TransformSystem& GetTransformSystem() const;
+
+		/// \brief Get the queue of the events deferred until the next commit.
+		/// \return Returns the queue of the events deferred until the next commit.
+		EventQueue& GetEventQueue();
+
+		/// \brief Get the allocator of the nodes and their components.
+		/// \return Returns the allocator of the nodes and their components.
+		const ComponentAllocator& GetAllocator() const;
+
+		/// \brief Get the components of every node exposing all the specified types.
+		/// Nodes are grouped by archetype, so the components are visited as packed arrays.
+		/// \tparam TComponents Types of the components each node must have.
+		/// \return Returns the components found. The result is invalidated as soon as any node gains or loses a component.
+		template <typename... TComponents>
+		ComponentQuery<TComponents...> Query() const;
+
+		/// \brief Update the transforms, deliver the deferred events, then commit the pending changes of both the mesh and the light hierarchy.
+		/// Call this method once per frame, before querying the hierarchies.
+		void Commit();
+
+		/// \brief Update the transforms and the bounds in parallel, deliver the deferred events, then commit the pending changes of both the mesh and the light hierarchy.
+		/// Call this method once per frame, before querying the hierarchies.
+		/// \param pool Pool used to update the transforms and the bounds.
+		void Commit(TaskPool& pool);
+
 		/// \brief Get the list of the nodes created so far.
 		/// \return Returns the list of the nodes created so far.
 		const vector<NodeComponent*>& GetNodes() const;
@@ -103,10 +367,18 @@ namespace gi_lib{
 
 	private:
 
+		ComponentAllocator allocator_;						///< \brief Allocator of the nodes and their components. Declared first, so that it outlives them.
+
 		vector<NodeComponent*> nodes_;						///< \brief Nodes inside the scene.
 
 		CameraComponent* main_camera_;						///< \brief Main camera.
 
+		TransformSystem transforms_;						///< \brief Transforms of the nodes.
+
+		EventQueue events_;									///< \brief Events deferred until the next commit.
+
+		ArchetypeStorage archetypes_;						///< \brief Components of the nodes, grouped by archetype.
+
 		unique_ptr<IVolumeHierarchy> mesh_hierarchy_;		///< \brief Mesh hierarchy.
 
 		unique_ptr<IVolumeHierarchy> light_hierarchy_;		///< \brief Light hierarchy.
@@ -129,6 +401,12 @@ namespace gi_lib{
 		/// \param name The node name.
 		NodeComponent(Scene& scene, const wstring& name);
 
+		/// \brief Create a new scene node.
+		/// \param scene The scene this node is associated to.
+		/// \param name The node name.
+		/// \param is_static Whether the node is static.
+		NodeComponent(Scene& scene, const wstring& name, bool is_static);
+
 		/// \brief Destructor.
 		virtual ~NodeComponent();
 
@@ -149,6 +427,12 @@ namespace gi_lib{
 		/// \return Returns the node unique identifier.
 		const Unique<NodeComponent> GetUid() const;
 
+		/// \brief Check whether the node is static.
+		/// Static nodes never move: their world matrix and their bounds are frozen by the first commit of the scene,
+		/// their transform is excluded from dirty tracking and their volumes are stored inside a separate hierarchy, which never relocates them.
+		/// \return Returns true if the node is static, returns false otherwise.
+		bool IsStatic() const;
+
 		virtual TypeSet GetTypes() const override;
 
 	protected:
@@ -161,6 +445,8 @@ namespace gi_lib{
 
 		Scene& scene_;						///< \brief Scene owning this node.
 
+		const bool is_static_;				///< \brief Whether the node is static.
+
 		const wstring name_;				///< \brief Name of the node.
 
 		const Unique<NodeComponent> uid_;	///< \brief Unique id of the node.
@@ -169,9 +455,12 @@ namespace gi_lib{
 
 	/// \brief Expose 3D-space transform capabilities.
 	/// The composite transformation is calculated by applying the scaling first, the rotation second and the translation last.
+	/// The component is a handle to the transform stored inside the transform system of the scene: changes are notified when the system is updated.
 	/// \author Raffaele D. Facendola
 	class TransformComponent : public Component{
 
+		friend class TransformSystem;
+
 	public:
 
 		/// \brief Arguments for the OnTransformChanged event.
@@ -187,13 +476,19 @@ namespace gi_lib{
 
 		/// \brief Create a new transform interface.
 		/// The local transform is initialized as an identity matrix.
-		TransformComponent();
+		/// \param system System storing the transform.
+		TransformComponent(TransformSystem& system);
 
 		/// \brief Create a new transform interface.
+		/// \param system System storing the transform.
 		/// \param translation Local translation.
 		/// \param rotation Local rotation.
 		/// \param scale Local scale.
-		TransformComponent(const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale);
+		TransformComponent(TransformSystem& system, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale);
+
+		/// \brief Destructor.
+		/// Children are detached and become roots.
+		virtual ~TransformComponent();
 
 		/// \brief Get the translation.
 		/// \return Returns the translation component.
@@ -219,6 +514,13 @@ namespace gi_lib{
 		/// \param scale The new scaling.
 		void SetScale(const AlignedScaling3f & scale);
 
+		/// \brief Set the translation, the rotation and the scaling components at once.
+		/// The subtree is marked dirty once, rather than once per component.
+		/// \param translation The new translation.
+		/// \param rotation The new rotation.
+		/// \param scale The new scaling.
+		void SetTRS(const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale);
+
 		/// \brief Get the right direction.
 		/// The right direction defines the positive X-axis in world space.
 		/// \return Returns the right direction.
@@ -269,8 +571,18 @@ namespace gi_lib{
 		virtual TypeSet GetTypes() const override;
 
 		/// \brief Event triggered when either the local or the composite transform matrix has been changed.
+		/// The event is triggered once per change by TransformSystem::Update, regardless of the number of edits, after the bounds of the attached volumes were updated.
 		Observable<OnTransformChangedEventArgs>& OnTransformChanged();
 
+		/// \brief Attach a volume to this transform.
+		/// The bounds of the volume are computed again and published by the transform system whenever the world transform changes.
+		/// \param volume Volume to attach.
+		void AttachVolume(VolumeComponent& volume);
+
+		/// \brief Detach a volume from this transform.
+		/// \param volume Volume to detach.
+		void DetachVolume(VolumeComponent& volume);
+
 	protected:
 
 		virtual void Initialize() override;
@@ -280,27 +592,22 @@ namespace gi_lib{
 	private:
 
 		/// \brief Signals that the local or the world transform needs to be calculated again.
-		/// This method will dirty every child node.
+		/// This method will dirty every child node which is not dirty already.
 		/// \param world_only Set this to true to dirten the world matrix only, set this to false to dirten both the local and the world matrix.
-		void SetDirty(bool world_only);	
-
-		TransformComponent* parent_;			///< \brief Parent transform.
+		void SetDirty(bool world_only);
 
-		vector<TransformComponent*> children_;	///< \brief Children transforms.
-
-		Translation3f translation_;				///< \brief Translation component.
-
-		Quaternionf rotation_;					///< \brief Rotation component.
+		/// \brief Trigger the OnTransformChanged event.
+		void NotifyChange();
 
-		AlignedScaling3f scale_;				///< \brief Scale component.
+		TransformSystem& system_;				///< \brief System storing the transform.
 
-		mutable Affine3f local_transform_;		///< \brief Local transform.
+		unsigned int transform_;				///< \brief Handle of the transform inside the system.
 
-		mutable Affine3f world_transform_;		///< \brief Composite transform.
+		TransformComponent* parent_;			///< \brief Parent transform.
 
-		mutable bool local_dirty_;				///< \brief The local transform needs to be recalculated.
+		vector<TransformComponent*> children_;	///< \brief Children transforms.
 
-		mutable bool world_dirty_;				///< \brief The world transform needs to be calculated.
+		vector<VolumeComponent*> volumes_;		///< \brief Volumes whose bounds depend on the transform.
 
 		Event< OnTransformChangedEventArgs > on_transform_changed_;		///< \brief Triggered when the transform matrix has been changed.
 
@@ -310,6 +617,8 @@ namespace gi_lib{
 	/// \author Raffaele D. Facendola
 	class VolumeComponent : public Component{
 
+		friend class TransformSystem;
+
 	public:
 
 		/// \brief Arguments relative to OnChanged event.
@@ -319,6 +628,12 @@ namespace gi_lib{
 
 		};
 
+		/// \brief Slot value of a volume that doesn't belong to any hierarchy.
+		static const unsigned int kNoSlot;
+
+		/// \brief Default constructor.
+		VolumeComponent();
+
 		/// \brief Virtual destructor.
 		virtual ~VolumeComponent() {};
 
@@ -340,21 +655,45 @@ namespace gi_lib{
 		/// \remarks This is not intended to be a perfect test! False positive may occur.
 		virtual IntersectionType TestAgainst(const Sphere& sphere) const = 0;
 
+		/// \brief Get the axis-aligned bounding box enclosing the volume in world space.
+		/// \return Returns the axis-aligned bounding box enclosing the volume. Unbounded volumes have infinite half-extents.
+		virtual AABB GetBoundingBox() const = 0;
+
 		/// \brief Event that is signaled whenever the bounds change.
 		/// \return Returns the event that is signaled whenever the bounds change.
 		Observable<OnChangedEventArgs>& OnChanged();
 
 		virtual TypeSet GetTypes() const override;
 
+		/// \brief Get the slot assigned to this volume by the hierarchy containing it.
+		/// \return Returns the slot assigned to this volume, or kNoSlot if none was assigned.
+		unsigned int GetHierarchySlot() const;
+
+		/// \brief Assign a slot to this volume.
+		/// The slot is an opaque index owned by the hierarchy containing the volume, used to locate the volume in constant time.
+		/// \param slot The new slot. Use kNoSlot to clear the slot.
+		void SetHierarchySlot(unsigned int slot);
+
 	protected:
 
 		/// \brief Notify that the volume has changed
 		void NotifyChange();
 
+		/// \brief Defer the change notifications to an event queue.
+		/// Multiple changes of the volume are notified once, when the queue is flushed.
+		/// \param queue Queue receiving the notifications. Use nullptr to notify the changes immediately. Pending notifications are discarded.
+		void DeferChanges(EventQueue* queue);
+
+		/// \brief Compute the bounds of the volume after the world transform of its node changed, without notifying the change.
+		/// Called by the transform system, possibly on a worker thread: implementations may only write the volume itself.
+		virtual void UpdateBounds() = 0;
+
 	private:
 
 		Event<OnChangedEventArgs> on_changed_;					///< \brief Event signaled whenever the bounds change.
 
+		unsigned int hierarchy_slot_;							///< \brief Slot assigned by the hierarchy containing this volume.
+
 	};
 
 	/// \brief Mesh component.
@@ -388,6 +727,8 @@ namespace gi_lib{
 
 		virtual IntersectionType TestAgainst(const Sphere& sphere) const override;
 
+		virtual AABB GetBoundingBox() const override;
+
 		virtual TypeSet GetTypes() const override;
 
 		/// \brief Get the world transform of the mesh.
@@ -402,6 +743,8 @@ namespace gi_lib{
 
 		virtual void Finalize() override;
 
+		virtual void UpdateBounds() override;
+
 	private:
 
 		/// \brief Compute the new bounds of the mesh.
@@ -414,8 +757,6 @@ namespace gi_lib{
 
 		AABB bounding_box_;										///< \brief Bounding box.
 
-		unique_ptr<Listener> on_transform_changed_lister_;		///< \brief Listener for the transform changed event.
-
 		AABB transformed_bounds_;								///< \brief Transformed bounds.
 
 		Sphere bounding_sphere_;								///< \brief Bounding sphere.
@@ -597,6 +938,153 @@ namespace gi_lib{
 		
 	};
 
+	////////////////////////////////// TRANSFORM SYSTEM //////////////////////////////
+
+	inline const Translation3f& TransformSystem::GetTranslation(unsigned int transform) const{
+
+		return translations_[slots_[transform]];
+
+	}
+
+	inline void TransformSystem::SetTranslation(unsigned int transform, const Translation3f& translation){
+
+		translations_[slots_[transform]] = translation;
+
+	}
+
+	inline const Quaternionf& TransformSystem::GetRotation(unsigned int transform) const{
+
+		return rotations_[slots_[transform]];
+
+	}
+
+	inline void TransformSystem::SetRotation(unsigned int transform, const Quaternionf& rotation){
+
+		rotations_[slots_[transform]] = rotation;
+
+	}
+
+	inline const AlignedScaling3f& TransformSystem::GetScale(unsigned int transform) const{
+
+		return scales_[slots_[transform]];
+
+	}
+
+	inline void TransformSystem::SetScale(unsigned int transform, const AlignedScaling3f& scale){
+
+		scales_[slots_[transform]] = scale;
+
+	}
+
+	inline unsigned int TransformSystem::GetParent(unsigned int transform) const{
+
+		return parents_[slots_[transform]];
+
+	}
+
+	inline const Affine3f& TransformSystem::GetWorldTransform(unsigned int transform) const{
+
+		auto slot = slots_[transform];
+
+		if (flags_[slot] & kWorldDirty){
+
+			EvaluateWorldTransform(slot);
+
+		}
+
+		return world_transforms_[slot];
+
+	}
+
+	inline bool TransformSystem::SetDirty(unsigned int transform, bool world_only){
+
+		auto& flags = flags_[slots_[transform]];
+
+		if (flags & kFrozen){
+
+			return false;		// Neither the transform nor its children are affected
+
+		}
+
+		auto clean = (flags & kWorldDirty) == 0;
+
+		flags |= kWorldDirty | kChanged | (world_only ? 0 : kLocalDirty);
+
+		if (edit_depth_ > 0){
+
+			if ((flags & kEdited) == 0){
+
+				flags |= kEdited;
+
+				edits_.push_back(transform);
+
+			}
+
+			return false;		// Deferred until the edit is closed
+
+		}
+
+		return clean;
+
+	}
+
+	inline void TransformSystem::BeginEdit(){
+
+		++edit_depth_;
+
+	}
+
+	inline void TransformSystem::Freeze(unsigned int transform){
+
+		auto& flags = flags_[slots_[transform]];
+
+		if ((flags & kFrozen) == 0){
+
+			flags |= kFreeze | kChanged;		// The owner is notified once more, with the final matrix
+
+		}
+
+	}
+
+	inline size_t TransformSystem::GetFrozenCount() const{
+
+		return frozen_count_;
+
+	}
+
+	inline size_t TransformSystem::GetTransformCount() const{
+
+		return transforms_.size();
+
+	}
+
+	inline size_t TransformSystem::GetUpdateCount() const{
+
+		return update_count_;
+
+	}
+
+	inline size_t TransformSystem::GetChangeCount() const{
+
+		return change_count_;
+
+	}
+
+	////////////////////////////////// TRANSFORM EDIT //////////////////////////////
+
+	inline TransformEdit::TransformEdit(TransformSystem& system) :
+	system_(system){
+
+		system_.BeginEdit();
+
+	}
+
+	inline TransformEdit::~TransformEdit(){
+
+		system_.EndEdit();
+
+	}
+
 	////////////////////////////////// SCENE //////////////////////////////
 
 	inline const vector<NodeComponent*>& Scene::GetNodes() const{
@@ -611,6 +1099,37 @@ namespace gi_lib{
 
 	}
 
+	inline TransformSystem& Scene::GetTransformSystem(){
+
+		return transforms_;
+
+	}
+
+	inline const TransformSystem& Scene::GetTransformSystem() const{
+
+		return transforms_;
+
+	}
+
+	inline EventQueue& Scene::GetEventQueue(){
+
+		return events_;
+
+	}
+
+	inline const ComponentAllocator& Scene::GetAllocator() const{
+
+		return allocator_;
+
+	}
+
+	template <typename... TComponents>
+	inline ComponentQuery<TComponents...> Scene::Query() const{
+
+		return archetypes_.Query<TComponents...>();
+
+	}
+
 	////////////////////////////////// VOLUME COMPONENT ///////////////////////////////////
 
 	inline Observable<VolumeComponent::OnChangedEventArgs>& VolumeComponent::OnChanged() {
@@ -619,6 +1138,21 @@ namespace gi_lib{
 
 	}
 
+	inline VolumeComponent::VolumeComponent() :
+		hierarchy_slot_(kNoSlot){}
+
+	inline unsigned int VolumeComponent::GetHierarchySlot() const {
+
+		return hierarchy_slot_;
+
+	}
+
+	inline void VolumeComponent::SetHierarchySlot(unsigned int slot) {
+
+		hierarchy_slot_ = slot;
+
+	}
+
 	inline void VolumeComponent::NotifyChange() {
 
 		auto args = OnChangedEventArgs{ this };
@@ -627,6 +1161,12 @@ namespace gi_lib{
 
 	}
 
+	inline void VolumeComponent::DeferChanges(EventQueue* queue) {
+
+		on_changed_.SetQueue(queue);
+
+	}
+
 	////////////////////////////////// MESH COMPONENT //////////////////////////////////////
 
 	inline const Affine3f& MeshComponent::GetWorldTransform() const {
@@ -635,6 +1175,12 @@ namespace gi_lib{
 
 	}
 
+	inline AABB MeshComponent::GetBoundingBox() const {
+
+		return transformed_bounds_;
+
+	}
+
 	inline const Sphere& MeshComponent::GetBoundingSphere() const {
 
 		return bounding_sphere_;
@@ -737,11 +1283,7 @@ namespace gi_lib{
 	template <typename TMaterial>
 	typename AspectComponent<TMaterial>::TypeSet AspectComponent<TMaterial>::GetTypes() const {
 
-		auto types = Component::GetTypes();
-
-		types.insert(type_index(typeid(AspectComponent<TMaterial>)));
-
-		return types;
+		return DeriveTypes<AspectComponent<TMaterial>>(Component::GetTypes());
 
 	}
 
@@ -0,0 +1,293 @@
+/// \file scene_snapshot.h
+/// \brief Binary snapshots of imported scenes.
+///
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "eigen.h"
+#include "gimath.h"
+#include "mesh.h"
+
+using ::std::wstring;
+using ::std::string;
+using ::std::vector;
+using ::std::unique_ptr;
+
+namespace gi_lib{
+
+	/// \brief Array stored inside a snapshot.
+	/// The array is stored as an offset from the beginning of the snapshot, which is replaced by a pointer when the snapshot is loaded.
+	/// \tparam TElement Type of the elements.
+	template <typename TElement>
+	struct SnapshotArray{
+
+		union{
+
+			unsigned long long offset;		///< \brief Offset of the first element from the beginning of the snapshot. Valid while the snapshot is stored.
+
+			TElement* data;					///< \brief Pointer to the first element. Valid while the snapshot is loaded.
+
+		};
+
+		unsigned long long size;			///< \brief Number of elements.
+
+		/// \brief Get a pointer to the first element.
+		const TElement* begin() const;
+
+		/// \brief Get a pointer past the last element.
+		const TElement* end() const;
+
+		/// \brief Access an element by index.
+		const TElement& operator[](size_t index) const;
+
+	};
+
+	/// \brief Node stored inside a snapshot.
+	struct SnapshotNode{
+
+		SnapshotArray<wchar_t> name;				///< \brief Name of the node.
+
+		unsigned int parent;						///< \brief Index of the parent node, or SceneSnapshot::kNone if the node is attached to the root. Parents always precede their children.
+
+		unsigned int mesh;							///< \brief Index of the mesh of the node, or SceneSnapshot::kNone if the node has no mesh.
+
+		float translation[3];						///< \brief Local translation.
+
+		float rotation[4];							///< \brief Local rotation, as quaternion coefficients in (x, y, z, w) order.
+
+		float scale[3];								///< \brief Local scale.
+
+	};
+
+	/// \brief Mesh subset stored inside a snapshot.
+	struct SnapshotSubset{
+
+		SnapshotArray<wchar_t> name;				///< \brief Name of the subset.
+
+		unsigned long long start_index;				///< \brief Index of the first vertex of the subset.
+
+		unsigned long long count;					///< \brief Number of triangles of the subset.
+
+		unsigned int material;						///< \brief Index of the material of the subset, or SceneSnapshot::kNone if the subset has no material.
+
+		unsigned int reserved;						///< \brief Padding.
+
+	};
+
+	/// \brief Mesh stored inside a snapshot.
+	struct SnapshotMesh{
+
+		SnapshotArray<wchar_t> name;							///< \brief Name of the mesh.
+
+		SnapshotArray<VertexFormatNormalTextured> vertices;		///< \brief Unindexed vertices of the mesh. Topology: triangle list.
+
+		SnapshotArray<SnapshotSubset> subsets;					///< \brief Subsets of the mesh.
+
+		AABB bounds;											///< \brief Bounds of the mesh, in object space.
+
+	};
+
+	/// \brief Material property stored inside a snapshot.
+	struct SnapshotProperty{
+
+		SnapshotArray<char> name;					///< \brief Name of the property.
+
+		SnapshotArray<char> value;					///< \brief Value of the property, as it appeared inside the source file.
+
+	};
+
+	/// \brief Material stored inside a snapshot.
+	struct SnapshotMaterial{
+
+		SnapshotArray<char> name;							///< \brief Name of the material.
+
+		SnapshotArray<SnapshotProperty> properties;			///< \brief Properties of the material.
+
+	};
+
+	/// \brief Binary snapshot of an imported scene, containing the node hierarchy, the transforms, the meshes, the material parameters and the bounds of each mesh.
+	/// A snapshot is a single block of memory: it is written to file as it is and loaded back with a single read, after which the offsets stored inside it are fixed up into pointers.
+	/// Snapshots are not portable across platforms and are discarded whenever the version does not match.
+	/// \author Raffaele D. Facendola
+	class SceneSnapshot{
+
+	public:
+
+		/// \brief Index of a missing parent, mesh or material.
+		static const unsigned int kNone;
+
+		/// \brief Version of the format. Snapshots with a different version are discarded.
+		static const unsigned int kVersion;
+
+		/// \brief Content of a snapshot, used to create one.
+		struct Description{
+
+			/// \brief Node of the hierarchy.
+			struct Node{
+
+				wstring name;						///< \brief Name of the node.
+
+				unsigned int parent;				///< \brief Index of the parent node, or kNone to attach the node to the root. Must precede the node.
+
+				unsigned int mesh;					///< \brief Index of the mesh of the node, or kNone.
+
+				Translation3f translation;			///< \brief Local translation.
+
+				Quaternionf rotation;				///< \brief Local rotation.
+
+				AlignedScaling3f scale;				///< \brief Local scale.
+
+			};
+
+			/// \brief Subset of a mesh.
+			struct Subset{
+
+				wstring name;						///< \brief Name of the subset.
+
+				MeshSubset range;					///< \brief First vertex and number of triangles of the subset.
+
+				unsigned int material;				///< \brief Index of the material of the subset, or kNone.
+
+			};
+
+			/// \brief Mesh referenced by the nodes.
+			struct Mesh{
+
+				wstring name;									///< \brief Name of the mesh.
+
+				vector<VertexFormatNormalTextured> vertices;	///< \brief Unindexed vertices. Topology: triangle list.
+
+				vector<Subset> subsets;							///< \brief Subsets of the mesh.
+
+			};
+
+			/// \brief Named material property.
+			struct Property{
+
+				string name;						///< \brief Name of the property.
+
+				string value;						///< \brief Value of the property.
+
+			};
+
+			/// \brief Material referenced by the subsets.
+			struct Material{
+
+				string name;						///< \brief Name of the material.
+
+				vector<Property> properties;		///< \brief Properties of the material.
+
+			};
+
+			vector<Node> nodes;						///< \brief Nodes of the hierarchy.
+
+			vector<Mesh> meshes;					///< \brief Meshes referenced by the nodes.
+
+			vector<Material> materials;				///< \brief Materials referenced by the subsets.
+
+		};
+
+		/// \brief Create a snapshot from a description.
+		/// The bounds of each mesh are computed from its vertices.
+		/// \param description Content of the snapshot.
+		SceneSnapshot(const Description& description);
+
+		/// \brief No copy constructor.
+		SceneSnapshot(const SceneSnapshot&) = delete;
+
+		/// \brief No assignment operator.
+		SceneSnapshot& operator=(const SceneSnapshot&) = delete;
+
+		/// \brief Load a snapshot from file.
+		/// \param file_name Name of the snapshot file.
+		/// \return Returns the loaded snapshot. Returns nullptr if the file could not be read, was written with a different version or is malformed.
+		static unique_ptr<SceneSnapshot> Load(const wstring& file_name);
+
+		/// \brief Load a snapshot from a memory block.
+		/// \param data Pointer to the memory block, laid out as a snapshot file.
+		/// \param size Size of the memory block, in bytes.
+		/// \return Returns the loaded snapshot. Returns nullptr if the block was written with a different version or is malformed.
+		static unique_ptr<SceneSnapshot> Load(const void* data, size_t size);
+
+		/// \brief Write the snapshot to file.
+		/// \param file_name Name of the snapshot file.
+		/// \return Returns true if the snapshot was written, returns false otherwise.
+		bool Save(const wstring& file_name) const;
+
+		/// \brief Write the snapshot to a memory block.
+		/// \param data Receives the snapshot, laid out as a snapshot file. Output.
+		void Save(vector<char>& data) const;
+
+		/// \brief Get the nodes of the hierarchy. Parents always precede their children.
+		const SnapshotArray<SnapshotNode>& GetNodes() const;
+
+		/// \brief Get the meshes referenced by the nodes.
+		const SnapshotArray<SnapshotMesh>& GetMeshes() const;
+
+		/// \brief Get the materials referenced by the subsets.
+		const SnapshotArray<SnapshotMaterial>& GetMaterials() const;
+
+		/// \brief Get the size of the snapshot, in bytes.
+		size_t GetSize() const;
+
+	private:
+
+		struct Header;
+
+		/// \brief Create a snapshot from a memory block whose offsets were fixed up already.
+		SceneSnapshot(vector<unsigned long long> buffer);
+
+		/// \brief Create a snapshot from the image of a file, fixing up its offsets.
+		/// \param buffer Image of the snapshot file.
+		/// \param size Size of the image, in bytes.
+		/// \return Returns the snapshot. Returns nullptr if the image was written with a different version or is malformed.
+		static unique_ptr<SceneSnapshot> FromImage(vector<unsigned long long> buffer, size_t size);
+
+		/// \brief Get the image of the snapshot file, with offsets in place of the pointers.
+		vector<unsigned long long> GetImage() const;
+
+		/// \brief Get the header of the snapshot.
+		const Header& GetHeader() const;
+
+		/// \brief Convert every array of a snapshot, walking the records from the header.
+		/// \param relocate Functor converting an array and returning a pointer to its elements, or nullptr if the array is malformed.
+		/// \return Returns true if every array was converted, returns false otherwise.
+		template <typename TRelocate>
+		static bool Relocate(Header& header, const TRelocate& relocate);
+
+		/// \brief Check that every index stored inside the snapshot is in range.
+		bool Validate() const;
+
+		vector<unsigned long long> buffer_;			///< \brief Memory block of the snapshot. Stored as 64-bit words to keep every record aligned.
+
+	};
+
+	///////////////////////////////// SNAPSHOT ARRAY /////////////////////////////////
+
+	template <typename TElement>
+	inline const TElement* SnapshotArray<TElement>::begin() const{
+
+		return data;
+
+	}
+
+	template <typename TElement>
+	inline const TElement* SnapshotArray<TElement>::end() const{
+
+		return data + size;
+
+	}
+
+	template <typename TElement>
+	inline const TElement& SnapshotArray<TElement>::operator[](size_t index) const{
+
+		return data[index];
+
+	}
+
+}
@@ -0,0 +1,103 @@
+/// \file slab_pool.h
+/// \brief Pools of fixed-size memory blocks.
+///
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+using ::std::unique_ptr;
+using ::std::vector;
+
+namespace gi_lib{
+
+	/// \brief Usage statistics of a pool.
+	struct PoolStatistics{
+
+		size_t block_size;				///< \brief Size of each block, in bytes, including the padding.
+
+		size_t live_count;				///< \brief Number of blocks currently allocated.
+
+		size_t peak_count;				///< \brief Maximum number of blocks allocated at the same time.
+
+		size_t allocation_count;		///< \brief Number of allocations served so far.
+
+		size_t slab_count;				///< \brief Number of slabs reserved.
+
+		size_t reserved_bytes;			///< \brief Memory reserved by the slabs, in bytes.
+
+	};
+
+	/// \brief Allocator of fixed-size blocks carved out of larger slabs.
+	/// Blocks allocated one after the other are contiguous in memory, and freed blocks are recycled before reserving a new slab.
+	/// Slabs are never returned while the pool is alive: they are released all at once when the pool is destroyed.
+	/// The pool is not thread-safe.
+	/// \author Raffaele D. Facendola
+	class SlabPool{
+
+	public:
+
+		/// \brief Alignment of each block, suitable for vectorized types.
+		static const size_t kAlignment;
+
+		/// \brief Size of each slab, in bytes.
+		static const size_t kSlabSize;
+
+		/// \brief Create an empty pool.
+		/// \param block_size Minimum size of each block, in bytes.
+		SlabPool(size_t block_size);
+
+		/// \brief No copy constructor.
+		SlabPool(const SlabPool&) = delete;
+
+		/// \brief Destructor.
+		/// Releases every slab: blocks still allocated become invalid.
+		~SlabPool();
+
+		/// \brief No assignment operator.
+		SlabPool& operator=(const SlabPool&) = delete;
+
+		/// \brief Allocate a block.
+		/// \return Returns a pointer to an uninitialized block of memory.
+		void* Allocate();
+
+		/// \brief Return a block to the pool.
+		/// \param block Block to return. Must have been allocated by this pool.
+		void Free(void* block);
+
+		/// \brief Get the usage statistics of the pool.
+		const PoolStatistics& GetStatistics() const;
+
+	private:
+
+		/// \brief Block waiting to be allocated.
+		struct FreeBlock{
+
+			FreeBlock* next;			///< \brief Next free block.
+
+		};
+
+		/// \brief Reserve a new slab and add its blocks to the free list.
+		void Grow();
+
+		size_t slab_blocks_;						///< \brief Number of blocks in each slab.
+
+		vector<unique_ptr<char[]>> slabs_;			///< \brief Slabs reserved so far.
+
+		FreeBlock* free_list_;						///< \brief First free block.
+
+		PoolStatistics statistics_;					///< \brief Usage statistics.
+
+	};
+
+	///////////////////////////////// SLAB POOL /////////////////////////////////
+
+	inline const PoolStatistics& SlabPool::GetStatistics() const{
+
+		return statistics_;
+
+	}
+
+}
@@ -0,0 +1,112 @@
+/// \file split_hierarchy.h
+/// \brief Volume hierarchy storing static and dynamic volumes apart.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "volume_hierarchy.h"
+
+using ::std::unique_ptr;
+
+namespace gi_lib{
+
+	/// \brief Represents a volume hierarchy made of two hierarchies: one for the volumes of the static nodes and one for every other volume.
+	/// Volumes of static nodes are stored inside a StaticTree, which never relocates them, while the other volumes are stored inside the dynamic hierarchy provided by the user.
+	/// Queries consult both hierarchies, dynamic first: the split is transparent to the caller.
+	/// \author Raffaele D. Facendola
+	class SplitHierarchy : public IVolumeHierarchy
+	{
+
+	public:
+
+		/// \brief Create a new empty hierarchy.
+		/// \param dynamic_hierarchy Hierarchy storing the volumes of the nodes which are not static.
+		SplitHierarchy(unique_ptr<IVolumeHierarchy> dynamic_hierarchy);
+
+		/// \brief Destructor.
+		virtual ~SplitHierarchy();
+
+		/// \brief Add a new volume to the hierarchy.
+		/// The volume is stored inside the static hierarchy if its node is static, inside the dynamic one otherwise.
+		/// \param volume The volume to add to the hierarchy.
+		virtual void AddVolume(VolumeComponent* volume) override;
+
+		virtual void RemoveVolume(VolumeComponent* volume) override;
+
+		virtual void Commit() override;
+
+		/// \brief Get the statistics of the last commit, summed over both hierarchies.
+		virtual HierarchyStats GetStats() const override;
+
+		/// \brief Get the log of the changes applied to the content of both hierarchies.
+		virtual const VolumeChangeLog& GetChangeLog() const override;
+
+		using IVolumeHierarchy::GetIntersections;
+
+		virtual void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const override;
+
+		virtual bool VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const override;
+
+		/// \brief Get the hierarchy storing the volumes of the nodes which are not static.
+		const IVolumeHierarchy& GetDynamicHierarchy() const;
+
+		/// \brief Get the hierarchy storing the volumes of the static nodes.
+		const IVolumeHierarchy& GetStaticHierarchy() const;
+
+	protected:
+
+		virtual void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const override;
+
+		virtual void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const override;
+
+		virtual void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+	private:
+
+		/// \brief Get the index of the hierarchy storing a volume.
+		unsigned int GetHierarchyIndex(const VolumeComponent& volume) const;
+
+		/// \brief Get a child hierarchy by index: the dynamic hierarchy comes first, the static one second.
+		IVolumeHierarchy& GetHierarchy(unsigned int index);
+
+		/// \brief Get a child hierarchy by index: the dynamic hierarchy comes first, the static one second.
+		const IVolumeHierarchy& GetHierarchy(unsigned int index) const;
+
+		/// \brief Copy the changes applied to the content of the child hierarchies since the last time.
+		void ForwardChanges();
+
+		/// \brief Copy the changes applied to the content of a child hierarchy since the specified revision.
+		/// \param hierarchy Child hierarchy.
+		/// \param revision Revision of the child log copied last. Receives the current revision.
+		void ForwardChanges(const IVolumeHierarchy& hierarchy, size_t& revision);
+
+		unique_ptr<IVolumeHierarchy> dynamic_hierarchy_;		///< \brief Hierarchy storing the volumes of the nodes which are not static.
+
+		unique_ptr<IVolumeHierarchy> static_hierarchy_;			///< \brief Hierarchy storing the volumes of the static nodes.
+
+		size_t volume_counts_[2];								///< \brief Number of volumes stored by each child hierarchy, indexed like the hierarchies.
+
+		size_t dynamic_revision_;								///< \brief Revision of the log of the dynamic hierarchy copied last.
+
+		size_t static_revision_;								///< \brief Revision of the log of the static hierarchy copied last.
+
+		VolumeChangeLog change_log_;							///< \brief Changes applied to the content of both hierarchies.
+
+	};
+
+}
@@ -0,0 +1,82 @@
+/// \file static_tree.h
+/// \brief Bounding volume hierarchy of volumes which never move.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "gimath.h"
+#include "volume_hierarchy.h"
+
+using ::std::unique_ptr;
+
+namespace gi_lib{
+
+	/// \brief Represents a bounding volume hierarchy whose volumes never move.
+	/// The tree is built at once by median splits and stored as a single array of nodes in depth-first order, each subtree referencing a contiguous range of volumes: queries walk the array linearly and skip missed subtrees in one jump.
+	/// Bounds are read once, when the tree is built: changes of the bounds are ignored and volumes are never relocated.
+	/// Volumes added after a commit are stored as soon as the next commit rebuilds the tree, removed volumes leave a hole until then.
+	/// Stored volumes keep their index as hierarchy slot, so a volume can belong to one slot-based hierarchy at a time: adding a volume stored inside another hierarchy throws, and so does the commit storing a volume which was stored inside another hierarchy after being added.
+	/// \author Raffaele D. Facendola
+	class StaticTree : public IVolumeHierarchy
+	{
+
+	public:
+
+		/// \brief Create a new empty tree.
+		StaticTree();
+
+		/// \brief Destructor.
+		virtual ~StaticTree();
+
+		virtual void AddVolume(VolumeComponent* volume) override;
+
+		virtual void RemoveVolume(VolumeComponent* volume) override;
+
+		/// \brief Rebuild the tree if any volume was added since the last commit.
+		virtual void Commit() override;
+
+		virtual HierarchyStats GetStats() const override;
+
+		virtual const VolumeChangeLog& GetChangeLog() const override;
+
+		using IVolumeHierarchy::GetIntersections;
+
+		virtual void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const override;
+
+		virtual bool VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const override;
+
+		/// \brief Get the number of nodes of the tree.
+		size_t GetNodeCount() const;
+
+	protected:
+
+		virtual void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const override;
+
+		virtual void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const override;
+
+		virtual void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+	private:
+
+		struct Impl;
+
+		unique_ptr<Impl> pimpl_;						///< \brief Private implementation.
+
+	};
+
+}
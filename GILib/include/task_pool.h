@@ -0,0 +1,61 @@
+/// \file task_pool.h
+/// \brief Pool of worker threads used to split the CPU work of a frame.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <memory>
+#include <functional>
+
+using ::std::unique_ptr;
+
+namespace gi_lib{
+
+	/// \brief Pool of worker threads executing data-parallel tasks.
+	/// Each call to ParallelFor splits a range of indices among the threads of the pool: every thread consumes its own share first and then steals the remaining work of the busiest threads.
+	/// The calling thread takes part in the execution, so a pool with a single thread runs every task sequentially on the caller.
+	/// Tasks are free to run in any order and on any thread: callers needing a deterministic result should write to a separate output for each index and merge them afterwards.
+	/// \author Raffaele D. Facendola
+	class TaskPool{
+
+	public:
+
+		/// \brief Task executed once for each index of a range.
+		using Task = std::function<void(size_t)>;
+
+		/// \brief Create a new pool using every hardware thread available.
+		TaskPool();
+
+		/// \brief Create a new pool.
+		/// \param thread_count Number of threads executing the tasks, including the calling thread. Zero is treated as one.
+		TaskPool(unsigned int thread_count);
+
+		/// \brief No copy constructor.
+		TaskPool(const TaskPool&) = delete;
+
+		/// \brief Destructor.
+		/// Joins every worker thread.
+		~TaskPool();
+
+		/// \brief No assignment operator.
+		TaskPool& operator=(const TaskPool&) = delete;
+
+		/// \brief Execute a task for each index in the range [0; count) and wait for completion.
+		/// Calls are not reentrant: tasks must not call ParallelFor on the same pool.
+		/// If a task throws, the other tasks are executed anyway and the first exception thrown is rethrown once every task has completed.
+		/// \param count Number of indices.
+		/// \param task Task to execute for each index.
+		void ParallelFor(size_t count, const Task& task);
+
+		/// \brief Get the number of threads executing the tasks, including the calling thread.
+		unsigned int GetThreadCount() const;
+
+	private:
+
+		struct Impl;
+
+		unique_ptr<Impl> pimpl_;				///< \brief Private implementation.
+
+	};
+
+}
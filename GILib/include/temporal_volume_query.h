@@ -0,0 +1,168 @@
+/// \file temporal_volume_query.h
+/// \brief Hierarchy queries whose results are cached across frames.
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+
+#include "gimath.h"
+#include "volume_hierarchy.h"
+
+using std::vector;
+
+namespace gi_lib{
+
+	/// \brief Outcome of the last update of a temporal query.
+	enum class TemporalQueryUpdate{
+
+		kReused,		///< \brief Neither the query volume nor the hierarchy changed: the cached results were reused as they were.
+		kPatched,		///< \brief Only the hierarchy changed: the volumes who changed were tested again and the cached results patched.
+		kTraversed,		///< \brief The query volume changed or the changes were no longer available: the hierarchy was traversed again.
+
+	};
+
+	/// \brief Stateful query whose results are cached and reused across frames.
+	/// The query is resolved against a slightly larger volume, inflated by a tolerance: as long as the new query volume stays inside the inflated one the cached results are reused.
+	/// Cached results are a conservative superset of the volumes found by the exact query: they contain every volume intersecting the inflated query volume.
+	/// Changes applied to the hierarchy in the meantime are read from its change log and patched in, testing only the volumes who changed.
+	/// Each object keeps a single cache, so each point of view (a camera, a light, a voxel grid) should own a different query.
+	/// \author Raffaele D. Facendola
+	class TemporalVolumeQuery{
+
+	public:
+
+		/// \brief Range of volumes found by the query.
+		using IntersectionRange = VolumeQueryBatch::IntersectionRange;
+
+		/// \brief Create a new temporal query.
+		/// \param tolerance Distance the query volume can move or grow by before the hierarchy is traversed again. Zero reuses the results only when the query volume does not change at all.
+		TemporalVolumeQuery(float tolerance = 0.0f);
+
+		/// \brief Get all the volumes intersecting a frustum, reusing the cached results when possible.
+		/// \param hierarchy Hierarchy to query. Changing the hierarchy discards the cached results.
+		/// \param frustum Frustum to test against.
+		/// \return Returns the range of volumes found. The range is valid until the next update.
+		IntersectionRange GetIntersections(const IVolumeHierarchy& hierarchy, const Frustum& frustum);
+
+		/// \brief Get all the volumes intersecting a sphere, reusing the cached results when possible.
+		/// \param hierarchy Hierarchy to query. Changing the hierarchy discards the cached results.
+		/// \param sphere Sphere to test against.
+		/// \return Returns the range of volumes found. The range is valid until the next update.
+		IntersectionRange GetIntersections(const IVolumeHierarchy& hierarchy, const Sphere& sphere);
+
+		/// \brief Get all the volumes intersecting an axis-aligned bounding box, reusing the cached results when possible.
+		/// \param hierarchy Hierarchy to query. Changing the hierarchy discards the cached results.
+		/// \param aabb Box to test against.
+		/// \return Returns the range of volumes found. The range is valid until the next update.
+		IntersectionRange GetIntersections(const IVolumeHierarchy& hierarchy, const AABB& aabb);
+
+		/// \brief Update the query with a new frustum, deferring any traversal to a batch.
+		/// If the hierarchy needs to be traversed again the query is added to the batch: the results become available after the batch is resolved and passed to Resolve.
+		/// \param hierarchy Hierarchy the batch will be resolved against.
+		/// \param frustum Frustum to test against.
+		/// \param batch Batch receiving the query, if needed.
+		void Update(const IVolumeHierarchy& hierarchy, const Frustum& frustum, VolumeQueryBatch& batch);
+
+		/// \brief Update the query with a new sphere, deferring any traversal to a batch.
+		/// \see Update(const IVolumeHierarchy&, const Frustum&, VolumeQueryBatch&)
+		void Update(const IVolumeHierarchy& hierarchy, const Sphere& sphere, VolumeQueryBatch& batch);
+
+		/// \brief Update the query with a new axis-aligned bounding box, deferring any traversal to a batch.
+		/// \see Update(const IVolumeHierarchy&, const Frustum&, VolumeQueryBatch&)
+		void Update(const IVolumeHierarchy& hierarchy, const AABB& aabb, VolumeQueryBatch& batch);
+
+		/// \brief Read the results of the query from a resolved batch.
+		/// Does nothing if the last update did not add the query to the batch.
+		/// \param batch Batch passed to the last update, resolved before the hierarchy changed again.
+		void Resolve(const VolumeQueryBatch& batch);
+
+		/// \brief Get the volumes found by the last update.
+		IntersectionRange GetIntersections() const;
+
+		/// \brief Get the outcome of the last update.
+		TemporalQueryUpdate GetLastUpdate() const;
+
+		/// \brief Discard the cached results. The next update traverses the hierarchy.
+		void Invalidate();
+
+	private:
+
+		/// \brief Type of the query volume.
+		enum class QueryType{
+
+			kNone,			///< \brief No query cached.
+			kFrustum,		///< \brief Frustum query.
+			kSphere,		///< \brief Sphere query.
+			kAABB,			///< \brief Axis-aligned bounding box query.
+
+		};
+
+		/// \brief Update the cached results.
+		/// \param hierarchy Hierarchy to query.
+		/// \param type Type of the query volume.
+		/// \param volume New query volume.
+		/// \param cached Inflated query volume the cached results refer to. Replaced when the hierarchy needs to be traversed again.
+		/// \return Returns true if the hierarchy needs to be traversed again using the cached query volume, returns false otherwise.
+		template <typename TVolume>
+		bool Prepare(const IVolumeHierarchy& hierarchy, QueryType type, const TVolume& volume, TVolume& cached);
+
+		/// \brief Patch the cached results with the changes applied to the hierarchy since the last update.
+		/// \param log Change log of the hierarchy.
+		/// \param cached Inflated query volume the cached results refer to.
+		template <typename TVolume>
+		void Patch(const VolumeChangeLog& log, const TVolume& cached);
+
+		/// \brief Index used when the query was not added to any batch.
+		static const size_t kNoQuery;
+
+		float tolerance_;							///< \brief Distance the query volume can move or grow by before the hierarchy is traversed again.
+
+		const IVolumeHierarchy* hierarchy_;			///< \brief Hierarchy the cached results refer to.
+
+		size_t revision_;							///< \brief Revision of the change log the cached results refer to.
+
+		QueryType type_;							///< \brief Type of the cached query volume.
+
+		Frustum frustum_;							///< \brief Cached frustum, inflated by the tolerance.
+
+		Sphere sphere_;								///< \brief Cached sphere, inflated by the tolerance.
+
+		AABB aabb_;									///< \brief Cached box, inflated by the tolerance.
+
+		vector<VolumeComponent*> intersections_;	///< \brief Cached results.
+
+		vector<VolumeChange> changes_;				///< \brief Changes being patched. Reused across updates.
+
+		size_t batch_query_;						///< \brief Index of the query inside the batch waiting to be resolved, if any.
+
+		TemporalQueryUpdate last_update_;			///< \brief Outcome of the last update.
+
+	};
+
+	///////////////////////////////// TEMPORAL VOLUME QUERY /////////////////////////////////
+
+	inline TemporalVolumeQuery::IntersectionRange TemporalVolumeQuery::GetIntersections() const{
+
+		return IntersectionRange(intersections_.cbegin(),
+								 intersections_.cend());
+
+	}
+
+	inline TemporalQueryUpdate TemporalVolumeQuery::GetLastUpdate() const{
+
+		return last_update_;
+
+	}
+
+	inline void TemporalVolumeQuery::Invalidate(){
+
+		type_ = QueryType::kNone;
+
+		hierarchy_ = nullptr;
+
+		batch_query_ = kNoQuery;
+
+	}
+
+}
@@ -64,6 +64,13 @@ namespace gi_lib{
 
 		/// \brief Interface destructor.
 		virtual ~ITexture2D(){}
+
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
 		
 		/// \brief Get the width of the texture.
 		/// \return Returns the width of the texture, in pixel.
@@ -109,6 +116,13 @@ namespace gi_lib{
 		/// \brief Abstract destructor.
 		virtual ~IGPTexture2D() = 0 {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
+
 		/// \brief Get the underlying texture.
 		/// \return Returns a pointer to the underlying texture.
 		virtual ObjectPtr<ITexture2D> GetTexture() = 0;
@@ -190,6 +204,13 @@ namespace gi_lib{
 		/// \brief Interface destructor.
 		virtual ~ITexture2DArray() {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
+
 		/// \brief Get the width of the texture.
 		/// \return Returns the width of the texture, in pixel.
 		virtual unsigned int GetWidth() const = 0;
@@ -222,6 +243,13 @@ namespace gi_lib{
 		/// \brief Interface destructor.
 		virtual ~IGPTexture2DArray() {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
+
 		/// \brief Get the underlying texture array.
 		/// \return Returns a pointer to the underlying texture array.
 		virtual ObjectPtr<ITexture2DArray> GetTextureArray() = 0;
@@ -262,6 +290,13 @@ namespace gi_lib{
 		/// \brief Interface destructor.
 		virtual ~ITexture3D() {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
+
 		/// \brief Get the width of the texture.
 		/// \return Returns the width of the texture, in pixel.
 		virtual unsigned int GetWidth() const = 0;
@@ -312,6 +347,13 @@ namespace gi_lib{
 		/// \brief Abstract destructor.
 		virtual ~IGPTexture3D() = 0 {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
+
 		/// \brief Get the underlying texture.
 		/// \return Returns a pointer to the underlying texture.
 		virtual ObjectPtr<ITexture3D> GetTexture() = 0;
@@ -371,6 +413,13 @@ namespace gi_lib{
 		/// \brief Abstract destructor.
 		virtual ~IGPClipmap3D() = 0 {}
 
+		/// \brief Get the category of the memory used by the resource.
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return MemoryCategory::kTexture;
+
+		}
+
 		/// \brief Get the pyramid part of the clipmap.
 		/// \return Returns a pointer to the pyramid part of the clipmap.
 		virtual ObjectPtr<IGPTexture3D> GetPyramid() = 0;
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include "gimath.h"
 #include "volume_hierarchy.h"
@@ -30,13 +31,43 @@ namespace gi_lib{
 
 		virtual void AddVolume(VolumeComponent* volume) override;
 
+		/// \brief Remove an existing volume from the hierarchy.
+		/// Pending changes of the other volumes are left to the next commit.
+		/// Volumes which are not inside the tree are ignored.
+		/// \param volume The volume to remove from the hierarchy.
 		virtual void RemoveVolume(VolumeComponent* volume) override;
 
-		virtual vector<VolumeComponent*> GetIntersections(const Frustum& frustum) const override;
+		virtual void Commit() override;
 
-		virtual vector<VolumeComponent*> GetIntersections(const Sphere& sphere) const override;
+		virtual HierarchyStats GetStats() const override;
 
-		virtual vector<VolumeComponent*> GetIntersections(const AABB& aabb) const override;
+		virtual const VolumeChangeLog& GetChangeLog() const override;
+
+		using IVolumeHierarchy::GetIntersections;
+
+		virtual void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const override;
+
+		virtual bool VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const override;
+
+		virtual bool VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const override;
+
+	protected:
+
+		virtual void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const override;
+
+		virtual void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const override;
+
+		virtual void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
+
+		virtual void GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const override;
 
 	private:
 
@@ -54,6 +85,9 @@ namespace gi_lib{
 		/// \param splits Number of splits left on each axis.
 		void Split(const Vector3i& splits);
 
+		/// \brief Get the root of the tree.
+		UniformTree* GetRoot();
+
 		/// \brief Check whether a particular volume is fully enclosed in this subspace.
 		/// \param volume Volume to check.
 		/// \return Returns true if the volume is fully enclosed in this subspace, returns false otherwise.
@@ -65,10 +99,22 @@ namespace gi_lib{
 
 		vector<Node*> nodes_;								///< \brief Volumes contained in this subspace.
 
+		AABBStream bounds_;									///< \brief Bounds of the volumes contained in this subspace, in the same order of the nodes.
+
 		AABB bounding_box_;									///< \brief Bounds of the octree node.
 
 		unsigned int volume_count_;							///< \brief Cumulative volume count.
 
+		vector<Node*> dirty_nodes_;							///< \brief Nodes whose volume changed since the last commit. Root only.
+
+		std::unordered_map<VolumeComponent*, Node*> volume_nodes_;	///< \brief Node of each volume inside the tree. Root only.
+
+		unsigned int pending_changes_;						///< \brief Number of volume changes recorded since the last commit. Root only.
+
+		HierarchyStats stats_;								///< \brief Statistics of the last commit. Root only.
+
+		VolumeChangeLog change_log_;						///< \brief Changes applied to the content of the tree. Root only.
+
 	};
 
 }
\ No newline at end of file
@@ -5,8 +5,11 @@
 #pragma once
 
 #include <vector>
+#include <functional>
 
 #include "component.h"
+#include "gimath.h"
+#include "range.h"
 
 using std::vector;
 
@@ -16,13 +19,232 @@ namespace gi_lib{
 
 	class VolumeComponent;
 	class VolumeHierarchyComponent;
+	class IVolumeHierarchy;
+
+	class TaskPool;
+
+	/// \brief Callback invoked for each volume found by a query.
+	/// The callback returns true to continue the query, false to stop it.
+	using VolumeVisitor = std::function<bool(VolumeComponent*)>;
+
+	/// \brief Statistics about the maintenance of a volume hierarchy.
+	struct HierarchyStats{
+
+		unsigned int changes;			///< \brief Number of volume changes recorded before the last commit.
+
+		unsigned int relocations;		///< \brief Number of volumes relocated by the last commit.
+
+		unsigned int coalesced;			///< \brief Number of volume changes coalesced by the last commit, that is changes minus relocations.
+
+	};
 	
+	/// \brief Portion of a volume hierarchy traversed by a single task of a parallel query.
+	struct HierarchyPartition{
+
+		size_t node;					///< \brief Node the partition starts from. The meaning depends on the hierarchy.
+
+		bool subtree;					///< \brief Whether the partition covers the whole subtree below the node or only the volumes stored inside the node itself.
+
+		unsigned int hierarchy;			///< \brief Index of the child hierarchy the partition belongs to, for hierarchies made of other hierarchies. Zero otherwise.
+
+	};
+
+	/// \brief Change applied to the content of a volume hierarchy.
+	struct VolumeChange{
+
+		VolumeComponent* volume;		///< \brief Volume who changed. Removed volumes may have been destroyed since.
+
+		bool removed;					///< \brief Whether the volume was removed from the hierarchy. If false, the volume was either added or its bounds were committed.
+
+	};
+
+	/// \brief Sequence of the most recent changes applied to the content of a volume hierarchy.
+	/// Each recorded change increases the revision of the log by one. Only the latest changes are retained, so that the log never grows unbounded.
+	/// Observers remembering the revision they last saw can patch their state with the changes applied since, or start over when those are no longer available.
+	/// \author Raffaele D. Facendola
+	class VolumeChangeLog{
+
+	public:
+
+		/// \brief Maximum number of changes retained by the log.
+		static const size_t kCapacity = 4096;
+
+		/// \brief Create an empty log.
+		VolumeChangeLog();
+
+		/// \brief Record a volume added to the hierarchy or whose bounds were committed.
+		void RecordChange(VolumeComponent* volume);
+
+		/// \brief Record a volume removed from the hierarchy.
+		void RecordRemoval(VolumeComponent* volume);
+
+		/// \brief Discard every retained change, so that every observer has to start over.
+		void Discard();
+
+		/// \brief Get the current revision, that is the total number of changes recorded so far.
+		size_t GetRevision() const;
+
+		/// \brief Get the oldest revision whose changes are still retained.
+		size_t GetOldestRevision() const;
+
+		/// \brief Get a recorded change.
+		/// \param revision Revision of the change. Must be at least GetOldestRevision() and less than GetRevision().
+		const VolumeChange& GetChange(size_t revision) const;
+
+	private:
+
+		/// \brief Append a change to the log, discarding the retained changes when full.
+		void Record(VolumeComponent* volume, bool removed);
+
+		vector<VolumeChange> changes_;			///< \brief Retained changes, oldest first.
+
+		size_t oldest_revision_;				///< \brief Revision of the first retained change.
+
+	};
+
+	/// \brief Set of query volumes resolved by a single traversal of a volume hierarchy.
+	/// Each node of the hierarchy is tested against the queries still active in its subtree only: queries are dropped as soon as they miss a node and are not tested again once they fully contain it.
+	/// The volumes found by each query are stored contiguously, in traversal order.
+	/// Clearing the batch retains its buffers: a batch reused every frame stops allocating once warmed up.
+	/// \author Raffaele D. Facendola
+	class VolumeQueryBatch{
+
+	public:
+
+		/// \brief Mask of the queries of a group. The bit i refers to the i-th query of the group.
+		using QueryMask = unsigned int;
+
+		/// \brief Range of volumes found by a query.
+		using IntersectionRange = Range<vector<VolumeComponent*>::const_iterator>;
+
+		/// \brief Maximum number of queries resolved by a single traversal. Larger batches are split in groups, each requiring its own traversal.
+		static const size_t kGroupSize = 32;
+
+		/// \brief Add a frustum query.
+		/// \return Returns the index of the new query.
+		size_t AddQuery(const Frustum& frustum);
+
+		/// \brief Add a sphere query.
+		/// \return Returns the index of the new query.
+		size_t AddQuery(const Sphere& sphere);
+
+		/// \brief Add an axis-aligned bounding box query.
+		/// \return Returns the index of the new query.
+		size_t AddQuery(const AABB& aabb);
+
+		/// \brief Get the number of queries inside the batch.
+		size_t GetQueryCount() const;
+
+		/// \brief Remove every query and every result from the batch.
+		void Clear();
+
+		/// \brief Get the volumes found by a query during the last traversal.
+		/// \param query Index of the query. The query must have been added before the last traversal.
+		IntersectionRange GetIntersections(size_t query) const;
+
+		/// \brief Get the number of volumes found by a query during the last traversal.
+		/// \param query Index of the query. The query must have been added before the last traversal.
+		size_t GetIntersectionCount(size_t query) const;
+
+		/// \brief Get the number of groups the batch is split in.
+		size_t GetGroupCount() const;
+
+		/// \brief Get the mask of the queries inside a group.
+		/// \param group Index of the group.
+		QueryMask GetGroupMask(size_t group) const;
+
+		/// \brief Intersection test between a bounding box and the active queries of a group.
+		/// Queries that fully contain the box are not tested.
+		/// \param group Index of the group.
+		/// \param bounds Box to test.
+		/// \param active Queries to test.
+		/// \param contained Queries fully containing the box. Tested queries that fully contain the box are added to the mask.
+		/// \return Returns the mask of the active queries intersecting the box.
+		QueryMask Intersect(size_t group, const AABB& bounds, QueryMask active, QueryMask& contained) const;
+
+		/// \brief Intersection test between a volume and the active queries of a group.
+		/// Queries that fully contain the volume are not tested.
+		/// \param group Index of the group.
+		/// \param volume Volume to test.
+		/// \param active Queries to test.
+		/// \param contained Queries fully containing the volume.
+		/// \return Returns the mask of the active queries intersecting the volume.
+		QueryMask TestAgainst(size_t group, const VolumeComponent& volume, QueryMask active, QueryMask contained) const;
+
+		/// \brief Record a volume found by some queries of a group.
+		/// \param group Index of the group.
+		/// \param queries Queries who found the volume.
+		/// \param volume Volume found.
+		void AddIntersection(size_t group, QueryMask queries, VolumeComponent* volume);
+
+	private:
+
+		friend class IVolumeHierarchy;
+
+		/// \brief Type of a query volume.
+		enum class QueryType{
+
+			kFrustum,		///< \brief Frustum query.
+			kSphere,		///< \brief Sphere query.
+			kAABB,			///< \brief Axis-aligned bounding box query.
+
+		};
+
+		/// \brief Query volume.
+		struct Query{
+
+			QueryType type;				///< \brief Type of the query volume.
+
+			size_t index;				///< \brief Index of the query volume inside the array of its type.
+
+		};
+
+		/// \brief Volume found by a query, before results are grouped.
+		struct Match{
+
+			size_t query;				///< \brief Index of the query.
+
+			VolumeComponent* volume;	///< \brief Volume found.
+
+		};
+
+		/// \brief Remove the results of the previous traversal.
+		void ClearIntersections();
+
+		/// \brief Group the results of a traversal by query.
+		void SortIntersections();
+
+		/// \brief Get the classification of a box with respect to a query.
+		IntersectionType Intersect(const Query& query, const AABB& bounds) const;
+
+		/// \brief Get the classification of a volume with respect to a query.
+		IntersectionType TestAgainst(const Query& query, const VolumeComponent& volume) const;
+
+		vector<Query> queries_;					///< \brief Queries, in insertion order.
+
+		vector<Frustum> frustums_;				///< \brief Frustum query volumes.
+
+		vector<Sphere> spheres_;				///< \brief Sphere query volumes.
+
+		vector<AABB> aabbs_;					///< \brief Box query volumes.
+
+		vector<Match> matches_;					///< \brief Volumes found by the queries, in traversal order.
+
+		vector<VolumeComponent*> intersections_;	///< \brief Volumes found by the queries, grouped by query.
+
+		vector<size_t> offsets_;				///< \brief Offset of the first volume found by each query inside the grouped results. Has one more element than queries.
+
+	};
+
 	/// \brief Base interface for volume hierarchy.
 	/// Volumes added to the hierarchy must be manually removed upon destruction of the component.
-	/// The hierarchy will relocate automatically the node whenever its bounds change.
+	/// Whenever the bounds of a volume change the hierarchy records the volume inside a dirty list: every relocation is applied at once by Commit.
+	/// Queries performed before committing see the volumes as they were when they were last committed.
 	/// \author Raffaele D. Facendola
 	class IVolumeHierarchy{
 
+		friend class SplitHierarchy;
+
 	public:
 
 		/// \brief Virtual destructor.
@@ -36,21 +258,273 @@ namespace gi_lib{
 		/// \param volume The volume to remove from the hierarchy.
 		virtual void RemoveVolume(VolumeComponent* volume) = 0;
 
+		/// \brief Relocate every volume whose bounds changed since the last commit.
+		/// A volume changing many times between two commits is relocated only once.
+		virtual void Commit() = 0;
+
+		/// \brief Get the statistics of the last commit.
+		/// \return Returns the statistics of the last commit.
+		virtual HierarchyStats GetStats() const = 0;
+
+		/// \brief Get the log of the changes applied to the content of the hierarchy.
+		/// Volumes are logged when added, removed or committed after their bounds changed.
+		virtual const VolumeChangeLog& GetChangeLog() const = 0;
+
 		/// \brief Get all the volume component who intersects with the given frustum.
 		/// \param frustum Frustum to test against.
 		/// \return Returns the list of all the volumes who intersect the specified frustum.
-		virtual vector<VolumeComponent*> GetIntersections(const Frustum& frustum) const = 0;
+		vector<VolumeComponent*> GetIntersections(const Frustum& frustum) const;
 
 		/// \brief Get all the volume component who intersects with the given sphere.
 		/// \param sphere Sphere to test against.
 		/// \return Returns the list of all the volumes who intersect the specified sphere.
-		virtual vector<VolumeComponent*> GetIntersections(const Sphere& sphere) const = 0;
+		vector<VolumeComponent*> GetIntersections(const Sphere& sphere) const;
 
 		/// \brief Get all the volume component who intersects with the given axis-aligned bounding box.
 		/// \param aabb Axis-aligned bounding box to test against.
 		/// \return Returns the list of all the volumes who intersect the specified box.
-		virtual vector<VolumeComponent*> GetIntersections(const AABB& aabb) const = 0;
+		vector<VolumeComponent*> GetIntersections(const AABB& aabb) const;
+
+		/// \brief Get all the volume component who intersects with the given frustum.
+		/// The query itself never allocates memory: reuse the same output vector across frames to avoid any allocation.
+		/// \param frustum Frustum to test against.
+		/// \param intersections Output vector. The volumes who intersect the specified frustum are appended at its end.
+		virtual void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const = 0;
+
+		/// \brief Get all the volume component who intersects with the given sphere.
+		/// The query itself never allocates memory: reuse the same output vector across frames to avoid any allocation.
+		/// \param sphere Sphere to test against.
+		/// \param intersections Output vector. The volumes who intersect the specified sphere are appended at its end.
+		virtual void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const = 0;
+
+		/// \brief Get all the volume component who intersects with the given axis-aligned bounding box.
+		/// The query itself never allocates memory: reuse the same output vector across frames to avoid any allocation.
+		/// \param aabb Axis-aligned bounding box to test against.
+		/// \param intersections Output vector. The volumes who intersect the specified box are appended at its end.
+		virtual void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const = 0;
+
+		/// \brief Visit all the volume component who intersects with the given frustum.
+		/// \param frustum Frustum to test against.
+		/// \param visitor Callback invoked for each volume who intersects the specified frustum. Return false to stop the query.
+		/// \return Returns true if every volume was visited, returns false if the visitor stopped the query.
+		virtual bool VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const = 0;
+
+		/// \brief Visit all the volume component who intersects with the given sphere.
+		/// \param sphere Sphere to test against.
+		/// \param visitor Callback invoked for each volume who intersects the specified sphere. Return false to stop the query.
+		/// \return Returns true if every volume was visited, returns false if the visitor stopped the query.
+		virtual bool VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const = 0;
+
+		/// \brief Visit all the volume component who intersects with the given axis-aligned bounding box.
+		/// \param aabb Axis-aligned bounding box to test against.
+		/// \param visitor Callback invoked for each volume who intersects the specified box. Return false to stop the query.
+		/// \return Returns true if every volume was visited, returns false if the visitor stopped the query.
+		virtual bool VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const = 0;
+
+		/// \brief Get all the volume component who intersects with the given frustum, splitting the traversal among the threads of a pool.
+		/// The top levels of the hierarchy are split in partitions traversed by different tasks, each one writing to its own buffer.
+		/// The buffers are concatenated in hierarchy order: the results are the same of the sequential query, in the same order, regardless of the number of threads.
+		/// \param frustum Frustum to test against.
+		/// \param intersections Output vector. The volumes who intersect the specified frustum are appended at its end.
+		/// \param pool Pool executing the traversal.
+		void GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections, TaskPool& pool) const;
+
+		/// \brief Get all the volume component who intersects with the given sphere, splitting the traversal among the threads of a pool.
+		/// \see GetIntersections(const Frustum&, vector<VolumeComponent*>&, TaskPool&)
+		void GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections, TaskPool& pool) const;
+
+		/// \brief Get all the volume component who intersects with the given axis-aligned bounding box, splitting the traversal among the threads of a pool.
+		/// \see GetIntersections(const Frustum&, vector<VolumeComponent*>&, TaskPool&)
+		void GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections, TaskPool& pool) const;
+
+		/// \brief Resolve every query of a batch.
+		/// Every group of queries requires a single traversal of the hierarchy, regardless of the number of queries inside it.
+		/// The results of any previous traversal are discarded.
+		/// \param batch Queries to resolve. Receives the volumes found by each query.
+		void GetIntersections(VolumeQueryBatch& batch) const;
+
+	protected:
+
+		/// \brief Resolve a group of queries of a batch with a single traversal of the hierarchy.
+		/// \param batch Queries to resolve. Volumes found are recorded via VolumeQueryBatch::AddIntersection.
+		/// \param group Index of the group to resolve.
+		virtual void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const = 0;
+
+		/// \brief Split the top levels of the hierarchy in disjoint partitions which can be traversed independently.
+		/// Concatenating the volumes found inside each partition, in order, must yield the results of the sequential query, in the same order.
+		/// \param count Number of partitions desired. Hierarchies too shallow or too sparse may return fewer partitions, dense ones may return more.
+		/// \param partitions Output vector. Receives the partitions, in hierarchy order.
+		virtual void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const = 0;
+
+		/// \brief Get the volume components inside a partition who intersect with the given frustum.
+		/// \param frustum Frustum to test against.
+		/// \param partition Partition to traverse, as returned by GetPartitions.
+		/// \param intersections Output vector. The volumes found are appended at its end.
+		virtual void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const = 0;
+
+		/// \brief Get the volume components inside a partition who intersect with the given sphere.
+		/// \see GetPartitionIntersections(const Frustum&, const HierarchyPartition&, vector<VolumeComponent*>&)
+		virtual void GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const = 0;
+
+		/// \brief Get the volume components inside a partition who intersect with the given axis-aligned bounding box.
+		/// \see GetPartitionIntersections(const Frustum&, const HierarchyPartition&, vector<VolumeComponent*>&)
+		virtual void GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const = 0;
+
+	private:
+
+		/// \brief Traverse each partition of the hierarchy on a different task and merge the results in hierarchy order.
+		template <typename TVolume>
+		void GetParallelIntersections(const TVolume& volume, vector<VolumeComponent*>& intersections, TaskPool& pool) const;
 
 	};
 
+	///////////////////////////////// VOLUME CHANGE LOG /////////////////////////////////
+
+	inline VolumeChangeLog::VolumeChangeLog() :
+	oldest_revision_(0){}
+
+	inline void VolumeChangeLog::RecordChange(VolumeComponent* volume){
+
+		Record(volume, false);
+
+	}
+
+	inline void VolumeChangeLog::RecordRemoval(VolumeComponent* volume){
+
+		Record(volume, true);
+
+	}
+
+	inline void VolumeChangeLog::Discard(){
+
+		oldest_revision_ += changes_.size() + 1;		// Even observers who saw every change are behind now
+
+		changes_.clear();
+
+	}
+
+	inline size_t VolumeChangeLog::GetRevision() const{
+
+		return oldest_revision_ + changes_.size();
+
+	}
+
+	inline size_t VolumeChangeLog::GetOldestRevision() const{
+
+		return oldest_revision_;
+
+	}
+
+	inline const VolumeChange& VolumeChangeLog::GetChange(size_t revision) const{
+
+		return changes_[revision - oldest_revision_];
+
+	}
+
+	inline void VolumeChangeLog::Record(VolumeComponent* volume, bool removed){
+
+		if (changes_.size() >= kCapacity){
+
+			oldest_revision_ += changes_.size();
+
+			changes_.clear();
+
+		}
+
+		changes_.push_back(VolumeChange{ volume, removed });
+
+	}
+
+	///////////////////////////////// VOLUME QUERY BATCH /////////////////////////////////
+
+	inline size_t VolumeQueryBatch::GetQueryCount() const{
+
+		return queries_.size();
+
+	}
+
+	inline size_t VolumeQueryBatch::GetGroupCount() const{
+
+		return (queries_.size() + kGroupSize - 1) / kGroupSize;
+
+	}
+
+	inline VolumeQueryBatch::QueryMask VolumeQueryBatch::GetGroupMask(size_t group) const{
+
+		auto count = std::min(queries_.size() - group * kGroupSize, kGroupSize);
+
+		return (count == kGroupSize) ? ~QueryMask(0) : ((QueryMask(1) << count) - 1);
+
+	}
+
+	inline VolumeQueryBatch::IntersectionRange VolumeQueryBatch::GetIntersections(size_t query) const{
+
+		return IntersectionRange(intersections_.cbegin() + offsets_[query],
+								 intersections_.cbegin() + offsets_[query + 1]);
+
+	}
+
+	inline size_t VolumeQueryBatch::GetIntersectionCount(size_t query) const{
+
+		return offsets_[query + 1] - offsets_[query];
+
+	}
+
+	inline void VolumeQueryBatch::AddIntersection(size_t group, QueryMask queries, VolumeComponent* volume){
+
+		for (; queries != 0; queries &= queries - 1){
+
+			matches_.push_back(Match{ group * kGroupSize + Math::CountTrailingZeros(queries), volume });
+
+		}
+
+	}
+
+	///////////////////////////////// IVOLUME HIERARCHY /////////////////////////////////
+
+	inline void IVolumeHierarchy::GetIntersections(VolumeQueryBatch& batch) const{
+
+		batch.ClearIntersections();
+
+		for (size_t group = 0; group < batch.GetGroupCount(); ++group){
+
+			GetGroupIntersections(batch, group);
+
+		}
+
+		batch.SortIntersections();
+
+	}
+
+
+	inline vector<VolumeComponent*> IVolumeHierarchy::GetIntersections(const Frustum& frustum) const{
+
+		vector<VolumeComponent*> intersections;
+
+		GetIntersections(frustum, intersections);
+
+		return intersections;
+
+	}
+
+	inline vector<VolumeComponent*> IVolumeHierarchy::GetIntersections(const Sphere& sphere) const{
+
+		vector<VolumeComponent*> intersections;
+
+		GetIntersections(sphere, intersections);
+
+		return intersections;
+
+	}
+
+	inline vector<VolumeComponent*> IVolumeHierarchy::GetIntersections(const AABB& aabb) const{
+
+		vector<VolumeComponent*> intersections;
+
+		GetIntersections(aabb, intersections);
+
+		return intersections;
+
+	}
+
 }
\ No newline at end of file
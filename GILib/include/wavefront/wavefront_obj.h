@@ -19,6 +19,7 @@ using ::std::unique_ptr;
 namespace gi_lib {
 
 	class Resources;
+	class DerivedDataCache;
 	class TransformComponent;
 	class MeshComponent;
 
@@ -89,18 +90,40 @@ namespace gi_lib {
 
 		public:
 			
+			/// \brief Name of the importer, used to key its outputs inside a derived data cache.
+			static const string kImporterName;
+
+			/// \brief Version of the importer. Bump it whenever the snapshots produced by the importer change.
+			static const unsigned int kImporterVersion;
+
 			/// \brief Create a new wavefront obj importer.
 			/// \param resources Object used to import various resources.
-			ObjImporter(Resources& resources);
+			/// \param cache Cache storing the snapshots of the imported scenes. Optional.
+			ObjImporter(Resources& resources, DerivedDataCache* cache = nullptr);
 
 			/// \brief Import an OBJ scene.
 			/// The scene will load various scene nodes and the appropriate components.
 			/// All the nodes will keep their structure but will be attached to the provided root.
+			/// The imported nodes are static if the root is static.
+			/// If the importer has a cache, the scene is instantiated from the snapshot stored inside the cache unless the OBJ file or any of its MTL files changed since the snapshot was stored.
+			/// Scenes referencing a MTL file which cannot be read are never cached.
 			/// \param file_name Name of the OBJ file to import.
 			/// \param root The node where all the imported nodes will be attached hierarchically.
 			/// \param resources Used to load resources during the import process.
 			bool ImportScene(const wstring& file_name, TransformComponent& root, IMtlMaterialImporter& material_importer) const;
 
+			/// \brief Import an OBJ scene through a snapshot file.
+			/// If the snapshot file can be loaded, the scene is instantiated from it and the OBJ file is not parsed at all.
+			/// Otherwise the OBJ file is imported and its snapshot is written to the snapshot file, to be loaded by the next import.
+			/// The snapshot is not checked against the OBJ file and its MTL libraries: delete the snapshot file whenever they change.
+			/// The cache of the importer is not used: prefer it whenever the OBJ file may change, since the cache tracks every input.
+			/// \param file_name Name of the OBJ file to import.
+			/// \param snapshot_file_name Name of the snapshot file of the OBJ file.
+			/// \param root The node where all the imported nodes will be attached hierarchically.
+			/// \param material_importer Importer receiving the materials of each mesh.
+			/// \return Returns true if the scene was imported, returns false otherwise.
+			bool ImportScene(const wstring& file_name, const wstring& snapshot_file_name, TransformComponent& root, IMtlMaterialImporter& material_importer) const;
+
 			/// \brief Import a mesh from an OBJ file.
 			/// \param file_name Name of the file to parse.
 			/// \param mesh_name Name of the mesh to import.
@@ -115,6 +138,8 @@ namespace gi_lib {
 
 			Resources& resources_;			///< \brief Used to import the various resources.
 
+			DerivedDataCache* cache_;		///< \brief Cache storing the snapshots of the imported scenes. May be null.
+
 		};
 
 	}
@@ -59,6 +59,16 @@ namespace gi_lib{
 
 			virtual wstring Read(const wstring& file_name) const override;
 
+			virtual bool MakeDirectory(const wstring& directory) const override;
+
+			virtual void EnumerateFiles(const wstring& directory, const wstring& extension, vector<FileEntry>& files) const override;
+
+			virtual bool Rename(const wstring& source, const wstring& destination) const override;
+
+			virtual bool Remove(const wstring& file_name) const override;
+
+			virtual bool Touch(const wstring& file_name) const override;
+
 		private:
 
 			FileSystem();
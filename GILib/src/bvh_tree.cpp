@@ -0,0 +1,1669 @@
+#include "bvh_tree.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <future>
+#include <chrono>
+#include <limits>
+#include <cmath>
+
+#include "gilib.h"
+#include "gimath.h"
+#include "observable.h"
+#include "scene.h"
+#include "exceptions.h"
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Index used to mark a missing node.
+	const unsigned int kNone = std::numeric_limits<unsigned int>::max();
+
+	/// \brief Number of bins used to evaluate the surface area heuristic along the split axis.
+	const unsigned int kSAHBins = 12;
+
+	/// \brief Node of the hierarchy.
+	/// Internal nodes have exactly two children, leaves reference exactly one volume.
+	struct BVHNode{
+
+		AABB bounds;							///< \brief Bounds enclosing every volume below this node.
+
+		unsigned int parent;					///< \brief Index of the parent node. kNone for the root.
+
+		unsigned int children[2];				///< \brief Index of the children nodes. Meaningless for leaves.
+
+		unsigned int volume;					///< \brief Index of the volume referenced by a leaf. kNone for internal nodes.
+
+		/// \brief Check whether the node is a leaf.
+		bool IsLeaf() const{
+
+			return volume != kNone;
+
+		}
+
+	};
+
+	/// \brief Stack used to traverse the tree.
+	/// The first entries are stored inline, so that the traversal of a reasonably balanced tree never allocates memory.
+	template <typename TEntry>
+	class TraversalStack{
+
+	public:
+
+		TraversalStack() :
+		size_(0){}
+
+		void Push(const TEntry& entry){
+
+			if (size_ < kInlineEntries){
+
+				inline_[size_] = entry;
+
+			}
+			else{
+
+				overflow_.push_back(entry);		// Degenerate tree
+
+			}
+
+			++size_;
+
+		}
+
+		TEntry Pop(){
+
+			--size_;
+
+			if (size_ < kInlineEntries){
+
+				return inline_[size_];
+
+			}
+
+			auto entry = overflow_.back();
+
+			overflow_.pop_back();
+
+			return entry;
+
+		}
+
+		bool IsEmpty() const{
+
+			return size_ == 0;
+
+		}
+
+	private:
+
+		static const size_t kInlineEntries = 128;
+
+		TEntry inline_[kInlineEntries];			///< \brief Inline entries.
+
+		vector<TEntry> overflow_;				///< \brief Entries exceeding the inline storage.
+
+		size_t size_;							///< \brief Number of entries in the stack.
+
+	};
+
+	/// \brief Entry of the stack used to resolve a group of queries.
+	struct BatchEntry{
+
+		unsigned int node;							///< \brief Index of the node to visit.
+
+		VolumeQueryBatch::QueryMask active;			///< \brief Queries intersecting the parent node.
+
+		VolumeQueryBatch::QueryMask contained;		///< \brief Queries fully containing the parent node.
+
+	};
+
+	/// \brief Result of a tree build.
+	struct BVHBuild{
+
+		vector<BVHNode> nodes;					///< \brief Nodes of the tree. Parents always precede their children.
+
+		vector<VolumeComponent*> volumes;		///< \brief Volumes referenced by the leaves, as they were when the build started.
+
+		unsigned int root;						///< \brief Index of the root node.
+
+	};
+
+	/// \brief Get the smallest box enclosing two boxes.
+	AABB Merge(const AABB& first, const AABB& second){
+
+		Vector3f min_corner = (first.center - first.half_extents).cwiseMin(second.center - second.half_extents);
+		Vector3f max_corner = (first.center + first.half_extents).cwiseMax(second.center + second.half_extents);
+
+		return AABB{ 0.5f * (max_corner + min_corner),
+					 0.5f * (max_corner - min_corner) };
+
+	}
+
+	/// \brief Get the surface area of a box.
+	float GetSurfaceArea(const AABB& aabb){
+
+		auto& extents = aabb.half_extents;
+
+		return 8.0f * (extents(0) * extents(1) +
+					   extents(1) * extents(2) +
+					   extents(2) * extents(0));
+
+	}
+
+	/// \brief Check whether a box has finite extents.
+	bool IsBounded(const AABB& aabb){
+
+		return std::isfinite(aabb.half_extents(0)) &&
+			   std::isfinite(aabb.half_extents(1)) &&
+			   std::isfinite(aabb.half_extents(2));
+
+	}
+
+	/// \brief Build a subtree top-down using a binned surface area heuristic.
+	/// \param bounds Bounds of each volume.
+	/// \param indices Indices of the volumes to partition. Reordered in place.
+	/// \param begin First index of the range to build.
+	/// \param end One past the last index of the range to build.
+	/// \param parent Index of the parent node.
+	/// \param nodes Destination node array.
+	/// \return Returns the index of the root of the subtree.
+	unsigned int BuildSubtree(const vector<AABB>& bounds, vector<unsigned int>& indices, unsigned int begin, unsigned int end, unsigned int parent, vector<BVHNode>& nodes){
+
+		auto node_index = static_cast<unsigned int>(nodes.size());
+
+		nodes.push_back(BVHNode{ bounds[indices[begin]],
+								 parent,
+								 { kNone, kNone },
+								 kNone });
+
+		if (end - begin == 1){
+
+			nodes[node_index].volume = indices[begin];		// Leaf
+
+			return node_index;
+
+		}
+
+		// Node bounds and centroid bounds
+
+		AABB node_bounds = bounds[indices[begin]];
+
+		Vector3f centroid_min = node_bounds.center;
+		Vector3f centroid_max = node_bounds.center;
+
+		for (auto index = begin + 1; index < end; ++index){
+
+			auto& volume_bounds = bounds[indices[index]];
+
+			node_bounds = Merge(node_bounds, volume_bounds);
+
+			centroid_min = centroid_min.cwiseMin(volume_bounds.center);
+			centroid_max = centroid_max.cwiseMax(volume_bounds.center);
+
+		}
+
+		nodes[node_index].bounds = node_bounds;
+
+		// Split along the axis with the largest centroid spread
+
+		int axis;
+
+		auto extent = (centroid_max - centroid_min).maxCoeff(&axis);
+
+		auto middle = begin + (end - begin) / 2;
+
+		if (extent > 0.0f){
+
+			// Binning
+
+			auto bin_scale = kSAHBins / extent;
+
+			unsigned int bin_count[kSAHBins] = {};
+
+			AABB bin_bounds[kSAHBins];
+
+			auto get_bin = [&](unsigned int index){
+
+				auto bin = static_cast<unsigned int>((bounds[index].center(axis) - centroid_min(axis)) * bin_scale);
+
+				return std::min(bin, kSAHBins - 1);
+
+			};
+
+			for (auto index = begin; index < end; ++index){
+
+				auto bin = get_bin(indices[index]);
+
+				bin_bounds[bin] = bin_count[bin] > 0 ?
+								  Merge(bin_bounds[bin], bounds[indices[index]]) :
+								  bounds[indices[index]];
+
+				++bin_count[bin];
+
+			}
+
+			// Sweep from the right to accumulate the cost of each right partition
+
+			float right_cost[kSAHBins];
+
+			AABB right_bounds;
+
+			unsigned int right_count = 0;
+
+			for (auto bin = kSAHBins - 1; bin > 0; --bin){
+
+				if (bin_count[bin] > 0){
+
+					right_bounds = right_count > 0 ?
+								   Merge(right_bounds, bin_bounds[bin]) :
+								   bin_bounds[bin];
+
+					right_count += bin_count[bin];
+
+				}
+
+				right_cost[bin] = right_count > 0 ?
+								  GetSurfaceArea(right_bounds) * right_count :
+								  0.0f;
+
+			}
+
+			// Sweep from the left and pick the cheapest split
+
+			AABB left_bounds;
+
+			unsigned int left_count = 0;
+
+			auto best_cost = std::numeric_limits<float>::infinity();
+
+			unsigned int best_split = 0;
+
+			for (unsigned int bin = 0; bin < kSAHBins - 1; ++bin){
+
+				if (bin_count[bin] > 0){
+
+					left_bounds = left_count > 0 ?
+								  Merge(left_bounds, bin_bounds[bin]) :
+								  bin_bounds[bin];
+
+					left_count += bin_count[bin];
+
+				}
+
+				if (left_count == 0 ||
+					left_count == end - begin){
+
+					continue;		// One of the partitions would be empty
+
+				}
+
+				auto cost = GetSurfaceArea(left_bounds) * left_count + right_cost[bin + 1];
+
+				if (cost < best_cost){
+
+					best_cost = cost;
+					best_split = bin + 1;
+
+				}
+
+			}
+
+			if (best_split > 0){
+
+				auto split = std::partition(indices.begin() + begin,
+											indices.begin() + end,
+											[&](unsigned int index){
+
+												return get_bin(index) < best_split;
+
+											});
+
+				middle = static_cast<unsigned int>(split - indices.begin());
+
+			}
+
+		}
+
+		if (middle == begin ||
+			middle == end){
+
+			middle = begin + (end - begin) / 2;		// Degenerate distribution: split by count
+
+		}
+
+		// Recursion. The node array may be reallocated, no reference is kept across the calls.
+
+		auto left = BuildSubtree(bounds, indices, begin, middle, node_index, nodes);
+		auto right = BuildSubtree(bounds, indices, middle, end, node_index, nodes);
+
+		nodes[node_index].children[0] = left;
+		nodes[node_index].children[1] = right;
+
+		return node_index;
+
+	}
+
+	/// \brief Build a new tree from scratch.
+	/// \param volumes Volumes to enclose.
+	/// \param bounds Bounds of each volume.
+	BVHBuild Build(const vector<VolumeComponent*>& volumes, const vector<AABB>& bounds){
+
+		BVHBuild build;
+
+		build.volumes = volumes;
+		build.root = kNone;
+
+		if (!volumes.empty()){
+
+			vector<unsigned int> indices(volumes.size());
+
+			for (unsigned int index = 0; index < indices.size(); ++index){
+
+				indices[index] = index;
+
+			}
+
+			build.nodes.reserve(2 * volumes.size() - 1);
+
+			build.root = BuildSubtree(bounds,
+									  indices,
+									  0,
+									  static_cast<unsigned int>(indices.size()),
+									  kNone,
+									  build.nodes);
+
+		}
+
+		return build;
+
+	}
+
+}
+
+////////////////////////////////// BVH TREE :: IMPL /////////////////////////////////////
+
+struct BVHTree::Impl{
+
+	Impl(float rebuild_threshold);
+
+	~Impl();
+
+	void AddVolume(VolumeComponent* volume);
+
+	void RemoveVolume(VolumeComponent* volume);
+
+	void Commit();
+
+	HierarchyStats GetStats() const;
+
+	const VolumeChangeLog& GetChangeLog() const;
+
+	template <typename TVolume, typename TVisitor>
+	bool VisitIntersections(const TVolume& volume, TVisitor&& visitor) const;
+
+	template <typename TVisitor>
+	bool VisitIntersections(const Frustum& frustum, TVisitor&& visitor) const;
+
+	void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const;
+
+	void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const;
+
+	template <typename TVolume>
+	void GetPartitionIntersections(const TVolume& volume, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const;
+
+	void Rebuild();
+
+	float GetCost() const;
+
+private:
+
+	/// \brief Called whenever the bounds of a volume change.
+	void OnVolumeChanged(VolumeComponent* volume);
+
+	/// \brief Visit the unbounded volumes who intersect a volume.
+	template <typename TVolume, typename TVisitor>
+	bool VisitUnbounded(const TVolume& volume, TVisitor&& visitor) const;
+
+	/// \brief Visit the volumes below a node who intersect a volume.
+	template <typename TVolume, typename TVisitor>
+	bool VisitSubtree(const TVolume& volume, unsigned int root, TVisitor&& visitor) const;
+
+	/// \brief Visit the volumes below a node who intersect a frustum.
+	template <typename TVisitor>
+	bool VisitSubtree(const Frustum& frustum, unsigned int root, TVisitor&& visitor) const;
+
+	/// \brief Visit every volume below a node, without testing them.
+	template <typename TVisitor>
+	bool VisitVolumes(unsigned int node, TVisitor&& visitor) const;
+
+	/// \brief Update the tree after the bounds of a volume changed.
+	void Relocate(VolumeComponent* volume);
+
+	/// \brief Subscribe to the bounds changes of a volume.
+	unique_ptr<Listener> Subscribe(VolumeComponent* volume);
+
+	/// \brief Add a bounded volume to the tree.
+	/// \param listener Bounds listener of the volume.
+	void AddBounded(VolumeComponent* volume, const AABB& bounds, unique_ptr<Listener> listener);
+
+	/// \brief Add an unbounded volume.
+	/// \param listener Bounds listener of the volume.
+	void AddUnbounded(VolumeComponent* volume, unique_ptr<Listener> listener);
+
+	/// \brief Remove a bounded volume from the tree.
+	/// \return Returns the bounds listener of the removed volume.
+	unique_ptr<Listener> RemoveBounded(unsigned int volume_index);
+
+	/// \brief Remove an unbounded volume.
+	/// \return Returns the bounds listener of the removed volume.
+	unique_ptr<Listener> RemoveUnbounded(vector<VolumeComponent*>::iterator unbounded_it);
+
+	/// \brief Create a new leaf node.
+	unsigned int CreateLeaf(unsigned int volume_index);
+
+	/// \brief Insert a leaf inside the tree, choosing the sibling which minimizes the surface area increase.
+	void InsertLeaf(unsigned int leaf);
+
+	/// \brief Detach a leaf from the tree and destroy it.
+	void RemoveLeaf(unsigned int leaf);
+
+	/// \brief Recompute the bounds of a node and all its ancestors.
+	void Refit(unsigned int node);
+
+	/// \brief Set the bounds of a node, keeping the total surface of the internal nodes up-to-date.
+	void SetBounds(unsigned int node, const AABB& bounds);
+
+	/// \brief Allocate a new node, recycling a free one if possible.
+	unsigned int AllocateNode();
+
+	/// \brief Release a node.
+	void FreeNode(unsigned int node);
+
+	/// \brief Adopt completed background builds and start a new one if the quality of the tree dropped too much.
+	void PollRebuild();
+
+	/// \brief Replace the current tree with a new one.
+	/// Volumes that changed, were added or were removed while the tree was being built are patched incrementally.
+	void Adopt(BVHBuild& build);
+
+	vector<VolumeComponent*> volumes_;						///< \brief Bounded volumes.
+
+	vector<AABB> bounds_;									///< \brief Bounds of each bounded volume.
+
+	vector<unsigned int> leaves_;							///< \brief Leaf associated to each bounded volume.
+
+	vector<unique_ptr<Listener>> listeners_;				///< \brief Bounds listener of each bounded volume.
+
+	vector<bool> dirty_;									///< \brief Whether each bounded volume is waiting to be relocated.
+
+	unordered_map<VolumeComponent*, unsigned int> volume_index_;	///< \brief Maps each bounded volume to its index.
+
+	vector<VolumeComponent*> unbounded_;					///< \brief Volumes whose bounds are infinite. Always tested.
+
+	vector<unique_ptr<Listener>> unbounded_listeners_;		///< \brief Bounds listener of each unbounded volume.
+
+	vector<bool> unbounded_dirty_;							///< \brief Whether each unbounded volume is waiting to be relocated.
+
+	vector<VolumeComponent*> dirty_volumes_;				///< \brief Volumes that changed since the last commit. May contain volumes removed in the meantime.
+
+	unsigned int pending_changes_;							///< \brief Number of volume changes recorded since the last commit.
+
+	HierarchyStats stats_;									///< \brief Statistics of the last commit.
+
+	VolumeChangeLog change_log_;							///< \brief Changes applied to the content of the tree.
+
+	vector<BVHNode> nodes_;									///< \brief Nodes of the tree.
+
+	vector<unsigned int> free_nodes_;						///< \brief Nodes available for recycling.
+
+	unsigned int root_;										///< \brief Index of the root node.
+
+	float internal_area_;									///< \brief Sum of the surface area of each internal node.
+
+	float build_cost_;										///< \brief SAH cost of the tree when it was last built.
+
+	float rebuild_threshold_;								///< \brief Cost ratio that triggers a background rebuild.
+
+	future<BVHBuild> pending_build_;						///< \brief Background build, if any.
+
+};
+
+BVHTree::Impl::Impl(float rebuild_threshold) :
+pending_changes_(0),
+stats_(HierarchyStats{ 0u, 0u, 0u }),
+root_(kNone),
+internal_area_(0.0f),
+build_cost_(0.0f),
+rebuild_threshold_(rebuild_threshold){}
+
+BVHTree::Impl::~Impl(){
+
+	if (pending_build_.valid()){
+
+		pending_build_.wait();
+
+	}
+
+}
+
+void BVHTree::Impl::AddVolume(VolumeComponent* volume){
+
+	auto bounds = volume->GetBoundingBox();
+
+	if (IsBounded(bounds)){
+
+		AddBounded(volume, bounds, Subscribe(volume));
+
+		PollRebuild();
+
+	}
+	else{
+
+		AddUnbounded(volume, Subscribe(volume));
+
+	}
+
+	change_log_.RecordChange(volume);
+
+}
+
+void BVHTree::Impl::RemoveVolume(VolumeComponent* volume){
+
+	auto it = volume_index_.find(volume);
+
+	if (it != volume_index_.end()){
+
+		RemoveBounded(it->second);
+
+		change_log_.RecordRemoval(volume);
+
+		PollRebuild();
+
+		return;
+
+	}
+
+	auto unbounded_it = std::find(unbounded_.begin(),
+								  unbounded_.end(),
+								  volume);
+
+	if (unbounded_it != unbounded_.end()){
+
+		RemoveUnbounded(unbounded_it);
+
+		change_log_.RecordRemoval(volume);
+
+	}
+
+}
+
+void BVHTree::Impl::Commit(){
+
+	unsigned int relocations = 0;
+
+	for (auto volume : dirty_volumes_){
+
+		// Volumes removed after being marked have no dirty flag anymore and are skipped.
+
+		auto it = volume_index_.find(volume);
+
+		if (it != volume_index_.end()){
+
+			if (!dirty_[it->second]){
+
+				continue;
+
+			}
+
+			dirty_[it->second] = false;
+
+		}
+		else{
+
+			auto unbounded_it = std::find(unbounded_.begin(),
+										  unbounded_.end(),
+										  volume);
+
+			if (unbounded_it == unbounded_.end() ||
+				!unbounded_dirty_[unbounded_it - unbounded_.begin()]){
+
+				continue;
+
+			}
+
+			unbounded_dirty_[unbounded_it - unbounded_.begin()] = false;
+
+		}
+
+		Relocate(volume);
+
+		change_log_.RecordChange(volume);
+
+		++relocations;
+
+	}
+
+	stats_ = HierarchyStats{ pending_changes_,
+							 relocations,
+							 pending_changes_ - relocations };
+
+	dirty_volumes_.clear();
+
+	pending_changes_ = 0;
+
+	PollRebuild();
+
+}
+
+HierarchyStats BVHTree::Impl::GetStats() const{
+
+	return stats_;
+
+}
+
+const VolumeChangeLog& BVHTree::Impl::GetChangeLog() const{
+
+	return change_log_;
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool BVHTree::Impl::VisitIntersections(const TVolume& volume, TVisitor&& visitor) const{
+
+	// Unbounded volumes cannot be culled by the hierarchy.
+
+	return VisitUnbounded(volume, visitor) &&
+		   (root_ == kNone || VisitSubtree(volume, root_, visitor));
+
+}
+
+template <typename TVisitor>
+bool BVHTree::Impl::VisitIntersections(const Frustum& frustum, TVisitor&& visitor) const{
+
+	return VisitUnbounded(frustum, visitor) &&
+		   (root_ == kNone || VisitSubtree(frustum, root_, visitor));
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool BVHTree::Impl::VisitUnbounded(const TVolume& volume, TVisitor&& visitor) const{
+
+	for (auto unbounded : unbounded_){
+
+		if ((unbounded->TestAgainst(volume) && IntersectionType::kIntersect) &&
+			!visitor(unbounded)){
+
+			return false;
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool BVHTree::Impl::VisitSubtree(const TVolume& volume, unsigned int root, TVisitor&& visitor) const{
+
+	// Iterative descent: the depth of a refitted tree is not bounded.
+
+	TraversalStack<unsigned int> stack;
+
+	stack.Push(root);
+
+	while (!stack.IsEmpty()){
+
+		auto& node = nodes_[stack.Pop()];
+
+		if (!(volume.Intersect(node.bounds) && IntersectionType::kIntersect)){
+
+			continue;		// Prune the whole subtree
+
+		}
+
+		if (node.IsLeaf()){
+
+			auto candidate = volumes_[node.volume];
+
+			if ((candidate->TestAgainst(volume) && IntersectionType::kIntersect) &&
+				!visitor(candidate)){
+
+				return false;
+
+			}
+
+		}
+		else{
+
+			stack.Push(node.children[1]);
+			stack.Push(node.children[0]);
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVisitor>
+bool BVHTree::Impl::VisitSubtree(const Frustum& frustum, unsigned int root, TVisitor&& visitor) const{
+
+	// Same as the generic descent, but each node carries the planes which do not contain its parent.
+
+	TraversalStack<pair<unsigned int, unsigned int>> stack;
+
+	stack.Push(make_pair(root, Frustum::kAllPlanes));
+
+	while (!stack.IsEmpty()){
+
+		auto entry = stack.Pop();
+
+		auto node_index = entry.first;
+
+		auto plane_mask = entry.second;
+
+		auto& node = nodes_[node_index];
+
+		auto intersection = frustum.Intersect(node.bounds, plane_mask);
+
+		if (!(intersection && IntersectionType::kIntersect)){
+
+			continue;		// Prune the whole subtree
+
+		}
+
+		if (intersection && IntersectionType::kInside){
+
+			if (!VisitVolumes(node_index, visitor)){		// Fully visible: no further test needed
+
+				return false;
+
+			}
+
+		}
+		else if (node.IsLeaf()){
+
+			auto candidate = volumes_[node.volume];
+
+			if ((candidate->TestAgainst(frustum) && IntersectionType::kIntersect) &&
+				!visitor(candidate)){
+
+				return false;
+
+			}
+
+		}
+		else{
+
+			stack.Push(make_pair(node.children[1], plane_mask));
+			stack.Push(make_pair(node.children[0], plane_mask));
+
+		}
+
+	}
+
+	return true;
+
+}
+
+void BVHTree::Impl::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	auto active = batch.GetGroupMask(group);
+
+	for (auto unbounded : unbounded_){
+
+		auto queries = batch.TestAgainst(group, *unbounded, active, 0);
+
+		if (queries != 0){
+
+			batch.AddIntersection(group, queries, unbounded);
+
+		}
+
+	}
+
+	if (root_ == kNone){
+
+		return;
+
+	}
+
+	// Single descent for the whole group: each subtree is visited once, carrying the queries which may still find something inside it.
+
+	TraversalStack<BatchEntry> stack;
+
+	stack.Push(BatchEntry{ root_, active, 0 });
+
+	while (!stack.IsEmpty()){
+
+		auto entry = stack.Pop();
+
+		auto& node = nodes_[entry.node];
+
+		auto contained = entry.contained;
+
+		auto queries = batch.Intersect(group, node.bounds, entry.active, contained);
+
+		if (queries == 0){
+
+			continue;		// Prune the whole subtree
+
+		}
+
+		if (node.IsLeaf()){
+
+			auto candidate = volumes_[node.volume];
+
+			queries = batch.TestAgainst(group, *candidate, queries, contained);
+
+			if (queries != 0){
+
+				batch.AddIntersection(group, queries, candidate);
+
+			}
+
+		}
+		else{
+
+			stack.Push(BatchEntry{ node.children[1], queries, contained });
+			stack.Push(BatchEntry{ node.children[0], queries, contained });
+
+		}
+
+	}
+
+}
+
+void BVHTree::Impl::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	// The unbounded volumes come first, then each internal node is replaced by its children, left to right:
+	// the order of the sequential traversal is preserved.
+
+	if (!unbounded_.empty()){
+
+		partitions.push_back(HierarchyPartition{ kNone, false });
+
+	}
+
+	if (root_ == kNone){
+
+		return;
+
+	}
+
+	vector<HierarchyPartition> expanded;
+
+	partitions.push_back(HierarchyPartition{ root_, true });
+
+	bool split;
+
+	do{
+
+		split = false;
+
+		expanded.clear();
+
+		for (auto&& partition : partitions){
+
+			if (partition.node == kNone ||
+				nodes_[partition.node].IsLeaf()){
+
+				expanded.push_back(partition);
+				continue;
+
+			}
+
+			auto& node = nodes_[partition.node];
+
+			expanded.push_back(HierarchyPartition{ node.children[0], true });
+			expanded.push_back(HierarchyPartition{ node.children[1], true });
+
+			split = true;
+
+		}
+
+		partitions.swap(expanded);
+
+	} while (split && partitions.size() < count);
+
+}
+
+template <typename TVolume>
+void BVHTree::Impl::GetPartitionIntersections(const TVolume& volume, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	auto visitor = [&intersections](VolumeComponent* volume){
+
+		intersections.push_back(volume);
+		return true;
+
+	};
+
+	if (partition.node == kNone){
+
+		VisitUnbounded(volume, visitor);
+
+	}
+	else{
+
+		VisitSubtree(volume, static_cast<unsigned int>(partition.node), visitor);
+
+	}
+
+}
+
+template <typename TVisitor>
+bool BVHTree::Impl::VisitVolumes(unsigned int node, TVisitor&& visitor) const{
+
+	TraversalStack<unsigned int> stack;
+
+	stack.Push(node);
+
+	while (!stack.IsEmpty()){
+
+		auto& current = nodes_[stack.Pop()];
+
+		if (current.IsLeaf()){
+
+			if (!visitor(volumes_[current.volume])){
+
+				return false;
+
+			}
+
+		}
+		else{
+
+			stack.Push(current.children[1]);
+			stack.Push(current.children[0]);
+
+		}
+
+	}
+
+	return true;
+
+}
+
+void BVHTree::Impl::Rebuild(){
+
+	if (pending_build_.valid()){
+
+		pending_build_.get();			// Discard the pending build, it would be stale anyway.
+
+	}
+
+	auto build = Build(volumes_, bounds_);
+
+	Adopt(build);
+
+}
+
+float BVHTree::Impl::GetCost() const{
+
+	if (root_ == kNone){
+
+		return 0.0f;
+
+	}
+
+	auto root_area = GetSurfaceArea(nodes_[root_].bounds);
+
+	return root_area > 0.0f ?
+		   internal_area_ / root_area :
+		   0.0f;
+
+}
+
+void BVHTree::Impl::OnVolumeChanged(VolumeComponent* volume){
+
+	++pending_changes_;
+
+	auto it = volume_index_.find(volume);
+
+	if (it != volume_index_.end()){
+
+		if (dirty_[it->second]){
+
+			return;			// Already marked
+
+		}
+
+		dirty_[it->second] = true;
+
+	}
+	else{
+
+		auto index = std::find(unbounded_.begin(),
+							   unbounded_.end(),
+							   volume) - unbounded_.begin();
+
+		if (unbounded_dirty_[index]){
+
+			return;			// Already marked
+
+		}
+
+		unbounded_dirty_[index] = true;
+
+	}
+
+	dirty_volumes_.push_back(volume);
+
+}
+
+void BVHTree::Impl::Relocate(VolumeComponent* volume){
+
+	auto bounds = volume->GetBoundingBox();
+
+	auto it = volume_index_.find(volume);
+
+	if (it != volume_index_.end()){
+
+		if (IsBounded(bounds)){
+
+			// Refit: the topology of the tree is left untouched.
+
+			auto volume_index = it->second;
+
+			auto leaf = leaves_[volume_index];
+
+			bounds_[volume_index] = bounds;
+
+			nodes_[leaf].bounds = bounds;
+
+			Refit(nodes_[leaf].parent);
+
+		}
+		else{
+
+			// The volume keeps its bounds listener.
+
+			AddUnbounded(volume, RemoveBounded(it->second));
+
+		}
+
+	}
+	else if(IsBounded(bounds)){
+
+		// The volume was unbounded.
+
+		auto unbounded_it = std::find(unbounded_.begin(),
+									  unbounded_.end(),
+									  volume);
+
+		AddBounded(volume, bounds, RemoveUnbounded(unbounded_it));
+
+	}
+
+}
+
+unique_ptr<Listener> BVHTree::Impl::Subscribe(VolumeComponent* volume){
+
+	return volume->OnChanged().Subscribe([this, volume](_, _){
+
+		this->OnVolumeChanged(volume);
+
+	});
+
+}
+
+void BVHTree::Impl::AddBounded(VolumeComponent* volume, const AABB& bounds, unique_ptr<Listener> listener){
+
+	auto volume_index = static_cast<unsigned int>(volumes_.size());
+
+	volumes_.push_back(volume);
+
+	bounds_.push_back(bounds);
+
+	leaves_.push_back(kNone);
+
+	listeners_.push_back(std::move(listener));
+
+	dirty_.push_back(false);
+
+	volume_index_[volume] = volume_index;
+
+	auto leaf = CreateLeaf(volume_index);
+
+	InsertLeaf(leaf);
+
+}
+
+void BVHTree::Impl::AddUnbounded(VolumeComponent* volume, unique_ptr<Listener> listener){
+
+	unbounded_.push_back(volume);
+
+	unbounded_listeners_.push_back(std::move(listener));
+
+	unbounded_dirty_.push_back(false);
+
+}
+
+unique_ptr<Listener> BVHTree::Impl::RemoveBounded(unsigned int volume_index){
+
+	auto listener = std::move(listeners_[volume_index]);
+
+	RemoveLeaf(leaves_[volume_index]);
+
+	volume_index_.erase(volumes_[volume_index]);
+
+	// Swap with the last volume and pop
+
+	auto last_index = static_cast<unsigned int>(volumes_.size() - 1);
+
+	if (volume_index != last_index){
+
+		volumes_[volume_index] = volumes_[last_index];
+		bounds_[volume_index] = bounds_[last_index];
+		leaves_[volume_index] = leaves_[last_index];
+		listeners_[volume_index] = std::move(listeners_[last_index]);
+		dirty_[volume_index] = dirty_[last_index];
+
+		volume_index_[volumes_[volume_index]] = volume_index;
+
+		nodes_[leaves_[volume_index]].volume = volume_index;
+
+	}
+
+	volumes_.pop_back();
+	bounds_.pop_back();
+	leaves_.pop_back();
+	listeners_.pop_back();
+	dirty_.pop_back();
+
+	return listener;
+
+}
+
+unique_ptr<Listener> BVHTree::Impl::RemoveUnbounded(vector<VolumeComponent*>::iterator unbounded_it){
+
+	auto index = unbounded_it - unbounded_.begin();
+
+	auto listener = std::move(unbounded_listeners_[index]);
+
+	unbounded_.erase(unbounded_it);
+
+	unbounded_listeners_.erase(unbounded_listeners_.begin() + index);
+
+	unbounded_dirty_.erase(unbounded_dirty_.begin() + index);
+
+	return listener;
+
+}
+
+unsigned int BVHTree::Impl::CreateLeaf(unsigned int volume_index){
+
+	auto leaf = AllocateNode();
+
+	nodes_[leaf].bounds = bounds_[volume_index];
+	nodes_[leaf].parent = kNone;
+	nodes_[leaf].volume = volume_index;
+
+	leaves_[volume_index] = leaf;
+
+	return leaf;
+
+}
+
+void BVHTree::Impl::InsertLeaf(unsigned int leaf){
+
+	if (root_ == kNone){
+
+		root_ = leaf;
+
+		nodes_[leaf].parent = kNone;
+
+		return;
+
+	}
+
+	// Descend the tree looking for the cheapest sibling (branch and bound on the surface area increase).
+
+	auto leaf_bounds = nodes_[leaf].bounds;
+
+	auto sibling = root_;
+
+	while (!nodes_[sibling].IsLeaf()){
+
+		auto& node = nodes_[sibling];
+
+		auto area = GetSurfaceArea(node.bounds);
+
+		auto combined_area = GetSurfaceArea(Merge(node.bounds, leaf_bounds));
+
+		auto pair_cost = 2.0f * combined_area;							// Cost of creating a new parent for this node and the leaf.
+
+		auto inheritance_cost = 2.0f * (combined_area - area);			// Minimum cost of pushing the leaf further down.
+
+		float child_cost[2];
+
+		for (int child_index = 0; child_index < 2; ++child_index){
+
+			auto& child = nodes_[node.children[child_index]];
+
+			auto merged_area = GetSurfaceArea(Merge(child.bounds, leaf_bounds));
+
+			child_cost[child_index] = child.IsLeaf() ?
+									  merged_area + inheritance_cost :
+									  merged_area - GetSurfaceArea(child.bounds) + inheritance_cost;
+
+		}
+
+		if (pair_cost < child_cost[0] &&
+			pair_cost < child_cost[1]){
+
+			break;
+
+		}
+
+		sibling = child_cost[0] < child_cost[1] ?
+				  node.children[0] :
+				  node.children[1];
+
+	}
+
+	// Create a new parent for the sibling and the leaf.
+
+	auto old_parent = nodes_[sibling].parent;
+
+	auto new_parent = AllocateNode();			// May reallocate the node array.
+
+	nodes_[new_parent].parent = old_parent;
+	nodes_[new_parent].volume = kNone;
+	nodes_[new_parent].children[0] = sibling;
+	nodes_[new_parent].children[1] = leaf;
+	nodes_[new_parent].bounds = Merge(nodes_[sibling].bounds, leaf_bounds);
+
+	internal_area_ += GetSurfaceArea(nodes_[new_parent].bounds);
+
+	if (old_parent != kNone){
+
+		auto& parent = nodes_[old_parent];
+
+		parent.children[parent.children[0] == sibling ? 0 : 1] = new_parent;
+
+	}
+	else{
+
+		root_ = new_parent;
+
+	}
+
+	nodes_[sibling].parent = new_parent;
+	nodes_[leaf].parent = new_parent;
+
+	Refit(old_parent);
+
+}
+
+void BVHTree::Impl::RemoveLeaf(unsigned int leaf){
+
+	if (leaf == root_){
+
+		root_ = kNone;
+
+		FreeNode(leaf);
+
+		return;
+
+	}
+
+	// The sibling takes the place of the parent.
+
+	auto parent = nodes_[leaf].parent;
+
+	auto grand_parent = nodes_[parent].parent;
+
+	auto sibling = nodes_[parent].children[nodes_[parent].children[0] == leaf ? 1 : 0];
+
+	internal_area_ -= GetSurfaceArea(nodes_[parent].bounds);
+
+	nodes_[sibling].parent = grand_parent;
+
+	if (grand_parent != kNone){
+
+		auto& node = nodes_[grand_parent];
+
+		node.children[node.children[0] == parent ? 0 : 1] = sibling;
+
+	}
+	else{
+
+		root_ = sibling;
+
+	}
+
+	FreeNode(parent);
+	FreeNode(leaf);
+
+	Refit(grand_parent);
+
+}
+
+void BVHTree::Impl::Refit(unsigned int node){
+
+	while (node != kNone){
+
+		auto& current = nodes_[node];
+
+		SetBounds(node,
+				  Merge(nodes_[current.children[0]].bounds,
+						nodes_[current.children[1]].bounds));
+
+		node = current.parent;
+
+	}
+
+}
+
+void BVHTree::Impl::SetBounds(unsigned int node, const AABB& bounds){
+
+	auto& current = nodes_[node];
+
+	if (!current.IsLeaf()){
+
+		internal_area_ += GetSurfaceArea(bounds) - GetSurfaceArea(current.bounds);
+
+	}
+
+	current.bounds = bounds;
+
+}
+
+unsigned int BVHTree::Impl::AllocateNode(){
+
+	unsigned int node;
+
+	if (!free_nodes_.empty()){
+
+		node = free_nodes_.back();
+
+		free_nodes_.pop_back();
+
+	}
+	else{
+
+		node = static_cast<unsigned int>(nodes_.size());
+
+		nodes_.push_back(BVHNode());
+
+	}
+
+	nodes_[node].parent = kNone;
+	nodes_[node].children[0] = kNone;
+	nodes_[node].children[1] = kNone;
+	nodes_[node].volume = kNone;
+
+	return node;
+
+}
+
+void BVHTree::Impl::FreeNode(unsigned int node){
+
+	nodes_[node].volume = kNone;
+
+	free_nodes_.push_back(node);
+
+}
+
+void BVHTree::Impl::PollRebuild(){
+
+	if (pending_build_.valid()){
+
+		if (pending_build_.wait_for(chrono::seconds(0)) != future_status::ready){
+
+			return;			// Still building
+
+		}
+
+		auto build = pending_build_.get();
+
+		Adopt(build);
+
+	}
+
+	if (volumes_.size() > 1 &&
+		GetCost() > build_cost_ * rebuild_threshold_){
+
+		// The build works on a snapshot of the current bounds, the scene can be modified in the meantime.
+
+		auto volumes = volumes_;
+		auto bounds = bounds_;
+
+		pending_build_ = std::async(std::launch::async,
+									[volumes, bounds](){
+
+										return Build(volumes, bounds);
+
+									});
+
+	}
+
+}
+
+void BVHTree::Impl::Adopt(BVHBuild& build){
+
+	nodes_ = std::move(build.nodes);
+
+	root_ = build.root;
+
+	free_nodes_.clear();
+
+	// Map the leaves to the current volumes. Volumes removed in the meantime leave stale leaves behind.
+
+	vector<bool> placed(volumes_.size(), false);
+
+	vector<unsigned int> stale_leaves;
+
+	for (unsigned int node_index = 0; node_index < nodes_.size(); ++node_index){
+
+		auto& node = nodes_[node_index];
+
+		if (node.IsLeaf()){
+
+			auto it = volume_index_.find(build.volumes[node.volume]);
+
+			if (it != volume_index_.end()){
+
+				node.volume = it->second;
+				node.bounds = bounds_[it->second];			// The volume may have moved in the meantime
+
+				leaves_[it->second] = node_index;
+
+				placed[it->second] = true;
+
+			}
+			else{
+
+				stale_leaves.push_back(node_index);
+
+			}
+
+		}
+
+	}
+
+	// Refit bottom-up: children always follow their parent inside a freshly-built tree.
+
+	internal_area_ = 0.0f;
+
+	for (auto node_index = static_cast<unsigned int>(nodes_.size()); node_index > 0; --node_index){
+
+		auto& node = nodes_[node_index - 1];
+
+		if (!node.IsLeaf()){
+
+			node.bounds = Merge(nodes_[node.children[0]].bounds,
+								nodes_[node.children[1]].bounds);
+
+			internal_area_ += GetSurfaceArea(node.bounds);
+
+		}
+
+	}
+
+	// Patch the removed and added volumes.
+
+	for (auto leaf : stale_leaves){
+
+		nodes_[leaf].volume = kNone;
+
+		RemoveLeaf(leaf);
+
+	}
+
+	for (unsigned int volume_index = 0; volume_index < volumes_.size(); ++volume_index){
+
+		if (!placed[volume_index]){
+
+			InsertLeaf(CreateLeaf(volume_index));
+
+		}
+
+	}
+
+	build_cost_ = GetCost();
+
+}
+
+///////////////////////////////////// BVH TREE ////////////////////////////////////
+
+const float BVHTree::kDefaultRebuildThreshold = 1.5f;
+
+BVHTree::BVHTree() :
+BVHTree(kDefaultRebuildThreshold){}
+
+BVHTree::BVHTree(float rebuild_threshold) :
+pimpl_(make_unique<Impl>(rebuild_threshold)){}
+
+BVHTree::~BVHTree(){}
+
+void BVHTree::AddVolume(VolumeComponent* volume){
+
+	pimpl_->AddVolume(volume);
+
+}
+
+void BVHTree::RemoveVolume(VolumeComponent* volume){
+
+	pimpl_->RemoveVolume(volume);
+
+}
+
+void BVHTree::GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(frustum,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+void BVHTree::GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(sphere,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+void BVHTree::GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(aabb,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+bool BVHTree::VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(frustum, visitor);
+
+}
+
+bool BVHTree::VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(sphere, visitor);
+
+}
+
+bool BVHTree::VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(aabb, visitor);
+
+}
+
+void BVHTree::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	pimpl_->GetGroupIntersections(batch, group);
+
+}
+
+void BVHTree::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	pimpl_->GetPartitions(count, partitions);
+
+}
+
+void BVHTree::GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(frustum, partition, intersections);
+
+}
+
+void BVHTree::GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(sphere, partition, intersections);
+
+}
+
+void BVHTree::GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(aabb, partition, intersections);
+
+}
+
+void BVHTree::Commit(){
+
+	pimpl_->Commit();
+
+}
+
+HierarchyStats BVHTree::GetStats() const{
+
+	return pimpl_->GetStats();
+
+}
+
+const VolumeChangeLog& BVHTree::GetChangeLog() const{
+
+	return pimpl_->GetChangeLog();
+
+}
+
+void BVHTree::Rebuild(){
+
+	pimpl_->Rebuild();
+
+}
+
+float BVHTree::GetCost() const{
+
+	return pimpl_->GetCost();
+
+}
@@ -1,6 +1,7 @@
 #include "component.h"
 
 #include <algorithm>
+#include <atomic>
 
 #include "exceptions.h"
 
@@ -9,37 +10,11 @@ using namespace ::std;
 
 namespace{
 
-	/// \brief Unmaps a component from a given multimap.
-	/// \param component Component to remove.
-	/// \param map Map where the component should be unmapped from.
-	void UnmapInterface(Component* component, Component::ComponentMap& map){
+	/// \brief Next component type id. Namespace-scope, so that it is initialized before any thread may use it.
+	atomic<ComponentTypeId> next_type_id(0);
 
-		// O(#types * #interfaces_per_type)
-
-		for (auto type : component->GetTypes()){
-
-			auto range = map.equal_range(type);
-
-			while (range.first != range.second){
-
-				if (range.first->second == component){
-
-					map.erase(range.first);		
-
-					break; // At most once per type
-
-				}
-				else{
-
-					++(range.first);
-
-				}
-
-			}
-
-		}
-
-	}
+	/// \brief Empty list of types, since Component has no base class.
+	const vector<ComponentTypeId> no_types;
 
 }
 
@@ -48,27 +23,29 @@ namespace{
 /// \brief Enables intra-component communications.
 class Component::Arbiter{
 
+	friend class ArchetypeStorage;
+
 public:
 
 	using ComponentSet = set < Component* >;
 
-	using ComponentMap = unordered_multimap < type_index, Component* >;
-
-	using range = Component::map_range;
+	using range = Component::table_range;
 
-	Arbiter();
+	Arbiter(ComponentAllocator& allocator);
 
 	~Arbiter();
 
+	ComponentAllocator& GetAllocator();
+
 	void AddComponent(Component* component);
 
 	void RemoveComponent(Component* component);
 
 	void RemoveAll();
 
-	Component* GetComponent(type_index type);
+	Component* GetComponent(ComponentTypeId type);
 
-	range GetComponents(type_index type);
+	range GetComponents(ComponentTypeId type);
 
 private:
 
@@ -76,21 +53,47 @@ private:
 
 	void FinalizeComponent(Component& component);
 
+	/// \brief Add a component to the table, once for each of its types.
+	void MapComponent(Component* component);
+
+	/// \brief Remove a component from the table. O(#types * #components)
+	void UnmapComponent(Component* component);
+
 	ComponentSet component_set_;
 
-	ComponentMap component_map_;
+	ComponentTable component_table_;		///< \brief Components grouped by type id. Components of the same type are sorted by insertion.
+
+	vector<unsigned int> type_offsets_;		///< \brief Index of the first component of each type id inside the table, followed by the size of the table.
 
 	bool autodestroy_;
 
+	ComponentAllocator& allocator_;			///< \brief Allocator of the entity and its components.
+
+	ArchetypeStorage* storage_;				///< \brief Storage tracking the entity, if any.
+
+	unsigned int archetype_;				///< \brief Archetype of the entity inside the storage.
+
+	unsigned int row_;						///< \brief Index of the entity inside its archetype.
+
 };
 
-Component::Arbiter::Arbiter() :
-autodestroy_(true){}
+Component::Arbiter::Arbiter(ComponentAllocator& allocator) :
+autodestroy_(true),
+allocator_(allocator),
+storage_(nullptr),
+archetype_(ArchetypeStorage::kNone),
+row_(0){}
 
 Component::Arbiter::~Arbiter(){
 
 	autodestroy_ = false;		// This ensures that this destructor is called exactly once
 
+	if (storage_){
+
+		storage_->Remove(*this);
+
+	}
+
 	// Finalize all the component together
 
 	for (auto&& component : component_set_) {
@@ -109,15 +112,21 @@ Component::Arbiter::~Arbiter(){
 
 }
 
+ComponentAllocator& Component::Arbiter::GetAllocator(){
+
+	return allocator_;
+
+}
+
 void Component::Arbiter::AddComponent(Component* component){
 
 	component_set_.insert(component);
 
-	// Map each component type - O(#types)
+	MapComponent(component);
 
-	for (auto& type : component->GetTypes()){
+	if (storage_){
 
-		component_map_.insert(ComponentMap::value_type(type, component));
+		storage_->Relocate(*this);
 
 	}
 
@@ -139,10 +148,16 @@ void Component::Arbiter::RemoveComponent(Component* component){
 		FinalizeComponent(**it);
 		DeleteComponent(it);
 
+		if (storage_){
+
+			storage_->Relocate(*this);
+
+		}
+
 		if (autodestroy_ &&
 			component_set_.empty()){
 
-			delete this;	// Autodestruction
+			Component::Destroy(this);	// Autodestruction
 
 		}
 
@@ -150,19 +165,75 @@ void Component::Arbiter::RemoveComponent(Component* component){
 	
 }
 
-Component* Component::Arbiter::GetComponent(type_index type){
-
-	auto it = component_map_.find(type);
+Component* Component::Arbiter::GetComponent(ComponentTypeId type){
 
-	return it != component_map_.end() ?
-		   it->second :
+	return (type + 1 < type_offsets_.size() && type_offsets_[type] != type_offsets_[type + 1]) ?
+		   component_table_[type_offsets_[type]] :
 		   nullptr;
 
 }
 
-Component::Arbiter::range Component::Arbiter::GetComponents(type_index type){
+Component::Arbiter::range Component::Arbiter::GetComponents(ComponentTypeId type){
+
+	if (type + 1 >= type_offsets_.size()){
+
+		return range(component_table_.end(),
+					 component_table_.end());
+
+	}
+
+	return range(component_table_.begin() + type_offsets_[type],
+				 component_table_.begin() + type_offsets_[type + 1]);
+
+}
+
+void Component::Arbiter::MapComponent(Component* component){
+
+	for (auto type : component->GetTypes()){
+
+		// Types never seen by this entity start out empty, at the end of the table
+
+		if (type + 1 >= type_offsets_.size()){
+
+			type_offsets_.resize(type + 2, static_cast<unsigned int>(component_table_.size()));
+
+		}
+
+		component_table_.insert(component_table_.begin() + type_offsets_[type + 1],
+								component);
+
+		for (auto offset = type_offsets_.begin() + type + 1; offset != type_offsets_.end(); ++offset){
+
+			++(*offset);
+
+		}
+
+	}
+
+}
+
+void Component::Arbiter::UnmapComponent(Component* component){
+
+	for (auto type : component->GetTypes()){
+
+		auto begin = component_table_.begin() + type_offsets_[type];
+		auto end = component_table_.begin() + type_offsets_[type + 1];
+
+		auto it = std::find(begin, end, component);
 
-	return range(component_map_.equal_range(type));
+		if (it != end){
+
+			component_table_.erase(it);
+
+			for (auto offset = type_offsets_.begin() + type + 1; offset != type_offsets_.end(); ++offset){
+
+				--(*offset);
+
+			}
+
+		}
+
+	}
 
 }
 
@@ -190,9 +261,9 @@ void Component::Arbiter::DeleteComponent(ComponentSet::iterator it){
 
 	component_set_.erase(it);
 
-	UnmapInterface(component, component_map_);
+	UnmapComponent(component);
 
-	delete component;								// Independent destruction
+	Component::Destroy(component);					// Independent destruction
 
 }
 
@@ -200,7 +271,8 @@ void Component::Arbiter::DeleteComponent(ComponentSet::iterator it){
 /////////////////////////////// COMPONENT /////////////////////////////////////////
 
 Component::Component() :
-arbiter_(nullptr){}
+arbiter_(nullptr),
+pool_(nullptr){}
 
 Component::~Component(){}
 
@@ -212,7 +284,7 @@ void Component::RemoveComponent(){
 
 void Component::Dispose(){
 
-	delete arbiter_;
+	Destroy(arbiter_);
 
 }
 
@@ -224,21 +296,65 @@ Observable<Component::OnRemovedEventArgs>& Component::OnRemoved(){
 
 Component::TypeSet Component::GetTypes() const{
 
-	set<type_index> types;
+	return DeriveTypes<Component>(TypeSet(no_types.cbegin(),
+										  no_types.cend()));
+
+}
+
+ComponentTypeId Component::MakeTypeId(){
+
+	return next_type_id.fetch_add(1, memory_order_relaxed);
+
+}
+
+vector<ComponentTypeId> Component::MakeTypes(TypeSet base_types, ComponentTypeId type){
 
-	types.insert(type_index(typeid(Component)));
+	vector<ComponentTypeId> types(base_types.begin(),
+								  base_types.end());
+
+	types.push_back(type);
 
 	return types;
 
 }
 
-Component* Component::GetComponent(type_index type) const{
+void Component::Destroy(Component* component){
+
+	// The pool hands out blocks for the most derived type
+
+	auto pool = component->pool_;
+
+	auto block = dynamic_cast<void*>(component);
+
+	component->~Component();
+
+	pool->Free(block);
+
+}
+
+void Component::Destroy(Arbiter* arbiter){
+
+	auto& allocator = arbiter->GetAllocator();
+
+	arbiter->~Arbiter();
+
+	allocator.entities_.Free(arbiter);
+
+}
+
+ComponentAllocator& Component::GetAllocator() const{
+
+	return arbiter_->GetAllocator();
+
+}
+
+Component* Component::GetComponent(ComponentTypeId type) const{
 
 	return arbiter_->GetComponent(type);
 
 }
 
-Component::map_range Component::GetComponents(type_index type) const{
+Component::table_range Component::GetComponents(ComponentTypeId type) const{
 
 	return arbiter_->GetComponents(type);
 
@@ -250,8 +366,218 @@ void Component::Setup(Arbiter* arbiter){
 
 }
 
-void Component::Setup(){
+void Component::Setup(ComponentAllocator& allocator){
+
+	Setup(new (allocator.entities_.Allocate()) Arbiter(allocator));
+
+}
+
+/////////////////////////////// COMPONENT ALLOCATOR /////////////////////////////////////////
+
+namespace{
+
+	/// \brief Allocator used by Component::Create. Never destroyed, since entities may outlive any static object.
+	ComponentAllocator* default_allocator = new ComponentAllocator();
+
+}
+
+ComponentAllocator::ComponentAllocator() :
+entities_(sizeof(Component::Arbiter)){}
+
+ComponentAllocator::~ComponentAllocator(){}
+
+ComponentAllocator& ComponentAllocator::GetDefault(){
+
+	return *default_allocator;
+
+}
+
+SlabPool& ComponentAllocator::GetPool(ComponentTypeId type, size_t size){
+
+	if (type >= pools_.size()){
+
+		pools_.resize(type + 1);
+
+	}
+
+	if (!pools_[type]){
+
+		pools_[type] = make_unique<SlabPool>(size);
+
+	}
+
+	return *pools_[type];
+
+}
+
+PoolStatistics ComponentAllocator::GetStatistics(ComponentTypeId type) const{
+
+	if (type < pools_.size() && pools_[type]){
+
+		return pools_[type]->GetStatistics();
+
+	}
+
+	PoolStatistics statistics = {};
+
+	return statistics;
+
+}
+
+/////////////////////////////// ARCHETYPE STORAGE /////////////////////////////////////////
+
+const unsigned int ArchetypeStorage::kNone = static_cast<unsigned int>(-1);
+
+ArchetypeStorage::ArchetypeStorage(){}
+
+ArchetypeStorage::~ArchetypeStorage(){
+
+	for (auto&& archetype : archetypes_){
+
+		for (auto&& entity : archetype.entities){
+
+			entity->storage_ = nullptr;
+			entity->archetype_ = kNone;
+
+		}
+
+	}
+
+}
+
+void ArchetypeStorage::AddEntity(Component& component){
+
+	auto& entity = *component.arbiter_;
+
+	if (entity.storage_ == this){
+
+		return;
+
+	}
+
+	if (entity.storage_){
+
+		THROW(L"The entity belongs to another storage already.");
+
+	}
+
+	entity.storage_ = this;
+
+	Relocate(entity);
+
+}
+
+void ArchetypeStorage::Relocate(Component::Arbiter& entity){
+
+	// The archetype is the set of types with at least one component
+
+	vector<ComponentTypeId> types;
+
+	for (ComponentTypeId type = 0; type + 1 < entity.type_offsets_.size(); ++type){
+
+		if (entity.type_offsets_[type] != entity.type_offsets_[type + 1]){
+
+			types.push_back(type);
+
+		}
+
+	}
+
+	Remove(entity);
+
+	if (types.empty()){
+
+		entity.storage_ = nullptr;		// The entity is being destroyed
+
+		return;
+
+	}
+
+	entity.archetype_ = FindArchetype(types);
+
+	auto& archetype = archetypes_[entity.archetype_];
+
+	entity.row_ = static_cast<unsigned int>(archetype.entities.size());
+
+	archetype.entities.push_back(&entity);
+
+	for (size_t column = 0; column < archetype.types.size(); ++column){
+
+		archetype.components[column].push_back(entity.component_table_[entity.type_offsets_[archetype.types[column]]]);
+
+	}
+
+}
+
+void ArchetypeStorage::Remove(Component::Arbiter& entity){
+
+	if (entity.archetype_ == kNone){
+
+		return;
+
+	}
+
+	// The last entity of the archetype fills the hole
+
+	auto& archetype = archetypes_[entity.archetype_];
+
+	auto row = entity.row_;
+
+	auto last = archetype.entities.size() - 1;
+
+	archetype.entities[row] = archetype.entities[last];
+	archetype.entities[row]->row_ = row;
+	archetype.entities.pop_back();
+
+	for (auto&& column : archetype.components){
 
-	Setup(new Arbiter());
+		column[row] = column[last];
+		column.pop_back();
+
+	}
+
+	entity.archetype_ = kNone;
+
+}
+
+unsigned int ArchetypeStorage::FindArchetype(const vector<ComponentTypeId>& types){
+
+	auto it = archetype_map_.find(types);
+
+	if (it != archetype_map_.end()){
+
+		return it->second;
+
+	}
+
+	auto index = static_cast<unsigned int>(archetypes_.size());
+
+	archetypes_.push_back(Archetype());
+
+	auto& archetype = archetypes_.back();
+
+	archetype.types = types;
+
+	archetype.columns.resize(types.back() + 1, kNone);
+
+	archetype.components.resize(types.size());
+
+	for (unsigned int column = 0; column < types.size(); ++column){
+
+		archetype.columns[types[column]] = column;
+
+	}
+
+	archetype_map_.insert(std::make_pair(types, index));
+
+	return index;
+
+}
+
+Component* const* ArchetypeStorage::GetColumn(const Archetype& archetype, ComponentTypeId type){
+
+	return (type < archetype.columns.size() && archetype.columns[type] != kNone) ?
+		   archetype.components[archetype.columns[type]].data() :
+		   nullptr;
 
 }
\ No newline at end of file
@@ -0,0 +1,418 @@
+#include "derived_data_cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include "core.h"
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Primes used to scramble the words. Borrowed from xxHash.
+	const unsigned long long kPrime1 = 0x9E3779B185EBCA87ull;
+	const unsigned long long kPrime2 = 0xC2B2AE3D27D4EB4Full;
+	const unsigned long long kPrime3 = 0x165667B19E3779F9ull;
+
+	/// \brief Size of a word, in bytes.
+	const size_t kWordSize = sizeof(unsigned long long);
+
+	/// \brief Size of the chunks used to read the source files, in bytes.
+	const size_t kReadChunkSize = 1 << 16;
+
+	/// \brief Extension of the blob files.
+	const wstring kBlobExtension = L".ddc";
+
+	/// \brief Extension of the blob files being written.
+	const wstring kTemporaryExtension = L".tmp";
+
+	/// \brief Identifies a blob file.
+	const char kMagic[4] = { 'G', 'I', 'D', 'D' };
+
+	/// \brief Version of the blob layout.
+	const unsigned int kBlobVersion = 1;
+
+	/// \brief Header preceding the content of each blob.
+	struct BlobHeader{
+
+		char magic[4];						///< \brief Always kMagic.
+
+		unsigned int version;				///< \brief Always kBlobVersion.
+
+		unsigned long long size;			///< \brief Size of the content following the header, in bytes.
+
+	};
+
+	/// \brief Used to give a distinct name to the temporary files written by this process.
+	atomic<unsigned long long> temporary_index(0);
+
+	/// \brief Get the size of a file.
+	/// \return Returns the size of the file in bytes, returns 0 if the file doesn't exist.
+	size_t GetFileSize(const wstring& file_name){
+
+		std::ifstream file(file_name.c_str(), ios::binary | ios::ate);
+
+		return file ?
+			   static_cast<size_t>(file.tellg()) :
+			   0;
+
+	}
+
+	/// \brief Rotate the bits of a word to the left.
+	unsigned long long Rotate(unsigned long long word, unsigned int bits){
+
+		return (word << bits) | (word >> (64 - bits));
+
+	}
+
+	/// \brief Spread every bit of a word over the whole word.
+	unsigned long long Avalanche(unsigned long long word){
+
+		word ^= word >> 33;
+		word *= kPrime2;
+		word ^= word >> 29;
+		word *= kPrime3;
+		word ^= word >> 32;
+
+		return word;
+
+	}
+
+}
+
+/////////////////////////////// DERIVED DATA KEY ///////////////////////////////
+
+DerivedDataKey::DerivedDataKey(const string& importer, unsigned int version) :
+tail_(0),
+length_(0){
+
+	lanes_[0] = kPrime1 + kPrime2;
+	lanes_[1] = kPrime2 ^ kPrime3;
+
+	// The length of the name keeps the name apart from the inputs that follow
+
+	AddValue(importer.size());
+
+	AddData(importer.data(), importer.size());
+
+	AddValue(version);
+
+}
+
+bool DerivedDataKey::AddFile(const wstring& file_name){
+
+	std::ifstream file(file_name.c_str(), ios::binary);
+
+	if (!file.good()){
+
+		return false;
+
+	}
+
+	vector<char> chunk(kReadChunkSize);
+
+	unsigned long long file_size = 0;
+
+	while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0){
+
+		auto read_size = static_cast<size_t>(file.gcount());
+
+		AddData(chunk.data(), read_size);
+
+		file_size += read_size;
+
+	}
+
+	// Appending the size prevents two files from hashing like their concatenation
+
+	AddValue(file_size);
+
+	return file.eof();
+
+}
+
+void DerivedDataKey::AddData(const void* data, size_t size){
+
+	auto bytes = static_cast<const unsigned char*>(data);
+
+	auto end = bytes + size;
+
+	// Complete the pending word first, then hash whole words and keep the remainder for later
+
+	for (; bytes != end && length_ % kWordSize != 0; ++bytes){
+
+		tail_ |= static_cast<unsigned long long>(*bytes) << (8 * (length_ % kWordSize));
+
+		if (++length_ % kWordSize == 0){
+
+			AddWord(tail_);
+
+			tail_ = 0;
+
+		}
+
+	}
+
+	for (; end - bytes >= static_cast<ptrdiff_t>(kWordSize); bytes += kWordSize){
+
+		unsigned long long word;
+
+		memcpy(&word, bytes, kWordSize);
+
+		AddWord(word);
+
+		length_ += kWordSize;
+
+	}
+
+	for (; bytes != end; ++bytes){
+
+		tail_ |= static_cast<unsigned long long>(*bytes) << (8 * (length_ % kWordSize));
+
+		++length_;
+
+	}
+
+}
+
+wstring DerivedDataKey::GetName() const{
+
+	// The key is left untouched, more inputs may follow
+
+	auto first = Avalanche(lanes_[0] ^ Avalanche(tail_ + length_));
+
+	auto second = Avalanche(lanes_[1] + first * kPrime1);
+
+	wstringstream name;
+
+	name << hex << setfill(L'0') << setw(16) << first << setw(16) << second;
+
+	return name.str();
+
+}
+
+void DerivedDataKey::AddWord(unsigned long long word){
+
+	lanes_[0] = Rotate(lanes_[0] + word * kPrime2, 31) * kPrime1;
+
+	lanes_[1] = Rotate(lanes_[1] ^ (word * kPrime3), 27) * kPrime1 + kPrime2;
+
+}
+
+/////////////////////////////// DERIVED DATA CACHE ///////////////////////////////
+
+DerivedDataCache::DerivedDataCache(const wstring& directory, size_t capacity) :
+directory_(directory),
+capacity_(capacity),
+size_(0){
+
+	if (!directory_.empty() &&
+		directory_.back() != L'\\' &&
+		directory_.back() != L'/'){
+
+		directory_ += L"\\";
+
+	}
+
+	FileSystem::GetInstance().MakeDirectory(directory_);
+
+	Trim();
+
+}
+
+bool DerivedDataCache::Get(const DerivedDataKey& key, vector<char>& data) const{
+
+	auto file_name = GetFileName(key);
+
+	std::ifstream file(file_name.c_str(), ios::binary | ios::ate);
+
+	if (!file.good()){
+
+		return false;
+
+	}
+
+	auto file_size = static_cast<unsigned long long>(file.tellg());
+
+	BlobHeader header;
+
+	file.seekg(0);
+
+	if (file_size < sizeof(BlobHeader) ||
+		!file.read(reinterpret_cast<char*>(&header), sizeof(BlobHeader)) ||
+		memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+		header.version != kBlobVersion ||
+		header.size != file_size - sizeof(BlobHeader)){
+
+		file.close();
+
+		FileSystem::GetInstance().Remove(file_name);
+
+		return false;
+
+	}
+
+	data.resize(static_cast<size_t>(header.size));
+
+	if (!file.read(data.data(), data.size())){
+
+		return false;
+
+	}
+
+	file.close();
+
+	// The write time tracks the last use of the blob
+
+	FileSystem::GetInstance().Touch(file_name);
+
+	return true;
+
+}
+
+bool DerivedDataCache::Put(const DerivedDataKey& key, const void* data, size_t size){
+
+	auto& file_system = FileSystem::GetInstance();
+
+	auto file_name = GetFileName(key);
+
+	wstringstream temporary_name;
+
+	temporary_name << file_name
+				   << L"." << chrono::high_resolution_clock::now().time_since_epoch().count()
+				   << L"." << temporary_index.fetch_add(1)
+				   << kTemporaryExtension;
+
+	// Write the whole blob aside, then move it in place at once
+
+	BlobHeader header;
+
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+
+	header.version = kBlobVersion;
+
+	header.size = size;
+
+	std::ofstream file(temporary_name.str().c_str(), ios::binary | ios::trunc);
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(BlobHeader));
+
+	file.write(static_cast<const char*>(data), size);
+
+	bool trim;
+
+	{
+		lock_guard<mutex> lock(mutex_);
+
+		// The file is closed under the lock, so that Trim never deletes it before it is renamed: open files cannot be deleted.
+
+		file.close();
+
+		// A blob with the same key is replaced: its size is no longer part of the cache
+
+		auto replaced_size = GetFileSize(file_name);
+
+		if (!file.good() ||
+			!file_system.Rename(temporary_name.str(), file_name)){
+
+			file_system.Remove(temporary_name.str());
+
+			return false;
+
+		}
+
+		size_ -= std::min(size_, replaced_size);
+
+		size_ += sizeof(BlobHeader) + size;
+
+		trim = size_ > capacity_;
+
+	}
+
+	if (trim){
+
+		Trim();
+
+	}
+
+	return true;
+
+}
+
+void DerivedDataCache::Trim(){
+
+	auto& file_system = FileSystem::GetInstance();
+
+	lock_guard<mutex> lock(mutex_);
+
+	// The directory is the only reliable source: other processes may have written or deleted some blobs
+
+	vector<FileEntry> blobs;
+
+	file_system.EnumerateFiles(directory_, kBlobExtension, blobs);
+
+	// Temporary files left behind by writers which died are deleted. Files still being written cannot be deleted: they count towards the capacity until they are renamed.
+
+	vector<FileEntry> temporary_files;
+
+	file_system.EnumerateFiles(directory_, kTemporaryExtension, temporary_files);
+
+	unsigned long long size = 0;
+
+	for (auto&& temporary_file : temporary_files){
+
+		if (!file_system.Remove(directory_ + temporary_file.name)){
+
+			size += temporary_file.size;
+
+		}
+
+	}
+
+	std::sort(blobs.begin(),
+			  blobs.end(),
+			  [](const FileEntry& first, const FileEntry& second){
+
+				  return first.write_time < second.write_time;
+
+			  });
+
+	for (auto&& blob : blobs){
+
+		size += blob.size;
+
+	}
+
+	for (auto blob = blobs.begin(); blob != blobs.end() && size > capacity_; ++blob){
+
+		if (file_system.Remove(directory_ + blob->name)){
+
+			size -= blob->size;
+
+		}
+
+	}
+
+	size_ = static_cast<size_t>(size);
+
+}
+
+size_t DerivedDataCache::GetSize() const{
+
+	lock_guard<mutex> lock(mutex_);
+
+	return size_;
+
+}
+
+wstring DerivedDataCache::GetFileName(const DerivedDataKey& key) const{
+
+	return directory_ + key.GetName() + kBlobExtension;
+
+}
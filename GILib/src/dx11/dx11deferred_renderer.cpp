@@ -1,6 +1,8 @@
 
 #include "dx11/dx11deferred_renderer.h"
 
+#include <algorithm>
+
 #include "gimath.h"
 #include "mesh.h"
 
@@ -29,6 +31,19 @@ using namespace ::gi_lib::dx11;
 using namespace ::gi_lib::windows;
 
 namespace{
+
+	/// \brief Width of the occlusion buffer in pixels.
+	const unsigned int kOcclusionBufferWidth = 320;
+
+	/// \brief Height of the occlusion buffer in pixels.
+	const unsigned int kOcclusionBufferHeight = 192;
+
+	/// \brief Maximum number of occluder triangles rasterized each frame.
+	/// Occluders are rasterized front to back, so the ones left out are the least likely to hide anything.
+	const size_t kOccluderTriangleBudget = 65536;
+
+	/// \brief Distance the camera frustum can move by before the mesh hierarchy is traversed again.
+	const float kCameraQueryTolerance = 1.0f;
 	
 	/// \brief Compute the view-projection matrix given a camera and the aspect ratio of the target.
 	Matrix4f ComputeViewProjectionMatrix(const CameraComponent& camera, float aspect_ratio){
@@ -68,16 +83,42 @@ namespace{
 	}
 
 	/// \brief Compute the visible nodes inside a given hierarchy given the camera and the aspect ratio of the target.
-	vector<VolumeComponent*> ComputeVisibleNodes(const IVolumeHierarchy& volume_hierarchy, const CameraComponent& camera, float aspect_ratio){
+	/// \param visible_nodes Output buffer. Cleared before the query, its capacity is reused across frames.
+	void ComputeVisibleNodes(const IVolumeHierarchy& volume_hierarchy, const CameraComponent& camera, float aspect_ratio, vector<VolumeComponent*>& visible_nodes){
 
 		// Basic frustum culling
 
-		auto camera_frustum = camera.GetViewFrustum(aspect_ratio);
+		auto camera_frustum = camera.GetViewFrustum(aspect_ratio);											// Updates the view frustum according to the output ratio.
+
+		visible_nodes.clear();
 
-		return volume_hierarchy.GetIntersections(camera_frustum);											// Updates the view frustum according to the output ratio.
+		volume_hierarchy.GetIntersections(camera_frustum, visible_nodes);
 		
 	}
 
+	/// \brief Check whether any subset of a node is flagged as an occluder.
+	bool IsOccluder(const VolumeComponent& node){
+
+		for (auto&& drawable : node.GetComponents<AspectComponent<DeferredRendererMaterial>>()){
+
+			auto mesh = drawable.GetMesh();
+
+			for (unsigned int subset_index = 0; subset_index < mesh->GetSubsetCount(); ++subset_index){
+
+				if (mesh->GetFlags(subset_index) && MeshFlags::kOccluder){
+
+					return true;
+
+				}
+
+			}
+
+		}
+
+		return false;
+
+	}
+
 }
 
 ///////////////////////////////// DX11 DEFERRED RENDERER MATERIAL ///////////////////////////////
@@ -130,6 +171,10 @@ void DX11DeferredRendererMaterial::SetMatrix(const Affine3f& world, const Matrix
 DX11DeferredRenderer::DX11DeferredRenderer(const RendererConstructionArgs& arguments) :
 DeferredRenderer(arguments.scene),
 graphics_(DX11Graphics::GetInstance()),
+camera_query_(kCameraQueryTolerance),
+voxelization_query_(0.0f),
+enable_occlusion_culling_(true),
+occlusion_buffer_(kOcclusionBufferWidth, kOcclusionBufferHeight),
 lock_camera_(false){
 
 	auto&& device = *DX11Graphics::GetInstance().GetDevice();
@@ -230,11 +275,16 @@ ObjectPtr<ITexture2D> DX11DeferredRenderer::Draw(const Time& time, unsigned int
 
 		}
 
+		ComputeVisibility(frame_info);						// Scene -> Visible lights, mesh queries
+
+		ComputeOcclusion(frame_info);						// Mesh queries -> Visible meshes
+
 		DrawGBuffer(frame_info);							// Scene -> GBuffer
 		
 		if (enable_global_illumination_) {
 
-			voxelization_->Update(frame_info);				// Dynamic voxelization of the scene
+			voxelization_->Update(frame_info,
+								  voxelization_query_.GetIntersections());		// Dynamic voxelization of the scene
 
 		}
 
@@ -256,6 +306,142 @@ ObjectPtr<ITexture2D> DX11DeferredRenderer::Draw(const Time& time, unsigned int
 
 }
 
+// Visibility
+
+void DX11DeferredRenderer::ComputeVisibility(const FrameInfo& frame_info){
+
+	// Lights
+
+	ComputeVisibleNodes(frame_info.scene->GetLightHierarchy(), 
+						*frame_info.camera, 
+						frame_info.aspect_ratio,
+						visible_lights_);
+
+	// Meshes - Queries whose cached results are still valid are reused, the others are resolved with a single traversal
+
+	auto& meshes = frame_info.scene->GetMeshHierarchy();
+
+	mesh_queries_.Clear();
+
+	camera_query_.Update(meshes,
+						 frame_info.camera->GetViewFrustum(frame_info.aspect_ratio),
+						 mesh_queries_);
+
+	if (enable_global_illumination_) {
+
+		voxelization_query_.Update(meshes,
+								   voxelization_->GetGridDomain(frame_info),
+								   mesh_queries_);
+
+	}
+
+	lighting_->UpdateShadowQueries(visible_lights_,
+								   meshes,
+								   mesh_queries_);
+
+	if (mesh_queries_.GetQueryCount() > 0) {
+
+		meshes.GetIntersections(mesh_queries_);
+
+	}
+
+	camera_query_.Resolve(mesh_queries_);
+
+	voxelization_query_.Resolve(mesh_queries_);
+
+	lighting_->ResolveShadowQueries(mesh_queries_);
+
+}
+
+void DX11DeferredRenderer::ComputeOcclusion(const FrameInfo& frame_info){
+
+	auto meshes = camera_query_.GetIntersections();
+
+	visible_meshes_.clear();
+
+	if (!enable_occlusion_culling_) {
+
+		visible_meshes_.assign(meshes.begin(), meshes.end());
+
+		return;
+
+	}
+
+	// Sort the occluders front to back
+
+	auto camera_position = frame_info.camera->GetWorldTransform().translation();
+
+	occluders_.clear();
+
+	for (auto&& node : meshes){
+
+		if (IsOccluder(*node)){
+
+			occluders_.push_back(std::make_pair((node->GetBoundingBox().center - camera_position).squaredNorm(),
+												node));
+
+		}
+
+	}
+
+	std::sort(occluders_.begin(),
+			  occluders_.end(),
+			  [](const std::pair<float, VolumeComponent*>& first, const std::pair<float, VolumeComponent*>& second){
+
+				  return first.first < second.first;
+
+			  });
+
+	// Rasterize the occluders
+
+	occlusion_buffer_.Clear(ComputeViewProjectionMatrix(*frame_info.camera, 
+														frame_info.aspect_ratio));
+
+	for (auto&& occluder : occluders_){
+
+		if (occlusion_buffer_.GetTriangleCount() >= kOccluderTriangleBudget){
+
+			break;
+
+		}
+
+		for (auto&& drawable : occluder.second->GetComponents<AspectComponent<DeferredRendererMaterial>>()){
+
+			auto mesh = drawable.GetMesh();
+
+			for (unsigned int subset_index = 0; subset_index < mesh->GetSubsetCount(); ++subset_index){
+
+				if (mesh->GetFlags(subset_index) && MeshFlags::kOccluder){
+
+					occlusion_buffer_.DrawOccluder(mesh->GetPositions(),
+												   mesh->GetIndices(),
+												   mesh->GetSubset(subset_index).start_index,
+												   mesh->GetIndexCount(subset_index),
+												   drawable.GetWorldTransform());
+
+				}
+
+			}
+
+		}
+
+	}
+
+	// Discard the occluded meshes. Occluders are always kept since their bounds lie on the very surfaces they rasterized.
+
+	for (auto&& node : meshes){
+
+		if (IsOccluder(*node) ||
+			occlusion_buffer_.IsVisible(node->GetBoundingBox())){
+
+			visible_meshes_.push_back(node);
+
+		}
+
+	}
+
+}
+
 // GBuffer
 
 void DX11DeferredRenderer::DrawGBuffer(const FrameInfo& frame_info){
@@ -279,9 +465,7 @@ void DX11DeferredRenderer::DrawGBuffer(const FrameInfo& frame_info){
 
 	// Draw the visible nodes
 
-	DrawNodes(ComputeVisibleNodes(frame_info.scene->GetMeshHierarchy(), 
-								  *frame_info.camera, 
-								  frame_info.aspect_ratio), 
+	DrawNodes(visible_meshes_, 
 			  frame_info);
 	
 	// Cleanup
@@ -292,7 +476,7 @@ void DX11DeferredRenderer::DrawGBuffer(const FrameInfo& frame_info){
 
 }
 
-void DX11DeferredRenderer::DrawNodes(const vector<VolumeComponent*>& meshes, const FrameInfo& frame_info){
+void DX11DeferredRenderer::DrawNodes(const vector<VolumeComponent*>& nodes, const FrameInfo& frame_info){
 
 	graphics_.PushEvent(L"Geometry");
 
@@ -301,7 +485,7 @@ void DX11DeferredRenderer::DrawNodes(const vector<VolumeComponent*>& meshes, con
 
 	// TODO: Implement some batching strategy here!
 
-	for (auto&& node : meshes){
+	for (auto&& node : nodes){
 
 		for (auto&& drawable : node->GetComponents<AspectComponent<DeferredRendererMaterial>>()){
 
@@ -353,12 +537,8 @@ ObjectPtr<ITexture2D> DX11DeferredRenderer::ComputeLighting(const FrameInfo& fra
 
 	// Accumulate the visible lights
 
-	auto&& visible_lights = ComputeVisibleNodes(frame_info.scene->GetLightHierarchy(), 
-												*frame_info.camera, 
-												frame_info.aspect_ratio);
-
 	return lighting_->AccumulateLight(ObjectPtr<IRenderTarget>(gbuffer_), 
-									  visible_lights,
+									  visible_lights_,
 									  frame_info);
 
 }
\ No newline at end of file
@@ -254,6 +254,79 @@ DX11DeferredRendererLighting::~DX11DeferredRendererLighting(){
     
 }
 
+void DX11DeferredRendererLighting::UpdateShadowQueries(const vector<VolumeComponent*>& lights, const IVolumeHierarchy& casters, VolumeQueryBatch& batch) {
+
+    for (auto&& entry : shadow_query_cache_) {
+
+        entry.second.used = false;
+
+    }
+
+    // Same order used by UpdateShadowmaps
+
+    shadow_queries_.clear();
+
+    for (auto&& node : lights) {
+
+        for (auto&& point_light : node->GetComponents<PointLightComponent>()) {
+
+            auto& shadow_query = shadow_query_cache_[&point_light];
+
+            shadow_query.casters.Update(casters,
+                                        shadow_atlas_->GetCasterDomain(point_light),
+                                        batch);
+
+            shadow_query.used = true;
+
+            shadow_queries_.push_back(&shadow_query.casters);
+
+        }
+
+        for (auto&& directional_light : node->GetComponents<DirectionalLightComponent>()) {
+
+            auto& shadow_query = shadow_query_cache_[&directional_light];
+
+            shadow_query.casters.Update(casters,
+                                        shadow_atlas_->GetCasterDomain(directional_light),
+                                        batch);
+
+            shadow_query.used = true;
+
+            shadow_queries_.push_back(&shadow_query.casters);
+
+        }
+
+    }
+
+    // Forget the lights which are no longer visible
+
+    for (auto it = shadow_query_cache_.begin(); it != shadow_query_cache_.end();) {
+
+        if (it->second.used) {
+
+            ++it;
+
+        }
+        else {
+
+            it = shadow_query_cache_.erase(it);
+
+        }
+
+    }
+
+}
+
+void DX11DeferredRendererLighting::ResolveShadowQueries(const VolumeQueryBatch& batch) {
+
+    for (auto&& shadow_query : shadow_queries_) {
+
+        shadow_query->Resolve(batch);
+
+    }
+
+}
+
 ObjectPtr<ITexture2D> DX11DeferredRendererLighting::AccumulateLight(const ObjectPtr<IRenderTarget>& gbuffer, const vector<VolumeComponent*>& lights, const FrameInfo& frame_info) {
         
     // Shadowmaps and optional light injection
@@ -311,14 +384,16 @@ void DX11DeferredRendererLighting::UpdateShadowmaps(const vector<VolumeComponent
     point_lights_count = 0;
     directional_lights_count = 0;
 
+    auto shadow_query = shadow_queries_.cbegin();
+
     for (auto&& node : lights) {
 
         // Point lights
 
         for (auto&& point_light : node->GetComponents<PointLightComponent>()) {
 
-            UpdateLight(*frame_info.scene,
-                        point_light,
+            UpdateLight(point_light,
+                        (*shadow_query++)->GetIntersections(),
                         point_lights[point_lights_count],
                         point_shadows[point_lights_count],
                         frame_info.enable_global_illumination);
@@ -331,8 +406,8 @@ void DX11DeferredRendererLighting::UpdateShadowmaps(const vector<VolumeComponent
 
         for (auto&& directional_light : node->GetComponents<DirectionalLightComponent>()) {
 
-            UpdateLight(*frame_info.scene,
-                        directional_light,
+            UpdateLight(directional_light,
+                        (*shadow_query++)->GetIntersections(),
                         frame_info.aspect_ratio,
                         directional_lights[directional_lights_count],
                         directional_shadows[directional_lights_count],
@@ -353,7 +428,7 @@ void DX11DeferredRendererLighting::UpdateShadowmaps(const vector<VolumeComponent
 
 }
 
-void DX11DeferredRendererLighting::UpdateLight(const Scene& scene, const PointLightComponent& point_light, PointLight& light, PointShadow& shadow, bool light_injection) {
+void DX11DeferredRendererLighting::UpdateLight(const PointLightComponent& point_light, VolumeQueryBatch::IntersectionRange casters, PointLight& light, PointShadow& shadow, bool light_injection) {
 
     auto& graphics = DX11Graphics::GetInstance();
 
@@ -373,7 +448,7 @@ void DX11DeferredRendererLighting::UpdateLight(const Scene& scene, const PointLi
     ObjectPtr<IRenderTarget> shadow_map;
 
     shadow_atlas_->ComputeShadowmap(point_light, 
-                                    scene, 
+                                    casters,
                                     shadow,
                                     &shadow_map);
     
@@ -419,7 +494,7 @@ void DX11DeferredRendererLighting::UpdateLight(const Scene& scene, const PointLi
 
 }
 
-void DX11DeferredRendererLighting::UpdateLight(const Scene& scene, const DirectionalLightComponent& directional_light, float /*aspect_ratio*/, DirectionalLight& light, DirectionalShadow& shadow, bool light_injection) {
+void DX11DeferredRendererLighting::UpdateLight(const DirectionalLightComponent& directional_light, VolumeQueryBatch::IntersectionRange casters, float /*aspect_ratio*/, DirectionalLight& light, DirectionalShadow& shadow, bool light_injection) {
 
     /*auto& graphics = DX11Graphics::GetInstance();*/
 
@@ -435,7 +510,7 @@ void DX11DeferredRendererLighting::UpdateLight(const Scene& scene, const Directi
     ObjectPtr<IRenderTarget> shadow_map;
 
     shadow_atlas_->ComputeShadowmap(directional_light,
-                                    scene,
+                                    casters,
                                     shadow,
                                     &shadow_map);
 
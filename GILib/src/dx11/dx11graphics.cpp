@@ -21,6 +21,7 @@
 #include "exceptions.h"
 #include "resources.h"
 #include "instance_builder.h"
+#include "texture.h"
 #include "deferred_renderer.h"
 #include "scope_guard.h"
 
@@ -76,6 +77,15 @@ namespace{
 
 #endif
 
+	/// \brief Check whether a resource can be created by any thread.
+	/// The resource must touch the device only, never the immediate context nor any shared state.
+	bool IsFreeThreaded(const type_index& resource_type, const type_index& args_type){
+
+		return resource_type == type_index(typeid(ITexture2D)) &&
+			   args_type == type_index(typeid(ITexture2D::FromFile));
+
+	}
+
 	/// \brief Convert a DXGI sample desc to an antialiasing mode.
 	AntialiasingMode SampleDescToAntialiasingMode(const DXGI_SAMPLE_DESC & sample_desc){
 
@@ -476,6 +486,12 @@ DX11Resources& DX11Resources::GetInstance(){
 
 DX11Resources::DX11Resources(){}
 
+DX11Resources::~DX11Resources(){
+
+	// The instance is destroyed during static destruction, when joining the loaders may deadlock on the loader lock: the owner stops them before exiting.
+
+}
+
 ObjectPtr<IResource> DX11Resources::Load(const type_index& resource_type, const type_index& args_type, const void* args) const{
 
 	return static_cast<IResource*>(InstanceBuilder::Build(resource_type, 
@@ -484,6 +500,30 @@ ObjectPtr<IResource> DX11Resources::Load(const type_index& resource_type, const
 	
 }
 
+function<ObjectPtr<IResource>()> DX11Resources::PrepareLoad(const type_index& resource_type, const type_index& args_type, const void* args) const{
+
+	if (IsFreeThreaded(resource_type, args_type)){
+
+		// Create the whole resource here: the owning thread just picks it up.
+
+		auto resource = Load(resource_type,
+							 args_type,
+							 args);
+
+		return [resource](){
+
+			return resource;
+
+		};
+
+	}
+
+	return Resources::PrepareLoad(resource_type,
+								  args_type,
+								  args);
+
+}
+
 //////////////////////////////////// DX11 PIPELINE STATE //////////////////////////////////
 
 const DX11PipelineState DX11PipelineState::kDefault;
@@ -49,7 +49,60 @@ namespace{
 					 0.5f * (max_corner - min_corner) };
 
 	}
-	
+
+	/// \brief Read the content of a buffer back to system memory.
+	/// The buffer is copied to a staging buffer first, so it doesn't need to grant any CPU access.
+	/// \param buffer Buffer to read.
+	/// \param data Receives the content of the buffer.
+	void ReadBack(ID3D11Buffer& buffer, vector<char>& data){
+
+		auto& graphics = DX11Graphics::GetInstance();
+
+		auto& device = *graphics.GetDevice();
+
+		auto context = graphics.GetContext().GetImmediateContext();
+
+		D3D11_BUFFER_DESC buffer_desc;
+
+		buffer.GetDesc(&buffer_desc);
+
+		buffer_desc.Usage = D3D11_USAGE_STAGING;
+		buffer_desc.BindFlags = 0;
+		buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		buffer_desc.MiscFlags = 0;
+
+		ID3D11Buffer* staging_buffer;
+
+		THROW_ON_FAIL(device.CreateBuffer(&buffer_desc,
+										  nullptr,
+										  &staging_buffer));
+
+		COMPtr<ID3D11Buffer> staging;
+
+		staging << &staging_buffer;
+
+		context->CopyResource(staging.Get(), &buffer);
+
+		D3D11_MAPPED_SUBRESOURCE subresource;
+
+		THROW_ON_FAIL(context->Map(staging.Get(),
+								   0,
+								   D3D11_MAP_READ,
+								   0,
+								   &subresource));
+
+		data.resize(buffer_desc.ByteWidth);
+
+		memcpy_s(data.data(),
+				 data.size(),
+				 subresource.pData,
+				 buffer_desc.ByteWidth);
+
+		context->Unmap(staging.Get(),
+					   0);
+
+	}
+
 }
 
 ///////////////////////////// MESH ////////////////////////////////////////////////
@@ -273,6 +326,8 @@ void DX11Mesh::SetFlags(unsigned int subset_index, MeshFlags flags){
 	
 	flags_[subset_index] = flags;
 
+	UpdateGeometryCopy();
+
 }
 
 gi_lib::MeshFlags DX11Mesh::GetFlags() const{
@@ -294,4 +349,80 @@ void DX11Mesh::SetFlags(MeshFlags flags){
 			  flags_.end(),
 			  flags);
 
+	UpdateGeometryCopy();
+
+}
+
+void DX11Mesh::UpdateGeometryCopy(){
+
+	auto occluder = std::any_of(flags_.begin(),
+								flags_.end(),
+								[](MeshFlags flags) {
+
+									return flags && MeshFlags::kOccluder;
+
+								});
+
+	if (occluder && positions_.empty()){
+
+		// The copy is read back from the GPU: the bundle the mesh was created from is long gone by the time the flags are set.
+
+		vector<char> data;
+
+		ReadBack(*vertex_buffer_.Get(), data);
+
+		positions_.resize(vertex_count_);
+
+		for (size_t vertex_index = 0; vertex_index < vertex_count_; ++vertex_index){
+
+			// The position is the first member of every vertex format.
+
+			memcpy_s(&positions_[vertex_index],
+					 sizeof(Vector3f),
+					 &data[vertex_index * vertex_stride_],
+					 sizeof(Vector3f));
+
+		}
+
+		if (index_buffer_){
+
+			ReadBack(*index_buffer_.Get(), data);
+
+			indices_.resize(data.size() / sizeof(unsigned int));
+
+			memcpy_s(indices_.data(),
+					 indices_.size() * sizeof(unsigned int),
+					 data.data(),
+					 indices_.size() * sizeof(unsigned int));
+
+		}
+		else{
+
+			// Non-indexed meshes get one index per vertex.
+
+			indices_.resize(vertex_count_);
+
+			for (unsigned int index = 0; index < indices_.size(); ++index){
+
+				indices_[index] = index;
+
+			}
+
+		}
+
+		MemoryAccounting::Refresh(*this);		// The copy counts towards the size of the mesh
+
+	}
+	else if (!occluder && !positions_.empty()){
+
+		// Release the memory as well
+
+		vector<Vector3f>().swap(positions_);
+
+		vector<unsigned int>().swap(indices_);
+
+		MemoryAccounting::Refresh(*this);
+
+	}
+
 }
@@ -18,6 +18,9 @@ using namespace ::dx11;
 
 namespace {
 	
+	/// \brief Region of space containing the geometry casting directional shadows.
+	const Sphere kDirectionalShadowDomain{ Vector3f::Zero(), 15000.f };
+
 	/// \brief Vertex shader constant buffer used to draw the geometry from the light perspective.
 	struct VSMPerObjectCBuffer {
 
@@ -211,7 +214,7 @@ namespace {
 	/// \param volumes Volumes collection to cycle through
 	/// \param direction Depth direction.
 	/// \return Returns a 2-element vector where the first element is the minimum depth found and the second is the maximum one.
-	Vector2f GetZRange(const vector<VolumeComponent*>& volumes, const Vector3f& direction) {
+	Vector2f GetZRange(VolumeQueryBatch::IntersectionRange volumes, const Vector3f& direction) {
 
 		Vector2f range(std::numeric_limits<float>::infinity(),			// Min
 					   -std::numeric_limits<float>::infinity());		// Max
@@ -381,7 +384,19 @@ void DX11VSMAtlas::Reset() {
 
 }
 
-bool DX11VSMAtlas::ComputeShadowmap(const PointLightComponent& point_light, const Scene& scene, PointShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map) {
+Sphere DX11VSMAtlas::GetCasterDomain(const PointLightComponent& point_light) const {
+
+	return point_light.GetBoundingSphere();
+
+}
+
+Sphere DX11VSMAtlas::GetCasterDomain(const DirectionalLightComponent& /*directional_light*/) const {
+
+	return kDirectionalShadowDomain;
+
+}
+
+bool DX11VSMAtlas::ComputeShadowmap(const PointLightComponent& point_light, VolumeQueryBatch::IntersectionRange casters, PointShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map) {
 
 	if (!point_light.IsShadowEnabled() ||
 		!ReserveChunk(point_light.GetShadowMapSize(),
@@ -418,7 +433,7 @@ bool DX11VSMAtlas::ComputeShadowmap(const PointLightComponent& point_light, cons
 	// Draw the actual shadowmap
 
 	DrawShadowmap(shadow,
-				  scene.GetMeshHierarchy().GetIntersections(point_light.GetBoundingSphere()),
+				  casters,
 				  light_transform,
 				  shadow_map);
 		
@@ -426,7 +441,7 @@ bool DX11VSMAtlas::ComputeShadowmap(const PointLightComponent& point_light, cons
 
 }
 
-bool DX11VSMAtlas::ComputeShadowmap(const DirectionalLightComponent& directional_light, const Scene& scene, DirectionalShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map) {
+bool DX11VSMAtlas::ComputeShadowmap(const DirectionalLightComponent& directional_light, VolumeQueryBatch::IntersectionRange casters, DirectionalShadow& shadow, ObjectPtr<IRenderTarget>* shadow_map) {
 		
 	if (!directional_light.IsShadowEnabled() ||
 		!ReserveChunk(directional_light.GetShadowMapSize(),
@@ -443,9 +458,7 @@ bool DX11VSMAtlas::ComputeShadowmap(const DirectionalLightComponent& directional
 
 	Vector2f ortho_size(10000.f, 10000.f);
 
-	Sphere domain{ Vector3f::Zero(), 15000.f };
-
-	auto lit_geometry = scene.GetMeshHierarchy().GetIntersections(domain);
+	auto& lit_geometry = casters;
 
 	auto z_range = GetZRange(lit_geometry,
 							 directional_light.GetDirection());
@@ -474,7 +487,7 @@ bool DX11VSMAtlas::ComputeShadowmap(const DirectionalLightComponent& directional
 
 }
 
-void DX11VSMAtlas::DrawShadowmap(const PointShadow& shadow, const vector<VolumeComponent*>& nodes, const Matrix4f& light_view_transform, ObjectPtr<IRenderTarget>* shadow_map){
+void DX11VSMAtlas::DrawShadowmap(const PointShadow& shadow, VolumeQueryBatch::IntersectionRange nodes, const Matrix4f& light_view_transform, ObjectPtr<IRenderTarget>* shadow_map){
 
 	// Per-light setup
 
@@ -501,7 +514,7 @@ void DX11VSMAtlas::DrawShadowmap(const PointShadow& shadow, const vector<VolumeC
 	
 }
 
-void DX11VSMAtlas::DrawShadowmap(const DirectionalShadow& shadow, const vector<VolumeComponent*>& nodes, const Matrix4f& light_proj_transform, ObjectPtr<IRenderTarget>* shadow_map) {
+void DX11VSMAtlas::DrawShadowmap(const DirectionalShadow& shadow, VolumeQueryBatch::IntersectionRange nodes, const Matrix4f& light_proj_transform, ObjectPtr<IRenderTarget>* shadow_map) {
 	
 	// Draw the geometry to the shadowmap
 
@@ -519,7 +532,7 @@ void DX11VSMAtlas::DrawShadowmap(const DirectionalShadow& shadow, const vector<V
 
 }
 
-void DX11VSMAtlas::DrawShadowmap(const AlignedBox2i& boundaries, unsigned int /*atlas_page*/, const vector<VolumeComponent*> nodes, const ObjectPtr<DX11Material>& shadow_material, const Matrix4f& light_transform, ObjectPtr<IRenderTarget>* out_shadow_map, bool tessellable) {
+void DX11VSMAtlas::DrawShadowmap(const AlignedBox2i& boundaries, unsigned int /*atlas_page*/, VolumeQueryBatch::IntersectionRange nodes, const ObjectPtr<DX11Material>& shadow_material, const Matrix4f& light_transform, ObjectPtr<IRenderTarget>* out_shadow_map, bool tessellable) {
 
 	auto& graphics_ = DX11Graphics::GetInstance();
 
@@ -712,7 +712,16 @@ float DX11Voxelization::GetGridSize() const {
 
 }
 
-void DX11Voxelization::Update(const FrameInfo& frame_info) {
+AABB DX11Voxelization::GetGridDomain(const FrameInfo& frame_info) const {
+
+    Vector3f grid_center = frame_info.camera->GetWorldTransform().translation();		// Center of the voxelization
+
+    return AABB{ grid_center, 
+                 Vector3f::Ones() * GetGridSize() * 0.5f };
+
+}
+
+void DX11Voxelization::Update(const FrameInfo& frame_info, VolumeQueryBatch::IntersectionRange nodes) {
     
     ObjectPtr<DX11Mesh> mesh;
 
@@ -736,16 +745,9 @@ void DX11Voxelization::Update(const FrameInfo& frame_info) {
 
     // Voxelize the nodes inside the voxelization domain grid
     
-    Vector3f grid_center = frame_info.camera->GetWorldTransform().translation();		// Center of the voxelization
-
-    cb_voxelization_->Lock<CBVoxelization>()->center_ = grid_center;
+    cb_voxelization_->Lock<CBVoxelization>()->center_ = GetGridDomain(frame_info).center;
 
     cb_voxelization_->Unlock();
-
-    AABB grid_domain{ grid_center, 
-                      Vector3f::Ones() * GetGridSize() * 0.5f };
-    
-    vector<VolumeComponent*> nodes = frame_info.scene->GetMeshHierarchy().GetIntersections(grid_domain);
     
     graphics.PushEvent(L"Geometry");
 
@@ -116,11 +116,7 @@ void FlyCameraComponent::Update(const Time& time){
 
 FlyCameraComponent::TypeSet FlyCameraComponent::GetTypes() const{
 
-    auto types = Component::GetTypes();
-
-    types.insert(type_index(typeid(FlyCameraComponent)));
-
-    return types;
+    return DeriveTypes<FlyCameraComponent>(Component::GetTypes());
 
 }
 
@@ -2,11 +2,108 @@
 
 #include <math.h>
 
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+#elif defined(_M_X64) || defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
 #include "exceptions.h"
 
 using namespace ::gi_lib;
 using namespace ::Eigen;
 
+namespace{
+
+	// SIMD lanes used by the stream culling kernels. Where no SIMD instruction set is available only the scalar path is compiled.
+
+#if defined(__AVX__)
+
+	#define GI_SIMD_CULLING
+
+	const size_t kLanes = 8;
+
+	typedef __m256 Lane;
+
+	inline Lane Load(const float* address){ return _mm256_loadu_ps(address); }
+
+	inline Lane Splat(float value){ return _mm256_set1_ps(value); }
+
+	inline Lane Add(Lane left, Lane right){ return _mm256_add_ps(left, right); }
+
+	inline Lane Sub(Lane left, Lane right){ return _mm256_sub_ps(left, right); }
+
+	inline Lane Mul(Lane left, Lane right){ return _mm256_mul_ps(left, right); }
+
+	inline Lane Or(Lane left, Lane right){ return _mm256_or_ps(left, right); }
+
+	inline Lane Zero(){ return _mm256_setzero_ps(); }
+
+	inline Lane And(Lane left, Lane right){ return _mm256_and_ps(left, right); }
+
+	inline Lane AllSet(){ return _mm256_cmp_ps(_mm256_setzero_ps(), _mm256_setzero_ps(), _CMP_EQ_OQ); }
+
+	inline Lane Less(Lane left, Lane right){ return _mm256_cmp_ps(left, right, _CMP_LT_OQ); }
+
+	inline Lane GreaterEqual(Lane left, Lane right){ return _mm256_cmp_ps(left, right, _CMP_GE_OQ); }
+
+	inline unsigned int MoveMask(Lane mask){ return static_cast<unsigned int>(_mm256_movemask_ps(mask)); }
+
+#elif defined(_M_X64) || defined(__SSE2__)
+
+	#define GI_SIMD_CULLING
+
+	const size_t kLanes = 4;
+
+	typedef __m128 Lane;
+
+	inline Lane Load(const float* address){ return _mm_loadu_ps(address); }
+
+	inline Lane Splat(float value){ return _mm_set1_ps(value); }
+
+	inline Lane Add(Lane left, Lane right){ return _mm_add_ps(left, right); }
+
+	inline Lane Sub(Lane left, Lane right){ return _mm_sub_ps(left, right); }
+
+	inline Lane Mul(Lane left, Lane right){ return _mm_mul_ps(left, right); }
+
+	inline Lane Or(Lane left, Lane right){ return _mm_or_ps(left, right); }
+
+	inline Lane Zero(){ return _mm_setzero_ps(); }
+
+	inline Lane And(Lane left, Lane right){ return _mm_and_ps(left, right); }
+
+	inline Lane AllSet(){ return _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); }
+
+	inline Lane Less(Lane left, Lane right){ return _mm_cmplt_ps(left, right); }
+
+	inline Lane GreaterEqual(Lane left, Lane right){ return _mm_cmpge_ps(left, right); }
+
+	inline unsigned int MoveMask(Lane mask){ return static_cast<unsigned int>(_mm_movemask_ps(mask)); }
+
+#endif
+
+	/// \brief Set the visibility bit of an element.
+	inline void SetVisible(unsigned int* visibility, size_t index){
+
+		visibility[index >> 5] |= 1u << (index & 31);
+
+	}
+
+	/// \brief Set the visibility bits of a block of elements, given the bitmask of the elements to exclude.
+	/// \remarks The index of the first element of the block must be a multiple of the block size.
+	inline void SetVisible(unsigned int* visibility, size_t index, unsigned int excluded, unsigned int block_mask){
+
+		visibility[index >> 5] |= (~excluded & block_mask) << (index & 31);
+
+	}
+
+}
+
 float Math::kPi = 3.1415926f;
 
 float Math::kDegToRad = Math::kPi / 180.0f;
@@ -178,6 +275,18 @@ IntersectionType Sphere::Intersect(const AABB& box) const {
 
 ///////////////////////////////////////// FRUSTUM /////////////////////////////////////////
 
+Frustum::Frustum(){
+
+	for (size_t plane_index = 0; plane_index < kFrustumPlanes; ++plane_index){
+
+		planes_[plane_index] = Vector4f(0.0f, 0.0f, 0.0f, -1.0f);		// Every point lies behind the plane
+
+		abs_normals_[plane_index] = Vector3f::Zero();
+
+	}
+
+}
+
 Frustum::Frustum(const vector<Vector4f>& planes){
 
 	if (planes.size() != 6){
@@ -200,46 +309,498 @@ Frustum::Frustum(const vector<Vector4f>& planes){
 	
 }
 
+const Vector4f& Frustum::GetPlane(size_t index) const{
+
+	return planes_[index];
+
+}
+
+Frustum Frustum::Inflate(float distance) const{
+
+	Frustum inflated(*this);
+
+	for (size_t plane_index = 0; plane_index < kFrustumPlanes; ++plane_index){
+
+		inflated.planes_[plane_index](3) += distance;
+
+	}
+
+	return inflated;
+
+}
+
 IntersectionType Frustum::Intersect(const AABB& bounds) const{
 
+	auto plane_mask = kAllPlanes;
+
+	return Intersect(bounds, plane_mask);
+
+}
+
+IntersectionType Frustum::Intersect(const AABB& bounds, unsigned int& plane_mask) const{
+
 	/// Theory on: https://fgiesen.wordpress.com/2010/10/17/view-frustum-culling/
 	/// Method 5 with a small tweak: the w component is kept within the plane and the dot product will multiply it by 1.
 
-	int plane_index = 0;
-
 	auto hcenter = Math::ToHomogeneous(bounds.center);	// Needed to compute the distance as a dot product between two 4-elements vectors.
 	
-	for (auto& plane : planes_){
+	for (size_t plane_index = 0; plane_index < kFrustumPlanes; ++plane_index){
+
+		if ((plane_mask & (1u << plane_index)) == 0){
+
+			continue;								// The plane already contains the box
+
+		}
+
+		auto distance = planes_[plane_index].dot(hcenter);
+
+		auto radius = bounds.half_extents.dot(abs_normals_[plane_index]);
 
-		if (plane.dot(hcenter) < -bounds.half_extents.dot(abs_normals_[plane_index])){
+		if (distance < -radius){
 
 			return IntersectionType::kNone;			// Outside the plane
 
 		}
-		
-		++plane_index;
+
+		if (distance >= radius){
+
+			plane_mask &= ~(1u << plane_index);		// Fully inside the plane
+
+		}
 
 	}
 
-	return IntersectionType::kIntersect;	// Intersection
+	return plane_mask == 0 ?
+		   IntersectionType::kInside | IntersectionType::kIntersect :		// Count as intersection
+		   IntersectionType::kIntersect;
 
 }
 
 IntersectionType Frustum::Intersect(const Sphere& sphere) const{
 
+	auto plane_mask = kAllPlanes;
+
+	return Intersect(sphere, plane_mask);
+
+}
+
+IntersectionType Frustum::Intersect(const Sphere& sphere, unsigned int& plane_mask) const{
+
 	auto hcenter = Math::ToHomogeneous(sphere.center);	// Needed to compute the distance as a dot product between two 4-elements vectors.
 
-	for (auto& plane : planes_){
+	for (size_t plane_index = 0; plane_index < kFrustumPlanes; ++plane_index){
+
+		if ((plane_mask & (1u << plane_index)) == 0){
 
-		if (plane.dot(hcenter) < -sphere.radius ){
+			continue;								// The plane already contains the sphere
+
+		}
+
+		auto distance = planes_[plane_index].dot(hcenter);
+
+		if (distance < -sphere.radius){
 
 			return IntersectionType::kNone;			// Outside the plane
 
 		}
 
+		if (distance >= sphere.radius){
+
+			plane_mask &= ~(1u << plane_index);		// Fully inside the plane
+
+		}
+
+	}
+
+	return plane_mask == 0 ?
+		   IntersectionType::kInside | IntersectionType::kIntersect :		// Count as intersection
+		   IntersectionType::kIntersect;
+
+}
+
+void Frustum::Intersect(const AABBStream& aabbs, vector<unsigned int>& visibility) const{
+
+	vector<unsigned int> containment;
+
+	Intersect(aabbs, kAllPlanes, visibility, containment);
+
+}
+
+void Frustum::Intersect(const AABBStream& aabbs, unsigned int plane_mask, vector<unsigned int>& visibility, vector<unsigned int>& containment) const{
+
+	auto words = (aabbs.GetSize() + 31) >> 5;
+
+	visibility.resize(words);
+	containment.resize(words);
+
+	Intersect(aabbs, 0, aabbs.GetSize(), plane_mask, visibility.data(), containment.data());
+
+}
+
+void Frustum::Intersect(const AABBStream& aabbs, size_t begin, size_t end, unsigned int plane_mask, unsigned int* visibility, unsigned int* containment) const{
+
+	auto size = end - begin;
+
+	std::fill(visibility, visibility + ((size + 31) >> 5), 0u);
+	std::fill(containment, containment + ((size + 31) >> 5), 0u);
+
+	auto cx = aabbs.center_[0].data() + begin;
+	auto cy = aabbs.center_[1].data() + begin;
+	auto cz = aabbs.center_[2].data() + begin;
+
+	auto ex = aabbs.half_extents_[0].data() + begin;
+	auto ey = aabbs.half_extents_[1].data() + begin;
+	auto ez = aabbs.half_extents_[2].data() + begin;
+
+	size_t index = 0;
+
+#ifdef GI_SIMD_CULLING
+
+	// Same test of the scalar version: a box is outside when center distance + projected radius < 0 for any plane,
+	// and it is inside a plane when center distance - projected radius >= 0. NaNs (unbounded boxes) are never inside.
+
+	size_t planes[kFrustumPlanes];
+
+	size_t plane_count = 0;
+
+	for (size_t plane_index = 0; plane_index < kFrustumPlanes; ++plane_index){
+
+		if (plane_mask & (1u << plane_index)){
+
+			planes[plane_count++] = plane_index;
+
+		}
+
+	}
+
+	const unsigned int block_mask = (1u << kLanes) - 1u;
+
+	for (; index + kLanes <= size; index += kLanes){
+
+		auto center_x = Load(cx + index);
+		auto center_y = Load(cy + index);
+		auto center_z = Load(cz + index);
+
+		auto extent_x = Load(ex + index);
+		auto extent_y = Load(ey + index);
+		auto extent_z = Load(ez + index);
+
+		auto outside = Zero();
+		auto inside = AllSet();
+
+		for (size_t plane_index = 0; plane_index < plane_count; ++plane_index){
+
+			auto& plane = planes_[planes[plane_index]];
+			auto& abs_normal = abs_normals_[planes[plane_index]];
+
+			auto distance = Add(Add(Mul(Splat(plane(0)), center_x),
+									Mul(Splat(plane(1)), center_y)),
+								Add(Mul(Splat(plane(2)), center_z),
+									Splat(plane(3))));
+
+			auto radius = Add(Add(Mul(Splat(abs_normal(0)), extent_x),
+								  Mul(Splat(abs_normal(1)), extent_y)),
+							  Mul(Splat(abs_normal(2)), extent_z));
+
+			outside = Or(outside,
+						 Less(Add(distance, radius), Zero()));
+
+			inside = And(inside,
+						 GreaterEqual(Sub(distance, radius), Zero()));
+
+		}
+
+		auto outside_bits = MoveMask(outside);
+
+		SetVisible(visibility, index, outside_bits, block_mask);
+		SetVisible(containment, index, outside_bits | ~MoveMask(inside), block_mask);
+
+	}
+
+#endif
+
+	for (; index < size; ++index){
+
+		auto box_mask = plane_mask;
+
+		auto intersection = Intersect(aabbs.Get(begin + index), box_mask);
+
+		if (intersection && IntersectionType::kIntersect){
+
+			SetVisible(visibility, index);
+
+		}
+
+		if (intersection && IntersectionType::kInside){
+
+			SetVisible(containment, index);
+
+		}
+
+	}
+
+}
+
+void Frustum::Intersect(const SphereStream& spheres, vector<unsigned int>& visibility) const{
+
+	vector<unsigned int> containment;
+
+	Intersect(spheres, kAllPlanes, visibility, containment);
+
+}
+
+void Frustum::Intersect(const SphereStream& spheres, unsigned int plane_mask, vector<unsigned int>& visibility, vector<unsigned int>& containment) const{
+
+	auto words = (spheres.GetSize() + 31) >> 5;
+
+	visibility.resize(words);
+	containment.resize(words);
+
+	Intersect(spheres, 0, spheres.GetSize(), plane_mask, visibility.data(), containment.data());
+
+}
+
+void Frustum::Intersect(const SphereStream& spheres, size_t begin, size_t end, unsigned int plane_mask, unsigned int* visibility, unsigned int* containment) const{
+
+	auto size = end - begin;
+
+	std::fill(visibility, visibility + ((size + 31) >> 5), 0u);
+	std::fill(containment, containment + ((size + 31) >> 5), 0u);
+
+	auto cx = spheres.center_[0].data() + begin;
+	auto cy = spheres.center_[1].data() + begin;
+	auto cz = spheres.center_[2].data() + begin;
+
+	auto r = spheres.radius_.data() + begin;
+
+	size_t index = 0;
+
+#ifdef GI_SIMD_CULLING
+
+	size_t planes[kFrustumPlanes];
+
+	size_t plane_count = 0;
+
+	for (size_t plane_index = 0; plane_index < kFrustumPlanes; ++plane_index){
+
+		if (plane_mask & (1u << plane_index)){
+
+			planes[plane_count++] = plane_index;
+
+		}
+
+	}
+
+	const unsigned int block_mask = (1u << kLanes) - 1u;
+
+	for (; index + kLanes <= size; index += kLanes){
+
+		auto center_x = Load(cx + index);
+		auto center_y = Load(cy + index);
+		auto center_z = Load(cz + index);
+
+		auto radius = Load(r + index);
+
+		auto outside = Zero();
+		auto inside = AllSet();
+
+		for (size_t plane_index = 0; plane_index < plane_count; ++plane_index){
+
+			auto& plane = planes_[planes[plane_index]];
+
+			auto distance = Add(Add(Mul(Splat(plane(0)), center_x),
+									Mul(Splat(plane(1)), center_y)),
+								Add(Mul(Splat(plane(2)), center_z),
+									Splat(plane(3))));
+
+			outside = Or(outside,
+						 Less(Add(distance, radius), Zero()));
+
+			inside = And(inside,
+						 GreaterEqual(Sub(distance, radius), Zero()));
+
+		}
+
+		auto outside_bits = MoveMask(outside);
+
+		SetVisible(visibility, index, outside_bits, block_mask);
+		SetVisible(containment, index, outside_bits | ~MoveMask(inside), block_mask);
+
+	}
+
+#endif
+
+	for (; index < size; ++index){
+
+		auto sphere_mask = plane_mask;
+
+		auto intersection = Intersect(spheres.Get(begin + index), sphere_mask);
+
+		if (intersection && IntersectionType::kIntersect){
+
+			SetVisible(visibility, index);
+
+		}
+
+		if (intersection && IntersectionType::kInside){
+
+			SetVisible(containment, index);
+
+		}
+
+	}
+
+}
+
+///////////////////////////////////////// AABB STREAM /////////////////////////////////////////
+
+size_t AABBStream::GetSize() const{
+
+	return center_[0].size();
+
+}
+
+AABB AABBStream::Get(size_t index) const{
+
+	return AABB{ Vector3f(center_[0][index], center_[1][index], center_[2][index]),
+				 Vector3f(half_extents_[0][index], half_extents_[1][index], half_extents_[2][index]) };
+
+}
+
+void AABBStream::Set(size_t index, const AABB& aabb){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis][index] = aabb.center(axis);
+		half_extents_[axis][index] = aabb.half_extents(axis);
+
+	}
+
+}
+
+void AABBStream::PushBack(const AABB& aabb){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis].push_back(aabb.center(axis));
+		half_extents_[axis].push_back(aabb.half_extents(axis));
+
+	}
+
+}
+
+void AABBStream::SwapPop(size_t index){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis][index] = center_[axis].back();
+		half_extents_[axis][index] = half_extents_[axis].back();
+
+		center_[axis].pop_back();
+		half_extents_[axis].pop_back();
+
+	}
+
+}
+
+void AABBStream::Erase(size_t index){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis].erase(center_[axis].begin() + index);
+		half_extents_[axis].erase(half_extents_[axis].begin() + index);
+
+	}
+
+}
+
+void AABBStream::Clear(){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis].clear();
+		half_extents_[axis].clear();
+
+	}
+
+}
+
+///////////////////////////////////////// SPHERE STREAM /////////////////////////////////////////
+
+size_t SphereStream::GetSize() const{
+
+	return radius_.size();
+
+}
+
+Sphere SphereStream::Get(size_t index) const{
+
+	return Sphere{ Vector3f(center_[0][index], center_[1][index], center_[2][index]),
+				   radius_[index] };
+
+}
+
+void SphereStream::Set(size_t index, const Sphere& sphere){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis][index] = sphere.center(axis);
+
+	}
+
+	radius_[index] = sphere.radius;
+
+}
+
+void SphereStream::PushBack(const Sphere& sphere){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis].push_back(sphere.center(axis));
+
+	}
+
+	radius_.push_back(sphere.radius);
+
+}
+
+void SphereStream::SwapPop(size_t index){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis][index] = center_[axis].back();
+
+		center_[axis].pop_back();
+
+	}
+
+	radius_[index] = radius_.back();
+
+	radius_.pop_back();
+
+}
+
+void SphereStream::Erase(size_t index){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis].erase(center_[axis].begin() + index);
+
+	}
+
+	radius_.erase(radius_.begin() + index);
+
+}
+
+void SphereStream::Clear(){
+
+	for (int axis = 0; axis < 3; ++axis){
+
+		center_[axis].clear();
+
 	}
 
-	return IntersectionType::kIntersect;
+	radius_.clear();
 
 }
 
@@ -1,12 +1,17 @@
 #include "graphics.h"
 
-#include <numeric>
-#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <list>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 #include "exceptions.h"
 #include "core.h"
 #include "resources.h"
-#include "range.h"
 
 #include "dx11/dx11graphics.h"
 
@@ -39,24 +44,99 @@ namespace{
 			args_id_(args_id),
 			cache_key_(cache_key){}
 
-		/// \brief Lesser comparison operator needed by the cache.
-		bool operator<(const ResourceCacheKey& other) const{
+		/// \brief Equality operator needed by the cache.
+		bool operator==(const ResourceCacheKey& other) const{
 
-			return memcmp(this,
-						  &other,
-						  sizeof(ResourceCacheKey)) < 0;
+			return resource_id_ == other.resource_id_ &&
+				   args_id_ == other.args_id_ &&
+				   cache_key_ == other.cache_key_;
 
 		}
 
 	};
 
-	/// \brief The resource cached simply maps a cache key to the proper resource.
+	/// \brief Hash function of the cache keys.
+	struct ResourceCacheKeyHash{
+
+		size_t operator()(const ResourceCacheKey& key) const{
+
+			// The cache key is a hash already: the type indices only separate equal arguments used for different resources.
+
+			auto hash = key.cache_key_;
+
+			hash ^= key.resource_id_.hash_code() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+			hash ^= key.args_id_.hash_code() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+			return hash;
+
+		}
+
+	};
+
+	/// \brief Resource kept alive by the cache after being used.
+	struct RetainedResource{
+
+		ResourceCacheKey key;					///< \brief Key of the resource inside the cache.
+
+		ObjectPtr<IResource> resource;			///< \brief Strong reference keeping the resource alive.
+
+		size_t size;							///< \brief Size charged to the retention budget, in bytes. Never smaller than the entry itself.
+
+	};
+
+	/// \brief List of the retained resources, sorted from the most recently used to the least recently used one.
+	using RetentionList = list < RetainedResource >;
+
+	/// \brief Entry of the resource cache.
+	struct ResourceCacheEntry{
+
+		ObjectWeakPtr<IResource> resource;		///< \brief Cached resource.
+
+		RetentionList::iterator retention;		///< \brief Position of the resource inside the retention list. End of the list if the resource is not retained.
+
+	};
+
+	/// \brief The resource cache maps a cache key to the proper resource.
 	/// \brief A cached resource is a weak smart pointer. If there's at least one pointer alive, the cached resource will be alive as well.
 	/// The cached resource is invalidated when the last pointer is destroyed.
-	using ResourceCache = map < const ResourceCacheKey, ObjectWeakPtr < IResource > >;
+	using ResourceCache = unordered_map < ResourceCacheKey, ResourceCacheEntry, ResourceCacheKeyHash >;
 
-	/// \brief List of the loaded resources.
-	using ResourceList = vector < ObjectWeakPtr < IResource > >;
+	/// \brief Minimum number of cache entries before the expired ones are purged.
+	const size_t kMinimumPurgeThreshold = 64;
+
+	/// \brief Asynchronous load which was not completed yet. Owned by the thread owning the resources.
+	struct InFlightLoad{
+
+		shared_ptr<AsyncLoad> load;						///< \brief State shared with the handles.
+
+		ResourceCacheKey key;							///< \brief Key of the resource inside the cache. Meaningful for cached loads only.
+
+		bool cached;									///< \brief Whether the resource has to be stored inside the cache.
+
+		shared_ptr<const void> args;					///< \brief Load arguments. Kept alive until the load is completed.
+
+	};
+
+	/// \brief Asynchronous load waiting for a worker thread.
+	struct PendingLoad{
+
+		size_t ticket;														///< \brief Identifies the load among the ones in flight.
+
+		function<function<ObjectPtr<IResource>()>()> prepare;				///< \brief Runs the part of the load executed by the worker.
+
+	};
+
+	/// \brief Asynchronous load prepared by a worker thread and waiting to be completed.
+	struct PreparedLoad{
+
+		size_t ticket;										///< \brief Identifies the load among the ones in flight.
+
+		function<ObjectPtr<IResource>()> complete;			///< \brief Completes the load on the thread owning the resources.
+
+		exception_ptr error;								///< \brief Exception thrown by the worker, if any.
+
+	};
 
 }
 
@@ -71,12 +151,15 @@ const Color gi_lib::kTransparentBlack = Color(0.0f, 0.0f, 0.0f, 0.0f);
 //////////////////////// RESOURCES :: IMPL //////////////////////////////
 
 /// \brief Private implementation of the Resources class.
-/// Cached resources are stored with two weak pointers (one for the cache and one for the resource list).
-/// Resource requiring no cache are stored with only one weak pointer (for the resource list).
+/// Cached resources are stored with a weak pointer, resources requiring no cache are not stored at all: both are accounted by MemoryAccounting.
+/// The most recently used cached resources are also kept alive by the retention list, as long as their overall size fits inside the retention budget.
+/// Asynchronous loads are prepared by a pool of loader threads, created along with the first load, and completed by the thread owning the resources.
 struct Resources::Impl{
 
 	Impl(Resources& subject);
 
+	~Impl();
+
 	Impl& operator=(const Impl&) = delete;
 
 	/// \brief Fetch a resource from cache.
@@ -87,9 +170,12 @@ struct Resources::Impl{
 
 		if (it != resource_cache_.end()){
 
-			if (auto resource = it->second.Lock()){
+			if (auto resource = it->second.resource.Lock()){
 
 				// The resource was found and is still valid.
+
+				Retain(cache_key, it->second, resource);
+
 				return resource;
 
 			}
@@ -104,58 +190,488 @@ struct Resources::Impl{
 
 	}
 
-	/// \brief Get the loaded resources
-	Range<ResourceList::const_iterator> GetResources() const{
+	/// \brief Store a cached resource.
+	void StoreResource(const ResourceCacheKey& cache_key, const ObjectPtr<IResource>& resource){
+
+		auto& entry = resource_cache_[cache_key];
+
+		entry.resource = resource;								// Cache.
+
+		entry.retention = retention_list_.end();
+
+		Retain(cache_key, entry, resource);
+
+		StoreResource(resource);
+
+		if (resource_cache_.size() >= purge_threshold_){
+
+			// Amortized: the threshold grows along with the live entries.
+
+			EvictInvalidResources();
+
+			purge_threshold_ = std::max(kMinimumPurgeThreshold,
+										2 * resource_cache_.size());
+
+		}
+
+	}
+
+	/// \brief Store a resource.
+	void StoreResource(const ObjectPtr<IResource>& resource){
+
+		MemoryAccounting::Add(*resource);
+
+	}
 
-		EvictInvalidResources();
+	/// \brief Set the retention budget and evict the least recently used resources exceeding it.
+	void SetRetentionBudget(size_t budget){
 
-		return Range<ResourceList::const_iterator>(resource_list_.cbegin(),
-												   resource_list_.cend());
+		retention_budget_ = budget;
+
+		EvictRetainedResources();
 
 	}
-	
-	/// \brief Store a cached resource.
-	void StoreResource(const ResourceCacheKey& cache_key, ObjectWeakPtr<IResource> resource){
 
-		resource_cache_[cache_key] = resource;		// Cache.
+	/// \brief Get the retention budget, in bytes.
+	size_t GetRetentionBudget() const{
 
-		StoreResource(resource);					// Resource list.
+		return retention_budget_;
 
 	}
 
-	/// \brief Store a resource.
-	void StoreResource(ObjectWeakPtr<IResource> resource){
+	/// \brief Get the size of the retained resources, in bytes.
+	size_t GetRetainedSize() const{
+
+		return retained_size_;
+
+	}
+
+	/// \brief Fetch a cached resource which is being loaded asynchronously.
+	/// \return Returns the state of the load if any, returns nullptr otherwise.
+	shared_ptr<AsyncLoad> FetchFromPendingLoads(const ResourceCacheKey& cache_key) const{
+
+		auto it = pending_cache_.find(cache_key);
+
+		return (it != pending_cache_.end()) ?
+			   it->second :
+			   nullptr;
+
+	}
+
+	/// \brief Hand an asynchronous load to the loader threads.
+	/// \param in_flight Load to start.
+	/// \param prepare Functor run by a loader thread, returning the functor which completes the load.
+	void StartLoad(InFlightLoad in_flight, function<function<ObjectPtr<IResource>()>()> prepare){
+
+		if (loaders_.empty()){
+
+			StartLoaders();
+
+		}
+
+		auto ticket = next_ticket_++;
+
+		if (in_flight.cached){
+
+			pending_cache_[in_flight.key] = in_flight.load;			// Later requests of the same resource will share the load.
+
+		}
+
+		in_flight_.insert(make_pair(ticket, std::move(in_flight)));
+
+		{
+			lock_guard<mutex> lock(mutex_);
+
+			pending_loads_.push_back(PendingLoad{ ticket, std::move(prepare) });
+
+		}
 
-		resource_list_.push_back(resource);			// Resource list.
+		load_pending_.notify_one();
+
+	}
+
+	/// \brief Complete the loads prepared by the loader threads.
+	/// \param flush Whether to wait for every load in flight.
+	void CompleteLoads(bool flush){
+
+		exception_ptr error;
+
+		do{
+
+			vector<PreparedLoad> prepared_loads;
+
+			{
+				unique_lock<mutex> lock(mutex_);
+
+				if (flush){
+
+					load_prepared_.wait(lock,
+										[this](){
+
+											return !prepared_loads_.empty() || in_flight_.empty();
+
+										});
+
+				}
+
+				prepared_loads.swap(prepared_loads_);
+
+			}
+
+			for (auto&& prepared_load : prepared_loads){
+
+				try{
+
+					CompleteLoad(prepared_load);
+
+				}
+				catch (...){
+
+					if (!error){
+
+						error = current_exception();	// Other loads are completed anyway
+
+					}
+
+				}
+
+			}
+
+		} while (flush && !in_flight_.empty());
+
+		if (error){
+
+			rethrow_exception(error);
+
+		}
+
+	}
+
+	/// \brief Get the number of asynchronous loads in flight.
+	size_t GetPendingCount() const{
+
+		return in_flight_.size();
+
+	}
+
+	/// \brief Stop the loader threads. Loads which were not prepared yet fail and are completed by the next Update or Flush.
+	void StopLoaders(){
+
+		{
+			lock_guard<mutex> lock(mutex_);
+
+			stop_ = true;
+
+			// Discarded loads are still in flight: hand them back as failed so that their handles resolve.
+
+			for (auto&& pending_load : pending_loads_){
+
+				prepared_loads_.push_back(PreparedLoad{ pending_load.ticket,
+														[](){ return ObjectPtr<IResource>(); } });
+
+			}
+
+			pending_loads_.clear();
+
+		}
+
+		load_pending_.notify_all();
+
+		load_prepared_.notify_all();
+
+		for (auto&& loader : loaders_){
+
+			loader.join();
+
+		}
+
+		loaders_.clear();
 
 	}
 
 private:
 
-	/// \brief Removes the invalid resources from the resource list and cache.
-	void EvictInvalidResources() const{
+	/// \brief Create the loader threads.
+	void StartLoaders(){
+
+		{
+			lock_guard<mutex> lock(mutex_);
+
+			stop_ = false;			// The loaders may have been stopped before.
+
+		}
+
+		// Leave one core to the owning thread.
+
+		auto thread_count = thread::hardware_concurrency();
+
+		thread_count = (thread_count > 1) ? thread_count - 1 : 1;
+
+		for (unsigned int thread_index = 0; thread_index < thread_count; ++thread_index){
+
+			loaders_.emplace_back(&Impl::RunLoader, this);
+
+		}
+
+	}
+
+	/// \brief Body of each loader thread.
+	void RunLoader(){
+
+		for (;;){
+
+			PendingLoad pending_load;
+
+			{
+				unique_lock<mutex> lock(mutex_);
+
+				load_pending_.wait(lock,
+								   [this](){
+
+									   return stop_ || !pending_loads_.empty();
+
+								   });
+
+				if (stop_){
+
+					return;
+
+				}
+
+				pending_load = std::move(pending_loads_.front());
+
+				pending_loads_.pop_front();
+
+			}
+
+			PreparedLoad prepared_load{ pending_load.ticket };
+
+			try{
+
+				prepared_load.complete = pending_load.prepare();
+
+			}
+			catch (...){
+
+				prepared_load.error = current_exception();		// Forwarded to the owning thread
+
+			}
+
+			{
+				lock_guard<mutex> lock(mutex_);
+
+				prepared_loads_.push_back(std::move(prepared_load));
+
+			}
+
+			load_prepared_.notify_all();
+
+		}
+
+	}
+
+	/// \brief Complete a load prepared by a loader thread, store the resource and execute the continuations.
+	void CompleteLoad(PreparedLoad& prepared_load){
+
+		auto it = in_flight_.find(prepared_load.ticket);
+
+		auto in_flight = std::move(it->second);
+
+		in_flight_.erase(it);
+
+		if (in_flight.cached){
+
+			pending_cache_.erase(in_flight.key);
+
+		}
+
+		auto error = prepared_load.error;
+
+		ObjectPtr<IResource> resource;
+
+		if (!error){
+
+			try{
+
+				resource = prepared_load.complete();
+
+			}
+			catch (...){
+
+				error = current_exception();
+
+			}
+
+		}
+
+		if (resource){
+
+			if (!in_flight.cached){
+
+				StoreResource(resource);
+
+			}
+			else if (auto cached_resource = FetchFromCache(in_flight.key)){
+
+				resource = cached_resource;				// Loaded synchronously in the meanwhile: the first instance wins.
+
+			}
+			else{
+
+				StoreResource(in_flight.key,
+							  resource);
+
+			}
+
+		}
+
+		auto& load = *in_flight.load;
+
+		load.resource = resource;
 
-		resource_list_.erase(std::remove_if(resource_list_.begin(),
-											resource_list_.end(),
-											[](const ObjectWeakPtr<IResource>& resource){
+		load.completed = true;
 
-												return resource.IsValid();
-											
-											}),
-							 resource_list_.end());
+		auto continuations = std::move(load.continuations);
+
+		for (auto&& continuation : continuations){
+
+			continuation(resource);
+
+		}
+
+		if (error){
+
+			rethrow_exception(error);
+
+		}
+
+	}
+
+	/// \brief Move a cached resource on top of the retention list, evicting the least recently used resources if needed.
+	void Retain(const ResourceCacheKey& cache_key, ResourceCacheEntry& entry, const ObjectPtr<IResource>& resource){
+
+		if (entry.retention != retention_list_.end()){
+
+			// Retained already: touch it.
+
+			retention_list_.splice(retention_list_.begin(),
+								   retention_list_,
+								   entry.retention);
+
+			return;
+
+		}
+
+		if (retention_budget_ == 0){
+
+			return;					// Retention disabled.
+
+		}
+
+		// Resources reporting no size still cost their bookkeeping: this bounds the number of retained resources.
+
+		auto size = std::max(resource->GetSize(), sizeof(RetainedResource));
+
+		if (size > retention_budget_){
+
+			return;					// Would not fit anyway.
+
+		}
+
+		retention_list_.push_front(RetainedResource{ cache_key, resource, size });
+
+		entry.retention = retention_list_.begin();
+
+		retained_size_ += size;
+
+		EvictRetainedResources();
+
+	}
+
+	/// \brief Removes the expired resources from the cache.
+	void EvictInvalidResources(){
+
+		for (auto it = resource_cache_.begin(); it != resource_cache_.end();){
+
+			if (it->second.resource.IsValid()){
+
+				++it;
+
+			}
+			else{
+
+				it = resource_cache_.erase(it);
+
+			}
+
+		}
 			
 	}
 
-	mutable ResourceCache resource_cache_;		/// \brief List of cached resources.
+	/// \brief Release the least recently used resources until the retained ones fit inside the retention budget.
+	void EvictRetainedResources(){
+
+		while (retained_size_ > retention_budget_){
 
-	mutable ResourceList resource_list_;		/// \brief List of the loaded resources, either cached or not. Needed to compute the correct memory consumption.
+			auto& retained = retention_list_.back();
+
+			retained_size_ -= retained.size;
+
+			resource_cache_[retained.key].retention = retention_list_.end();
+
+			retention_list_.pop_back();		// May destroy the resource: the entry becomes invalid and is erased later.
+
+		}
+
+	}
+
+	ResourceCache resource_cache_;				/// \brief List of cached resources.
+
+	size_t purge_threshold_;					///< \brief Number of cache entries causing the expired ones to be purged.
+
+	RetentionList retention_list_;				///< \brief Cached resources kept alive after being used, most recently used first.
+
+	size_t retention_budget_;					///< \brief Maximum size of the retained resources, in bytes.
+
+	size_t retained_size_;						///< \brief Size of the retained resources, in bytes.
 
 	Resources& subject_;						///< \brief Subject of the implementation.
 
+	unordered_map<ResourceCacheKey, shared_ptr<AsyncLoad>, ResourceCacheKeyHash> pending_cache_;		///< \brief Cached resources being loaded asynchronously.
+
+	unordered_map<size_t, InFlightLoad> in_flight_;		///< \brief Asynchronous loads which were not completed yet, by ticket.
+
+	size_t next_ticket_;								///< \brief Ticket of the next asynchronous load.
+
+	vector<thread> loaders_;							///< \brief Loader threads.
+
+	mutex mutex_;										///< \brief Guards the queues shared with the loader threads.
+
+	condition_variable load_pending_;					///< \brief Signaled whenever a load is queued or the loaders are stopped.
+
+	condition_variable load_prepared_;					///< \brief Signaled whenever a load is prepared.
+
+	deque<PendingLoad> pending_loads_;					///< \brief Loads waiting for a loader thread.
+
+	vector<PreparedLoad> prepared_loads_;				///< \brief Loads prepared by the loader threads and waiting to be completed.
+
+	bool stop_;											///< \brief Whether the loader threads have to quit.
+
 };
 
 Resources::Impl::Impl(Resources& subject) :
-subject_(subject){}
+purge_threshold_(kMinimumPurgeThreshold),
+retention_budget_(0),
+retained_size_(0),
+subject_(subject),
+next_ticket_(0),
+stop_(false){}
+
+Resources::Impl::~Impl(){
+
+	StopLoaders();		// Nothing to join if the owner stopped the loaders already
+
+}
 
 //////////////////////// RESOURCES //////////////////////////////
 
@@ -166,24 +682,61 @@ Resources::~Resources(){}
 
 size_t Resources::GetSize() const{
 
-	// Runs trough every resource and sum its memory footprint.
+	return MemoryAccounting::GetSize();
 
-	auto resources = pimpl_->GetResources();
+}
 
-	return accumulate(resources.begin(),
-					  resources.end(),
-					  static_cast<size_t>(0),
-					  [](size_t accumulator, const ObjectWeakPtr<IResource>& resource){
+void Resources::SetRetentionBudget(size_t budget){
 
-							if (auto locked_resource = resource.Lock()){
+	pimpl_->SetRetentionBudget(budget);
 
-								accumulator += locked_resource->GetSize();
+}
 
-							}
+size_t Resources::GetRetentionBudget() const{
 
-							return accumulator;
+	return pimpl_->GetRetentionBudget();
 
-					  });
+}
+
+size_t Resources::GetRetainedSize() const{
+
+	return pimpl_->GetRetainedSize();
+
+}
+
+void Resources::Update(){
+
+	pimpl_->CompleteLoads(false);
+
+}
+
+void Resources::Flush(){
+
+	pimpl_->CompleteLoads(true);
+
+}
+
+size_t Resources::GetPendingCount() const{
+
+	return pimpl_->GetPendingCount();
+
+}
+
+void Resources::StopLoaders(){
+
+	pimpl_->StopLoaders();
+
+}
+
+function<ObjectPtr<IResource>()> Resources::PrepareLoad(const type_index& resource_type, const type_index& args_type, const void* args) const{
+
+	return [this, resource_type, args_type, args](){
+
+		return Load(resource_type,
+					args_type,
+					args);
+
+	};
 
 }
 
@@ -236,6 +789,68 @@ ObjectPtr<IResource> Resources::LoadDirect(const type_index& resource_type, cons
 
 }
 
+shared_ptr<AsyncLoad> Resources::LoadAsyncFromCache(const type_index& resource_type, const type_index& args_type, shared_ptr<const void> args, size_t cache_key){
+
+	ResourceCacheKey key = { resource_type,
+							 args_type,
+							 cache_key };
+
+	// Share the load if the resource is being loaded already.
+
+	if (auto pending_load = pimpl_->FetchFromPendingLoads(key)){
+
+		return pending_load;
+
+	}
+
+	auto load = make_shared<AsyncLoad>();
+
+	load->resource = pimpl_->FetchFromCache(key);
+
+	load->completed = static_cast<bool>(load->resource);
+
+	if (!load->completed){
+
+		// The resource is not cached. Load it.
+
+		auto args_ptr = args.get();
+
+		pimpl_->StartLoad(InFlightLoad{ load, key, true, std::move(args) },
+						  [this, resource_type, args_type, args_ptr](){
+
+							  return PrepareLoad(resource_type,
+												 args_type,
+												 args_ptr);
+
+						  });
+
+	}
+
+	return load;
+
+}
+
+shared_ptr<AsyncLoad> Resources::LoadAsyncDirect(const type_index& resource_type, const type_index& args_type, shared_ptr<const void> args){
+
+	auto load = make_shared<AsyncLoad>();
+
+	load->completed = false;
+
+	auto args_ptr = args.get();
+
+	pimpl_->StartLoad(InFlightLoad{ load, ResourceCacheKey(), false, std::move(args) },
+					  [this, resource_type, args_type, args_ptr](){
+
+						  return PrepareLoad(resource_type,
+											 args_type,
+											 args_ptr);
+
+					  });
+
+	return load;
+
+}
+
 ////////////////////// GRAPHICS ////////////////////////////////
 
 Graphics::Graphics(){}
@@ -8,11 +8,7 @@ using namespace gi_lib;
 
 BaseLightComponent::TypeSet BaseLightComponent::GetTypes() const {
 
-	auto types = Component::GetTypes();
-
-	types.insert(type_index(typeid(BaseLightComponent)));
-
-	return types;
+	return DeriveTypes<BaseLightComponent>(Component::GetTypes());
 
 }
 
@@ -28,21 +24,26 @@ void BaseLightComponent::ComputeBounds(bool notify) {
 
 }
 
+void BaseLightComponent::UpdateBounds() {
+
+	ComputeBounds();
+
+}
+
 void BaseLightComponent::Initialize() {
 
 	transform_ = GetComponent<TransformComponent>();
 	
 	ComputeBounds(false);
 	
-	on_transform_changed_lister_ = transform_->OnTransformChanged().Subscribe([this](_, _) {
+	transform_->AttachVolume(*this);		// The bounds follow the world matrix of the transform component.
 
-		ComputeBounds();	// The world matrix of the transform component changed.
+	auto& scene = GetComponent<NodeComponent>()->GetScene();
 
-	});
+	DeferChanges(&scene.GetEventQueue());	// Changes are delivered once per frame.
 
-	GetComponent<NodeComponent>()->GetScene()
-								 .GetLightHierarchy()
-								 .AddVolume(this);
+	scene.GetLightHierarchy()
+		 .AddVolume(this);
 }
 
 void BaseLightComponent::Finalize() {
@@ -51,6 +52,10 @@ void BaseLightComponent::Finalize() {
 								 .GetLightHierarchy()
 								 .RemoveVolume(this);
 	
+	DeferChanges(nullptr);
+
+	transform_->DetachVolume(*this);
+
 	transform_ = nullptr;
 	
 }
@@ -61,11 +66,7 @@ const float PointLightComponent::kDefaultCutoff = 0.001f;
 
 PointLightComponent::TypeSet PointLightComponent::GetTypes() const{
 
-	auto types = BaseLightComponent::GetTypes();
-
-	types.insert(type_index(typeid(PointLightComponent)));
-
-	return types;
+	return DeriveTypes<PointLightComponent>(BaseLightComponent::GetTypes());
 
 }
 
@@ -122,11 +123,7 @@ void PointLightComponent::ComputeBounds() {
 
 DirectionalLightComponent::TypeSet DirectionalLightComponent::GetTypes() const{
 
-	auto types = BaseLightComponent::GetTypes();
-
-	types.insert(type_index(typeid(DirectionalLightComponent)));
-
-	return types;
+	return DeriveTypes<DirectionalLightComponent>(BaseLightComponent::GetTypes());
 
 }
 
@@ -134,11 +131,7 @@ DirectionalLightComponent::TypeSet DirectionalLightComponent::GetTypes() const{
 
 SpotLightComponent::TypeSet SpotLightComponent::GetTypes() const {
 
-	auto types = BaseLightComponent::GetTypes();
-
-	types.insert(type_index(typeid(SpotLightComponent)));
-
-	return types;
+	return DeriveTypes<SpotLightComponent>(BaseLightComponent::GetTypes());
 
 }
 
@@ -163,6 +156,12 @@ IntersectionType SpotLightComponent::TestAgainst(const Sphere&) const {
 
 }
 
+AABB SpotLightComponent::GetBoundingBox() const {
+
+	THROW(L"NOT YET IMPLEMENTED");
+
+}
+
 void SpotLightComponent::ComputeBounds() {
 
 	THROW(L"NOT YET IMPLEMENTED");
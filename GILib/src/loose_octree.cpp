@@ -0,0 +1,1031 @@
+#include "loose_octree.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "gilib.h"
+#include "gimath.h"
+#include "observable.h"
+#include "scene.h"
+#include "exceptions.h"
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Maximum number of volumes culled at once.
+	const size_t kBatchSize = 256;
+
+	/// \brief Index used to mark a missing cell.
+	const unsigned int kNoCell = std::numeric_limits<unsigned int>::max();
+
+	/// \brief Check whether a box has finite extents.
+	bool IsBounded(const AABB& aabb){
+
+		return std::isfinite(aabb.half_extents(0)) &&
+			   std::isfinite(aabb.half_extents(1)) &&
+			   std::isfinite(aabb.half_extents(2));
+
+	}
+
+}
+
+////////////////////////////////// LOOSE OCTREE :: IMPL /////////////////////////////////////
+
+struct LooseOctree::Impl{
+
+	Impl(const AABB& domain, unsigned int depth, float looseness);
+
+	~Impl();
+
+	void AddVolume(VolumeComponent* volume);
+
+	void RemoveVolume(VolumeComponent* volume);
+
+	void Commit();
+
+	HierarchyStats GetStats() const;
+
+	const VolumeChangeLog& GetChangeLog() const;
+
+	template <typename TVolume, typename TVisitor>
+	bool VisitIntersections(const TVolume& volume, TVisitor&& visitor) const;
+
+	template <typename TVisitor>
+	bool VisitIntersections(const Frustum& frustum, TVisitor&& visitor) const;
+
+	void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const;
+
+	void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const;
+
+	template <typename TVolume>
+	void GetPartitionIntersections(const TVolume& volume, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const;
+
+	void GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const;
+
+private:
+
+	/// \brief Called whenever the bounds of a volume change. Marks the volume as dirty.
+	void OnVolumeChanged(VolumeComponent* volume);
+
+	/// \brief Get the cell a volume should be stored into.
+	/// \param bounds Bounds of the volume.
+	/// \return Returns the index of the deepest cell containing the center of the volume whose loose bounds enclose the volume.
+	unsigned int GetCell(const AABB& bounds) const;
+
+	/// \brief Link a volume to a cell.
+	void Link(unsigned int slot, unsigned int cell, const AABB& bounds);
+
+	/// \brief Unlink a volume from its cell.
+	void Unlink(unsigned int slot);
+
+	/// \brief Test the volumes inside a cell and recurse to its children.
+	/// \param level Level of the cell.
+	/// \param coordinates Coordinates of the cell within its level.
+	/// \param recursive Whether to recurse to the children of the cell.
+	/// \return Returns false if the visitor stopped the traversal, returns true otherwise.
+	template <typename TVolume, typename TVisitor>
+	bool Traverse(const TVolume& volume, unsigned int level, const Vector3i& coordinates, bool recursive, TVisitor&& visitor) const;
+
+	/// \brief Test the volumes inside a cell against a frustum and recurse to its children.
+	/// The bounds of the volumes inside the cell are culled at once, only the volumes which are not fully contained are tested individually.
+	/// \param level Level of the cell.
+	/// \param coordinates Coordinates of the cell within its level.
+	/// \param plane_mask Planes of the frustum which do not contain the parent cell.
+	/// \param recursive Whether to recurse to the children of the cell.
+	/// \return Returns false if the visitor stopped the traversal, returns true otherwise.
+	template <typename TVisitor>
+	bool Traverse(const Frustum& frustum, unsigned int level, const Vector3i& coordinates, unsigned int plane_mask, bool recursive, TVisitor&& visitor) const;
+
+	/// \brief Resolve a group of queries inside a cell and recurse to its children.
+	/// \param level Level of the cell.
+	/// \param coordinates Coordinates of the cell within its level.
+	/// \param active Queries intersecting the parent cell.
+	/// \param contained Queries fully containing the parent cell.
+	void Traverse(VolumeQueryBatch& batch, size_t group, unsigned int level, const Vector3i& coordinates, VolumeQueryBatch::QueryMask active, VolumeQueryBatch::QueryMask contained) const;
+
+	/// \brief Visit the volumes inside a cell and its children, without testing them.
+	/// \param level Level of the cell.
+	/// \param coordinates Coordinates of the cell within its level.
+	/// \param recursive Whether to visit the children of the cell.
+	/// \return Returns false if the visitor stopped the traversal, returns true otherwise.
+	template <typename TVisitor>
+	bool VisitVolumes(unsigned int level, const Vector3i& coordinates, bool recursive, TVisitor&& visitor) const;
+
+	/// \brief Get the coordinates of a child cell.
+	static Vector3i GetChildCoordinates(const Vector3i& coordinates, int child);
+
+	/// \brief Get the loose bounds of a cell.
+	AABB GetLooseBounds(unsigned int level, const Vector3i& coordinates) const;
+
+	/// \brief Get the index of a cell.
+	unsigned int GetCellIndex(unsigned int level, const Vector3i& coordinates) const;
+
+	/// \brief Get the level and the coordinates of a cell given its index.
+	void GetCellLocation(unsigned int cell, unsigned int& level, Vector3i& coordinates) const;
+
+	AABB domain_;											///< \brief Region of space subdivided by the tree.
+
+	Vector3f domain_min_;									///< \brief Minimum corner of the domain.
+
+	unsigned int depth_;									///< \brief Number of subdivisions on each axis.
+
+	float looseness_;										///< \brief Ratio between the loose bounds of a cell and its region of space.
+
+	vector<unsigned int> level_offsets_;					///< \brief Index of the first cell of each level.
+
+	vector<Vector3f> level_half_extents_;					///< \brief Half-extents of the region of space of the cells of each level.
+
+	vector<vector<unsigned int>> cell_slots_;				///< \brief Slots of the volumes stored inside each cell.
+
+	vector<AABBStream> cell_bounds_;						///< \brief Bounds of the volumes stored inside each cell, in the same order of the slots.
+
+	vector<unsigned int> cell_parents_;						///< \brief Parent of each cell. kNoCell for the root.
+
+	vector<unsigned int> cell_counts_;						///< \brief Cumulative volume count of each cell.
+
+	vector<VolumeComponent*> volumes_;						///< \brief Volume associated to each slot. nullptr for free slots.
+
+	vector<unsigned int> cells_;							///< \brief Cell containing the volume of each slot.
+
+	vector<unsigned int> positions_;						///< \brief Position of each slot inside its cell.
+
+	vector<unique_ptr<Listener>> listeners_;				///< \brief Bounds listener of each slot.
+
+	vector<unsigned int> free_slots_;						///< \brief Slots available for recycling.
+
+	vector<bool> dirty_;									///< \brief Whether the volume of each slot is waiting to be relocated.
+
+	vector<unsigned int> dirty_slots_;						///< \brief Slots whose volume changed since the last commit. May contain slots freed in the meantime.
+
+	unsigned int pending_changes_;							///< \brief Number of volume changes recorded since the last commit.
+
+	HierarchyStats stats_;									///< \brief Statistics of the last commit.
+
+	VolumeChangeLog change_log_;							///< \brief Changes applied to the content of the tree.
+
+};
+
+LooseOctree::Impl::Impl(const AABB& domain, unsigned int depth, float looseness) :
+domain_(domain),
+domain_min_(domain.center - domain.half_extents),
+depth_(depth),
+looseness_(looseness),
+pending_changes_(0),
+stats_(HierarchyStats{ 0u, 0u, 0u }){
+
+	if (looseness <= 1.0f){
+
+		THROW(L"The looseness of an octree must be greater than 1.");
+
+	}
+
+	// Flat cell layout: levels are stored one after the other, cells within a level are stored in x-y-z order.
+
+	unsigned int cell_count = 0;
+
+	for (unsigned int level = 0; level <= depth_; ++level){
+
+		auto splits = 1u << level;
+
+		level_offsets_.push_back(cell_count);
+
+		level_half_extents_.push_back(domain_.half_extents / static_cast<float>(splits));
+
+		cell_count += splits * splits * splits;
+
+	}
+
+	cell_slots_.resize(cell_count);
+
+	cell_bounds_.resize(cell_count);
+
+	cell_counts_.resize(cell_count, 0);
+
+	cell_parents_.resize(cell_count, kNoCell);
+
+	for (unsigned int level = 1; level <= depth_; ++level){
+
+		int splits = 1 << level;
+
+		for (int z = 0; z < splits; ++z){
+
+			for (int y = 0; y < splits; ++y){
+
+				for (int x = 0; x < splits; ++x){
+
+					cell_parents_[GetCellIndex(level, Vector3i(x, y, z))] = GetCellIndex(level - 1, Vector3i(x / 2, y / 2, z / 2));
+
+				}
+
+			}
+
+		}
+
+	}
+
+}
+
+LooseOctree::Impl::~Impl(){
+
+	for (auto volume : volumes_){
+
+		if (volume){
+
+			volume->SetHierarchySlot(VolumeComponent::kNoSlot);
+
+		}
+
+	}
+
+}
+
+void LooseOctree::Impl::AddVolume(VolumeComponent* volume){
+
+	if (volume->GetHierarchySlot() != VolumeComponent::kNoSlot){
+
+		THROW(L"The volume already belongs to a loose octree.");
+
+	}
+
+	unsigned int slot;
+
+	if (free_slots_.empty()){
+
+		slot = static_cast<unsigned int>(volumes_.size());
+
+		volumes_.push_back(nullptr);
+		cells_.push_back(kNoCell);
+		positions_.push_back(0);
+		listeners_.push_back(nullptr);
+		dirty_.push_back(false);
+
+	}
+	else{
+
+		slot = free_slots_.back();
+
+		free_slots_.pop_back();
+
+	}
+
+	volumes_[slot] = volume;
+
+	listeners_[slot] = volume->OnChanged().Subscribe([this, volume](_, _){
+
+		this->OnVolumeChanged(volume);
+
+	});
+
+	volume->SetHierarchySlot(slot);
+
+	auto bounds = volume->GetBoundingBox();
+
+	Link(slot, GetCell(bounds), bounds);
+
+	change_log_.RecordChange(volume);
+
+}
+
+void LooseOctree::Impl::RemoveVolume(VolumeComponent* volume){
+
+	auto slot = volume->GetHierarchySlot();
+
+	if (slot >= volumes_.size() ||
+		volumes_[slot] != volume){
+
+		return;		// Not inside this tree
+
+	}
+
+	Unlink(slot);
+
+	volumes_[slot] = nullptr;
+
+	listeners_[slot] = nullptr;
+
+	dirty_[slot] = false;
+
+	free_slots_.push_back(slot);
+
+	volume->SetHierarchySlot(VolumeComponent::kNoSlot);
+
+	change_log_.RecordRemoval(volume);
+
+}
+
+void LooseOctree::Impl::Commit(){
+
+	unsigned int relocations = 0;
+
+	for (auto slot : dirty_slots_){
+
+		if (!dirty_[slot]){
+
+			continue;		// Freed after being marked
+
+		}
+
+		dirty_[slot] = false;
+
+		auto bounds = volumes_[slot]->GetBoundingBox();
+
+		auto cell = GetCell(bounds);
+
+		if (cell != cells_[slot]){
+
+			Unlink(slot);
+
+			Link(slot, cell, bounds);
+
+		}
+		else{
+
+			cell_bounds_[cell].Set(positions_[slot], bounds);
+
+		}
+
+		change_log_.RecordChange(volumes_[slot]);
+
+		++relocations;
+
+	}
+
+	stats_ = HierarchyStats{ pending_changes_,
+							 relocations,
+							 pending_changes_ - relocations };
+
+	dirty_slots_.clear();
+
+	pending_changes_ = 0;
+
+}
+
+HierarchyStats LooseOctree::Impl::GetStats() const{
+
+	return stats_;
+
+}
+
+const VolumeChangeLog& LooseOctree::Impl::GetChangeLog() const{
+
+	return change_log_;
+
+}
+
+void LooseOctree::Impl::OnVolumeChanged(VolumeComponent* volume){
+
+	auto slot = volume->GetHierarchySlot();
+
+	if (slot >= volumes_.size() ||
+		volumes_[slot] != volume){
+
+		return;		// Not inside this tree
+
+	}
+
+	++pending_changes_;
+
+	if (!dirty_[slot]){
+
+		dirty_[slot] = true;
+
+		dirty_slots_.push_back(slot);
+
+	}
+
+}
+
+unsigned int LooseOctree::Impl::GetCell(const AABB& bounds) const{
+
+	if (!IsBounded(bounds) ||
+		((bounds.center - domain_.center).cwiseAbs().array() > domain_.half_extents.array()).any()){
+
+		return 0;		// Root
+
+	}
+
+	// A volume whose center falls inside a cell is enclosed by the loose bounds of that cell as long as its half-extents do not exceed the slack of the cell.
+
+	auto level = depth_;
+
+	for (; level > 0; --level){
+
+		Vector3f slack = level_half_extents_[level] * (looseness_ - 1.0f);
+
+		if ((bounds.half_extents.array() <= slack.array()).all()){
+
+			break;
+
+		}
+
+	}
+
+	int splits = 1 << level;
+
+	Vector3f relative = (bounds.center - domain_min_).cwiseQuotient(2.0f * level_half_extents_[level]);
+
+	Vector3i coordinates(std::min(std::max(static_cast<int>(std::floor(relative(0))), 0), splits - 1),
+						 std::min(std::max(static_cast<int>(std::floor(relative(1))), 0), splits - 1),
+						 std::min(std::max(static_cast<int>(std::floor(relative(2))), 0), splits - 1));
+
+	return GetCellIndex(level, coordinates);
+
+}
+
+void LooseOctree::Impl::Link(unsigned int slot, unsigned int cell, const AABB& bounds){
+
+	auto& slots = cell_slots_[cell];
+
+	cells_[slot] = cell;
+
+	positions_[slot] = static_cast<unsigned int>(slots.size());
+
+	slots.push_back(slot);
+
+	cell_bounds_[cell].PushBack(bounds);
+
+	for (; cell != kNoCell; cell = cell_parents_[cell]){
+
+		++cell_counts_[cell];
+
+	}
+
+}
+
+void LooseOctree::Impl::Unlink(unsigned int slot){
+
+	auto cell = cells_[slot];
+
+	auto& slots = cell_slots_[cell];
+
+	// Swap-pop: the last volume of the cell takes the place of the removed one.
+
+	auto last = slots.back();
+
+	slots[positions_[slot]] = last;
+
+	slots.pop_back();
+
+	cell_bounds_[cell].SwapPop(positions_[slot]);
+
+	positions_[last] = positions_[slot];
+
+	cells_[slot] = kNoCell;
+
+	for (; cell != kNoCell; cell = cell_parents_[cell]){
+
+		--cell_counts_[cell];
+
+	}
+
+}
+
+unsigned int LooseOctree::Impl::GetCellIndex(unsigned int level, const Vector3i& coordinates) const{
+
+	unsigned int splits = 1u << level;
+
+	return level_offsets_[level] + static_cast<unsigned int>(coordinates(0)) +
+								   static_cast<unsigned int>(coordinates(1)) * splits +
+								   static_cast<unsigned int>(coordinates(2)) * splits * splits;
+
+}
+
+void LooseOctree::Impl::GetCellLocation(unsigned int cell, unsigned int& level, Vector3i& coordinates) const{
+
+	level = static_cast<unsigned int>(std::upper_bound(level_offsets_.begin(), level_offsets_.end(), cell) - level_offsets_.begin()) - 1;
+
+	unsigned int splits = 1u << level;
+
+	auto offset = cell - level_offsets_[level];
+
+	coordinates = Vector3i(static_cast<int>(offset % splits),
+						   static_cast<int>((offset / splits) % splits),
+						   static_cast<int>(offset / (splits * splits)));
+
+}
+
+void LooseOctree::Impl::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	// Each partition of a cell is replaced by the volumes stored inside the cell followed by the partitions of its children:
+	// the order of the sequential traversal is preserved. Empty partitions are dropped.
+
+	if (cell_counts_[0] == 0){
+
+		return;
+
+	}
+
+	vector<HierarchyPartition> expanded;
+
+	partitions.push_back(HierarchyPartition{ 0, true });
+
+	bool split;
+
+	do{
+
+		split = false;
+
+		expanded.clear();
+
+		for (auto&& partition : partitions){
+
+			unsigned int level;
+			Vector3i coordinates;
+
+			GetCellLocation(static_cast<unsigned int>(partition.node), level, coordinates);
+
+			if (!partition.subtree ||
+				level == depth_){
+
+				expanded.push_back(partition);
+				continue;
+
+			}
+
+			if (!cell_slots_[partition.node].empty()){
+
+				expanded.push_back(HierarchyPartition{ partition.node, false });
+
+			}
+
+			for (int child = 0; child < 8; ++child){
+
+				auto child_cell = GetCellIndex(level + 1, GetChildCoordinates(coordinates, child));
+
+				if (cell_counts_[child_cell] > 0){
+
+					expanded.push_back(HierarchyPartition{ child_cell, true });
+
+				}
+
+			}
+
+			split = true;
+
+		}
+
+		partitions.swap(expanded);
+
+	} while (split && partitions.size() < count);
+
+}
+
+template <typename TVolume>
+void LooseOctree::Impl::GetPartitionIntersections(const TVolume& volume, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	unsigned int level;
+	Vector3i coordinates;
+
+	GetCellLocation(static_cast<unsigned int>(partition.node), level, coordinates);
+
+	Traverse(volume,
+			 level,
+			 coordinates,
+			 partition.subtree,
+			 [&intersections](VolumeComponent* volume){
+
+				intersections.push_back(volume);
+				return true;
+
+			 });
+
+}
+
+void LooseOctree::Impl::GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	unsigned int level;
+	Vector3i coordinates;
+
+	GetCellLocation(static_cast<unsigned int>(partition.node), level, coordinates);
+
+	Traverse(frustum,
+			 level,
+			 coordinates,
+			 Frustum::kAllPlanes,
+			 partition.subtree,
+			 [&intersections](VolumeComponent* volume){
+
+				intersections.push_back(volume);
+				return true;
+
+			 });
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool LooseOctree::Impl::VisitIntersections(const TVolume& volume, TVisitor&& visitor) const{
+
+	return Traverse(volume, 0, Vector3i::Zero(), true, visitor);
+
+}
+
+template <typename TVisitor>
+bool LooseOctree::Impl::VisitIntersections(const Frustum& frustum, TVisitor&& visitor) const{
+
+	return Traverse(frustum, 0, Vector3i::Zero(), Frustum::kAllPlanes, true, visitor);
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool LooseOctree::Impl::Traverse(const TVolume& volume, unsigned int level, const Vector3i& coordinates, bool recursive, TVisitor&& visitor) const{
+
+	auto cell = GetCellIndex(level, coordinates);
+
+	if (cell_counts_[cell] == 0){
+
+		return true;		// Empty subtree
+
+	}
+
+	// The root is never culled since it stores the volumes outside the domain.
+
+	if (level > 0 &&
+		!(volume.Intersect(GetLooseBounds(level, coordinates)) && IntersectionType::kIntersect)){
+
+		return true;
+
+	}
+
+	for (auto slot : cell_slots_[cell]){
+
+		auto candidate = volumes_[slot];
+
+		if ((candidate->TestAgainst(volume) && IntersectionType::kIntersect) &&
+			!visitor(candidate)){
+
+			return false;
+
+		}
+
+	}
+
+	if (recursive && level < depth_){
+
+		for (int child = 0; child < 8; ++child){
+
+			if (!Traverse(volume,
+						  level + 1,
+						  GetChildCoordinates(coordinates, child),
+						  true,
+						  visitor)){
+
+				return false;
+
+			}
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVisitor>
+bool LooseOctree::Impl::Traverse(const Frustum& frustum, unsigned int level, const Vector3i& coordinates, unsigned int plane_mask, bool recursive, TVisitor&& visitor) const{
+
+	auto cell = GetCellIndex(level, coordinates);
+
+	if (cell_counts_[cell] == 0){
+
+		return true;		// Empty subtree
+
+	}
+
+	if (level > 0){
+
+		// The loose bounds of a cell enclose the loose bounds of its children and every volume inside it:
+		// planes containing the cell are not tested again below.
+
+		auto intersection = frustum.Intersect(GetLooseBounds(level, coordinates), plane_mask);
+
+		if (!(intersection && IntersectionType::kIntersect)){
+
+			return true;
+
+		}
+
+		if (intersection && IntersectionType::kInside){
+
+			return VisitVolumes(level, coordinates, recursive, visitor);		// Fully visible: no further test needed
+
+		}
+
+	}
+
+	// Test against volumes, a batch at a time. The root is never culled since it stores the volumes outside the domain.
+
+	unsigned int visibility[kBatchSize / 32];
+	unsigned int containment[kBatchSize / 32];
+
+	auto& slots = cell_slots_[cell];
+
+	for (size_t begin = 0; begin < slots.size(); begin += kBatchSize){
+
+		auto end = std::min(begin + kBatchSize, slots.size());
+
+		frustum.Intersect(cell_bounds_[cell], begin, end, plane_mask, visibility, containment);
+
+		for (size_t word = 0; word < ((end - begin + 31) >> 5); ++word){
+
+			// Visit the set bits only
+
+			for (auto bits = visibility[word]; bits != 0; bits &= bits - 1){
+
+				auto bit = Math::CountTrailingZeros(bits);
+
+				auto candidate = volumes_[slots[begin + (word << 5) + bit]];
+
+				if (((containment[word] & (1u << bit)) ||
+					 (candidate->TestAgainst(frustum) && IntersectionType::kIntersect)) &&
+					!visitor(candidate)){
+
+					return false;
+
+				}
+
+			}
+
+		}
+
+	}
+
+	if (recursive && level < depth_){
+
+		for (int child = 0; child < 8; ++child){
+
+			if (!Traverse(frustum,
+						  level + 1,
+						  GetChildCoordinates(coordinates, child),
+						  plane_mask,
+						  true,
+						  visitor)){
+
+				return false;
+
+			}
+
+		}
+
+	}
+
+	return true;
+
+}
+
+void LooseOctree::Impl::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	Traverse(batch, group, 0, Vector3i::Zero(), batch.GetGroupMask(group), 0);
+
+}
+
+void LooseOctree::Impl::Traverse(VolumeQueryBatch& batch, size_t group, unsigned int level, const Vector3i& coordinates, VolumeQueryBatch::QueryMask active, VolumeQueryBatch::QueryMask contained) const{
+
+	auto cell = GetCellIndex(level, coordinates);
+
+	if (cell_counts_[cell] == 0){
+
+		return;		// Empty subtree
+
+	}
+
+	// The root is never culled since it stores the volumes outside the domain.
+
+	if (level > 0){
+
+		active = batch.Intersect(group, GetLooseBounds(level, coordinates), active, contained);
+
+		if (active == 0){
+
+			return;
+
+		}
+
+	}
+
+	// Test against volumes
+
+	auto& slots = cell_slots_[cell];
+	auto& bounds = cell_bounds_[cell];
+
+	for (size_t index = 0; index < slots.size(); ++index){
+
+		auto candidate = volumes_[slots[index]];
+
+		auto candidate_contained = contained;
+
+		auto queries = batch.Intersect(group, bounds.Get(index), active, candidate_contained);
+
+		if (queries != 0 &&
+			(queries = batch.TestAgainst(group, *candidate, queries, candidate_contained)) != 0){
+
+			batch.AddIntersection(group, queries, candidate);
+
+		}
+
+	}
+
+	if (level < depth_){
+
+		for (int child = 0; child < 8; ++child){
+
+			Traverse(batch,
+					 group,
+					 level + 1,
+					 GetChildCoordinates(coordinates, child),
+					 active,
+					 contained);
+
+		}
+
+	}
+
+}
+
+template <typename TVisitor>
+bool LooseOctree::Impl::VisitVolumes(unsigned int level, const Vector3i& coordinates, bool recursive, TVisitor&& visitor) const{
+
+	auto cell = GetCellIndex(level, coordinates);
+
+	if (cell_counts_[cell] == 0){
+
+		return true;		// Empty subtree
+
+	}
+
+	for (auto slot : cell_slots_[cell]){
+
+		if (!visitor(volumes_[slot])){
+
+			return false;
+
+		}
+
+	}
+
+	if (recursive && level < depth_){
+
+		for (int child = 0; child < 8; ++child){
+
+			if (!VisitVolumes(level + 1,
+							  GetChildCoordinates(coordinates, child),
+							  true,
+							  visitor)){
+
+				return false;
+
+			}
+
+		}
+
+	}
+
+	return true;
+
+}
+
+Vector3i LooseOctree::Impl::GetChildCoordinates(const Vector3i& coordinates, int child){
+
+	return Vector3i(2 * coordinates(0) + (child & 1),
+					2 * coordinates(1) + ((child >> 1) & 1),
+					2 * coordinates(2) + ((child >> 2) & 1));
+
+}
+
+AABB LooseOctree::Impl::GetLooseBounds(unsigned int level, const Vector3i& coordinates) const{
+
+	auto& half_extents = level_half_extents_[level];
+
+	return AABB{ domain_min_ + (2.0f * coordinates.cast<float>() + Vector3f::Ones()).cwiseProduct(half_extents),
+				 half_extents * looseness_ };
+
+}
+
+///////////////////////////////////// LOOSE OCTREE ////////////////////////////////////
+
+const float LooseOctree::kDefaultLooseness = 2.0f;
+
+LooseOctree::LooseOctree(const AABB& domain, unsigned int depth) :
+LooseOctree(domain, depth, kDefaultLooseness){}
+
+LooseOctree::LooseOctree(const AABB& domain, unsigned int depth, float looseness) :
+pimpl_(make_unique<Impl>(domain, depth, looseness)){}
+
+LooseOctree::~LooseOctree(){}
+
+void LooseOctree::AddVolume(VolumeComponent* volume){
+
+	pimpl_->AddVolume(volume);
+
+}
+
+void LooseOctree::RemoveVolume(VolumeComponent* volume){
+
+	pimpl_->RemoveVolume(volume);
+
+}
+
+void LooseOctree::Commit(){
+
+	pimpl_->Commit();
+
+}
+
+HierarchyStats LooseOctree::GetStats() const{
+
+	return pimpl_->GetStats();
+
+}
+
+const VolumeChangeLog& LooseOctree::GetChangeLog() const{
+
+	return pimpl_->GetChangeLog();
+
+}
+
+void LooseOctree::GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(frustum,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+void LooseOctree::GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(sphere,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+void LooseOctree::GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(aabb,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+bool LooseOctree::VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(frustum, visitor);
+
+}
+
+bool LooseOctree::VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(sphere, visitor);
+
+}
+
+bool LooseOctree::VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(aabb, visitor);
+
+}
+
+void LooseOctree::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	pimpl_->GetGroupIntersections(batch, group);
+
+}
+
+void LooseOctree::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	pimpl_->GetPartitions(count, partitions);
+
+}
+
+void LooseOctree::GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(frustum, partition, intersections);
+
+}
+
+void LooseOctree::GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(sphere, partition, intersections);
+
+}
+
+void LooseOctree::GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(aabb, partition, intersections);
+
+}
@@ -1,17 +1,38 @@
 #include "observable.h"
 
+#include <cassert>
+#include <atomic>
+#include <mutex>
+
 using namespace std;
 using namespace gi_lib;
 
+namespace{
+
+	/// \brief Protects the pool of the listeners, since listeners may be created and destroyed by any thread. Never destroyed, like the pool.
+	mutex& listener_mutex = *new mutex();
+
+	/// \brief Pool of the listeners. Never destroyed, since listeners may outlive any static object.
+	SlabPool* listener_pool = new SlabPool(sizeof(Listener));
+
+	/// \brief Identifier of the next flush of any event queue. Zero is never used.
+	atomic<size_t> next_flush(1);
+
+}
+
 ///////////////////////////////////// LISTENER ///////////////////////////////////////////
 
 Listener::Listener() :
 id_(Unique<ListenerTag>::kNull),
-subject_(nullptr){}
+subject_(nullptr),
+slot_(0),
+generation_(0){}
 
-Listener::Listener(BaseObservable* observable, Unique<ListenerTag> id) :
+Listener::Listener(BaseObservable* observable, Unique<ListenerTag> id, unsigned int slot, unsigned int generation) :
 id_(id),
-subject_(observable){}
+subject_(observable),
+slot_(slot),
+generation_(generation){}
 
 Listener::~Listener(){
 
@@ -37,6 +58,32 @@ void Listener::Unsubscribe(){
 	
 }
 
+void* Listener::operator new(size_t size){
+
+	assert(size == sizeof(Listener));		// The blocks of the pool fit a listener only
+
+	lock_guard<mutex> lock(listener_mutex);
+
+	return listener_pool->Allocate();
+
+}
+
+void Listener::operator delete(void* block){
+
+	lock_guard<mutex> lock(listener_mutex);
+
+	listener_pool->Free(block);
+
+}
+
+PoolStatistics Listener::GetStatistics(){
+
+	lock_guard<mutex> lock(listener_mutex);
+
+	return listener_pool->GetStatistics();
+
+}
+
 void Listener::Invalidate(){
 
 	id_ = Unique<ListenerTag>::kNull;
@@ -56,20 +103,106 @@ void BaseObservable::Invalidate(Listener& listener){
 
 }
 
-unique_ptr<Listener> BaseObservable::GenerateListener(){
+unique_ptr<Listener> BaseObservable::GenerateListener(unsigned int slot, unsigned int generation){
 
-	return make_unique<Listener>(this, Unique < ListenerTag >::MakeUnique());
+	return make_unique<Listener>(this, Unique < ListenerTag >::MakeUnique(), slot, generation);
 
 }
 
 void BaseObservable::Unsubscribe(Listener& listener){
 
-	Unsubscribe(listener.id_);
+	Unsubscribe(listener.slot_, listener.generation_);
 
 	listener.Invalidate();
 
 }
 
+///////////////////////////////////// DEFERRED EVENT ///////////////////////////////////////////
+
+DeferredEvent::DeferredEvent() :
+queue_index_(0),
+flush_(0){}
+
+///////////////////////////////////// EVENT QUEUE ///////////////////////////////////////////
+
+EventQueue::EventQueue() :
+pending_count_(0){}
+
+void EventQueue::Enqueue(DeferredEvent& event){
+
+	event.queue_index_ = events_.size();
+
+	events_.push_back(&event);
+
+	++pending_count_;
+
+}
+
+void EventQueue::Cancel(DeferredEvent& event){
+
+	// The index may refer to another queue the event was enqueued to
+
+	if (event.queue_index_ < events_.size() &&
+		events_[event.queue_index_] == &event){
+
+		events_[event.queue_index_] = nullptr;
+
+		--pending_count_;
+
+	}
+
+}
+
+void EventQueue::Flush(){
+
+	// Delivering an event may enqueue other events: they are appended and delivered by this very loop.
+	// Events delivered already are moved to the front instead, and wait for the next flush.
+
+	auto flush = next_flush++;
+
+	size_t deferred_count = 0;
+
+	for (size_t index = 0; index < events_.size(); ++index){
+
+		auto event = events_[index];
+
+		if (!event){
+
+			continue;
+
+		}
+
+		events_[index] = nullptr;
+
+		if (event->flush_ == flush){
+
+			event->queue_index_ = deferred_count;
+
+			events_[deferred_count++] = event;
+
+		}
+		else{
+
+			--pending_count_;
+
+			event->flush_ = flush;
+
+			event->Deliver();
+
+		}
+
+	}
+
+	events_.resize(deferred_count);
+
+}
+
+size_t EventQueue::GetPendingCount() const{
+
+	return pending_count_;
+
+}
+
 ////////////////////// EVENT ARGS ///////////////////////////
 
 const EventArgs EventArgs::kEmpty = EventArgs();
\ No newline at end of file
@@ -0,0 +1,415 @@
+#include "occlusion_buffer.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+#elif defined(_M_X64) || defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
+using namespace ::gi_lib;
+using namespace ::std;
+
+namespace{
+
+	/// \brief Minimum view-space depth of a rasterized vertex. Vertices closer than this are behind the camera or too close to be projected safely.
+	const float kMinimumDepth = 1e-4f;
+
+	/// \brief Minimum screen-space area of a rasterized triangle, in pixels.
+	const float kMinimumArea = 1e-6f;
+
+	// SIMD lanes used by the rasterizer. Where no SIMD instruction set is available only the scalar path is compiled.
+
+#if defined(__AVX__)
+
+	#define GI_SIMD_RASTERIZER
+
+	const unsigned int kLanes = 8;
+
+	typedef __m256 Lane;
+
+	inline Lane Load(const float* address){ return _mm256_loadu_ps(address); }
+
+	inline void Store(float* address, Lane value){ _mm256_storeu_ps(address, value); }
+
+	inline Lane Splat(float value){ return _mm256_set1_ps(value); }
+
+	inline Lane Offsets(){ return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+
+	inline Lane Add(Lane left, Lane right){ return _mm256_add_ps(left, right); }
+
+	inline Lane Mul(Lane left, Lane right){ return _mm256_mul_ps(left, right); }
+
+	inline Lane Max(Lane left, Lane right){ return _mm256_max_ps(left, right); }
+
+	inline Lane And(Lane left, Lane right){ return _mm256_and_ps(left, right); }
+
+	inline Lane Select(Lane mask, Lane if_set, Lane if_clear){ return _mm256_blendv_ps(if_clear, if_set, mask); }
+
+	inline Lane GreaterEqual(Lane left, Lane right){ return _mm256_cmp_ps(left, right, _CMP_GE_OQ); }
+
+	inline unsigned int MoveMask(Lane mask){ return static_cast<unsigned int>(_mm256_movemask_ps(mask)); }
+
+#elif defined(_M_X64) || defined(__SSE2__)
+
+	#define GI_SIMD_RASTERIZER
+
+	const unsigned int kLanes = 4;
+
+	typedef __m128 Lane;
+
+	inline Lane Load(const float* address){ return _mm_loadu_ps(address); }
+
+	inline void Store(float* address, Lane value){ _mm_storeu_ps(address, value); }
+
+	inline Lane Splat(float value){ return _mm_set1_ps(value); }
+
+	inline Lane Offsets(){ return _mm_setr_ps(0.f, 1.f, 2.f, 3.f); }
+
+	inline Lane Add(Lane left, Lane right){ return _mm_add_ps(left, right); }
+
+	inline Lane Mul(Lane left, Lane right){ return _mm_mul_ps(left, right); }
+
+	inline Lane Max(Lane left, Lane right){ return _mm_max_ps(left, right); }
+
+	inline Lane And(Lane left, Lane right){ return _mm_and_ps(left, right); }
+
+	inline Lane Select(Lane mask, Lane if_set, Lane if_clear){ return _mm_or_ps(_mm_and_ps(mask, if_set), _mm_andnot_ps(mask, if_clear)); }
+
+	inline Lane GreaterEqual(Lane left, Lane right){ return _mm_cmpge_ps(left, right); }
+
+	inline unsigned int MoveMask(Lane mask){ return static_cast<unsigned int>(_mm_movemask_ps(mask)); }
+
+#endif
+
+	/// \brief Edge function of a triangle: positive on the inner side of the edge.
+	struct Edge{
+
+		Edge(const Vector3f& from, const Vector3f& to) :
+			a(from(1) - to(1)),
+			b(to(0) - from(0)),
+			c(from(0) * to(1) - to(0) * from(1)){}
+
+		float Evaluate(float x, float y) const{
+
+			return a * x + b * y + c;
+
+		}
+
+		float a;		///< \brief Coefficient of x.
+
+		float b;		///< \brief Coefficient of y.
+
+		float c;		///< \brief Constant term.
+
+	};
+
+	/// \brief Project a point to screen space.
+	/// \param transform Matrix transforming the point to clip space.
+	/// \param point Point to project.
+	/// \param width Width of the screen in pixels.
+	/// \param height Height of the screen in pixels.
+	/// \param projected Contains the pixel coordinates in x and y and the reciprocal of the view-space depth in z. Output.
+	/// \return Returns true if the point could be projected, returns false if it is too close or behind the camera.
+	bool Project(const Matrix4f& transform, const Vector3f& point, float width, float height, Vector3f& projected){
+
+		Vector4f clip = transform * Math::ToHomogeneous(point);
+
+		if (!(clip(3) > kMinimumDepth)){
+
+			return false;
+
+		}
+
+		auto inverse_depth = 1.0f / clip(3);
+
+		projected = Vector3f((clip(0) * inverse_depth * 0.5f + 0.5f) * width,
+							 (0.5f - clip(1) * inverse_depth * 0.5f) * height,			// Rows go top to bottom
+							 inverse_depth);
+
+		return true;
+
+	}
+
+}
+
+///////////////////////////////// OCCLUSION BUFFER /////////////////////////////////
+
+OcclusionBuffer::OcclusionBuffer(unsigned int width, unsigned int height) :
+width_((width + 7u) & ~7u),
+height_(height),
+depth_(width_ * height_, 0.0f),
+view_projection_(Matrix4f::Identity()),
+triangle_count_(0){}
+
+void OcclusionBuffer::Clear(const Matrix4f& view_projection){
+
+	std::fill(depth_.begin(), depth_.end(), 0.0f);
+
+	view_projection_ = view_projection;
+
+	triangle_count_ = 0;
+
+}
+
+void OcclusionBuffer::DrawOccluder(const vector<Vector3f>& positions, const vector<unsigned int>& indices, size_t start_index, size_t index_count, const Affine3f& world){
+
+	Matrix4f transform = view_projection_ * world.matrix();
+
+	auto width = static_cast<float>(width_);
+	auto height = static_cast<float>(height_);
+
+	Vector3f vertices[3];
+
+	for (auto index = start_index; index + 2 < start_index + index_count; index += 3){
+
+		if (Project(transform, positions[indices[index]], width, height, vertices[0]) &&
+			Project(transform, positions[indices[index + 1]], width, height, vertices[1]) &&
+			Project(transform, positions[indices[index + 2]], width, height, vertices[2])){
+
+			DrawTriangle(vertices[0], vertices[1], vertices[2]);
+
+		}
+
+	}
+
+}
+
+void OcclusionBuffer::DrawTriangle(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2){
+
+	// Both windings are rasterized: the vertices are sorted such that the edge functions are positive inside the triangle.
+
+	auto area = (v1(0) - v0(0)) * (v2(1) - v0(1)) - (v2(0) - v0(0)) * (v1(1) - v0(1));
+
+	if (!(std::fabs(area) > kMinimumArea)){
+
+		return;		// Degenerate
+
+	}
+
+	auto& p0 = v0;
+	auto& p1 = (area > 0.0f) ? v1 : v2;
+	auto& p2 = (area > 0.0f) ? v2 : v1;
+
+	area = std::fabs(area);
+
+	// Pixels whose center lies inside the bounds of the triangle
+
+	auto min_x = std::max(static_cast<int>(std::floor(std::min(std::min(p0(0), p1(0)), p2(0)))), 0);
+	auto max_x = std::min(static_cast<int>(std::floor(std::max(std::max(p0(0), p1(0)), p2(0)))), static_cast<int>(width_) - 1);
+	auto min_y = std::max(static_cast<int>(std::floor(std::min(std::min(p0(1), p1(1)), p2(1)))), 0);
+	auto max_y = std::min(static_cast<int>(std::floor(std::max(std::max(p0(1), p1(1)), p2(1)))), static_cast<int>(height_) - 1);
+
+	if (min_x > max_x || min_y > max_y){
+
+		return;		// Off-screen
+
+	}
+
+	++triangle_count_;
+
+	Edge e0(p1, p2);
+	Edge e1(p2, p0);
+	Edge e2(p0, p1);
+
+	// The reciprocal of the depth is linear in screen space.
+
+	auto dz_dx = ((p1(2) - p0(2)) * (p2(1) - p0(1)) - (p2(2) - p0(2)) * (p1(1) - p0(1))) / area;
+	auto dz_dy = ((p1(0) - p0(0)) * (p2(2) - p0(2)) - (p2(0) - p0(0)) * (p1(2) - p0(2))) / area;
+	auto z_c = p0(2) - dz_dx * p0(0) - dz_dy * p0(1);
+
+#ifdef GI_SIMD_RASTERIZER
+
+	auto first_column = static_cast<unsigned int>(min_x) & ~(kLanes - 1u);
+
+	auto offsets = Add(Offsets(), Splat(static_cast<float>(first_column) + 0.5f));		// Pixel centers of the first block
+
+	auto e0_step = Splat(e0.a * kLanes);
+	auto e1_step = Splat(e1.a * kLanes);
+	auto e2_step = Splat(e2.a * kLanes);
+	auto z_step = Splat(dz_dx * kLanes);
+
+	auto zero = Splat(0.0f);
+
+	for (auto y = min_y; y <= max_y; ++y){
+
+		auto center_y = y + 0.5f;
+
+		auto e0_row = Add(Mul(Splat(e0.a), offsets), Splat(e0.b * center_y + e0.c));
+		auto e1_row = Add(Mul(Splat(e1.a), offsets), Splat(e1.b * center_y + e1.c));
+		auto e2_row = Add(Mul(Splat(e2.a), offsets), Splat(e2.b * center_y + e2.c));
+		auto z_row = Add(Mul(Splat(dz_dx), offsets), Splat(dz_dy * center_y + z_c));
+
+		auto row = &depth_[y * width_];
+
+		for (auto x = first_column; x <= static_cast<unsigned int>(max_x); x += kLanes){
+
+			// Coverage mask of the block
+
+			auto mask = And(And(GreaterEqual(e0_row, zero),
+								GreaterEqual(e1_row, zero)),
+							GreaterEqual(e2_row, zero));
+
+			if (MoveMask(mask) != 0){
+
+				auto depth = Load(row + x);
+
+				Store(row + x, Select(mask, Max(depth, z_row), depth));
+
+			}
+
+			e0_row = Add(e0_row, e0_step);
+			e1_row = Add(e1_row, e1_step);
+			e2_row = Add(e2_row, e2_step);
+			z_row = Add(z_row, z_step);
+
+		}
+
+	}
+
+#else
+
+	for (auto y = min_y; y <= max_y; ++y){
+
+		auto center_y = y + 0.5f;
+
+		auto row = &depth_[y * width_];
+
+		for (auto x = min_x; x <= max_x; ++x){
+
+			auto center_x = x + 0.5f;
+
+			if (e0.Evaluate(center_x, center_y) >= 0.0f &&
+				e1.Evaluate(center_x, center_y) >= 0.0f &&
+				e2.Evaluate(center_x, center_y) >= 0.0f){
+
+				row[x] = std::max(row[x], z_c + dz_dx * center_x + dz_dy * center_y);
+
+			}
+
+		}
+
+	}
+
+#endif
+
+}
+
+bool OcclusionBuffer::IsVisible(const AABB& bounds) const{
+
+	auto width = static_cast<float>(width_);
+	auto height = static_cast<float>(height_);
+
+	// Screen-space bounds of the box and depth of its closest point
+
+	Vector3f min_corner(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), 0.0f);
+	Vector3f max_corner(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), 0.0f);
+
+	Vector3f projected;
+
+	for (int corner = 0; corner < 8; ++corner){
+
+		Vector3f direction((corner & 1) ? 1.0f : -1.0f,
+						   (corner & 2) ? 1.0f : -1.0f,
+						   (corner & 4) ? 1.0f : -1.0f);
+
+		if (!Project(view_projection_,
+					 bounds.center + bounds.half_extents.cwiseProduct(direction),
+					 width,
+					 height,
+					 projected)){
+
+			return true;		// Crossing the near plane
+
+		}
+
+		min_corner = min_corner.cwiseMin(projected);
+		max_corner = max_corner.cwiseMax(projected);
+
+	}
+
+	auto min_x = std::max(static_cast<int>(std::floor(min_corner(0))), 0);
+	auto max_x = std::min(static_cast<int>(std::floor(max_corner(0))), static_cast<int>(width_) - 1);
+	auto min_y = std::max(static_cast<int>(std::floor(min_corner(1))), 0);
+	auto max_y = std::min(static_cast<int>(std::floor(max_corner(1))), static_cast<int>(height_) - 1);
+
+	if (min_x > max_x || min_y > max_y){
+
+		return true;		// Outside the buffer, nothing to test against
+
+	}
+
+	// The box is hidden only if every pixel it covers has a closer occluder.
+
+	auto closest = max_corner(2);
+
+#ifdef GI_SIMD_RASTERIZER
+
+	auto first_column = static_cast<unsigned int>(min_x) & ~(kLanes - 1u);
+	auto last_column = static_cast<unsigned int>(max_x) & ~(kLanes - 1u);
+
+	auto first_mask = ~((1u << (min_x - first_column)) - 1u);				// Discards the pixels before min_x
+	auto last_mask = (2u << (max_x - last_column)) - 1u;					// Discards the pixels after max_x
+
+	auto box_depth = Splat(closest);
+
+	for (auto y = min_y; y <= max_y; ++y){
+
+		auto row = &depth_[y * width_];
+
+		for (auto x = first_column; x <= last_column; x += kLanes){
+
+			auto mask = MoveMask(GreaterEqual(box_depth, Load(row + x)));
+
+			if (x == first_column){
+
+				mask &= first_mask;
+
+			}
+
+			if (x == last_column){
+
+				mask &= last_mask;
+
+			}
+
+			if (mask != 0){
+
+				return true;
+
+			}
+
+		}
+
+	}
+
+#else
+
+	for (auto y = min_y; y <= max_y; ++y){
+
+		auto row = &depth_[y * width_];
+
+		for (auto x = min_x; x <= max_x; ++x){
+
+			if (closest >= row[x]){
+
+				return true;
+
+			}
+
+		}
+
+	}
+
+#endif
+
+	return false;
+
+}
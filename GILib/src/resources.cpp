@@ -0,0 +1,193 @@
+#include "resources.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <algorithm>
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Number of memory categories.
+	const size_t kCategoryCount = static_cast<size_t>(MemoryCategory::kCount);
+
+	/// \brief Atomic counters of a memory category.
+	struct MemoryCounters{
+
+		atomic<size_t> size;				///< \brief Current size, in bytes.
+
+		atomic<size_t> peak;				///< \brief Highest size ever reached, in bytes.
+
+		atomic<size_t> count;				///< \brief Number of resources.
+
+	};
+
+	/// \brief Orders the consumers by decreasing size. Ties are broken by address.
+	struct ConsumerOrder{
+
+		bool operator()(const MemoryConsumer& first, const MemoryConsumer& second) const{
+
+			return first.size > second.size ||
+				   (first.size == second.size && first.resource < second.resource);
+
+		}
+
+	};
+
+	/// \brief Counters of each category. The last element counts every category.
+	MemoryCounters category_counters[kCategoryCount + 1];
+
+	/// \brief Accounted resources, largest first.
+	set<MemoryConsumer, ConsumerOrder> consumers;
+
+	/// \brief Guards the consumers.
+	mutex consumers_mutex;
+
+	/// \brief Get the counters of every category.
+	MemoryCounters& GetTotalCounters(){
+
+		return category_counters[kCategoryCount];
+
+	}
+
+	/// \brief Add a resource to some counters and update their peak.
+	void Increase(MemoryCounters& counters, size_t size){
+
+		auto new_size = counters.size.fetch_add(size) + size;
+
+		counters.count.fetch_add(1);
+
+		auto peak = counters.peak.load();
+
+		while (new_size > peak &&
+			   !counters.peak.compare_exchange_weak(peak, new_size)){}
+
+	}
+
+	/// \brief Remove a resource from some counters.
+	void Decrease(MemoryCounters& counters, size_t size){
+
+		counters.size.fetch_sub(size);
+
+		counters.count.fetch_sub(1);
+
+	}
+
+	/// \brief Read some counters.
+	MemoryUsage Read(const MemoryCounters& counters){
+
+		return MemoryUsage{ counters.size.load(),
+							counters.peak.load(),
+							counters.count.load() };
+
+	}
+
+}
+
+///////////////////////////////////// MEMORY ACCOUNTING ////////////////////////////////////
+
+void MemoryAccounting::Add(IResource& resource){
+
+	if (resource.accounted_category_ != MemoryCategory::kCount){
+
+		return;				// Accounted already
+
+	}
+
+	auto category = resource.GetMemoryCategory();
+
+	auto size = resource.GetSize();
+
+	resource.accounted_category_ = category;
+
+	resource.accounted_size_ = size;
+
+	Increase(category_counters[static_cast<size_t>(category)], size);
+
+	Increase(GetTotalCounters(), size);
+
+	lock_guard<mutex> lock(consumers_mutex);
+
+	consumers.insert(MemoryConsumer{ &resource, type_index(typeid(resource)), category, size });
+
+}
+
+void MemoryAccounting::Remove(IResource& resource){
+
+	if (resource.accounted_category_ == MemoryCategory::kCount){
+
+		return;				// Never accounted
+
+	}
+
+	auto category = resource.accounted_category_;
+
+	auto size = resource.accounted_size_;
+
+	resource.accounted_category_ = MemoryCategory::kCount;
+
+	Decrease(category_counters[static_cast<size_t>(category)], size);
+
+	Decrease(GetTotalCounters(), size);
+
+	lock_guard<mutex> lock(consumers_mutex);
+
+	// The order ignores the type: the key is rebuilt from the accounted values
+
+	consumers.erase(MemoryConsumer{ &resource, type_index(typeid(void)), category, size });
+
+}
+
+void MemoryAccounting::Refresh(IResource& resource){
+
+	if (resource.accounted_category_ == MemoryCategory::kCount){
+
+		return;				// Never accounted
+
+	}
+
+	// Removed and accounted again with its current size and category
+
+	Remove(resource);
+
+	Add(resource);
+
+}
+
+size_t MemoryAccounting::GetSize(MemoryCategory category){
+
+	return category_counters[static_cast<size_t>(category)].size.load();
+
+}
+
+size_t MemoryAccounting::GetSize(){
+
+	return GetTotalCounters().size.load();
+
+}
+
+MemorySnapshot MemoryAccounting::GetSnapshot(size_t top_count){
+
+	MemorySnapshot snapshot;
+
+	for (size_t category = 0; category < kCategoryCount; ++category){
+
+		snapshot.categories[category] = Read(category_counters[category]);
+
+	}
+
+	snapshot.total = Read(GetTotalCounters());
+
+	lock_guard<mutex> lock(consumers_mutex);
+
+	auto end = consumers.begin();
+
+	advance(end, min(top_count, consumers.size()));
+
+	snapshot.top_consumers.assign(consumers.begin(), end);
+
+	return snapshot;
+
+}
@@ -2,17 +2,24 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <limits>
+#include <atomic>
 
 #include "gilib.h"
 #include "exceptions.h"
 
 #include "mesh.h"
+#include "task_pool.h"
+#include "split_hierarchy.h"
 
 using namespace ::gi_lib;
 using namespace ::std;
 
 namespace{
 
+	/// \brief Number of transforms of the same hierarchy level swept by each task.
+	const unsigned int kSweepChunk = 1024;
+
 	/// \brief Calculate the view frustum from a projective camera description.
 	/// \param camera_transform Camera transform matrix in world space.
 	/// \param near_distance Minimum projected distance in world units.
@@ -99,12 +106,491 @@ namespace{
 
 }
 
+////////////////////////////////////// TRANSFORM SYSTEM //////////////////////////////////////////
+
+const unsigned int TransformSystem::kNoTransform = std::numeric_limits<unsigned int>::max();
+
+TransformSystem::TransformSystem() :
+edit_depth_(0),
+frozen_count_(0),
+sorted_(true),
+update_count_(0),
+change_count_(0){}
+
+unsigned int TransformSystem::CreateTransform(TransformComponent& owner, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale){
+
+	unsigned int transform;
+
+	if (free_transforms_.empty()){
+
+		transform = static_cast<unsigned int>(slots_.size());
+
+		slots_.push_back(kNoTransform);
+
+	}
+	else{
+
+		transform = free_transforms_.back();
+
+		free_transforms_.pop_back();
+
+	}
+
+	slots_[transform] = static_cast<unsigned int>(transforms_.size());
+
+	transforms_.push_back(transform);
+	owners_.push_back(&owner);
+	parents_.push_back(kNoTransform);
+	parent_slots_.push_back(kNoTransform);
+	translations_.push_back(translation);
+	rotations_.push_back(rotation);
+	scales_.push_back(scale);
+	local_transforms_.push_back(Affine3f::Identity());
+	world_transforms_.push_back(Affine3f::Identity());
+	flags_.push_back(kLocalDirty | kWorldDirty);
+
+	sorted_ = false;		// A new root may end up after a deeper transform
+
+	return transform;
+
+}
+
+void TransformSystem::DestroyTransform(unsigned int transform){
+
+	// The last slot fills the hole
+
+	auto slot = slots_[transform];
+
+	auto last = static_cast<unsigned int>(transforms_.size() - 1);
+
+	if (slot != last){
+
+		Move(last, slot);
+
+	}
+
+	sorted_ = false;		// The levels and the frozen slots need to be counted again
+
+	transforms_.pop_back();
+	owners_.pop_back();
+	parents_.pop_back();
+	parent_slots_.pop_back();
+	translations_.pop_back();
+	rotations_.pop_back();
+	scales_.pop_back();
+	local_transforms_.pop_back();
+	world_transforms_.pop_back();
+	flags_.pop_back();
+
+	slots_[transform] = kNoTransform;
+
+	free_transforms_.push_back(transform);
+
+}
+
+void TransformSystem::EndEdit(){
+
+	if (--edit_depth_ > 0){
+
+		return;
+
+	}
+
+	// Mark the subtree of each edited transform once. Children edited as well are marked by their own entry.
+
+	for (auto&& transform : edits_){
+
+		auto slot = slots_[transform];
+
+		if (slot == kNoTransform ||
+			(flags_[slot] & kEdited) == 0){
+
+			continue;		// Destroyed or recycled during the edit
+
+		}
+
+		flags_[slot] &= ~kEdited;
+
+		for (auto&& child : owners_[slot]->children_){
+
+			child->SetDirty(true);
+
+		}
+
+	}
+
+	edits_.clear();
+
+}
+
+void TransformSystem::SetParent(unsigned int transform, unsigned int parent){
+
+	parents_[slots_[transform]] = parent;
+
+	sorted_ = false;
+
+}
+
+const Affine3f& TransformSystem::GetLocalTransform(unsigned int transform) const{
+
+	auto slot = slots_[transform];
+
+	if (flags_[slot] & kLocalDirty){
+
+		local_transforms_[slot] = translations_[slot] * rotations_[slot] * scales_[slot];
+
+		flags_[slot] &= ~kLocalDirty;
+
+	}
+
+	return local_transforms_[slot];
+
+}
+
+void TransformSystem::EvaluateWorldTransform(unsigned int slot) const{
+
+	auto& local_transform = GetLocalTransform(transforms_[slot]);
+
+	auto parent = parents_[slot];
+
+	world_transforms_[slot] = (parent != kNoTransform) ?
+							  GetWorldTransform(parent) * local_transform :
+							  local_transform;
+
+	flags_[slot] &= ~kWorldDirty;		// The owner is still notified during the next update
+
+}
+
+void TransformSystem::Update(){
+
+	if (!sorted_){
+
+		Sort();
+
+	}
+
+	// Parents come before their children: by the time a transform is reached, the world matrix of its parent is up-to-date.
+
+	update_count_ = Sweep(frozen_count_, static_cast<unsigned int>(transforms_.size()));
+
+	CollectChanges();
+
+	for (size_t change = 0; change < changes_.size(); ++change){
+
+		UpdateBounds(change);
+
+	}
+
+	Publish();
+
+}
+
+void TransformSystem::Update(TaskPool& pool){
+
+	if (!sorted_){
+
+		Sort();
+
+	}
+
+	// The transforms of the same level only depend on the levels above: each level is split in chunks swept in parallel.
+
+	std::atomic<size_t> update_count(0);
+
+	for (size_t level = 0; level + 1 < levels_.size(); ++level){
+
+		auto begin = levels_[level];
+		auto end = levels_[level + 1];
+
+		if (end - begin <= kSweepChunk){
+
+			update_count += Sweep(begin, end);		// Not worth waking the pool
+
+			continue;
+
+		}
+
+		pool.ParallelFor((end - begin + kSweepChunk - 1) / kSweepChunk,
+						 [this, begin, end, &update_count](size_t chunk){
+
+							auto chunk_begin = begin + static_cast<unsigned int>(chunk) * kSweepChunk;
+
+							update_count += Sweep(chunk_begin,
+												  std::min(chunk_begin + kSweepChunk, end));
+
+						 });
+
+	}
+
+	update_count_ = update_count;
+
+	// Every world matrix is up-to-date: the bounds only read their own transform.
+
+	CollectChanges();
+
+	pool.ParallelFor(changes_.size(),
+					 [this](size_t change){
+
+						UpdateBounds(change);
+
+					 });
+
+	Publish();
+
+}
+
+size_t TransformSystem::Sweep(unsigned int begin, unsigned int end){
+
+	size_t update_count = 0;
+
+	for (auto slot = begin; slot < end; ++slot){
+
+		auto flags = flags_[slot];
+
+		if (flags & kLocalDirty){
+
+			local_transforms_[slot] = translations_[slot] * rotations_[slot] * scales_[slot];
+
+		}
+
+		if (flags & kWorldDirty){
+
+			auto parent_slot = parent_slots_[slot];
+
+			world_transforms_[slot] = (parent_slot != kNoTransform) ?
+									  world_transforms_[parent_slot] * local_transforms_[slot] :
+									  local_transforms_[slot];
+
+			++update_count;
+
+		}
+
+		flags_[slot] = flags & ~(kLocalDirty | kWorldDirty);
+
+	}
+
+	return update_count;
+
+}
+
+void TransformSystem::CollectChanges(){
+
+	auto count = transforms_.size();
+
+	for (size_t slot = frozen_count_; slot < count; ++slot){
+
+		auto& flags = flags_[slot];
+
+		if (flags & kChanged){
+
+			changes_.push_back(transforms_[slot]);
+
+			flags &= ~kChanged;
+
+			if (flags & kFreeze){
+
+				flags = (flags & ~kFreeze) | kFrozen;
+
+				sorted_ = false;		// Moved among the frozen transforms by the next update
+
+			}
+
+		}
+
+	}
+
+}
+
+void TransformSystem::UpdateBounds(size_t change){
+
+	for (auto&& volume : owners_[slots_[changes_[change]]]->volumes_){
+
+		volume->UpdateBounds();
+
+	}
+
+}
+
+void TransformSystem::Publish(){
+
+	// Publish the new bounds to the hierarchies first, so that listeners see a consistent scene.
+	// Transforms destroyed after being changed have no slot anymore.
+
+	for (auto&& transform : changes_){
+
+		auto slot = slots_[transform];
+
+		if (slot != kNoTransform){
+
+			for (auto&& volume : owners_[slot]->volumes_){
+
+				volume->NotifyChange();
+
+			}
+
+		}
+
+	}
+
+	// Listeners may read, move or destroy any transform: check whether each handle is still alive.
+
+	change_count_ = changes_.size();
+
+	for (auto&& transform : changes_){
+
+		auto slot = slots_[transform];
+
+		if (slot != kNoTransform){
+
+			owners_[slot]->NotifyChange();
+
+		}
+
+	}
+
+	changes_.clear();
+
+}
+
+void TransformSystem::Sort(){
+
+	// Counting sort by hierarchy level: stable and linear in the number of transforms. Frozen transforms are never swept, they come first regardless of their level.
+
+	auto count = static_cast<unsigned int>(transforms_.size());
+
+	vector<unsigned int> levels(count, kNoTransform);
+
+	vector<unsigned int> path;
+
+	unsigned int level_count = 0;
+
+	for (unsigned int slot = 0; slot < count; ++slot){
+
+		// Walk up until a transform whose level is known, then assign the levels on the way back
+
+		auto current = slot;
+
+		while (current != kNoTransform && levels[current] == kNoTransform){
+
+			path.push_back(current);
+
+			auto parent = parents_[current];
+
+			current = (parent != kNoTransform) ? slots_[parent] : kNoTransform;
+
+		}
+
+		auto level = (current != kNoTransform) ? levels[current] + 1 : 0;
+
+		for (auto it = path.rbegin(); it != path.rend(); ++it){
+
+			levels[*it] = level++;
+
+		}
+
+		level_count = std::max(level_count, level);
+
+		path.clear();
+
+	}
+
+	for (unsigned int slot = 0; slot < count; ++slot){
+
+		levels[slot] = (flags_[slot] & kFrozen) ? 0 : levels[slot] + 1;
+
+	}
+
+	vector<unsigned int> offsets(level_count + 2, 0);
+
+	for (auto&& level : levels){
+
+		++offsets[level + 1];
+
+	}
+
+	for (unsigned int level = 1; level <= level_count + 1; ++level){
+
+		offsets[level] += offsets[level - 1];
+
+	}
+
+	frozen_count_ = offsets[1];
+
+	levels_.assign(offsets.begin() + 1, offsets.end());
+
+	vector<unsigned int> order(count);
+
+	for (unsigned int slot = 0; slot < count; ++slot){
+
+		order[offsets[levels[slot]]++] = slot;
+
+	}
+
+	// Gather every array in the new order
+
+	auto transforms = transforms_;
+	auto owners = owners_;
+	auto parents = parents_;
+	auto translations = translations_;
+	auto rotations = rotations_;
+	auto scales = scales_;
+	auto local_transforms = local_transforms_;
+	auto world_transforms = world_transforms_;
+	auto flags = flags_;
+
+	for (unsigned int slot = 0; slot < count; ++slot){
+
+		auto source = order[slot];
+
+		transforms_[slot] = transforms[source];
+		owners_[slot] = owners[source];
+		parents_[slot] = parents[source];
+		translations_[slot] = translations[source];
+		rotations_[slot] = rotations[source];
+		scales_[slot] = scales[source];
+		local_transforms_[slot] = local_transforms[source];
+		world_transforms_[slot] = world_transforms[source];
+		flags_[slot] = flags[source];
+
+		slots_[transforms_[slot]] = slot;
+
+	}
+
+	for (unsigned int slot = 0; slot < count; ++slot){
+
+		auto parent = parents_[slot];
+
+		parent_slots_[slot] = (parent != kNoTransform) ? slots_[parent] : kNoTransform;
+
+	}
+
+	sorted_ = true;
+
+}
+
+void TransformSystem::Move(unsigned int source, unsigned int destination){
+
+	transforms_[destination] = transforms_[source];
+	owners_[destination] = owners_[source];
+	parents_[destination] = parents_[source];
+	parent_slots_[destination] = parent_slots_[source];
+	translations_[destination] = translations_[source];
+	rotations_[destination] = rotations_[source];
+	scales_[destination] = scales_[source];
+	local_transforms_[destination] = local_transforms_[source];
+	world_transforms_[destination] = world_transforms_[source];
+	flags_[destination] = flags_[source];
+
+	slots_[transforms_[destination]] = destination;
+
+}
+
 ////////////////////////////////////// SCENE //////////////////////////////////////////
 
 Scene::Scene(unique_ptr<IVolumeHierarchy> mesh_hierarchy, unique_ptr<IVolumeHierarchy> light_hierarchy) :
 main_camera_(nullptr),
-mesh_hierarchy_(std::move(mesh_hierarchy)),
-light_hierarchy_(std::move(light_hierarchy)){}
+mesh_hierarchy_(make_unique<SplitHierarchy>(std::move(mesh_hierarchy))),
+light_hierarchy_(make_unique<SplitHierarchy>(std::move(light_hierarchy))){}
 
 Scene::~Scene(){
 
@@ -122,7 +608,9 @@ Scene::~Scene(){
 
 NodeComponent* Scene::CreateNode(const wstring& name){
 
-	auto node = Component::Create<NodeComponent>(*this, name);
+	auto node = Component::CreateIn<NodeComponent>(allocator_, *this, name);
+
+	archetypes_.AddEntity(*node);
 
 	nodes_.push_back(node);
 
@@ -132,9 +620,11 @@ NodeComponent* Scene::CreateNode(const wstring& name){
 
 TransformComponent* Scene::CreateNode(const wstring& name, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale){
 
-	auto node = Component::Create<NodeComponent>(*this, name);
+	auto node = Component::CreateIn<NodeComponent>(allocator_, *this, name);
+
+	archetypes_.AddEntity(*node);
 
-	auto transform = node->AddComponent<TransformComponent>(translation, rotation, scale);
+	auto transform = node->AddComponent<TransformComponent>(transforms_, translation, rotation, scale);
 
 	// Node and transform are the same entity. When node is deleted, transform is deleted as well.
 	nodes_.push_back(node);	
@@ -143,6 +633,20 @@ TransformComponent* Scene::CreateNode(const wstring& name, const Translation3f&
 
 }
 
+TransformComponent* Scene::CreateStaticNode(const wstring& name, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale){
+
+	auto node = Component::CreateIn<NodeComponent>(allocator_, *this, name, true);
+
+	archetypes_.AddEntity(*node);
+
+	auto transform = node->AddComponent<TransformComponent>(transforms_, translation, rotation, scale);		// Frozen by the next commit
+
+	nodes_.push_back(node);
+
+	return transform;
+
+}
+
 CameraComponent* Scene::GetMainCamera(){
 
 	return main_camera_;
@@ -185,10 +689,38 @@ const IVolumeHierarchy& Scene::GetLightHierarchy() const {
 
 }
 
+void Scene::Commit(){
+
+	transforms_.Update();		// Moves the volumes of the nodes who changed
+
+	events_.Flush();			// Relocates the volumes inside the hierarchies
+
+	mesh_hierarchy_->Commit();
+
+	light_hierarchy_->Commit();
+
+}
+
+void Scene::Commit(TaskPool& pool){
+
+	transforms_.Update(pool);
+
+	events_.Flush();
+
+	mesh_hierarchy_->Commit();
+
+	light_hierarchy_->Commit();
+
+}
+
 ////////////////////////////////////// NODE COMPONENT /////////////////////////////////////
 
 NodeComponent::NodeComponent(Scene& scene, const wstring& name) :
+NodeComponent(scene, name, false){}
+
+NodeComponent::NodeComponent(Scene& scene, const wstring& name, bool is_static) :
 scene_(scene),
+is_static_(is_static),
 name_(name),
 uid_(Unique<NodeComponent>::MakeUnique()){}
 
@@ -219,13 +751,15 @@ const Unique<NodeComponent> NodeComponent::GetUid() const{
 
 }
 
-NodeComponent::TypeSet NodeComponent::GetTypes() const{
+bool NodeComponent::IsStatic() const{
+
+	return is_static_;
 
-	auto types = Component::GetTypes();
+}
 
-	types.insert(type_index(typeid(NodeComponent)));
+NodeComponent::TypeSet NodeComponent::GetTypes() const{
 
-	return types;
+	return DeriveTypes<NodeComponent>(Component::GetTypes());
 
 }
 
@@ -235,28 +769,57 @@ void NodeComponent::Finalize(){}
 
 ////////////////////////////////////// TRANSFORM COMPONENT /////////////////////////////////////
 
-TransformComponent::TransformComponent() :
-TransformComponent(Translation3f(Vector3f::Zero()),
+TransformComponent::TransformComponent(TransformSystem& system) :
+TransformComponent(system,
+				   Translation3f(Vector3f::Zero()),
 				   Quaternionf::Identity(),
 				   AlignedScaling3f(Vector3f::Ones())){}
 
-TransformComponent::TransformComponent(const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale) :
-parent_(nullptr),
-translation_(translation),
-rotation_(rotation),
-scale_(scale),
-local_dirty_(true),
-world_dirty_(true){}
+TransformComponent::TransformComponent(TransformSystem& system, const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale) :
+system_(system),
+transform_(system.CreateTransform(*this, translation, rotation, scale)),
+parent_(nullptr){}
+
+TransformComponent::~TransformComponent(){
+
+	// Children become roots
+
+	for (auto&& child : children_){
+
+		child->parent_ = nullptr;
+
+		system_.SetParent(child->transform_, TransformSystem::kNoTransform);
+
+		child->SetDirty(true);
+
+	}
+
+	children_.clear();
+
+	if (parent_ != nullptr){
+
+		auto& parent_children = parent_->children_;
+
+		parent_children.erase(std::remove(parent_children.begin(),
+										  parent_children.end(),
+										  this),
+							  parent_children.end());
+
+	}
+
+	system_.DestroyTransform(transform_);
+
+}
 
 const Translation3f & TransformComponent::GetTranslation() const{
 
-	return translation_;
+	return system_.GetTranslation(transform_);
 
 }
 
 void TransformComponent::SetTranslation(const Translation3f & translation){
 
-	translation_ = translation;
+	system_.SetTranslation(transform_, translation);
 
 	SetDirty(false);	// World and local
 
@@ -264,13 +827,13 @@ void TransformComponent::SetTranslation(const Translation3f & translation){
 
 const Quaternionf & TransformComponent::GetRotation() const{
 
-	return rotation_;
+	return system_.GetRotation(transform_);
 
 }
 
 void TransformComponent::SetRotation(const Quaternionf & rotation){
 
-	rotation_ = rotation;
+	system_.SetRotation(transform_, rotation);
 
 	SetDirty(false);	// World and local
 
@@ -278,47 +841,37 @@ void TransformComponent::SetRotation(const Quaternionf & rotation){
 
 const AlignedScaling3f & TransformComponent::GetScale() const{
 
-	return scale_;
+	return system_.GetScale(transform_);
 
 }
 
 void TransformComponent::SetScale(const AlignedScaling3f & scale){
 
-	scale_ = scale;
+	system_.SetScale(transform_, scale);
 
 	SetDirty(false);	// World and local
 
 }
 
-const Affine3f & TransformComponent::GetLocalTransform() const{
+void TransformComponent::SetTRS(const Translation3f& translation, const Quaternionf& rotation, const AlignedScaling3f& scale){
 
-	if (local_dirty_){
+	system_.SetTranslation(transform_, translation);
+	system_.SetRotation(transform_, rotation);
+	system_.SetScale(transform_, scale);
 
-		local_transform_ = translation_ * rotation_ * scale_;
+	SetDirty(false);	// World and local
 
-		local_dirty_ = false;
+}
 
-	}
+const Affine3f & TransformComponent::GetLocalTransform() const{
 
-	return local_transform_;
+	return system_.GetLocalTransform(transform_);
 
 }
 
 const Affine3f & TransformComponent::GetWorldTransform() const{
 
-	if (world_dirty_){
-
-		auto local_transform = GetLocalTransform();
-
-		world_transform_ = parent_ ?
-						   parent_->GetWorldTransform() * local_transform :
-						   local_transform;
-
-		world_dirty_ = false;
-
-	}
-
-	return world_transform_;
+	return system_.GetWorldTransform(transform_);
 
 }
 
@@ -339,7 +892,7 @@ void TransformComponent::SetParent(TransformComponent* parent){
 	// Remove from the old parent
 	if (parent_ != nullptr){
 
-		auto& parent_children = parent->children_;
+		auto& parent_children = parent_->children_;
 
 		parent_children.erase(std::remove(parent_children.begin(),
 										  parent_children.end(),
@@ -357,6 +910,9 @@ void TransformComponent::SetParent(TransformComponent* parent){
 
 	}
 
+	system_.SetParent(transform_,
+					  parent != nullptr ? parent->transform_ : TransformSystem::kNoTransform);
+
 	// The world transform is now invalid
 	SetDirty(true);
 
@@ -378,35 +934,62 @@ TransformComponent::const_range TransformComponent::GetChildren() const{
 
 TransformComponent::TypeSet TransformComponent::GetTypes() const{
 
-	auto types = Component::GetTypes();
+	return DeriveTypes<TransformComponent>(Component::GetTypes());
 
-	types.insert(type_index(typeid(TransformComponent)));
+}
 
-	return types;
+void TransformComponent::Initialize(){
 
-}
+	// The transform of a static node is frozen by the next update
+
+	auto node = GetComponent<NodeComponent>();
+
+	if (node && node->IsStatic()){
 
-void TransformComponent::Initialize(){}
+		system_.Freeze(transform_);
+
+	}
+
+}
 
 void TransformComponent::Finalize(){}
 
 void TransformComponent::SetDirty(bool world_only){
 
-	local_dirty_ |= !world_only;
+	// A subtree whose root is dirty is dirty as a whole: the children need to be visited only the first time.
 
-	world_dirty_ = true;
+	if (system_.SetDirty(transform_, world_only)){
 
-	OnTransformChangedEventArgs args{ this };
+		for (auto& child : children_){
 
-	on_transform_changed_.Notify(args);
+			child->SetDirty(true);	// Children's matrix needs to be recalculated
+
+		}
+
+	}
 
-	// Invalidate the children recursively
+}
 
-	for (auto& child : children_){
+void TransformComponent::AttachVolume(VolumeComponent& volume){
 
-		child->SetDirty(true);	// Children's matrix needs to be recalculated
+	volumes_.push_back(&volume);
 
-	}
+}
+
+void TransformComponent::DetachVolume(VolumeComponent& volume){
+
+	volumes_.erase(std::remove(volumes_.begin(),
+							   volumes_.end(),
+							   &volume),
+				   volumes_.end());
+
+}
+
+void TransformComponent::NotifyChange(){
+
+	OnTransformChangedEventArgs args{ this };
+
+	on_transform_changed_.Notify(args);
 
 }
 
@@ -418,13 +1001,11 @@ Observable<TransformComponent::OnTransformChangedEventArgs>& TransformComponent:
 
 ///////////////////////// VOLUME COMPONENT /////////////////////////
 
-VolumeComponent::TypeSet VolumeComponent::GetTypes() const {
-
-	auto types = Component::GetTypes();
+const unsigned int VolumeComponent::kNoSlot = std::numeric_limits<unsigned int>::max();
 
-	types.insert(type_index(typeid(VolumeComponent)));
+VolumeComponent::TypeSet VolumeComponent::GetTypes() const {
 
-	return types;
+	return DeriveTypes<VolumeComponent>(Component::GetTypes());
 
 }
 
@@ -477,11 +1058,7 @@ IntersectionType MeshComponent::TestAgainst(const Sphere& sphere) const{
 
 MeshComponent::TypeSet MeshComponent::GetTypes() const{
 	
-	auto types = VolumeComponent::GetTypes();
-
-	types.insert(type_index(typeid(MeshComponent)));
-
-	return types;
+	return DeriveTypes<MeshComponent>(VolumeComponent::GetTypes());
 
 }
 
@@ -493,17 +1070,16 @@ void MeshComponent::Initialize(){
 	 
 	ComputeBounds(false);
 
-	on_transform_changed_lister_ = transform_->OnTransformChanged().Subscribe([this](_, _) {
-	 
-	 	ComputeBounds();	// The world matrix of the transform component changed.
-	 
-	});
+	transform_->AttachVolume(*this);		// The bounds follow the world matrix of the transform component.
 
-	// Plug the mesh inside the mesh hierarchy
+	// Plug the mesh inside the mesh hierarchy. Changes are delivered once per frame.
 
-	GetComponent<NodeComponent>()->GetScene()
-								 .GetMeshHierarchy()
-								 .AddVolume(this);
+	auto& scene = GetComponent<NodeComponent>()->GetScene();
+
+	DeferChanges(&scene.GetEventQueue());
+
+	scene.GetMeshHierarchy()
+		 .AddVolume(this);
 
 }
 
@@ -515,6 +1091,16 @@ void MeshComponent::Finalize(){
 								 .GetMeshHierarchy()
 								 .RemoveVolume(this);
 
+	DeferChanges(nullptr);
+
+	transform_->DetachVolume(*this);
+
+}
+
+void MeshComponent::UpdateBounds() {
+
+	ComputeBounds(false);
+
 }
 
 void MeshComponent::ComputeBounds(bool notify) {
@@ -635,11 +1221,7 @@ Frustum CameraComponent::GetViewFrustum(float aspect_ratio) const{
 
 CameraComponent::TypeSet CameraComponent::GetTypes() const{
 
-	auto types = Component::GetTypes();
-
-	types.insert(type_index(typeid(CameraComponent)));
-
-	return types;
+	return DeriveTypes<CameraComponent>(Component::GetTypes());
 
 }
 
@@ -0,0 +1,531 @@
+#include "scene_snapshot.h"
+
+#include <fstream>
+#include <cstring>
+#include <type_traits>
+
+using namespace ::gi_lib;
+using namespace ::std;
+
+///////////////////////////////// SCENE SNAPSHOT :: HEADER /////////////////////////////////
+
+/// \brief Header of a snapshot, stored at the beginning of the memory block.
+struct SceneSnapshot::Header{
+
+	char magic[4];										///< \brief Identifies the file as a scene snapshot.
+
+	unsigned int version;								///< \brief Version of the format.
+
+	unsigned int char_size;								///< \brief Size of a wide character on the platform who wrote the snapshot.
+
+	unsigned int reserved;								///< \brief Padding.
+
+	SnapshotArray<SnapshotNode> nodes;					///< \brief Nodes of the hierarchy.
+
+	SnapshotArray<SnapshotMesh> meshes;					///< \brief Meshes referenced by the nodes.
+
+	SnapshotArray<SnapshotMaterial> materials;			///< \brief Materials referenced by the subsets.
+
+};
+
+namespace{
+
+	/// \brief Identifies the file as a scene snapshot.
+	const char kMagic[4] = { 'G', 'I', 'S', 'S' };
+
+	/// \brief Size of a word of the memory block.
+	const size_t kWordSize = sizeof(unsigned long long);
+
+	/// \brief Reserve zero-filled room for some elements at the end of a memory block.
+	/// \return Returns the array of elements, stored as an offset.
+	template <typename TElement>
+	SnapshotArray<TElement> Append(vector<unsigned long long>& buffer, size_t count){
+
+		SnapshotArray<TElement> array;
+
+		array.offset = buffer.size() * kWordSize;
+		array.size = count;
+
+		buffer.resize(buffer.size() + (count * sizeof(TElement) + kWordSize - 1) / kWordSize, 0);
+
+		return array;
+
+	}
+
+	/// \brief Copy some elements at the end of a memory block.
+	/// \return Returns the array of elements, stored as an offset.
+	template <typename TElement>
+	SnapshotArray<TElement> Append(vector<unsigned long long>& buffer, const TElement* elements, size_t count){
+
+		auto array = Append<TElement>(buffer, count);
+
+		if (count > 0){
+
+			memcpy(reinterpret_cast<char*>(buffer.data()) + array.offset,
+				   elements,
+				   count * sizeof(TElement));
+
+		}
+
+		return array;
+
+	}
+
+	/// \brief Access an element of an array stored as an offset.
+	/// The reference is invalidated by the next append.
+	template <typename TElement>
+	TElement& Element(vector<unsigned long long>& buffer, const SnapshotArray<TElement>& array, size_t index){
+
+		return reinterpret_cast<TElement*>(reinterpret_cast<char*>(buffer.data()) + array.offset)[index];
+
+	}
+
+	/// \brief Compute the bounds of a list of vertices.
+	AABB ComputeBounds(const vector<VertexFormatNormalTextured>& vertices){
+
+		if (vertices.empty()){
+
+			return AABB{ Vector3f::Zero(), Vector3f::Zero() };
+
+		}
+
+		Vector3f min_corner = vertices[0].position;
+		Vector3f max_corner = vertices[0].position;
+
+		for (auto&& vertex : vertices){
+
+			min_corner = min_corner.cwiseMin(vertex.position);
+			max_corner = max_corner.cwiseMax(vertex.position);
+
+		}
+
+		return AABB{ 0.5f * (max_corner + min_corner),
+					 0.5f * (max_corner - min_corner) };
+
+	}
+
+	/// \brief Replaces the offsets of the arrays with pointers, checking that each array lies inside the memory block.
+	struct FixUp{
+
+		char* base;						///< \brief Beginning of the memory block.
+
+		unsigned long long size;		///< \brief Size of the memory block.
+
+		template <typename TElement>
+		TElement* operator()(SnapshotArray<TElement>& array) const{
+
+			if (array.offset > size ||
+				array.offset % std::alignment_of<TElement>::value != 0 ||
+				array.size > (size - array.offset) / sizeof(TElement)){
+
+				return nullptr;
+
+			}
+
+			array.data = reinterpret_cast<TElement*>(base + array.offset);
+
+			return array.data;
+
+		}
+
+	};
+
+	/// \brief Replaces the pointers of the arrays of a copy of a memory block with offsets.
+	struct Unfix{
+
+		const char* source;				///< \brief Beginning of the memory block the pointers refer to.
+
+		char* destination;				///< \brief Beginning of the copy.
+
+		template <typename TElement>
+		TElement* operator()(SnapshotArray<TElement>& array) const{
+
+			array.offset = static_cast<unsigned long long>(reinterpret_cast<const char*>(array.data) - source);
+
+			return reinterpret_cast<TElement*>(destination + array.offset);
+
+		}
+
+	};
+
+}
+
+///////////////////////////////// SCENE SNAPSHOT /////////////////////////////////
+
+const unsigned int SceneSnapshot::kNone = static_cast<unsigned int>(-1);
+
+const unsigned int SceneSnapshot::kVersion = 1;
+
+SceneSnapshot::SceneSnapshot(const Description& description){
+
+	Append<Header>(buffer_, 1);
+
+	// Nodes
+
+	auto nodes = Append<SnapshotNode>(buffer_, description.nodes.size());
+
+	for (size_t node_index = 0; node_index < description.nodes.size(); ++node_index){
+
+		auto& node = description.nodes[node_index];
+
+		auto name = Append(buffer_, node.name.data(), node.name.size());
+
+		auto& record = Element(buffer_, nodes, node_index);
+
+		record.name = name;
+		record.parent = node.parent;
+		record.mesh = node.mesh;
+
+		Eigen::Map<Vector3f>(record.translation) = node.translation.vector();
+		Eigen::Map<Vector4f>(record.rotation) = node.rotation.coeffs();
+		Eigen::Map<Vector3f>(record.scale) = node.scale.diagonal();
+
+	}
+
+	// Meshes
+
+	auto meshes = Append<SnapshotMesh>(buffer_, description.meshes.size());
+
+	for (size_t mesh_index = 0; mesh_index < description.meshes.size(); ++mesh_index){
+
+		auto& mesh = description.meshes[mesh_index];
+
+		auto name = Append(buffer_, mesh.name.data(), mesh.name.size());
+
+		auto vertices = Append(buffer_, mesh.vertices.data(), mesh.vertices.size());
+
+		auto subsets = Append<SnapshotSubset>(buffer_, mesh.subsets.size());
+
+		for (size_t subset_index = 0; subset_index < mesh.subsets.size(); ++subset_index){
+
+			auto& subset = mesh.subsets[subset_index];
+
+			auto subset_name = Append(buffer_, subset.name.data(), subset.name.size());
+
+			auto& subset_record = Element(buffer_, subsets, subset_index);
+
+			subset_record.name = subset_name;
+			subset_record.start_index = subset.range.start_index;
+			subset_record.count = subset.range.count;
+			subset_record.material = subset.material;
+
+		}
+
+		auto& record = Element(buffer_, meshes, mesh_index);
+
+		record.name = name;
+		record.vertices = vertices;
+		record.subsets = subsets;
+		record.bounds = ComputeBounds(mesh.vertices);
+
+	}
+
+	// Materials
+
+	auto materials = Append<SnapshotMaterial>(buffer_, description.materials.size());
+
+	for (size_t material_index = 0; material_index < description.materials.size(); ++material_index){
+
+		auto& material = description.materials[material_index];
+
+		auto name = Append(buffer_, material.name.data(), material.name.size());
+
+		auto properties = Append<SnapshotProperty>(buffer_, material.properties.size());
+
+		for (size_t property_index = 0; property_index < material.properties.size(); ++property_index){
+
+			auto& property = material.properties[property_index];
+
+			auto property_name = Append(buffer_, property.name.data(), property.name.size());
+
+			auto property_value = Append(buffer_, property.value.data(), property.value.size());
+
+			auto& property_record = Element(buffer_, properties, property_index);
+
+			property_record.name = property_name;
+			property_record.value = property_value;
+
+		}
+
+		auto& record = Element(buffer_, materials, material_index);
+
+		record.name = name;
+		record.properties = properties;
+
+	}
+
+	// Header
+
+	auto& header = reinterpret_cast<Header&>(buffer_[0]);
+
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+
+	header.version = kVersion;
+	header.char_size = sizeof(wchar_t);
+	header.nodes = nodes;
+	header.meshes = meshes;
+	header.materials = materials;
+
+	Relocate(header, FixUp{ reinterpret_cast<char*>(buffer_.data()), buffer_.size() * kWordSize });
+
+}
+
+SceneSnapshot::SceneSnapshot(vector<unsigned long long> buffer) :
+buffer_(std::move(buffer)){}
+
+unique_ptr<SceneSnapshot> SceneSnapshot::FromImage(vector<unsigned long long> buffer, size_t size){
+
+	if (size < sizeof(Header)){
+
+		return nullptr;
+
+	}
+
+	auto& header = reinterpret_cast<Header&>(buffer[0]);
+
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+		header.version != kVersion ||
+		header.char_size != sizeof(wchar_t) ||
+		!Relocate(header, FixUp{ reinterpret_cast<char*>(buffer.data()), size })){
+
+		return nullptr;
+
+	}
+
+	// Moving the buffer preserves the pointers
+
+	unique_ptr<SceneSnapshot> snapshot(new SceneSnapshot(std::move(buffer)));
+
+	if (!snapshot->Validate()){
+
+		return nullptr;
+
+	}
+
+	return snapshot;
+
+}
+
+vector<unsigned long long> SceneSnapshot::GetImage() const{
+
+	auto image = buffer_;
+
+	Relocate(reinterpret_cast<Header&>(image[0]),
+			 Unfix{ reinterpret_cast<const char*>(buffer_.data()), reinterpret_cast<char*>(image.data()) });
+
+	return image;
+
+}
+
+unique_ptr<SceneSnapshot> SceneSnapshot::Load(const wstring& file_name){
+
+	std::ifstream file(file_name.c_str(), ios::binary | ios::ate);
+
+	if (!file.good()){
+
+		return nullptr;
+
+	}
+
+	auto size = static_cast<size_t>(file.tellg());
+
+	// Single read of the whole snapshot, followed by the fix-up of the offsets
+
+	vector<unsigned long long> buffer((size + kWordSize - 1) / kWordSize);
+
+	file.seekg(0);
+
+	if (!file.read(reinterpret_cast<char*>(buffer.data()), size)){
+
+		return nullptr;
+
+	}
+
+	return FromImage(std::move(buffer), size);
+
+}
+
+unique_ptr<SceneSnapshot> SceneSnapshot::Load(const void* data, size_t size){
+
+	// The copy keeps every record aligned, whatever the alignment of the source
+
+	vector<unsigned long long> buffer((size + kWordSize - 1) / kWordSize);
+
+	memcpy(buffer.data(), data, size);
+
+	return FromImage(std::move(buffer), size);
+
+}
+
+bool SceneSnapshot::Save(const wstring& file_name) const{
+
+	auto image = GetImage();
+
+	std::ofstream file(file_name.c_str(), ios::binary | ios::trunc);
+
+	file.write(reinterpret_cast<const char*>(image.data()),
+			   image.size() * kWordSize);
+
+	return file.good();
+
+}
+
+void SceneSnapshot::Save(vector<char>& data) const{
+
+	auto image = GetImage();
+
+	data.resize(image.size() * kWordSize);
+
+	memcpy(data.data(), image.data(), data.size());
+
+}
+
+const SnapshotArray<SnapshotNode>& SceneSnapshot::GetNodes() const{
+
+	return GetHeader().nodes;
+
+}
+
+const SnapshotArray<SnapshotMesh>& SceneSnapshot::GetMeshes() const{
+
+	return GetHeader().meshes;
+
+}
+
+const SnapshotArray<SnapshotMaterial>& SceneSnapshot::GetMaterials() const{
+
+	return GetHeader().materials;
+
+}
+
+size_t SceneSnapshot::GetSize() const{
+
+	return buffer_.size() * kWordSize;
+
+}
+
+const SceneSnapshot::Header& SceneSnapshot::GetHeader() const{
+
+	return reinterpret_cast<const Header&>(buffer_[0]);
+
+}
+
+template <typename TRelocate>
+bool SceneSnapshot::Relocate(Header& header, const TRelocate& relocate){
+
+	auto nodes = relocate(header.nodes);
+	auto meshes = relocate(header.meshes);
+	auto materials = relocate(header.materials);
+
+	if (!nodes || !meshes || !materials){
+
+		return false;
+
+	}
+
+	for (size_t node_index = 0; node_index < header.nodes.size; ++node_index){
+
+		if (!relocate(nodes[node_index].name)){
+
+			return false;
+
+		}
+
+	}
+
+	for (size_t mesh_index = 0; mesh_index < header.meshes.size; ++mesh_index){
+
+		auto& mesh = meshes[mesh_index];
+
+		auto subsets = relocate(mesh.subsets);
+
+		if (!relocate(mesh.name) ||
+			!relocate(mesh.vertices) ||
+			!subsets){
+
+			return false;
+
+		}
+
+		for (size_t subset_index = 0; subset_index < mesh.subsets.size; ++subset_index){
+
+			if (!relocate(subsets[subset_index].name)){
+
+				return false;
+
+			}
+
+		}
+
+	}
+
+	for (size_t material_index = 0; material_index < header.materials.size; ++material_index){
+
+		auto& material = materials[material_index];
+
+		auto properties = relocate(material.properties);
+
+		if (!relocate(material.name) ||
+			!properties){
+
+			return false;
+
+		}
+
+		for (size_t property_index = 0; property_index < material.properties.size; ++property_index){
+
+			if (!relocate(properties[property_index].name) ||
+				!relocate(properties[property_index].value)){
+
+				return false;
+
+			}
+
+		}
+
+	}
+
+	return true;
+
+}
+
+bool SceneSnapshot::Validate() const{
+
+	auto& nodes = GetNodes();
+	auto& meshes = GetMeshes();
+	auto& materials = GetMaterials();
+
+	// Parents must precede their children, every index must be in range
+
+	for (size_t node_index = 0; node_index < nodes.size; ++node_index){
+
+		auto& node = nodes[node_index];
+
+		if ((node.parent != kNone && node.parent >= node_index) ||
+			(node.mesh != kNone && node.mesh >= meshes.size)){
+
+			return false;
+
+		}
+
+	}
+
+	for (auto&& mesh : meshes){
+
+		for (auto&& subset : mesh.subsets){
+
+			if ((subset.material != kNone && subset.material >= materials.size) ||
+				subset.count > mesh.vertices.size / 3 ||
+				subset.start_index > mesh.vertices.size - subset.count * 3){
+
+				return false;
+
+			}
+
+		}
+
+	}
+
+	return true;
+
+}
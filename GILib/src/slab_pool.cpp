@@ -0,0 +1,102 @@
+#include "slab_pool.h"
+
+#include <algorithm>
+
+using namespace ::gi_lib;
+using namespace ::std;
+
+///////////////////////////////// SLAB POOL /////////////////////////////////
+
+const size_t SlabPool::kAlignment = 16;
+
+const size_t SlabPool::kSlabSize = 64 * 1024;
+
+SlabPool::SlabPool(size_t block_size) :
+free_list_(nullptr){
+
+	// Each block must hold the free list link and keep the next block aligned
+
+	block_size = std::max(block_size, sizeof(FreeBlock));
+
+	block_size = (block_size + kAlignment - 1) / kAlignment * kAlignment;
+
+	slab_blocks_ = std::max(kSlabSize / block_size, static_cast<size_t>(1));
+
+	statistics_.block_size = block_size;
+	statistics_.live_count = 0;
+	statistics_.peak_count = 0;
+	statistics_.allocation_count = 0;
+	statistics_.slab_count = 0;
+	statistics_.reserved_bytes = 0;
+
+}
+
+SlabPool::~SlabPool(){}
+
+void* SlabPool::Allocate(){
+
+	if (!free_list_){
+
+		Grow();
+
+	}
+
+	auto block = free_list_;
+
+	free_list_ = block->next;
+
+	++statistics_.allocation_count;
+
+	statistics_.peak_count = std::max(statistics_.peak_count, ++statistics_.live_count);
+
+	return block;
+
+}
+
+void SlabPool::Free(void* block){
+
+	if (!block){
+
+		return;
+
+	}
+
+	auto free_block = static_cast<FreeBlock*>(block);
+
+	free_block->next = free_list_;
+
+	free_list_ = free_block;
+
+	--statistics_.live_count;
+
+}
+
+void SlabPool::Grow(){
+
+	// Slabs are allocated with the default alignment: the padding moves the first block to the required one.
+
+	auto size = slab_blocks_ * statistics_.block_size + kAlignment - 1;
+
+	slabs_.push_back(unique_ptr<char[]>(new char[size]));
+
+	auto address = reinterpret_cast<size_t>(slabs_.back().get());
+
+	auto first = reinterpret_cast<char*>((address + kAlignment - 1) / kAlignment * kAlignment);
+
+	// Blocks are linked backwards so that they are handed out in address order
+
+	for (auto index = slab_blocks_; index > 0; --index){
+
+		auto block = reinterpret_cast<FreeBlock*>(first + (index - 1) * statistics_.block_size);
+
+		block->next = free_list_;
+
+		free_list_ = block;
+
+	}
+
+	++statistics_.slab_count;
+
+	statistics_.reserved_bytes += size;
+
+}
@@ -0,0 +1,303 @@
+#include "split_hierarchy.h"
+
+#include <algorithm>
+
+#include "gilib.h"
+#include "scene.h"
+#include "static_tree.h"
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Index of the dynamic hierarchy.
+	const unsigned int kDynamic = 0;
+
+	/// \brief Index of the static hierarchy.
+	const unsigned int kStatic = 1;
+
+	/// \brief Number of child hierarchies. The static hierarchy follows the dynamic one.
+	const unsigned int kHierarchyCount = 2;
+
+}
+
+///////////////////////////////////// SPLIT HIERARCHY ////////////////////////////////////
+
+SplitHierarchy::SplitHierarchy(unique_ptr<IVolumeHierarchy> dynamic_hierarchy) :
+dynamic_hierarchy_(std::move(dynamic_hierarchy)),
+static_hierarchy_(make_unique<StaticTree>()),
+dynamic_revision_(dynamic_hierarchy_->GetChangeLog().GetRevision()),
+static_revision_(static_hierarchy_->GetChangeLog().GetRevision()){
+
+	volume_counts_[kDynamic] = 0;
+	volume_counts_[kStatic] = 0;
+
+}
+
+SplitHierarchy::~SplitHierarchy(){}
+
+void SplitHierarchy::AddVolume(VolumeComponent* volume){
+
+	auto index = GetHierarchyIndex(*volume);
+
+	GetHierarchy(index).AddVolume(volume);
+
+	++volume_counts_[index];
+
+	ForwardChanges();
+
+}
+
+void SplitHierarchy::RemoveVolume(VolumeComponent* volume){
+
+	auto index = GetHierarchyIndex(*volume);
+
+	auto& hierarchy = GetHierarchy(index);
+
+	// The children ignore the volumes they don't store: only an actual removal advances their log
+
+	auto revision = hierarchy.GetChangeLog().GetRevision();
+
+	hierarchy.RemoveVolume(volume);
+
+	if (hierarchy.GetChangeLog().GetRevision() != revision){
+
+		--volume_counts_[index];
+
+	}
+
+	ForwardChanges();
+
+}
+
+void SplitHierarchy::Commit(){
+
+	dynamic_hierarchy_->Commit();
+
+	static_hierarchy_->Commit();
+
+	ForwardChanges();
+
+}
+
+HierarchyStats SplitHierarchy::GetStats() const{
+
+	auto dynamic_stats = dynamic_hierarchy_->GetStats();
+
+	auto static_stats = static_hierarchy_->GetStats();
+
+	return HierarchyStats{ dynamic_stats.changes + static_stats.changes,
+						   dynamic_stats.relocations + static_stats.relocations,
+						   dynamic_stats.coalesced + static_stats.coalesced };
+
+}
+
+const VolumeChangeLog& SplitHierarchy::GetChangeLog() const{
+
+	return change_log_;
+
+}
+
+void SplitHierarchy::GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const{
+
+	dynamic_hierarchy_->GetIntersections(frustum, intersections);
+
+	static_hierarchy_->GetIntersections(frustum, intersections);
+
+}
+
+void SplitHierarchy::GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const{
+
+	dynamic_hierarchy_->GetIntersections(sphere, intersections);
+
+	static_hierarchy_->GetIntersections(sphere, intersections);
+
+}
+
+void SplitHierarchy::GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const{
+
+	dynamic_hierarchy_->GetIntersections(aabb, intersections);
+
+	static_hierarchy_->GetIntersections(aabb, intersections);
+
+}
+
+bool SplitHierarchy::VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const{
+
+	return dynamic_hierarchy_->VisitIntersections(frustum, visitor) &&
+		   static_hierarchy_->VisitIntersections(frustum, visitor);
+
+}
+
+bool SplitHierarchy::VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const{
+
+	return dynamic_hierarchy_->VisitIntersections(sphere, visitor) &&
+		   static_hierarchy_->VisitIntersections(sphere, visitor);
+
+}
+
+bool SplitHierarchy::VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const{
+
+	return dynamic_hierarchy_->VisitIntersections(aabb, visitor) &&
+		   static_hierarchy_->VisitIntersections(aabb, visitor);
+
+}
+
+const IVolumeHierarchy& SplitHierarchy::GetDynamicHierarchy() const{
+
+	return *dynamic_hierarchy_;
+
+}
+
+const IVolumeHierarchy& SplitHierarchy::GetStaticHierarchy() const{
+
+	return *static_hierarchy_;
+
+}
+
+void SplitHierarchy::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	// Both traversals record their results inside the same batch
+
+	dynamic_hierarchy_->GetGroupIntersections(batch, group);
+
+	static_hierarchy_->GetGroupIntersections(batch, group);
+
+}
+
+void SplitHierarchy::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	// The partitions are shared among the children in proportion to their volumes: each child is split on its own, then its partitions are tagged so that they can be routed back to it.
+
+	vector<HierarchyPartition> child_partitions;
+
+	auto remaining_count = count;
+
+	auto remaining_volumes = volume_counts_[kDynamic] + volume_counts_[kStatic];
+
+	for (unsigned int index = 0; index < kHierarchyCount; ++index){
+
+		auto volume_count = volume_counts_[index];
+
+		if (volume_count == 0){
+
+			continue;		// Nothing to find
+
+		}
+
+		// Rounded to the nearest partition, the last child takes whatever is left
+
+		auto child_count = (remaining_count * volume_count + remaining_volumes / 2) / remaining_volumes;
+
+		remaining_count -= child_count;
+
+		remaining_volumes -= volume_count;
+
+		child_partitions.clear();
+
+		GetHierarchy(index).GetPartitions(std::max<size_t>(child_count, 1), child_partitions);
+
+		for (auto&& partition : child_partitions){
+
+			partitions.push_back(HierarchyPartition{ partition.node, partition.subtree, index });
+
+		}
+
+	}
+
+}
+
+void SplitHierarchy::GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	GetHierarchy(partition.hierarchy).GetPartitionIntersections(frustum,
+																 HierarchyPartition{ partition.node, partition.subtree },
+																 intersections);
+
+}
+
+void SplitHierarchy::GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	GetHierarchy(partition.hierarchy).GetPartitionIntersections(sphere,
+																 HierarchyPartition{ partition.node, partition.subtree },
+																 intersections);
+
+}
+
+void SplitHierarchy::GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	GetHierarchy(partition.hierarchy).GetPartitionIntersections(aabb,
+																 HierarchyPartition{ partition.node, partition.subtree },
+																 intersections);
+
+}
+
+unsigned int SplitHierarchy::GetHierarchyIndex(const VolumeComponent& volume) const{
+
+	// The flag of a node never changes, so a volume is always routed to the same hierarchy.
+
+	auto node = volume.GetComponent<NodeComponent>();
+
+	return (node && node->IsStatic()) ?
+		   kStatic :
+		   kDynamic;
+
+}
+
+IVolumeHierarchy& SplitHierarchy::GetHierarchy(unsigned int index){
+
+	return (index == kDynamic) ?
+		   *dynamic_hierarchy_ :
+		   *static_hierarchy_;
+
+}
+
+const IVolumeHierarchy& SplitHierarchy::GetHierarchy(unsigned int index) const{
+
+	return (index == kDynamic) ?
+		   *dynamic_hierarchy_ :
+		   *static_hierarchy_;
+
+}
+
+void SplitHierarchy::ForwardChanges(){
+
+	ForwardChanges(*dynamic_hierarchy_, dynamic_revision_);
+
+	ForwardChanges(*static_hierarchy_, static_revision_);
+
+}
+
+void SplitHierarchy::ForwardChanges(const IVolumeHierarchy& hierarchy, size_t& revision){
+
+	auto& log = hierarchy.GetChangeLog();
+
+	if (revision < log.GetOldestRevision()){
+
+		change_log_.Discard();		// Some changes are gone already: the observers have to start over
+
+	}
+	else{
+
+		for (; revision < log.GetRevision(); ++revision){
+
+			auto& change = log.GetChange(revision);
+
+			if (change.removed){
+
+				change_log_.RecordRemoval(change.volume);
+
+			}
+			else{
+
+				change_log_.RecordChange(change.volume);
+
+			}
+
+		}
+
+	}
+
+	revision = log.GetRevision();
+
+}
@@ -0,0 +1,846 @@
+#include "static_tree.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "gilib.h"
+#include "gimath.h"
+#include "scene.h"
+#include "exceptions.h"
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Index used to mark a missing node.
+	const unsigned int kNone = std::numeric_limits<unsigned int>::max();
+
+	/// \brief Maximum number of volumes referenced by a leaf.
+	const unsigned int kLeafSize = 4;
+
+	/// \brief Maximum depth of the tree. Median splits halve the volumes at each level, so the depth never exceeds the logarithm of their number.
+	const size_t kMaxDepth = 64;
+
+	/// \brief Node of the tree.
+	/// Nodes are stored in depth-first order: the first child of an internal node follows the node itself, the second child follows the whole subtree of the first one.
+	struct StaticNode{
+
+		AABB bounds;							///< \brief Bounds enclosing every volume below this node.
+
+		unsigned int skip;						///< \brief Index of the first node past the subtree of this node. Leaves are followed directly by the next subtree.
+
+		unsigned int first;						///< \brief Index of the first volume below this node.
+
+		unsigned int count;						///< \brief Number of volumes below this node.
+
+	};
+
+	/// \brief Entry of the stack used to resolve a group of queries.
+	struct BatchEntry{
+
+		unsigned int node;							///< \brief Index of the node to visit.
+
+		VolumeQueryBatch::QueryMask active;			///< \brief Queries intersecting the parent node.
+
+		VolumeQueryBatch::QueryMask contained;		///< \brief Queries fully containing the parent node.
+
+	};
+
+	/// \brief Check whether a box has finite extents.
+	bool IsBounded(const AABB& aabb){
+
+		return std::isfinite(aabb.half_extents(0)) &&
+			   std::isfinite(aabb.half_extents(1)) &&
+			   std::isfinite(aabb.half_extents(2));
+
+	}
+
+	/// \brief Build a subtree top-down by splitting the volumes at the median of the axis with the largest centroid spread.
+	/// \param bounds Bounds of each volume.
+	/// \param indices Indices of the volumes to partition. Reordered in place: each subtree ends up referencing a contiguous range.
+	/// \param begin First index of the range to build.
+	/// \param end One past the last index of the range to build.
+	/// \param nodes Destination node array.
+	void BuildSubtree(const vector<AABB>& bounds, vector<unsigned int>& indices, unsigned int begin, unsigned int end, vector<StaticNode>& nodes){
+
+		auto node_index = nodes.size();
+
+		// Node bounds and centroid bounds
+
+		auto& first_bounds = bounds[indices[begin]];
+
+		Vector3f min_corner = first_bounds.center - first_bounds.half_extents;
+		Vector3f max_corner = first_bounds.center + first_bounds.half_extents;
+
+		Vector3f centroid_min = first_bounds.center;
+		Vector3f centroid_max = first_bounds.center;
+
+		for (auto index = begin + 1; index < end; ++index){
+
+			auto& volume_bounds = bounds[indices[index]];
+
+			min_corner = min_corner.cwiseMin(volume_bounds.center - volume_bounds.half_extents);
+			max_corner = max_corner.cwiseMax(volume_bounds.center + volume_bounds.half_extents);
+
+			centroid_min = centroid_min.cwiseMin(volume_bounds.center);
+			centroid_max = centroid_max.cwiseMax(volume_bounds.center);
+
+		}
+
+		nodes.push_back(StaticNode{ AABB{ 0.5f * (max_corner + min_corner),
+										  0.5f * (max_corner - min_corner) },
+									kNone,
+									begin,
+									end - begin });
+
+		if (end - begin > kLeafSize){
+
+			int axis;
+
+			(centroid_max - centroid_min).maxCoeff(&axis);
+
+			auto middle = begin + (end - begin) / 2;
+
+			std::nth_element(indices.begin() + begin,
+							 indices.begin() + middle,
+							 indices.begin() + end,
+							 [&bounds, axis](unsigned int first, unsigned int second){
+
+								return bounds[first].center(axis) < bounds[second].center(axis);
+
+							 });
+
+			BuildSubtree(bounds, indices, begin, middle, nodes);
+			BuildSubtree(bounds, indices, middle, end, nodes);
+
+		}
+
+		nodes[node_index].skip = static_cast<unsigned int>(nodes.size());
+
+	}
+
+}
+
+////////////////////////////////// STATIC TREE :: IMPL /////////////////////////////////////
+
+struct StaticTree::Impl{
+
+	Impl();
+
+	void AddVolume(VolumeComponent* volume);
+
+	void RemoveVolume(VolumeComponent* volume);
+
+	void Commit();
+
+	HierarchyStats GetStats() const;
+
+	const VolumeChangeLog& GetChangeLog() const;
+
+	size_t GetNodeCount() const;
+
+	template <typename TVolume, typename TVisitor>
+	bool VisitIntersections(const TVolume& volume, TVisitor&& visitor) const;
+
+	void GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const;
+
+	void GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const;
+
+	template <typename TVolume>
+	void GetPartitionIntersections(const TVolume& volume, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const;
+
+private:
+
+	/// \brief Check whether a node is a leaf.
+	bool IsLeaf(unsigned int node) const;
+
+	/// \brief Visit the unbounded volumes who intersect a volume.
+	template <typename TVolume, typename TVisitor>
+	bool VisitUnbounded(const TVolume& volume, TVisitor&& visitor) const;
+
+	/// \brief Visit the volumes below a node who intersect a volume.
+	template <typename TVolume, typename TVisitor>
+	bool VisitSubtree(const TVolume& volume, unsigned int root, TVisitor&& visitor) const;
+
+	/// \brief Visit the volumes below a node who intersect a frustum.
+	template <typename TVisitor>
+	bool VisitSubtree(const Frustum& frustum, unsigned int root, TVisitor&& visitor) const;
+
+	/// \brief Visit the volumes referenced by a leaf who intersect a volume.
+	template <typename TVolume, typename TVisitor>
+	bool VisitLeaf(const TVolume& volume, const StaticNode& leaf, TVisitor&& visitor) const;
+
+	/// \brief Visit every volume below a node, without testing them.
+	template <typename TVisitor>
+	bool VisitVolumes(const StaticNode& node, TVisitor&& visitor) const;
+
+	/// \brief Build the tree from scratch, storing the pending volumes and dropping the holes left by the removed ones.
+	void Build();
+
+	vector<StaticNode> nodes_;								///< \brief Nodes of the tree, in depth-first order.
+
+	vector<VolumeComponent*> volumes_;						///< \brief Volumes referenced by the leaves, in depth-first order. Removed volumes leave a nullptr.
+
+	vector<VolumeComponent*> pending_volumes_;				///< \brief Bounded volumes added since the last build.
+
+	vector<VolumeComponent*> unbounded_;					///< \brief Volumes whose bounds are infinite. Always tested.
+
+	size_t hole_count_;										///< \brief Number of volumes removed since the last build.
+
+	HierarchyStats stats_;									///< \brief Statistics of the last commit.
+
+	VolumeChangeLog change_log_;							///< \brief Changes applied to the content of the tree.
+
+};
+
+StaticTree::Impl::Impl() :
+hole_count_(0),
+stats_(HierarchyStats{ 0u, 0u, 0u }){}
+
+void StaticTree::Impl::AddVolume(VolumeComponent* volume){
+
+	if (volume->GetHierarchySlot() != VolumeComponent::kNoSlot){
+
+		THROW(L"The volume already belongs to another hierarchy.");
+
+	}
+
+	if (IsBounded(volume->GetBoundingBox())){
+
+		pending_volumes_.push_back(volume);		// Stored by the next commit
+
+	}
+	else{
+
+		unbounded_.push_back(volume);
+
+	}
+
+	change_log_.RecordChange(volume);
+
+}
+
+void StaticTree::Impl::RemoveVolume(VolumeComponent* volume){
+
+	auto slot = volume->GetHierarchySlot();
+
+	if (slot < volumes_.size() &&
+		volumes_[slot] == volume){
+
+		// The tree is not touched: the bounds of the ancestors stay conservative until the next build.
+
+		volumes_[slot] = nullptr;
+
+		volume->SetHierarchySlot(VolumeComponent::kNoSlot);
+
+		++hole_count_;
+
+	}
+	else{
+
+		auto pending_it = std::find(pending_volumes_.begin(),
+									pending_volumes_.end(),
+									volume);
+
+		if (pending_it != pending_volumes_.end()){
+
+			pending_volumes_.erase(pending_it);
+
+		}
+		else{
+
+			auto unbounded_it = std::find(unbounded_.begin(),
+										  unbounded_.end(),
+										  volume);
+
+			if (unbounded_it == unbounded_.end()){
+
+				return;
+
+			}
+
+			unbounded_.erase(unbounded_it);
+
+		}
+
+	}
+
+	change_log_.RecordRemoval(volume);
+
+}
+
+void StaticTree::Impl::Commit(){
+
+	// Volumes never move: the only change worth a commit is a new volume.
+
+	if (!pending_volumes_.empty()){
+
+		Build();
+
+	}
+
+	stats_ = HierarchyStats{ 0u, 0u, 0u };
+
+}
+
+HierarchyStats StaticTree::Impl::GetStats() const{
+
+	return stats_;
+
+}
+
+const VolumeChangeLog& StaticTree::Impl::GetChangeLog() const{
+
+	return change_log_;
+
+}
+
+size_t StaticTree::Impl::GetNodeCount() const{
+
+	return nodes_.size();
+
+}
+
+bool StaticTree::Impl::IsLeaf(unsigned int node) const{
+
+	return nodes_[node].skip == node + 1;
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool StaticTree::Impl::VisitIntersections(const TVolume& volume, TVisitor&& visitor) const{
+
+	// Unbounded volumes cannot be culled by the hierarchy.
+
+	return VisitUnbounded(volume, visitor) &&
+		   (nodes_.empty() || VisitSubtree(volume, 0, visitor));
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool StaticTree::Impl::VisitUnbounded(const TVolume& volume, TVisitor&& visitor) const{
+
+	for (auto unbounded : unbounded_){
+
+		if ((unbounded->TestAgainst(volume) && IntersectionType::kIntersect) &&
+			!visitor(unbounded)){
+
+			return false;
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool StaticTree::Impl::VisitSubtree(const TVolume& volume, unsigned int root, TVisitor&& visitor) const{
+
+	// Linear walk: the next node is either the first child or, when the subtree is pruned or done, the node past it. No stack needed.
+
+	auto end = nodes_[root].skip;
+
+	for (auto node_index = root; node_index < end;){
+
+		auto& node = nodes_[node_index];
+
+		if (!(volume.Intersect(node.bounds) && IntersectionType::kIntersect)){
+
+			node_index = node.skip;		// Prune the whole subtree
+
+		}
+		else if (IsLeaf(node_index)){
+
+			if (!VisitLeaf(volume, node, visitor)){
+
+				return false;
+
+			}
+
+			node_index = node.skip;
+
+		}
+		else{
+
+			++node_index;
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVisitor>
+bool StaticTree::Impl::VisitSubtree(const Frustum& frustum, unsigned int root, TVisitor&& visitor) const{
+
+	// Same as the generic walk, but fully visible subtrees are visited without testing the volumes.
+
+	auto end = nodes_[root].skip;
+
+	for (auto node_index = root; node_index < end;){
+
+		auto& node = nodes_[node_index];
+
+		auto intersection = frustum.Intersect(node.bounds);
+
+		if (!(intersection && IntersectionType::kIntersect)){
+
+			node_index = node.skip;		// Prune the whole subtree
+
+		}
+		else if (intersection && IntersectionType::kInside){
+
+			if (!VisitVolumes(node, visitor)){
+
+				return false;
+
+			}
+
+			node_index = node.skip;
+
+		}
+		else if (IsLeaf(node_index)){
+
+			if (!VisitLeaf(frustum, node, visitor)){
+
+				return false;
+
+			}
+
+			node_index = node.skip;
+
+		}
+		else{
+
+			++node_index;
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVolume, typename TVisitor>
+bool StaticTree::Impl::VisitLeaf(const TVolume& volume, const StaticNode& leaf, TVisitor&& visitor) const{
+
+	for (auto index = leaf.first; index < leaf.first + leaf.count; ++index){
+
+		auto candidate = volumes_[index];
+
+		if (candidate &&
+			(candidate->TestAgainst(volume) && IntersectionType::kIntersect) &&
+			!visitor(candidate)){
+
+			return false;
+
+		}
+
+	}
+
+	return true;
+
+}
+
+template <typename TVisitor>
+bool StaticTree::Impl::VisitVolumes(const StaticNode& node, TVisitor&& visitor) const{
+
+	// The volumes of a subtree are contiguous
+
+	for (auto index = node.first; index < node.first + node.count; ++index){
+
+		auto candidate = volumes_[index];
+
+		if (candidate &&
+			!visitor(candidate)){
+
+			return false;
+
+		}
+
+	}
+
+	return true;
+
+}
+
+void StaticTree::Impl::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	auto active = batch.GetGroupMask(group);
+
+	for (auto unbounded : unbounded_){
+
+		auto queries = batch.TestAgainst(group, *unbounded, active, 0);
+
+		if (queries != 0){
+
+			batch.AddIntersection(group, queries, unbounded);
+
+		}
+
+	}
+
+	if (nodes_.empty()){
+
+		return;
+
+	}
+
+	// Each subtree carries its own masks, so the walk needs a stack. Its size never exceeds the depth of the tree.
+
+	BatchEntry stack[kMaxDepth + 1];
+
+	size_t stack_size = 0;
+
+	stack[stack_size++] = BatchEntry{ 0, active, 0 };
+
+	while (stack_size > 0){
+
+		auto entry = stack[--stack_size];
+
+		auto& node = nodes_[entry.node];
+
+		auto contained = entry.contained;
+
+		auto queries = batch.Intersect(group, node.bounds, entry.active, contained);
+
+		if (queries == 0){
+
+			continue;		// Prune the whole subtree
+
+		}
+
+		if (IsLeaf(entry.node)){
+
+			for (auto index = node.first; index < node.first + node.count; ++index){
+
+				auto candidate = volumes_[index];
+
+				if (!candidate){
+
+					continue;
+
+				}
+
+				auto found = batch.TestAgainst(group, *candidate, queries, contained);
+
+				if (found != 0){
+
+					batch.AddIntersection(group, found, candidate);
+
+				}
+
+			}
+
+		}
+		else{
+
+			auto first_child = entry.node + 1;
+
+			stack[stack_size++] = BatchEntry{ nodes_[first_child].skip, queries, contained };
+			stack[stack_size++] = BatchEntry{ first_child, queries, contained };
+
+		}
+
+	}
+
+}
+
+void StaticTree::Impl::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	// The unbounded volumes come first, then each internal node is replaced by its children, left to right:
+	// the order of the sequential traversal is preserved.
+
+	if (!unbounded_.empty()){
+
+		partitions.push_back(HierarchyPartition{ kNone, false });
+
+	}
+
+	if (nodes_.empty()){
+
+		return;
+
+	}
+
+	vector<HierarchyPartition> expanded;
+
+	partitions.push_back(HierarchyPartition{ 0, true });
+
+	bool split;
+
+	do{
+
+		split = false;
+
+		expanded.clear();
+
+		for (auto&& partition : partitions){
+
+			if (partition.node == kNone ||
+				IsLeaf(static_cast<unsigned int>(partition.node))){
+
+				expanded.push_back(partition);
+				continue;
+
+			}
+
+			auto first_child = partition.node + 1;
+
+			expanded.push_back(HierarchyPartition{ first_child, true });
+			expanded.push_back(HierarchyPartition{ nodes_[first_child].skip, true });
+
+			split = true;
+
+		}
+
+		partitions.swap(expanded);
+
+	} while (split && partitions.size() < count);
+
+}
+
+template <typename TVolume>
+void StaticTree::Impl::GetPartitionIntersections(const TVolume& volume, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	auto visitor = [&intersections](VolumeComponent* volume){
+
+		intersections.push_back(volume);
+		return true;
+
+	};
+
+	if (partition.node == kNone){
+
+		VisitUnbounded(volume, visitor);
+
+	}
+	else{
+
+		VisitSubtree(volume, static_cast<unsigned int>(partition.node), visitor);
+
+	}
+
+}
+
+void StaticTree::Impl::Build(){
+
+	// Slots of the pending volumes are claimed by this build: another hierarchy may have claimed them in the meantime.
+
+	for (auto volume : pending_volumes_){
+
+		if (volume->GetHierarchySlot() != VolumeComponent::kNoSlot){
+
+			THROW(L"The volume already belongs to another hierarchy.");
+
+		}
+
+	}
+
+	// Gather the volumes still alive and the new ones
+
+	vector<VolumeComponent*> volumes;
+
+	volumes.reserve(volumes_.size() - hole_count_ + pending_volumes_.size());
+
+	for (auto volume : volumes_){
+
+		if (volume){
+
+			volumes.push_back(volume);
+
+		}
+
+	}
+
+	volumes.insert(volumes.end(),
+				   pending_volumes_.begin(),
+				   pending_volumes_.end());
+
+	vector<AABB> bounds;
+
+	bounds.reserve(volumes.size());
+
+	for (auto volume : volumes){
+
+		bounds.push_back(volume->GetBoundingBox());
+
+	}
+
+	vector<unsigned int> indices(volumes.size());
+
+	for (unsigned int index = 0; index < indices.size(); ++index){
+
+		indices[index] = index;
+
+	}
+
+	// Build a fresh array, sized to fit: the tree is not going to grow until the next build.
+
+	vector<StaticNode> nodes;
+
+	nodes.reserve(2 * (volumes.size() + kLeafSize - 1) / kLeafSize);
+
+	BuildSubtree(bounds,
+				 indices,
+				 0,
+				 static_cast<unsigned int>(indices.size()),
+				 nodes);
+
+	nodes.shrink_to_fit();
+
+	nodes_.swap(nodes);
+
+	// Store the volumes in leaf order, so that each subtree references a contiguous range
+
+	volumes_.resize(volumes.size());
+
+	volumes_.shrink_to_fit();
+
+	for (unsigned int index = 0; index < indices.size(); ++index){
+
+		volumes_[index] = volumes[indices[index]];
+
+		volumes_[index]->SetHierarchySlot(index);
+
+	}
+
+	pending_volumes_.clear();
+
+	hole_count_ = 0;
+
+}
+
+///////////////////////////////////// STATIC TREE ////////////////////////////////////
+
+StaticTree::StaticTree() :
+pimpl_(make_unique<Impl>()){}
+
+StaticTree::~StaticTree(){}
+
+void StaticTree::AddVolume(VolumeComponent* volume){
+
+	pimpl_->AddVolume(volume);
+
+}
+
+void StaticTree::RemoveVolume(VolumeComponent* volume){
+
+	pimpl_->RemoveVolume(volume);
+
+}
+
+void StaticTree::Commit(){
+
+	pimpl_->Commit();
+
+}
+
+HierarchyStats StaticTree::GetStats() const{
+
+	return pimpl_->GetStats();
+
+}
+
+const VolumeChangeLog& StaticTree::GetChangeLog() const{
+
+	return pimpl_->GetChangeLog();
+
+}
+
+void StaticTree::GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(frustum,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+void StaticTree::GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(sphere,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+void StaticTree::GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->VisitIntersections(aabb,
+							   [&intersections](VolumeComponent* volume){
+
+									intersections.push_back(volume);
+									return true;
+
+							   });
+
+}
+
+bool StaticTree::VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(frustum, visitor);
+
+}
+
+bool StaticTree::VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(sphere, visitor);
+
+}
+
+bool StaticTree::VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const{
+
+	return pimpl_->VisitIntersections(aabb, visitor);
+
+}
+
+size_t StaticTree::GetNodeCount() const{
+
+	return pimpl_->GetNodeCount();
+
+}
+
+void StaticTree::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	pimpl_->GetGroupIntersections(batch, group);
+
+}
+
+void StaticTree::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	pimpl_->GetPartitions(count, partitions);
+
+}
+
+void StaticTree::GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(frustum, partition, intersections);
+
+}
+
+void StaticTree::GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(sphere, partition, intersections);
+
+}
+
+void StaticTree::GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	pimpl_->GetPartitionIntersections(aabb, partition, intersections);
+
+}
@@ -0,0 +1,406 @@
+#include "task_pool.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Range of indices owned by a thread of the pool.
+	/// The owner consumes the range from the front, thieves split it from the back.
+	struct WorkQueue{
+
+		mutex lock;					///< \brief Protects the range.
+
+		size_t begin;				///< \brief First index left.
+
+		size_t end;					///< \brief One past the last index left.
+
+	};
+
+}
+
+///////////////////////////////// TASK POOL :: IMPL /////////////////////////////////
+
+struct TaskPool::Impl{
+
+	Impl(unsigned int thread_count);
+
+	~Impl();
+
+	void ParallelFor(size_t count, const Task& task);
+
+	/// \brief Body of the worker threads.
+	/// \param queue Index of the queue owned by the worker.
+	void Work(unsigned int queue);
+
+	/// \brief Execute tasks until there is no work left, neither in the owned queue nor in any other.
+	/// \param queue Index of the queue owned by the calling thread.
+	void Run(unsigned int queue, const Task& task);
+
+	/// \brief Take the next index from a queue.
+	bool Pop(unsigned int queue, size_t& index);
+
+	/// \brief Move half of the work left inside the busiest queue to another queue.
+	/// \return Returns true if some work was stolen, returns false if every queue is empty.
+	bool Steal(unsigned int queue);
+
+	unsigned int thread_count_;					///< \brief Number of threads, including the calling one.
+
+	vector<thread> workers_;					///< \brief Worker threads.
+
+	unique_ptr<WorkQueue[]> queues_;			///< \brief Work left to each thread. The first queue belongs to the calling thread.
+
+	mutex mutex_;								///< \brief Protects the job state below.
+
+	condition_variable wake_;					///< \brief Signaled when a new job is available or the pool is destroyed.
+
+	condition_variable done_;					///< \brief Signaled when the last task of the job completes or the last worker leaves the job.
+
+	const Task* task_;							///< \brief Task of the current job. nullptr when no job is running.
+
+	size_t generation_;							///< \brief Incremented by each new job.
+
+	unsigned int busy_;							///< \brief Number of workers executing the current job.
+
+	bool stop_;									///< \brief Whether the workers should quit.
+
+	atomic<size_t> remaining_;					///< \brief Number of tasks of the current job not completed yet.
+
+	exception_ptr exception_;					///< \brief First exception thrown by a task of the current job. Protected by mutex_.
+
+};
+
+TaskPool::Impl::Impl(unsigned int thread_count) :
+thread_count_(std::max(thread_count, 1u)),
+queues_(new WorkQueue[std::max(thread_count, 1u)]),
+task_(nullptr),
+generation_(0),
+busy_(0),
+stop_(false),
+remaining_(0){
+
+	for (unsigned int queue = 0; queue < thread_count_; ++queue){
+
+		queues_[queue].begin = 0;
+		queues_[queue].end = 0;
+
+	}
+
+	for (unsigned int queue = 1; queue < thread_count_; ++queue){
+
+		workers_.push_back(thread(&Impl::Work, this, queue));
+
+	}
+
+}
+
+TaskPool::Impl::~Impl(){
+
+	{
+		lock_guard<mutex> lock(mutex_);
+
+		stop_ = true;
+	}
+
+	wake_.notify_all();
+
+	for (auto&& worker : workers_){
+
+		worker.join();
+
+	}
+
+}
+
+void TaskPool::Impl::ParallelFor(size_t count, const Task& task){
+
+	if (thread_count_ == 1 || count <= 1){
+
+		exception_ptr exception;
+
+		for (size_t index = 0; index < count; ++index){
+
+			try{
+
+				task(index);
+
+			}
+			catch (...){
+
+				if (!exception){
+
+					exception = current_exception();
+
+				}
+
+			}
+
+		}
+
+		if (exception){
+
+			rethrow_exception(exception);
+
+		}
+
+		return;
+
+	}
+
+	// Contiguous shares: neighbouring indices usually touch neighbouring data.
+
+	for (unsigned int queue = 0; queue < thread_count_; ++queue){
+
+		lock_guard<mutex> lock(queues_[queue].lock);
+
+		queues_[queue].begin = count * queue / thread_count_;
+		queues_[queue].end = count * (queue + 1) / thread_count_;
+
+	}
+
+	{
+		lock_guard<mutex> lock(mutex_);
+
+		task_ = &task;
+
+		remaining_ = count;
+
+		++generation_;
+	}
+
+	wake_.notify_all();
+
+	Run(0, task);
+
+	// Wait for the tasks stolen by the workers and for the workers themselves, so that no one references the task after returning.
+
+	unique_lock<mutex> lock(mutex_);
+
+	done_.wait(lock,
+			   [this](){
+
+					return remaining_ == 0 && busy_ == 0;
+
+			   });
+
+	task_ = nullptr;
+
+	// Rethrow only once no one references the task anymore.
+
+	if (exception_){
+
+		auto exception = exception_;
+
+		exception_ = nullptr;
+
+		lock.unlock();
+
+		rethrow_exception(exception);
+
+	}
+
+}
+
+void TaskPool::Impl::Work(unsigned int queue){
+
+	size_t generation = 0;
+
+	unique_lock<mutex> lock(mutex_);
+
+	while (true){
+
+		wake_.wait(lock,
+				   [this, generation](){
+
+						return stop_ || generation_ != generation;
+
+				   });
+
+		if (stop_){
+
+			return;
+
+		}
+
+		generation = generation_;
+
+		if (task_ == nullptr){
+
+			continue;		// Woke up after the job was already completed
+
+		}
+
+		auto task = task_;
+
+		++busy_;
+
+		lock.unlock();
+
+		Run(queue, *task);
+
+		lock.lock();
+
+		if (--busy_ == 0){
+
+			done_.notify_all();
+
+		}
+
+	}
+
+}
+
+void TaskPool::Impl::Run(unsigned int queue, const Task& task){
+
+	size_t index;
+
+	do{
+
+		while (Pop(queue, index)){
+
+			// A throwing task must not leave the job: the others would wait for it forever. The exception is rethrown by ParallelFor.
+
+			try{
+
+				task(index);
+
+			}
+			catch (...){
+
+				lock_guard<mutex> lock(mutex_);
+
+				if (!exception_){
+
+					exception_ = current_exception();
+
+				}
+
+			}
+
+			if (--remaining_ == 0){
+
+				lock_guard<mutex> lock(mutex_);
+
+				done_.notify_all();
+
+			}
+
+		}
+
+	} while (Steal(queue));
+
+}
+
+bool TaskPool::Impl::Pop(unsigned int queue, size_t& index){
+
+	auto& work = queues_[queue];
+
+	lock_guard<mutex> lock(work.lock);
+
+	if (work.begin == work.end){
+
+		return false;
+
+	}
+
+	index = work.begin++;
+
+	return true;
+
+}
+
+bool TaskPool::Impl::Steal(unsigned int queue){
+
+	// Look for the queue with the most work left, starting from the next one so that thieves spread among victims.
+
+	unsigned int victim = queue;
+
+	size_t largest = 0;
+
+	for (unsigned int offset = 1; offset < thread_count_; ++offset){
+
+		auto candidate = (queue + offset) % thread_count_;
+
+		auto& work = queues_[candidate];
+
+		lock_guard<mutex> lock(work.lock);
+
+		if (work.end - work.begin > largest){
+
+			largest = work.end - work.begin;
+
+			victim = candidate;
+
+		}
+
+	}
+
+	if (victim == queue){
+
+		return false;
+
+	}
+
+	// The victim may have consumed some work in the meantime: split whatever is left.
+
+	size_t begin;
+	size_t end;
+
+	{
+		auto& work = queues_[victim];
+
+		lock_guard<mutex> lock(work.lock);
+
+		if (work.begin == work.end){
+
+			return true;		// Try again
+
+		}
+
+		end = work.end;
+
+		begin = end - (end - work.begin + 1) / 2;
+
+		work.end = begin;
+	}
+
+	auto& work = queues_[queue];
+
+	lock_guard<mutex> lock(work.lock);
+
+	work.begin = begin;
+	work.end = end;
+
+	return true;
+
+}
+
+///////////////////////////////// TASK POOL /////////////////////////////////
+
+TaskPool::TaskPool() :
+TaskPool(thread::hardware_concurrency()){}
+
+TaskPool::TaskPool(unsigned int thread_count) :
+pimpl_(make_unique<Impl>(thread_count)){}
+
+TaskPool::~TaskPool(){}
+
+void TaskPool::ParallelFor(size_t count, const Task& task){
+
+	pimpl_->ParallelFor(count, task);
+
+}
+
+unsigned int TaskPool::GetThreadCount() const{
+
+	return pimpl_->thread_count_;
+
+}
@@ -0,0 +1,281 @@
+#include "temporal_volume_query.h"
+
+#include <algorithm>
+
+#include "scene.h"
+
+using namespace ::gi_lib;
+using namespace ::std;
+
+namespace{
+
+	/// \brief Maximum difference between the components of two plane normals considered equal.
+	/// Rotating the camera changes the normals, which requires the hierarchy to be traversed again.
+	const float kNormalTolerance = 1e-5f;
+
+	/// \brief Inflate a frustum by a given distance.
+	Frustum Inflate(const Frustum& frustum, float distance){
+
+		return frustum.Inflate(distance);
+
+	}
+
+	/// \brief Inflate a sphere by a given distance.
+	Sphere Inflate(const Sphere& sphere, float distance){
+
+		return Sphere{ sphere.center, sphere.radius + distance };
+
+	}
+
+	/// \brief Inflate a box by a given distance.
+	AABB Inflate(const AABB& aabb, float distance){
+
+		return AABB{ aabb.center, aabb.half_extents + Vector3f::Constant(distance) };
+
+	}
+
+	/// \brief Check whether a frustum is fully inside another one.
+	/// Only frustums with the same orientation are compared: the inner one may only move each plane inwards.
+	bool Covers(const Frustum& outer, const Frustum& inner){
+
+		for (size_t plane_index = 0; plane_index < Frustum::kFrustumPlanes; ++plane_index){
+
+			auto& outer_plane = outer.GetPlane(plane_index);
+			auto& inner_plane = inner.GetPlane(plane_index);
+
+			if ((Math::ToVector3(outer_plane) - Math::ToVector3(inner_plane)).cwiseAbs().maxCoeff() > kNormalTolerance ||
+				inner_plane(3) > outer_plane(3)){
+
+				return false;
+
+			}
+
+		}
+
+		return true;
+
+	}
+
+	/// \brief Check whether a sphere is fully inside another one.
+	bool Covers(const Sphere& outer, const Sphere& inner){
+
+		return (inner.center - outer.center).norm() + inner.radius <= outer.radius;
+
+	}
+
+	/// \brief Check whether a box is fully inside another one.
+	bool Covers(const AABB& outer, const AABB& inner){
+
+		return ((inner.center - outer.center).cwiseAbs() + inner.half_extents - outer.half_extents).maxCoeff() <= 0.0f;
+
+	}
+
+	/// \brief Order changes by volume, preserving the order of the changes of the same volume.
+	bool CompareVolume(const VolumeChange& first, const VolumeChange& second){
+
+		return std::less<VolumeComponent*>()(first.volume, second.volume);
+
+	}
+
+}
+
+///////////////////////////////// TEMPORAL VOLUME QUERY /////////////////////////////////
+
+const size_t TemporalVolumeQuery::kNoQuery = static_cast<size_t>(-1);
+
+TemporalVolumeQuery::TemporalVolumeQuery(float tolerance) :
+tolerance_(tolerance),
+hierarchy_(nullptr),
+revision_(0),
+type_(QueryType::kNone),
+batch_query_(kNoQuery),
+last_update_(TemporalQueryUpdate::kTraversed){}
+
+TemporalVolumeQuery::IntersectionRange TemporalVolumeQuery::GetIntersections(const IVolumeHierarchy& hierarchy, const Frustum& frustum){
+
+	if (Prepare(hierarchy, QueryType::kFrustum, frustum, frustum_)){
+
+		hierarchy.GetIntersections(frustum_, intersections_);
+
+	}
+
+	return GetIntersections();
+
+}
+
+TemporalVolumeQuery::IntersectionRange TemporalVolumeQuery::GetIntersections(const IVolumeHierarchy& hierarchy, const Sphere& sphere){
+
+	if (Prepare(hierarchy, QueryType::kSphere, sphere, sphere_)){
+
+		hierarchy.GetIntersections(sphere_, intersections_);
+
+	}
+
+	return GetIntersections();
+
+}
+
+TemporalVolumeQuery::IntersectionRange TemporalVolumeQuery::GetIntersections(const IVolumeHierarchy& hierarchy, const AABB& aabb){
+
+	if (Prepare(hierarchy, QueryType::kAABB, aabb, aabb_)){
+
+		hierarchy.GetIntersections(aabb_, intersections_);
+
+	}
+
+	return GetIntersections();
+
+}
+
+void TemporalVolumeQuery::Update(const IVolumeHierarchy& hierarchy, const Frustum& frustum, VolumeQueryBatch& batch){
+
+	if (Prepare(hierarchy, QueryType::kFrustum, frustum, frustum_)){
+
+		batch_query_ = batch.AddQuery(frustum_);
+
+	}
+
+}
+
+void TemporalVolumeQuery::Update(const IVolumeHierarchy& hierarchy, const Sphere& sphere, VolumeQueryBatch& batch){
+
+	if (Prepare(hierarchy, QueryType::kSphere, sphere, sphere_)){
+
+		batch_query_ = batch.AddQuery(sphere_);
+
+	}
+
+}
+
+void TemporalVolumeQuery::Update(const IVolumeHierarchy& hierarchy, const AABB& aabb, VolumeQueryBatch& batch){
+
+	if (Prepare(hierarchy, QueryType::kAABB, aabb, aabb_)){
+
+		batch_query_ = batch.AddQuery(aabb_);
+
+	}
+
+}
+
+void TemporalVolumeQuery::Resolve(const VolumeQueryBatch& batch){
+
+	if (batch_query_ == kNoQuery){
+
+		return;
+
+	}
+
+	auto intersections = batch.GetIntersections(batch_query_);
+
+	intersections_.assign(intersections.begin(),
+						  intersections.end());
+
+	batch_query_ = kNoQuery;
+
+}
+
+template <typename TVolume>
+bool TemporalVolumeQuery::Prepare(const IVolumeHierarchy& hierarchy, QueryType type, const TVolume& volume, TVolume& cached){
+
+	auto& log = hierarchy.GetChangeLog();
+
+	batch_query_ = kNoQuery;
+
+	if (hierarchy_ == &hierarchy &&
+		type_ == type &&
+		revision_ >= log.GetOldestRevision() &&
+		Covers(cached, volume)){
+
+		// The cached results still apply: patch the changes applied since the last update, if any.
+
+		if (revision_ == log.GetRevision()){
+
+			last_update_ = TemporalQueryUpdate::kReused;
+
+		}
+		else{
+
+			Patch(log, cached);
+
+			last_update_ = TemporalQueryUpdate::kPatched;
+
+		}
+
+		return false;
+
+	}
+
+	// Start over: the results of the traversal are the new cache
+
+	hierarchy_ = &hierarchy;
+
+	revision_ = log.GetRevision();
+
+	type_ = type;
+
+	cached = Inflate(volume, tolerance_);
+
+	intersections_.clear();
+
+	last_update_ = TemporalQueryUpdate::kTraversed;
+
+	return true;
+
+}
+
+template <typename TVolume>
+void TemporalVolumeQuery::Patch(const VolumeChangeLog& log, const TVolume& cached){
+
+	// Only the last change of each volume matters
+
+	changes_.clear();
+
+	for (auto revision = revision_; revision < log.GetRevision(); ++revision){
+
+		changes_.push_back(log.GetChange(revision));
+
+	}
+
+	revision_ = log.GetRevision();
+
+	std::stable_sort(changes_.begin(),
+					 changes_.end(),
+					 CompareVolume);
+
+	changes_.erase(changes_.begin(),
+				   std::unique(changes_.rbegin(),
+							   changes_.rend(),
+							   [](const VolumeChange& first, const VolumeChange& second){
+
+									return first.volume == second.volume;
+
+							   }).base());
+
+	// Drop every volume who changed...
+
+	intersections_.erase(std::remove_if(intersections_.begin(),
+										intersections_.end(),
+										[this](VolumeComponent* volume){
+
+											return std::binary_search(changes_.begin(),
+																	  changes_.end(),
+																	  VolumeChange{ volume, false },
+																	  CompareVolume);
+
+										}),
+						 intersections_.end());
+
+	// ...and test again the ones still inside the hierarchy.
+
+	for (auto&& change : changes_){
+
+		if (!change.removed &&
+			(change.volume->TestAgainst(cached) && IntersectionType::kIntersect)){
+
+			intersections_.push_back(change.volume);
+
+		}
+
+	}
+
+}
@@ -81,32 +81,67 @@ struct UniformTree::Node{
 	/// \brief Pull this node up int the hierarchy.
 	void PullUp();	
 
+	/// \brief Move this node inside another space, or refresh its bounds if the space is the same.
 	void SetParent(UniformTree* new_parent);
 
+	/// \brief Add this node to a space.
+	void Attach(UniformTree* parent);
+
+	/// \brief Remove this node from its space.
+	void Detach();
+
+	/// \brief Record the node inside the dirty list of the tree.
+	void MarkDirty();
+
 	UniformTree* parent_;									///< \brief Space containing this node
 
+	size_t index_;											///< \brief Index of this node inside the space containing it
+
 	VolumeComponent* volume_;								///< \brief Volume component inside this node
 
 	unique_ptr<Listener> on_bounds_changed_listener_;		///< \brief Volume.OnBoundsChanged listener
 
+	bool dirty_;											///< \brief Whether the node is waiting to be relocated.
+
+	size_t dirty_index_;									///< \brief Index of this node inside the dirty list of the tree. Valid only if the node is dirty.
+
 };
 
 UniformTree::Node::Node(UniformTree* parent, VolumeComponent* volume) :
-parent_(parent),
-volume_(volume){
+parent_(nullptr),
+volume_(volume),
+dirty_(false){
 
-	++(parent_->volume_count_);
+	++(parent->volume_count_);
 
-	parent_->nodes_.push_back(this);
+	Attach(parent);
 
 	on_bounds_changed_listener_ = volume->OnChanged().Subscribe([this](_, _){
 
-		this->PullUp();	// Relocate the moving node
+		this->MarkDirty();	// The node is relocated upon commit
 
 	});
 
 }
 
+void UniformTree::Node::MarkDirty(){
+
+	auto root = parent_->GetRoot();
+
+	++(root->pending_changes_);
+
+	if (!dirty_){
+
+		dirty_ = true;
+
+		dirty_index_ = root->dirty_nodes_.size();
+
+		root->dirty_nodes_.push_back(this);
+
+	}
+
+}
+
 void UniformTree::Node::PushDown(){
 	
 	auto new_parent = parent_;
@@ -167,29 +202,48 @@ void UniformTree::Node::SetParent(UniformTree* new_parent){
 
 	if (parent_ != new_parent){
 
-		auto& old_nodes = parent_->nodes_;
+		Detach();
 
-		auto it = std::find(old_nodes.begin(),
-							old_nodes.end(),
-							this);
+		Attach(new_parent);
 
-		if (it != old_nodes.end()){
+	}
+	else{
 
-			old_nodes.erase(it);
+		parent_->bounds_.Set(index_, volume_->GetBoundingBox());
 
-		}
-		else{
+	}
 
-			// If this happens it means that we have a bug...
-			THROW(L"Bad programmer exception.");
+}
 
-		}
+void UniformTree::Node::Attach(UniformTree* parent){
 
-		parent_ = new_parent;								// Update parent reference
+	parent_ = parent;
 
-		parent_->nodes_.push_back(this);					// Add the node to the new parent
+	index_ = parent_->nodes_.size();
 
-	}
+	parent_->nodes_.push_back(this);
+
+	parent_->bounds_.PushBack(volume_->GetBoundingBox());
+
+}
+
+void UniformTree::Node::Detach(){
+
+	// Swap-pop: the last node of the space takes the place of this one.
+
+	auto& nodes = parent_->nodes_;
+
+	auto last = nodes.back();
+
+	nodes[index_] = last;
+
+	last->index_ = index_;
+
+	nodes.pop_back();
+
+	parent_->bounds_.SwapPop(index_);
+
+	parent_ = nullptr;
 
 }
 
@@ -197,139 +251,340 @@ void UniformTree::Node::SetParent(UniformTree* new_parent){
 
 struct UniformTree::Impl{
 
-	static void GetIntersections(const UniformTree* tree, const Frustum& frustum, vector<VolumeComponent*>& intersections);
+	/// \brief Visit the volumes inside a subspace who intersect a volume.
+	/// \param recursive Whether to visit the children of the subspace as well.
+	template <typename TVolume, typename TVisitor>
+	static bool VisitIntersections(const UniformTree* tree, const TVolume& volume, bool recursive, TVisitor&& visitor);
 
-	static void GetIntersections(const UniformTree* tree, const Sphere& sphere, vector<VolumeComponent*>& intersections);
-	
-	static void GetIntersections(const UniformTree* tree, const AABB& aabb, vector<VolumeComponent*>& intersections);
+	/// \brief Visit the volumes inside a subspace who intersect a frustum.
+	/// \param plane_mask Planes of the frustum which do not contain the parent space.
+	/// \param recursive Whether to visit the children of the subspace as well.
+	template <typename TVisitor>
+	static bool VisitIntersections(const UniformTree* tree, const Frustum& frustum, unsigned int plane_mask, bool recursive, TVisitor&& visitor);
 
-private:
+	/// \brief Split the top levels of the tree in partitions.
+	static void GetPartitions(const UniformTree* tree, size_t count, vector<HierarchyPartition>& partitions);
 
-	/// \brief Simple wrapper around the Node struct.
-	struct VolumeMapper{
+	/// \brief Resolve a group of queries inside a subspace and its children.
+	/// \param active Queries intersecting the parent space.
+	/// \param contained Queries fully containing the parent space.
+	static void GetGroupIntersections(const UniformTree* tree, VolumeQueryBatch& batch, size_t group, VolumeQueryBatch::QueryMask active, VolumeQueryBatch::QueryMask contained);
 
-		VolumeComponent** operator()(UniformTree::Node* node) const;
+private:
 
-	};
+	/// \brief Maximum number of volumes culled at once.
+	static const size_t kBatchSize = 256;
 
-	using iterator = vector<UniformTree::Node*>::const_iterator;
+	/// \brief Cull the bounds of the volumes inside a subspace at once, then test the surviving volumes that are not fully contained individually.
+	template <typename TVisitor>
+	static bool VisitNodes(const UniformTree* tree, const Frustum& frustum, unsigned int plane_mask, TVisitor&& visitor);
 
-	using iterator_wrapper = IteratorWrapper<vector<UniformTree::Node*>::const_iterator,
-											 VolumeComponent*,
-											 VolumeMapper>;
-	
-	template <typename TVolume>
-	static void GetIntersections(const vector<UniformTree::Node*>& nodes, const TVolume& volume, vector<VolumeComponent*>& intersections);
+	/// \brief Visit every volume inside a subspace and its children, without testing them.
+	/// \param recursive Whether to visit the children of the subspace as well.
+	template <typename TVisitor>
+	static bool VisitVolumes(const UniformTree* tree, bool recursive, TVisitor&& visitor);
 
 };
 
-VolumeComponent** UniformTree::Impl::VolumeMapper::operator()(UniformTree::Node* node) const{
+template <typename TVolume, typename TVisitor>
+bool UniformTree::Impl::VisitIntersections(const UniformTree* tree, const TVolume& volume, bool recursive, TVisitor&& visitor){
+
+	// Stop the recursion if this space doesn't intersect or if the subspace has no volumes inside.
+
+	if (tree->volume_count_ == 0 ||
+		!(volume.Intersect(tree->bounding_box_) && IntersectionType::kIntersect)){
+
+		return true;
+
+	}
+
+	// Test against volumes
+
+	for (auto node : tree->nodes_){
+
+		if ((node->volume_->TestAgainst(volume) && IntersectionType::kIntersect) &&
+			!visitor(node->volume_)){
+
+			return false;
+
+		}
+
+	}
+
+	// Recursion
+
+	if (!recursive){
+
+		return true;
+
+	}
+
+	for (auto child : tree->children_){
+
+		if (!VisitIntersections(child, volume, true, visitor)){
+
+			return false;
+
+		}
+
+	}
 
-	return &(node->volume_);
+	return true;
 
 }
 
-void UniformTree::Impl::GetIntersections(const UniformTree* tree, const Frustum& frustum, vector<VolumeComponent*>& intersections){
+template <typename TVisitor>
+bool UniformTree::Impl::VisitIntersections(const UniformTree* tree, const Frustum& frustum, unsigned int plane_mask, bool recursive, TVisitor&& visitor){
 
-	// Stop the recursion if this space doesn't intersect or if the subspace has no volumes inside.
+	// Stop the recursion if the subspace has no volumes inside.
+
+	if (tree->volume_count_ == 0){
+
+		return true;
+
+	}
+
+	// Planes containing this space contain every subspace as well and are not tested again.
 
-	if (tree->volume_count_ > 0 &&
-		(frustum.Intersect(tree->bounding_box_) && IntersectionType::kIntersect)){
+	auto intersection = frustum.Intersect(tree->bounding_box_, plane_mask);
 
-		// Test against volumes
+	if (!(intersection && IntersectionType::kIntersect)){
 
-		GetIntersections(tree->nodes_, 
-						 frustum, 
-						 intersections);
+		return true;
+
+	}
+
+	// The root may store volumes outside its bounds, every other space strictly encloses its volumes.
+
+	auto is_root = (tree->parent_ == nullptr);
+
+	if ((intersection && IntersectionType::kInside) && !is_root){
+
+		return VisitVolumes(tree, recursive, visitor);		// Fully visible: no further test needed
+
+	}
 
-		// Recursion
+	// Test against volumes
 
-		for (auto child : tree->children_){
+	if (!VisitNodes(tree,
+					frustum,
+					is_root ? Frustum::kAllPlanes : plane_mask,
+					visitor)){
 
-			GetIntersections(child,
-							 frustum, 
-							 intersections);
+		return false;
+
+	}
+
+	// Recursion
+
+	if (!recursive){
+
+		return true;
+
+	}
+
+	for (auto child : tree->children_){
+
+		if (!VisitIntersections(child,
+								frustum,
+								plane_mask,
+								true,
+								visitor)){
+
+			return false;
 
 		}
 
 	}
 
+	return true;
+
 }
 
-void UniformTree::Impl::GetIntersections(const UniformTree* tree, const Sphere& sphere, vector<VolumeComponent*>& intersections){
+void UniformTree::Impl::GetGroupIntersections(const UniformTree* tree, VolumeQueryBatch& batch, size_t group, VolumeQueryBatch::QueryMask active, VolumeQueryBatch::QueryMask contained){
 
-	// Stop the recursion if this space doesn't intersect or if the subspace has no volumes inside.
+	if (tree->volume_count_ == 0){
 
-	if (tree->volume_count_ > 0 &&
-		(sphere.Intersect(tree->bounding_box_) && IntersectionType::kIntersect)){
+		return;
 
-		// Test against volumes
+	}
+
+	// The root may store volumes outside its bounds, every other space strictly encloses its volumes.
 
-		GetIntersections(tree->nodes_, 
-						 sphere, 
-						 intersections);
+	if (tree->parent_ != nullptr){
 
-		// Recursion
+		active = batch.Intersect(group, tree->bounding_box_, active, contained);
 
-		for (auto child : tree->children_){
+		if (active == 0){
 
-			GetIntersections(child,
-							 sphere, 
-							 intersections);
+			return;
 
 		}
 
 	}
 
+	// Test against volumes
+
+	for (size_t index = 0; index < tree->nodes_.size(); ++index){
+
+		auto volume = tree->nodes_[index]->volume_;
+
+		auto volume_contained = contained;
+
+		auto queries = batch.Intersect(group, tree->bounds_.Get(index), active, volume_contained);
+
+		if (queries != 0 &&
+			(queries = batch.TestAgainst(group, *volume, queries, volume_contained)) != 0){
+
+			batch.AddIntersection(group, queries, volume);
+
+		}
+
+	}
+
+	// Recursion
+
+	for (auto child : tree->children_){
+
+		GetGroupIntersections(child, batch, group, active, contained);
+
+	}
+
 }
 
-void UniformTree::Impl::GetIntersections(const UniformTree* tree, const AABB& aabb, vector<VolumeComponent*>& intersections) {
+void UniformTree::Impl::GetPartitions(const UniformTree* tree, size_t count, vector<HierarchyPartition>& partitions){
 
-	// Stop the recursion if this space doesn't intersect or if the subspace has no volumes inside.
+	// Each partition of a space is replaced by the volumes stored inside the space followed by the partitions of its children:
+	// the order of the sequential traversal is preserved. Empty partitions are dropped.
+
+	vector<HierarchyPartition> expanded;
 
-	if (tree->volume_count_ > 0 &&
-		(aabb.Intersect(tree->bounding_box_) && IntersectionType::kIntersect)) {
+	partitions.push_back(HierarchyPartition{ reinterpret_cast<size_t>(tree), true });
 
-		// Test against volumes
+	bool split;
 
-		GetIntersections(tree->nodes_,
-						 aabb,
-						 intersections);
+	do{
 
-		// Recursion
+		split = false;
 
-		for (auto child : tree->children_) {
+		expanded.clear();
 
-			GetIntersections(child,
-							 aabb,
-							 intersections);
+		for (auto&& partition : partitions){
+
+			auto space = reinterpret_cast<const UniformTree*>(partition.node);
+
+			if (!partition.subtree ||
+				space->children_.empty()){
+
+				expanded.push_back(partition);
+				continue;
+
+			}
+
+			if (!space->nodes_.empty()){
+
+				expanded.push_back(HierarchyPartition{ partition.node, false });
+
+			}
+
+			for (auto child : space->children_){
+
+				if (child->volume_count_ > 0){
+
+					expanded.push_back(HierarchyPartition{ reinterpret_cast<size_t>(child), true });
+
+				}
+
+			}
+
+			split = true;
+
+		}
+
+		partitions.swap(expanded);
+
+	} while (split && partitions.size() < count);
+
+}
+
+template <typename TVisitor>
+bool UniformTree::Impl::VisitNodes(const UniformTree* tree, const Frustum& frustum, unsigned int plane_mask, TVisitor&& visitor){
+
+	unsigned int visibility[kBatchSize / 32];
+	unsigned int containment[kBatchSize / 32];
+
+	auto count = tree->nodes_.size();
+
+	for (size_t begin = 0; begin < count; begin += kBatchSize){
+
+		auto end = std::min(begin + kBatchSize, count);
+
+		frustum.Intersect(tree->bounds_, begin, end, plane_mask, visibility, containment);
+
+		for (size_t word = 0; word < ((end - begin + 31) >> 5); ++word){
+
+			// Visit the set bits only
+
+			for (auto bits = visibility[word]; bits != 0; bits &= bits - 1){
+
+				auto bit = Math::CountTrailingZeros(bits);
+
+				auto volume = tree->nodes_[begin + (word << 5) + bit]->volume_;
+
+				if (((containment[word] & (1u << bit)) ||
+					 (volume->TestAgainst(frustum) && IntersectionType::kIntersect)) &&
+					!visitor(volume)){
+
+					return false;
+
+				}
+
+			}
 
 		}
 
 	}
 
+	return true;
+
 }
 
-template <typename TVolume>
-void UniformTree::Impl::GetIntersections(const vector<UniformTree::Node*>& nodes, const TVolume& volume, vector<VolumeComponent*>& intersections){
+template <typename TVisitor>
+bool UniformTree::Impl::VisitVolumes(const UniformTree* tree, bool recursive, TVisitor&& visitor){
 
-	// Test each volume inside this node against the specified volume
+	if (tree->volume_count_ == 0){
 
-	auto size = intersections.size();
+		return true;
 
-	intersections.resize(size + nodes.size());	// Overshoot
+	}
+
+	for (auto node : tree->nodes_){
+
+		if (!visitor(node->volume_)){
+
+			return false;
 
-	auto end = std::copy_if(iterator_wrapper(nodes.begin()),
-							iterator_wrapper(nodes.end()),
-							intersections.begin() + size,
-							[&volume](const iterator_wrapper::reference v){
+		}
+
+	}
 
-								return v->TestAgainst(volume) && IntersectionType::kIntersect;
+	if (!recursive){
 
-							});
+		return true;
 
-	intersections.erase(end,
-						intersections.end());	// Shrink
+	}
+
+	for (auto child : tree->children_){
+
+		if (!VisitVolumes(child, true, visitor)){
+
+			return false;
+
+		}
+
+	}
+
+	return true;
 
 }
 
@@ -341,7 +596,9 @@ UniformTree(nullptr, domain, splits){}
 UniformTree::UniformTree(UniformTree* parent, const AABB& domain, const Vector3i& splits) :
 parent_(parent),
 bounding_box_(domain),
-volume_count_(0u){
+volume_count_(0u),
+pending_changes_(0u),
+stats_(HierarchyStats{ 0u, 0u, 0u }){
 
 	Split(splits);
 
@@ -361,95 +618,231 @@ void UniformTree::AddVolume(VolumeComponent* volume){
 
 	auto node = new Node(this, volume);
 
+	GetRoot()->volume_nodes_[volume] = node;
+
 	node->PushDown();
+
+	GetRoot()->change_log_.RecordChange(volume);
 	
 }
 
 void UniformTree::RemoveVolume(VolumeComponent* volume){
 
-	auto tree = this;
+	auto root = GetRoot();
 
-	bool repeat;
+	auto it = root->volume_nodes_.find(volume);
 
-	do{
+	if (it == root->volume_nodes_.end()){
 
-		repeat = false;
+		return;		// Not inside this tree
 
-		// Strictly enclosure ensures that at most one child may accept the volume.
+	}
 
-		for (auto& child : tree->children_){
+	auto node = it->second;
 
-			if (child->Encloses(*volume)){
+	root->volume_nodes_.erase(it);
 
-				tree = child;
+	if (node->dirty_){
 
-				repeat = true;
+		// Swap-pop: the last dirty node takes the place of the removed one.
 
-				break;
+		auto last = root->dirty_nodes_.back();
 
-			}
+		root->dirty_nodes_[node->dirty_index_] = last;
 
-		}
+		last->dirty_index_ = node->dirty_index_;
 
-	} while (repeat);			// Stop when every child rejected the volume.
+		root->dirty_nodes_.pop_back();
+
+	}
 
-	// Remove the volume from the subspace
+	// Remove the volume from the subspace storing it, which may not match its current bounds if the volume is moving
 
-	auto& nodes = tree->nodes_;
+	for (auto tree = node->parent_; tree != nullptr; tree = tree->parent_){
 
-	auto it = std::find_if(nodes.begin(),
-						   nodes.end(),
-						   [&volume](const Node* node){
+		--(tree->volume_count_);
 
-								return node->volume_ == volume;
+	}
 
-						   });
+	node->Detach();
 
-	delete *it;
+	delete node;
 
-	nodes.erase(it);	// We are sure the node exists, right?
+	GetRoot()->change_log_.RecordRemoval(volume);
 	
 }
 
-vector<VolumeComponent*> UniformTree::GetIntersections(const Frustum& frustum) const{
+void UniformTree::Commit(){
+
+	auto root = GetRoot();
+
+	for (auto node : root->dirty_nodes_){
+
+		node->dirty_ = false;
 
-	vector<VolumeComponent*> intersections;
+		node->PullUp();			// Relocate the moving node
 
-	intersections.reserve(volume_count_);	// Theoretical maximum number of volumes
+		root->change_log_.RecordChange(node->volume_);
 
-	Impl::GetIntersections(this, frustum, intersections);
+	}
+
+	auto relocations = static_cast<unsigned int>(root->dirty_nodes_.size());
 
-	intersections.shrink_to_fit();			// Shrink to the actual value
+	root->stats_ = HierarchyStats{ root->pending_changes_,
+								   relocations,
+								   root->pending_changes_ - relocations };
 
-	return intersections;
+	root->dirty_nodes_.clear();
+
+	root->pending_changes_ = 0;
 
 }
 
-vector<VolumeComponent*> UniformTree::GetIntersections(const Sphere& sphere) const {
+HierarchyStats UniformTree::GetStats() const{
 
-	vector<VolumeComponent*> intersections;
+	auto root = this;
 
-	intersections.reserve(volume_count_);	// Theoretical maximum number of volumes
+	while (root->parent_ != nullptr){
 
-	Impl::GetIntersections(this, sphere, intersections);
+		root = root->parent_;
 
-	intersections.shrink_to_fit();			// Shrink to the actual value
+	}
 
-	return intersections;
+	return root->stats_;
 
 }
 
-vector<VolumeComponent*> UniformTree::GetIntersections(const AABB& aabb) const {
+const VolumeChangeLog& UniformTree::GetChangeLog() const{
 
-	vector<VolumeComponent*> intersections;
+	auto root = this;
 
-	intersections.reserve(volume_count_);	// Theoretical maximum number of volumes
+	while (root->parent_ != nullptr){
 
-	Impl::GetIntersections(this, aabb, intersections);
+		root = root->parent_;
 
-	intersections.shrink_to_fit();			// Shrink to the actual value
+	}
 
-	return intersections;
+	return root->change_log_;
+
+}
+
+void UniformTree::GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections) const{
+
+	Impl::VisitIntersections(this,
+							 frustum,
+							 Frustum::kAllPlanes,
+							 true,
+							 [&intersections](VolumeComponent* volume){
+
+								intersections.push_back(volume);
+								return true;
+
+							 });
+
+}
+
+void UniformTree::GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections) const {
+
+	Impl::VisitIntersections(this,
+							 sphere,
+							 true,
+							 [&intersections](VolumeComponent* volume){
+
+								intersections.push_back(volume);
+								return true;
+
+							 });
+
+}
+
+void UniformTree::GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections) const {
+
+	Impl::VisitIntersections(this,
+							 aabb,
+							 true,
+							 [&intersections](VolumeComponent* volume){
+
+								intersections.push_back(volume);
+								return true;
+
+							 });
+
+}
+
+bool UniformTree::VisitIntersections(const Frustum& frustum, const VolumeVisitor& visitor) const{
+
+	return Impl::VisitIntersections(this, frustum, Frustum::kAllPlanes, true, visitor);
+
+}
+
+bool UniformTree::VisitIntersections(const Sphere& sphere, const VolumeVisitor& visitor) const{
+
+	return Impl::VisitIntersections(this, sphere, true, visitor);
+
+}
+
+bool UniformTree::VisitIntersections(const AABB& aabb, const VolumeVisitor& visitor) const{
+
+	return Impl::VisitIntersections(this, aabb, true, visitor);
+
+}
+
+void UniformTree::GetGroupIntersections(VolumeQueryBatch& batch, size_t group) const{
+
+	Impl::GetGroupIntersections(this,
+								batch,
+								group,
+								batch.GetGroupMask(group),
+								0);
+
+}
+
+void UniformTree::GetPartitions(size_t count, vector<HierarchyPartition>& partitions) const{
+
+	Impl::GetPartitions(this, count, partitions);
+
+}
+
+void UniformTree::GetPartitionIntersections(const Frustum& frustum, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	Impl::VisitIntersections(reinterpret_cast<const UniformTree*>(partition.node),
+							 frustum,
+							 Frustum::kAllPlanes,
+							 partition.subtree,
+							 [&intersections](VolumeComponent* volume){
+
+								intersections.push_back(volume);
+								return true;
+
+							 });
+
+}
+
+void UniformTree::GetPartitionIntersections(const Sphere& sphere, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	Impl::VisitIntersections(reinterpret_cast<const UniformTree*>(partition.node),
+							 sphere,
+							 partition.subtree,
+							 [&intersections](VolumeComponent* volume){
+
+								intersections.push_back(volume);
+								return true;
+
+							 });
+
+}
+
+void UniformTree::GetPartitionIntersections(const AABB& aabb, const HierarchyPartition& partition, vector<VolumeComponent*>& intersections) const{
+
+	Impl::VisitIntersections(reinterpret_cast<const UniformTree*>(partition.node),
+							 aabb,
+							 partition.subtree,
+							 [&intersections](VolumeComponent* volume){
+
+								intersections.push_back(volume);
+								return true;
+
+							 });
 
 }
 
@@ -471,6 +864,20 @@ void UniformTree::Split(const Vector3i& splits){
 
 }
 
+UniformTree* UniformTree::GetRoot(){
+
+	auto root = this;
+
+	while (root->parent_ != nullptr){
+
+		root = root->parent_;
+
+	}
+
+	return root;
+
+}
+
 bool UniformTree::Encloses(const VolumeComponent& volume){
 
 	// False positive are not acceptable here
@@ -0,0 +1,266 @@
+#include "volume_hierarchy.h"
+
+#include "scene.h"
+#include "task_pool.h"
+
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Number of partitions created for each thread of the pool.
+	/// More partitions than threads let idle threads steal work when the volumes are not uniformly distributed.
+	const size_t kPartitionsPerThread = 4;
+
+}
+
+///////////////////////////////// VOLUME QUERY BATCH /////////////////////////////////
+
+size_t VolumeQueryBatch::AddQuery(const Frustum& frustum){
+
+	queries_.push_back(Query{ QueryType::kFrustum, frustums_.size() });
+
+	frustums_.push_back(frustum);
+
+	return queries_.size() - 1;
+
+}
+
+size_t VolumeQueryBatch::AddQuery(const Sphere& sphere){
+
+	queries_.push_back(Query{ QueryType::kSphere, spheres_.size() });
+
+	spheres_.push_back(sphere);
+
+	return queries_.size() - 1;
+
+}
+
+size_t VolumeQueryBatch::AddQuery(const AABB& aabb){
+
+	queries_.push_back(Query{ QueryType::kAABB, aabbs_.size() });
+
+	aabbs_.push_back(aabb);
+
+	return queries_.size() - 1;
+
+}
+
+void VolumeQueryBatch::Clear(){
+
+	queries_.clear();
+	frustums_.clear();
+	spheres_.clear();
+	aabbs_.clear();
+
+	matches_.clear();
+	intersections_.clear();
+	offsets_.clear();
+
+}
+
+VolumeQueryBatch::QueryMask VolumeQueryBatch::Intersect(size_t group, const AABB& bounds, QueryMask active, QueryMask& contained) const{
+
+	auto first = group * kGroupSize;
+
+	auto intersections = active & contained;		// Queries containing the box contain every volume inside it as well
+
+	for (auto bits = active & ~contained; bits != 0; bits &= bits - 1){
+
+		auto bit = Math::CountTrailingZeros(bits);
+
+		auto intersection = Intersect(queries_[first + bit], bounds);
+
+		if (intersection && IntersectionType::kIntersect){
+
+			intersections |= (1u << bit);
+
+			if (intersection && IntersectionType::kInside){
+
+				contained |= (1u << bit);
+
+			}
+
+		}
+
+	}
+
+	return intersections;
+
+}
+
+VolumeQueryBatch::QueryMask VolumeQueryBatch::TestAgainst(size_t group, const VolumeComponent& volume, QueryMask active, QueryMask contained) const{
+
+	auto first = group * kGroupSize;
+
+	auto intersections = active & contained;
+
+	for (auto bits = active & ~contained; bits != 0; bits &= bits - 1){
+
+		auto bit = Math::CountTrailingZeros(bits);
+
+		if (TestAgainst(queries_[first + bit], volume) && IntersectionType::kIntersect){
+
+			intersections |= (1u << bit);
+
+		}
+
+	}
+
+	return intersections;
+
+}
+
+void VolumeQueryBatch::ClearIntersections(){
+
+	matches_.clear();
+
+}
+
+void VolumeQueryBatch::SortIntersections(){
+
+	// Counting sort: the order in which each query found its volumes is preserved.
+
+	offsets_.assign(queries_.size() + 1, 0);
+
+	for (auto&& match : matches_){
+
+		++offsets_[match.query + 1];
+
+	}
+
+	for (size_t query = 0; query < queries_.size(); ++query){
+
+		offsets_[query + 1] += offsets_[query];
+
+	}
+
+	intersections_.resize(matches_.size());
+
+	for (auto&& match : matches_){
+
+		intersections_[offsets_[match.query]++] = match.volume;
+
+	}
+
+	// Each offset was moved to the end of its query, which is the begin of the next one.
+
+	for (auto query = queries_.size(); query > 0; --query){
+
+		offsets_[query] = offsets_[query - 1];
+
+	}
+
+	offsets_[0] = 0;
+
+}
+
+IntersectionType VolumeQueryBatch::Intersect(const Query& query, const AABB& bounds) const{
+
+	switch (query.type){
+
+	case QueryType::kFrustum:
+
+		return frustums_[query.index].Intersect(bounds);
+
+	case QueryType::kSphere:
+
+		return bounds.Intersect(spheres_[query.index]);
+
+	default:
+
+		return aabbs_[query.index].Intersect(bounds);
+
+	}
+
+}
+
+IntersectionType VolumeQueryBatch::TestAgainst(const Query& query, const VolumeComponent& volume) const{
+
+	switch (query.type){
+
+	case QueryType::kFrustum:
+
+		return volume.TestAgainst(frustums_[query.index]);
+
+	case QueryType::kSphere:
+
+		return volume.TestAgainst(spheres_[query.index]);
+
+	default:
+
+		return volume.TestAgainst(aabbs_[query.index]);
+
+	}
+
+}
+
+///////////////////////////////// IVOLUME HIERARCHY /////////////////////////////////
+
+void IVolumeHierarchy::GetIntersections(const Frustum& frustum, vector<VolumeComponent*>& intersections, TaskPool& pool) const{
+
+	GetParallelIntersections(frustum, intersections, pool);
+
+}
+
+void IVolumeHierarchy::GetIntersections(const Sphere& sphere, vector<VolumeComponent*>& intersections, TaskPool& pool) const{
+
+	GetParallelIntersections(sphere, intersections, pool);
+
+}
+
+void IVolumeHierarchy::GetIntersections(const AABB& aabb, vector<VolumeComponent*>& intersections, TaskPool& pool) const{
+
+	GetParallelIntersections(aabb, intersections, pool);
+
+}
+
+template <typename TVolume>
+void IVolumeHierarchy::GetParallelIntersections(const TVolume& volume, vector<VolumeComponent*>& intersections, TaskPool& pool) const{
+
+	if (pool.GetThreadCount() == 1){
+
+		GetIntersections(volume, intersections);		// Nothing to split
+		return;
+
+	}
+
+	vector<HierarchyPartition> partitions;
+
+	GetPartitions(pool.GetThreadCount() * kPartitionsPerThread,
+				  partitions);
+
+	// Each partition owns its buffer: no synchronization needed.
+
+	vector<vector<VolumeComponent*>> results(partitions.size());
+
+	pool.ParallelFor(partitions.size(),
+					 [&](size_t partition){
+
+						GetPartitionIntersections(volume,
+												  partitions[partition],
+												  results[partition]);
+
+					 });
+
+	// Merge in hierarchy order, so that the result does not depend on the scheduling.
+
+	size_t count = 0;
+
+	for (auto&& result : results){
+
+		count += result.size();
+
+	}
+
+	intersections.reserve(intersections.size() + count);
+
+	for (auto&& result : results){
+
+		intersections.insert(intersections.end(),
+							 result.begin(),
+							 result.end());
+
+	}
+
+}
@@ -5,6 +5,8 @@
 
 #include "eigen.h"
 #include "scene.h"
+#include "scene_snapshot.h"
+#include "derived_data_cache.h"
 #include "mesh.h"
 #include "graphics.h"
 #include "core.h"
@@ -86,6 +88,8 @@ namespace {
 
 		virtual unique_ptr<IMtlProperty> operator [](const string& property_name) const override;
 
+		const std::map<string, string>& GetProperties() const;
+
 	private:
 
 		string name_;
@@ -147,12 +151,19 @@ namespace {
 		
 		/// \brief Get a material definition by name.
 		/// \return Returns a pointer to the material definition matching the specified name if any, returns nullptr otherwise.
-		const IMtlMaterial* GetMaterial(const string& material_name) const;
+		const MtlMaterial* GetMaterial(const string& material_name) const;
 
 		/// \brief Get the number of parsed objects.
 		/// \return Returns the number of parsed objects.
 		size_t GetObjectCount() const;
 
+		/// \brief Get the material libraries referenced by a line of an OBJ file.
+		/// The line is tokenized exactly like the parser does. A material-library directive may reference more than one library.
+		/// \param line Line to read.
+		/// \param file_name Name of the OBJ file containing the line.
+		/// \param library_names Receives the name of each library referenced by the line, relative to the working directory. Output.
+		static void GetMaterialLibraries(const string& line, const wstring& file_name, vector<wstring>& library_names);
+
 	private:
 		/// \brief Definition of a vertex.
 		struct VertexDefinition {
@@ -335,6 +346,12 @@ namespace {
 
 	}
 
+	const std::map<string, string>& MtlMaterial::GetProperties() const{
+
+		return properties_;
+
+	}
+
 	void MtlMaterial::AddProperty(const string& property_name, const string& property_value) {
 
 		properties_.insert(std::make_pair(property_name, property_value));
@@ -678,15 +695,43 @@ namespace {
 
 	void ObjParser::ParseMaterialLibrary(istringstream& line_stream, const wstring& file_name) {
 
+		// A single directive may reference more than one library
+
 		string library_name;
 
-		line_stream >> library_name;
+		auto& file_system = FileSystem::GetInstance();
+
+		while (line_stream >> library_name) {
+
+			material_libraries_.push_back(std::make_unique<MtlParser>());
+
+			material_libraries_.back()->Parse(file_system.GetDirectory(file_name) + to_wstring(library_name));
+
+		}
+
+	}
+
+	void ObjParser::GetMaterialLibraries(const string& line, const wstring& file_name, vector<wstring>& library_names) {
+
+		istringstream line_stream(line);
+
+		string token;
+
+		line_stream >> token;
+
+		if (token != kMaterialLibraryToken) {
+
+			return;
+
+		}
 
 		auto& file_system = FileSystem::GetInstance();
 
-		material_libraries_.push_back(std::make_unique<MtlParser>());
+		while (line_stream >> token) {
 
-		material_libraries_.back()->Parse(file_system.GetDirectory(file_name) + to_wstring(library_name));
+			library_names.push_back(file_system.GetDirectory(file_name) + to_wstring(token));
+
+		}
 
 	}
 	
@@ -824,9 +869,9 @@ namespace {
 
 	}
 
-	const IMtlMaterial* ObjParser::GetMaterial(const string& material_name) const{
+	const MtlMaterial* ObjParser::GetMaterial(const string& material_name) const{
 
-		const IMtlMaterial* material;
+		const MtlMaterial* material;
 
 		for (auto&& library : material_libraries_) {
 
@@ -844,76 +889,378 @@ namespace {
 
 	}
 
+	//////////////////////////////////// SNAPSHOT //////////////////////////////////////////////
+
+	/// \brief Describe the content of a parsed OBJ file.
+	/// Each object becomes a mesh attached to a node of its own, directly below the root.
+	/// \param parser Parser containing the OBJ file.
+	/// \param file_name Name of the parsed file, used to name the meshes without a name.
+	/// \param description Description of the scene. Output.
+	void Describe(const ObjParser& parser, const wstring& file_name, SceneSnapshot::Description& description) {
+
+		std::map<const MtlMaterial*, unsigned int> material_indices;
+
+		Mesh mesh;
+
+		for (size_t index = 0; index < parser.GetObjectCount(); ++index) {
+
+			parser.GetMesh(index, mesh);
+
+			// Node
+
+			description.nodes.push_back(SceneSnapshot::Description::Node{ to_wstring(mesh.name_),
+																		  SceneSnapshot::kNone,
+																		  static_cast<unsigned int>(description.meshes.size()),
+																		  Translation3f(Vector3f::Zero()),
+																		  Quaternionf::Identity(),
+																		  AlignedScaling3f(Vector3f::Ones()) });
+
+			// Mesh. Use the file name if the mesh didn't have any attached name to it
+
+			description.meshes.push_back(SceneSnapshot::Description::Mesh());
+
+			auto& mesh_description = description.meshes.back();
+
+			mesh_description.name = mesh.name_.length() > 0 ? to_wstring(mesh.name_) : file_name;
+
+			for (auto&& subset : mesh.subsets_) {
+
+				// Materials are shared among subsets
+
+				auto material = parser.GetMaterial(subset.material_name_);
+
+				auto material_index = SceneSnapshot::kNone;
+
+				if (material) {
+
+					auto it = material_indices.find(material);
+
+					if (it == material_indices.end()) {
+
+						it = material_indices.insert(std::make_pair(material, static_cast<unsigned int>(description.materials.size()))).first;
+
+						description.materials.push_back(SceneSnapshot::Description::Material{ material->GetName() });
+
+						for (auto&& property : material->GetProperties()) {
+
+							description.materials.back().properties.push_back(SceneSnapshot::Description::Property{ property.first, property.second });
+
+						}
+
+					}
+
+					material_index = it->second;
+
+				}
+
+				mesh_description.subsets.push_back(SceneSnapshot::Description::Subset{ to_wstring(subset.subset_name_),
+																					   MeshSubset{ mesh_description.vertices.size(), subset.vertices_.size() / 3 },
+																					   material_index });
+
+				mesh_description.vertices.insert(mesh_description.vertices.end(),
+												 subset.vertices_.begin(),
+												 subset.vertices_.end());
+
+			}
+
+		}
+
+	}
+
+	/// \brief Import a mesh stored inside a snapshot as static mesh.
+	/// \param mesh Mesh to import.
+	/// \param resources Object used to create the actual static mesh.
+	ObjectPtr<IStaticMesh> ImportStaticMesh(const SnapshotMesh& mesh, Resources& resources) {
+
+		IStaticMesh::FromVertices<VertexFormatNormalTextured> bundle;
+
+		bundle.vertices.assign(mesh.vertices.begin(),
+							   mesh.vertices.end());
+
+		for (auto&& subset : mesh.subsets) {
+
+			bundle.subsets.push_back(MeshSubset{ static_cast<size_t>(subset.start_index),
+												 static_cast<size_t>(subset.count) });
+
+		}
+
+		auto static_mesh = resources.Load<IStaticMesh, IStaticMesh::FromVertices<VertexFormatNormalTextured>>(bundle);
+
+		static_mesh->SetName(wstring(mesh.name.begin(), mesh.name.end()));
+
+		for (size_t subset_index = 0; subset_index < mesh.subsets.size; ++subset_index) {
+
+			static_mesh->SetSubsetName(subset_index,
+									   wstring(mesh.subsets[subset_index].name.begin(), mesh.subsets[subset_index].name.end()));
+
+		}
+
+		return static_mesh;
+
+	}
+
+	/// \brief Create the nodes, meshes and materials stored inside a snapshot.
+	/// \param snapshot Snapshot to instantiate.
+	/// \param base_directory Directory of the file the snapshot was created from.
+	/// \param root The node where all the nodes will be attached hierarchically.
+	/// \param material_importer Importer receiving the materials of each mesh.
+	/// \param resources Object used to create the actual static meshes.
+	void Instantiate(const SceneSnapshot& snapshot, const wstring& base_directory, TransformComponent& root, IMtlMaterialImporter& material_importer, Resources& resources) {
+
+		auto& scene = root.GetComponent<NodeComponent>()->GetScene();
+
+		// Materials are rebuilt from their properties, so the material importer sees exactly what the MTL parser produced.
+
+		vector<unique_ptr<MtlMaterial>> materials;
+
+		for (auto&& material : snapshot.GetMaterials()) {
+
+			materials.push_back(make_unique<MtlMaterial>(string(material.name.begin(), material.name.end())));
+
+			for (auto&& property : material.properties) {
+
+				materials.back()->AddProperty(string(property.name.begin(), property.name.end()),
+											  string(property.value.begin(), property.value.end()));
+
+			}
+
+		}
+
+		vector<ObjectPtr<IStaticMesh>> meshes;
+
+		for (auto&& mesh : snapshot.GetMeshes()) {
+
+			meshes.push_back(ImportStaticMesh(mesh, resources));
+
+		}
+
+		// Node definition and hierarchy. Parents always precede their children.
+
+		vector<TransformComponent*> nodes;
+
+		MtlMaterialCollection material_collection;
+
+		auto is_static = root.GetComponent<NodeComponent>()->IsStatic();		// Static roots get static content
+
+		for (auto&& node : snapshot.GetNodes()) {
+
+			wstring name(node.name.begin(), node.name.end());
+
+			Translation3f translation(Vector3f(node.translation[0], node.translation[1], node.translation[2]));
+
+			Quaternionf rotation(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+
+			AlignedScaling3f scale(Vector3f(node.scale[0], node.scale[1], node.scale[2]));
+
+			auto transform = is_static ?
+							 scene.CreateStaticNode(name, translation, rotation, scale) :
+							 scene.CreateNode(name, translation, rotation, scale);
+
+			transform->SetParent(node.parent != SceneSnapshot::kNone ? nodes[node.parent] : &root);
+
+			nodes.push_back(transform);
+
+			if (node.mesh == SceneSnapshot::kNone) {
+
+				continue;
+
+			}
+
+			auto mesh_component = transform->AddComponent<MeshComponent>(meshes[node.mesh]);
+
+			// Material collection import
+
+			auto& mesh = snapshot.GetMeshes()[node.mesh];
+
+			material_collection.clear();
+
+			for (auto&& subset : mesh.subsets) {
+
+				material_collection.push_back(subset.material != SceneSnapshot::kNone ? materials[subset.material].get() : nullptr);
+
+			}
+
+			material_importer.OnImportMaterial(base_directory,
+											   material_collection,
+											   *mesh_component);
+
+		}
+
+	}
+
+	/// \brief Parse an OBJ file and store its content inside a snapshot.
+	/// \param file_name Name of the OBJ file.
+	/// \return Returns the snapshot of the file, if it could be parsed. Returns nullptr otherwise.
+	unique_ptr<SceneSnapshot> Snap(const wstring& file_name) {
+
+		ObjParser parser;
+
+		if (!parser.Parse(file_name)) {
+
+			return nullptr;
+
+		}
+
+		SceneSnapshot::Description description;
+
+		Describe(parser, file_name, description);
+
+		return make_unique<SceneSnapshot>(description);
+
+	}
+
+	/// \brief Hash every input of the snapshot of an OBJ file: the file itself and the material libraries it references.
+	/// \param file_name Name of the OBJ file.
+	/// \param key Key receiving the inputs.
+	/// \return Returns true if every input could be read, returns false otherwise.
+	bool AddSnapshotInputs(const wstring& file_name, DerivedDataKey& key) {
+
+		std::ifstream file(file_name.c_str(), ios::binary);
+
+		if (!file.good()) {
+
+			return false;
+
+		}
+
+		string content((std::istreambuf_iterator<char>(file)),
+					   std::istreambuf_iterator<char>());
+
+		key.AddValue(SceneSnapshot::kVersion);
+
+		key.AddValue(content.size());
+
+		key.AddData(content.data(), content.size());
+
+		// Material libraries are resolved line by line the same way the parser does, without parsing the rest of the file
+
+		istringstream content_stream(content);
+
+		string line;
+
+		vector<wstring> library_names;
+
+		while (getline(content_stream, line)) {
+
+			ObjParser::GetMaterialLibraries(line, file_name, library_names);
+
+		}
+
+		for (auto&& library_name : library_names) {
+
+			if (!key.AddFile(library_name)) {
+
+				return false;		// A library which cannot be hashed could change unnoticed
+
+			}
+
+		}
+
+		return true;
+
+	}
+
 }
 
 ////////////////////////////////// OBJ IMPORTER /////////////////////////////////////
 
-ObjImporter::ObjImporter(Resources& resources) :
-	resources_(resources) {}
+const string ObjImporter::kImporterName = "wavefront::ObjImporter";
+
+const unsigned int ObjImporter::kImporterVersion = 1;
+
+ObjImporter::ObjImporter(Resources& resources, DerivedDataCache* cache) :
+	resources_(resources),
+	cache_(cache) {}
 
 bool ObjImporter::ImportScene(const wstring& file_name, TransformComponent& root, IMtlMaterialImporter& material_importer) const{
 
-	ObjParser parser;
+	unique_ptr<SceneSnapshot> snapshot;
 
-	if (!parser.Parse(file_name)) {
+	if (cache_) {
 
-		return false;
+		// The snapshot stored inside the cache is up to date as long as none of its inputs changed.
+		// Scenes whose inputs cannot be hashed are never cached: they are parsed every time.
+
+		DerivedDataKey key(kImporterName, kImporterVersion);
+
+		auto cached = AddSnapshotInputs(file_name, key);
+
+		vector<char> blob;
+
+		if (cached && cache_->Get(key, blob)) {
+
+			snapshot = SceneSnapshot::Load(blob.data(), blob.size());
+
+		}
+
+		if (!snapshot) {
+
+			snapshot = Snap(file_name);
+
+			if (snapshot && cached) {
+
+				snapshot->Save(blob);
+
+				cache_->Put(key, blob.data(), blob.size());
+
+			}
+
+		}
 
 	}
+	else {
 
-	// Create the actual meshes, materials and hierarchy
-	
-	auto base_directory = FileSystem::GetInstance().GetDirectory(file_name);
+		snapshot = Snap(file_name);
 
-	auto& scene = root.GetComponent<NodeComponent>()->GetScene();
-	
-	Mesh mesh;
+	}
 
-	MtlMaterialCollection material_collection;
+	if (!snapshot) {
 
-	for (size_t index = 0; index < parser.GetObjectCount(); ++index) {
+		return false;
 
-		parser.GetMesh(index, mesh);
+	}
 
-		// Node definition and hierarchy
+	// Create the actual meshes, materials and hierarchy
 
-		auto node = scene.CreateNode(to_wstring(mesh.name_),
-									 Translation3f(Vector3f::Zero()),
-									 Quaternionf::Identity(),
-									 AlignedScaling3f(Vector3f::Ones()));
+	Instantiate(*snapshot,
+				FileSystem::GetInstance().GetDirectory(file_name),
+				root,
+				material_importer,
+				resources_);
 
-		node->SetParent(&root);
-		
-		// Mesh import
+	return true;
 
-		auto mesh_component = node->AddComponent<MeshComponent>(ImportStaticMesh(mesh, resources_));
+}
 
-		// Use the file name if the mesh didn't have any attached name to it
+bool ObjImporter::ImportScene(const wstring& file_name, const wstring& snapshot_file_name, TransformComponent& root, IMtlMaterialImporter& material_importer) const{
 
-		if (mesh_component->GetMesh()->GetName().length() == 0) {
+	// A snapshot which cannot be loaded (missing, truncated or stale version) is replaced by a fresh import
 
-			mesh_component->GetMesh()->SetName(file_name);
+	auto snapshot = SceneSnapshot::Load(snapshot_file_name);
 
-		}
-		
-		// Material collection import
+	if (!snapshot) {
 
-		material_collection.reserve(mesh.subsets_.size());
-		material_collection.clear();
+		snapshot = Snap(file_name);
 
-		for (auto&& subset : mesh.subsets_) {
+		if (!snapshot) {
 
-			material_collection.push_back(parser.GetMaterial(subset.material_name_));
+			return false;
 
 		}
 
-		material_importer.OnImportMaterial(base_directory, 
-										   material_collection, 
-										   *mesh_component);
-		
+		snapshot->Save(snapshot_file_name);
+
 	}
 
-	return false;
+	// Create the actual meshes, materials and hierarchy
+
+	Instantiate(*snapshot,
+				FileSystem::GetInstance().GetDirectory(file_name),
+				root,
+				material_importer,
+				resources_);
+
+	return true;
 
 }
 
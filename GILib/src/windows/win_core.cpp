@@ -304,6 +304,94 @@ wstring FileSystem::Read(const wstring& file_name) const{
 
 }
 
+bool FileSystem::MakeDirectory(const wstring& directory) const{
+
+	return CreateDirectoryW(directory.c_str(), nullptr) ||
+		   GetLastError() == ERROR_ALREADY_EXISTS;
+
+}
+
+void FileSystem::EnumerateFiles(const wstring& directory, const wstring& extension, vector<FileEntry>& files) const{
+
+	auto path = directory;
+
+	if (!path.empty() &&
+		path.back() != L'\\' &&
+		path.back() != L'/'){
+
+		path += kPathSeparator;
+
+	}
+
+	WIN32_FIND_DATAW find_data;
+
+	auto find_handle = FindFirstFileW((path + L"*" + extension).c_str(),
+									  &find_data);
+
+	if (find_handle == INVALID_HANDLE_VALUE){
+
+		return;		// No file, or no directory at all
+
+	}
+
+	do{
+
+		if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0){
+
+			files.push_back(FileEntry{ find_data.cFileName,
+									   (static_cast<unsigned long long>(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow,
+									   (static_cast<unsigned long long>(find_data.ftLastWriteTime.dwHighDateTime) << 32) | find_data.ftLastWriteTime.dwLowDateTime });
+
+		}
+
+	} while (FindNextFileW(find_handle, &find_data));
+
+	FindClose(find_handle);
+
+}
+
+bool FileSystem::Rename(const wstring& source, const wstring& destination) const{
+
+	return MoveFileExW(source.c_str(),
+					   destination.c_str(),
+					   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+
+}
+
+bool FileSystem::Remove(const wstring& file_name) const{
+
+	return DeleteFileW(file_name.c_str()) != 0;
+
+}
+
+bool FileSystem::Touch(const wstring& file_name) const{
+
+	auto file_handle = CreateFileW(file_name.c_str(),
+								   FILE_WRITE_ATTRIBUTES,
+								   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+								   nullptr,
+								   OPEN_EXISTING,
+								   FILE_ATTRIBUTE_NORMAL,
+								   nullptr);
+
+	if (file_handle == INVALID_HANDLE_VALUE){
+
+		return false;
+
+	}
+
+	FILETIME now;
+
+	GetSystemTimeAsFileTime(&now);
+
+	auto touched = SetFileTime(file_handle, nullptr, nullptr, &now) != 0;
+
+	CloseHandle(file_handle);
+
+	return touched;
+
+}
+
 //////////////////////////////////// APPLICATION /////////////////////////////////////////
 
 Application& Application::GetInstance(){
@@ -0,0 +1,98 @@
+/// \file test.h
+/// \brief Minimal framework used to register and run the tests and the benchmarks of the library.
+///
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+using ::std::string;
+using ::std::vector;
+
+namespace gi_test{
+
+	/// \brief Kind of a test case.
+	enum class TestKind{
+
+		kTest,				///< \brief Checks a behavior. Always run.
+		kBenchmark			///< \brief Measures a performance. Run on demand only.
+
+	};
+
+	/// \brief Signature of the function running a test case.
+	using TestFunction = void(*)();
+
+	/// \brief A registered test case.
+	struct TestCase{
+
+		const char* name;					///< \brief Name of the test case.
+
+		const char* file;					///< \brief File defining the test case.
+
+		TestFunction function;				///< \brief Function running the test case.
+
+		TestKind kind;						///< \brief Kind of the test case.
+
+	};
+
+	/// \brief Thrown when a check fails. Aborts the current test case.
+	/// \author Raffaele D. Facendola
+	class TestFailure{
+
+	public:
+
+		/// \brief Create a new failure.
+		/// \param message Description of the failure.
+		TestFailure(const string& message);
+
+		/// \brief Get the description of the failure.
+		const string& GetMessage() const;
+
+	private:
+
+		string message_;					///< \brief Description of the failure.
+
+	};
+
+	/// \brief Register a test case.
+	/// \return Returns the number of test cases registered so far. Used to run the registration during static initialization.
+	int Register(const TestCase& test_case);
+
+	/// \brief Get every registered test case.
+	const vector<TestCase>& GetTestCases();
+
+	/// \brief Fail the current test case if a condition doesn't hold.
+	/// \param condition Condition to check.
+	/// \param expression Text of the condition.
+	/// \param file File containing the check.
+	/// \param line Line of the check.
+	void Check(bool condition, const char* expression, const char* file, int line);
+
+	/// \brief Report a measurement of the current benchmark.
+	/// \param label What was measured.
+	/// \param value Measured value.
+	/// \param unit Unit of the measured value.
+	void Report(const string& label, double value, const char* unit);
+
+	/// \brief Get the number of heap allocations performed by the process so far.
+	/// Counts every call to the global operator new, from any thread.
+	size_t GetAllocationCount();
+
+}
+
+/// \brief Define and register a test case.
+#define TEST(name) \
+	static void name(); \
+	static const int name##_registration = ::gi_test::Register(::gi_test::TestCase{ #name, __FILE__, &name, ::gi_test::TestKind::kTest }); \
+	static void name()
+
+/// \brief Define and register a benchmark.
+#define BENCHMARK(name) \
+	static void name(); \
+	static const int name##_registration = ::gi_test::Register(::gi_test::TestCase{ #name, __FILE__, &name, ::gi_test::TestKind::kBenchmark }); \
+	static void name()
+
+/// \brief Fail the current test case if the condition doesn't hold.
+#define CHECK(condition) ::gi_test::Check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,130 @@
+/// \file test_scene.h
+/// \brief Volumes and queries shared by the tests of the volume hierarchies.
+///
+/// \author Raffaele D. Facendola
+
+#pragma once
+
+#include <vector>
+#include <random>
+
+#include "gimath.h"
+#include "scene.h"
+
+using ::std::vector;
+
+namespace gi_test{
+
+	/// \brief Axis-aligned box whose bounds are set explicitly rather than derived from a transform.
+	/// \author Raffaele D. Facendola
+	class BoxVolume : public gi_lib::VolumeComponent{
+
+	public:
+
+		/// \brief Create a new box.
+		/// \param bounds Bounds of the box.
+		BoxVolume(const gi_lib::AABB& bounds);
+
+		/// \brief Move the box and notify the change.
+		/// \param bounds New bounds of the box.
+		void SetBounds(const gi_lib::AABB& bounds);
+
+		virtual gi_lib::IntersectionType TestAgainst(const gi_lib::Frustum& frustum) const override;
+
+		virtual gi_lib::IntersectionType TestAgainst(const gi_lib::AABB& box) const override;
+
+		virtual gi_lib::IntersectionType TestAgainst(const gi_lib::Sphere& sphere) const override;
+
+		virtual gi_lib::AABB GetBoundingBox() const override;
+
+		/// \brief Get the number of frustum tests performed against any box so far.
+		static size_t GetFrustumTestCount();
+
+		/// \brief Get the number of times the bounds of any box were computed again so far.
+		static size_t GetBoundsUpdateCount();
+
+	protected:
+
+		virtual void Initialize() override;
+
+		virtual void Finalize() override;
+
+		virtual void UpdateBounds() override;
+
+	private:
+
+		gi_lib::AABB bounds_;					///< \brief Bounds of the box.
+
+	};
+
+	/// \brief Half-extent of the domain of the test scenes.
+	const float kSceneDomain = 2700.0f;
+
+	/// \brief Create boxes scattered uniformly inside a cubic domain.
+	/// The same seed always yields the same boxes.
+	/// \param count Number of boxes to create.
+	/// \param domain Half-extent of the domain.
+	/// \param max_size Maximum half-extent of each box.
+	/// \param seed Seed of the random generator.
+	vector<BoxVolume*> CreateBoxes(size_t count, float domain, float max_size, unsigned int seed);
+
+	/// \brief Dispose boxes created via CreateBoxes.
+	void DisposeBoxes(vector<BoxVolume*>& boxes);
+
+	/// \brief Move a box by an offset.
+	/// \param box Box to move.
+	/// \param offset Offset to apply to the center of the box.
+	void MoveBox(BoxVolume& box, const Eigen::Vector3f& offset);
+
+	/// \brief Move a box by a random offset.
+	/// \param box Box to move.
+	/// \param generator Random generator drawing the offset.
+	/// \param distance Maximum offset along each axis.
+	void MoveBox(BoxVolume& box, std::mt19937& generator, float distance);
+
+	/// \brief Create a perspective frustum.
+	/// \param position Position of the camera.
+	/// \param forward Direction the camera is looking at. Must be normalized and not vertical.
+	/// \param field_of_view Vertical and horizontal field of view, in radians.
+	/// \param near_plane Distance of the near plane.
+	/// \param far_plane Distance of the far plane.
+	gi_lib::Frustum MakeFrustum(const Eigen::Vector3f& position, const Eigen::Vector3f& forward, float field_of_view, float near_plane, float far_plane);
+
+	/// \brief Sort the result of a query, so that results of different traversals can be compared.
+	vector<gi_lib::VolumeComponent*> Sorted(vector<gi_lib::VolumeComponent*> volumes);
+
+	/// \brief Test every box against a query, without any hierarchy.
+	/// \param boxes Boxes to test.
+	/// \param query Frustum, sphere or box to test against.
+	/// \return Returns the boxes intersecting the query, sorted.
+	template <typename TQuery>
+	vector<gi_lib::VolumeComponent*> GetIntersections(const vector<BoxVolume*>& boxes, const TQuery& query);
+
+	/// \brief Check that a hierarchy returns the same volumes of the brute force test, for random queries inside the domain of the test scenes.
+	/// \param hierarchy Hierarchy storing the boxes.
+	/// \param boxes Boxes stored by the hierarchy.
+	/// \param seed Seed of the random generator placing the queries.
+	void CheckQueries(const gi_lib::IVolumeHierarchy& hierarchy, const vector<BoxVolume*>& boxes, unsigned int seed);
+
+	/////////////////////////////////// HELPERS ///////////////////////////////////
+
+	template <typename TQuery>
+	inline vector<gi_lib::VolumeComponent*> GetIntersections(const vector<BoxVolume*>& boxes, const TQuery& query){
+
+		vector<gi_lib::VolumeComponent*> intersections;
+
+		for (auto&& box : boxes){
+
+			if (box->TestAgainst(query) != gi_lib::IntersectionType::kNone){
+
+				intersections.push_back(box);
+
+			}
+
+		}
+
+		return Sorted(std::move(intersections));
+
+	}
+
+}
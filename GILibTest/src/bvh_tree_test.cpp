@@ -0,0 +1,339 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <chrono>
+
+#include "bvh_tree.h"
+#include "uniform_tree.h"
+#include "timer.h"
+#include "scope_guard.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Create a uniform tree covering the domain of the test scenes.
+	unique_ptr<UniformTree> MakeUniformTree(){
+
+		return make_unique<UniformTree>(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) },
+										Vector3i::Ones() * 3);
+
+	}
+
+}
+
+TEST(BVHTreeMatchesBruteForce){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree bvh;
+
+	for (auto&& box : boxes){
+
+		bvh.AddVolume(box);
+
+	}
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 2);
+
+}
+
+TEST(BVHTreeRefitsMovedVolumes){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 3);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree bvh;
+
+	for (auto&& box : boxes){
+
+		bvh.AddVolume(box);
+
+	}
+
+	bvh.Commit();
+
+	mt19937 generator(4);
+
+	for (size_t index = 0; index < boxes.size(); index += 3){
+
+		MoveBox(*boxes[index], generator, 200.0f);
+
+	}
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 5);
+
+	// Removed volumes are never returned
+
+	for (size_t index = 0; index < boxes.size(); index += 2){
+
+		bvh.RemoveVolume(boxes[index]);
+
+		boxes[index]->Dispose();
+
+		boxes[index] = nullptr;
+
+	}
+
+	boxes.erase(std::remove(boxes.begin(), boxes.end(), nullptr), boxes.end());
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 6);
+
+	// A synchronous rebuild yields the same results
+
+	bvh.Rebuild();
+
+	CheckQueries(bvh, boxes, 7);
+
+}
+
+TEST(BVHTreeMatchesUniformTree){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 8);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree bvh;
+
+	auto uniform_tree = MakeUniformTree();
+
+	for (auto&& box : boxes){
+
+		bvh.AddVolume(box);
+
+		uniform_tree->AddVolume(box);
+
+	}
+
+	bvh.Commit();
+
+	uniform_tree->Commit();
+
+	auto frustum = MakeFrustum(Vector3f::Zero(), Vector3f::UnitZ(), 1.2f, 1.0f, 3000.0f);
+
+	CHECK(Sorted(bvh.GetIntersections(frustum)) == Sorted(uniform_tree->GetIntersections(frustum)));
+
+}
+
+TEST(BVHTreeAdoptsBackgroundRebuilds){
+
+	// A threshold of 0 starts a background rebuild whenever the tree changes.
+
+	auto boxes = CreateBoxes(3000, kSceneDomain, 30.0f, 11);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree bvh(0.0f);
+
+	for (auto&& box : boxes){
+
+		bvh.AddVolume(box);
+
+	}
+
+	mt19937 generator(12);
+
+	for (unsigned int round = 0; round < 8; ++round){
+
+		// Move, remove and add volumes while the build runs on an older snapshot
+
+		for (size_t index = round; index < boxes.size(); index += 5){
+
+			MoveBox(*boxes[index], generator, 200.0f);
+
+		}
+
+		for (size_t index = round; index < boxes.size(); index += 37){
+
+			bvh.RemoveVolume(boxes[index]);
+
+			boxes[index]->Dispose();
+
+			boxes[index] = nullptr;
+
+		}
+
+		boxes.erase(std::remove(boxes.begin(), boxes.end(), nullptr), boxes.end());
+
+		for (auto&& box : CreateBoxes(50, kSceneDomain, 30.0f, 100 + round)){
+
+			bvh.AddVolume(box);
+
+			boxes.push_back(box);
+
+		}
+
+		// The next change adopts the finished build and patches the changes it missed
+
+		this_thread::sleep_for(chrono::milliseconds(50));
+
+		auto added = CreateBoxes(1, kSceneDomain, 30.0f, 200 + round);
+
+		bvh.AddVolume(added.front());
+
+		boxes.push_back(added.front());
+
+		bvh.Commit();
+
+		CheckQueries(bvh, boxes, 13 + round);
+
+	}
+
+}
+
+TEST(BVHTreeMovesVolumesBetweenBoundedAndUnbounded){
+
+	auto boxes = CreateBoxes(1000, kSceneDomain, 30.0f, 21);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree bvh;
+
+	for (auto&& box : boxes){
+
+		bvh.AddVolume(box);
+
+	}
+
+	auto infinity = numeric_limits<float>::infinity();
+
+	vector<AABB> original_bounds;
+
+	for (size_t index = 0; index < boxes.size(); index += 10){
+
+		original_bounds.push_back(boxes[index]->GetBoundingBox());
+
+		boxes[index]->SetBounds(AABB{ original_bounds.back().center, Vector3f::Ones() * infinity });
+
+	}
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 22);
+
+	// The volumes keep being tracked after changing set: moving them back is noticed
+
+	for (size_t index = 0; index < boxes.size(); index += 10){
+
+		boxes[index]->SetBounds(original_bounds[index / 10]);
+
+	}
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 23);
+
+	for (size_t index = 0; index < boxes.size(); index += 10){
+
+		boxes[index]->SetBounds(AABB{ original_bounds[index / 10].center, Vector3f::Ones() * infinity });
+
+	}
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 24);
+
+	// Unbounded volumes can be removed
+
+	for (size_t index = 0; index < boxes.size(); index += 10){
+
+		bvh.RemoveVolume(boxes[index]);
+
+		boxes[index]->Dispose();
+
+		boxes[index] = nullptr;
+
+	}
+
+	boxes.erase(std::remove(boxes.begin(), boxes.end(), nullptr), boxes.end());
+
+	bvh.Commit();
+
+	CheckQueries(bvh, boxes, 25);
+
+}
+
+BENCHMARK(BVHTreeVersusUniformTree){
+
+	// Side-by-side frustum queries on a synthetic 100k volumes scene
+
+	auto boxes = CreateBoxes(100000, kSceneDomain, 30.0f, 9);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree bvh;
+
+	auto uniform_tree = MakeUniformTree();
+
+	for (auto&& box : boxes){
+
+		bvh.AddVolume(box);
+
+		uniform_tree->AddVolume(box);
+
+	}
+
+	bvh.Commit();
+
+	uniform_tree->Commit();
+
+	mt19937 generator(10);
+
+	uniform_real_distribution<float> position(-kSceneDomain, kSceneDomain);
+
+	vector<Vector3f> positions;
+
+	vector<Vector3f> directions;
+
+	for (int query = 0; query < 100; ++query){
+
+		positions.push_back(Vector3f(position(generator), position(generator), position(generator)));
+
+		directions.push_back(Vector3f(position(generator), position(generator), kSceneDomain).normalized());
+
+	}
+
+	vector<VolumeComponent*> intersections;
+
+	Timer timer;
+
+	for (size_t query = 0; query < positions.size(); ++query){
+
+		intersections.clear();
+
+		bvh.GetIntersections(MakeFrustum(positions[query], directions[query], 1.0f, 1.0f, 2000.0f), intersections);
+
+	}
+
+	auto bvh_time = timer.GetTime().GetDeltaSeconds();
+
+	for (size_t query = 0; query < positions.size(); ++query){
+
+		intersections.clear();
+
+		uniform_tree->GetIntersections(MakeFrustum(positions[query], directions[query], 1.0f, 1.0f, 2000.0f), intersections);
+
+	}
+
+	auto uniform_tree_time = timer.GetTime().GetDeltaSeconds();
+
+	Report("BVHTree, per frustum query", 1000.0 * bvh_time / positions.size(), "ms");
+
+	Report("UniformTree, per frustum query", 1000.0 * uniform_tree_time / positions.size(), "ms");
+
+}
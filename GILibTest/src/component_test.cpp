@@ -0,0 +1,568 @@
+#include "test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "component.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Base component type.
+	class BaseComponent : public Component{
+
+	public:
+
+		virtual TypeSet GetTypes() const override{
+
+			return DeriveTypes<BaseComponent>(Component::GetTypes());
+
+		}
+
+	protected:
+
+		virtual void Initialize() override{}
+
+		virtual void Finalize() override{}
+
+	};
+
+	/// \brief Component type derived from another component type.
+	class DerivedComponent : public BaseComponent{
+
+	public:
+
+		virtual TypeSet GetTypes() const override{
+
+			return DeriveTypes<DerivedComponent>(BaseComponent::GetTypes());
+
+		}
+
+	};
+
+	/// \brief Unrelated component type, used to mimic the aspects of a node.
+	/// \tparam kIndex Index used to generate distinct types.
+	template <int kIndex>
+	class AspectLikeComponent : public Component{
+
+	public:
+
+		virtual TypeSet GetTypes() const override{
+
+			return DeriveTypes<AspectLikeComponent<kIndex>>(Component::GetTypes());
+
+		}
+
+	protected:
+
+		virtual void Initialize() override{}
+
+		virtual void Finalize() override{}
+
+	};
+
+	/// \brief Component type whose type information is computed by concurrent threads.
+	/// \tparam kIndex Index used to generate distinct types.
+	template <int kIndex>
+	class RacingComponent : public Component{
+
+	public:
+
+		/// \brief Extend a list of types with this type.
+		static TypeSet Derive(TypeSet base_types){
+
+			return DeriveTypes<RacingComponent<kIndex>>(base_types);
+
+		}
+
+	protected:
+
+		virtual void Initialize() override{}
+
+		virtual void Finalize() override{}
+
+	};
+
+	/// \brief Count the components of a range.
+	template <typename TRange>
+	size_t Count(TRange components){
+
+		return std::distance(components.begin(),
+							 components.end());
+
+	}
+
+	/// \brief Pair of components of the same entity.
+	using ComponentPair = pair<Component*, Component*>;
+
+	/// \brief Get the components visited by a query of two component types, sorted.
+	template <typename TFirst, typename TSecond>
+	vector<ComponentPair> GetQueryResults(const ComponentQuery<TFirst, TSecond>& query){
+
+		vector<ComponentPair> results;
+
+		query.ForEach([&results](TFirst& first, TSecond& second){
+
+			results.push_back(ComponentPair(&first, &second));
+
+		});
+
+		std::sort(results.begin(), results.end());
+
+		return results;
+
+	}
+
+	/// \brief Get the first components of each entity exposing two component types, sorted.
+	template <typename TFirst, typename TSecond>
+	vector<ComponentPair> GetExpectedResults(const vector<Component*>& entities){
+
+		vector<ComponentPair> results;
+
+		for (auto&& entity : entities){
+
+			auto first = entity->GetComponent<TFirst>();
+			auto second = entity->GetComponent<TSecond>();
+
+			if (first && second){
+
+				results.push_back(ComponentPair(first, second));
+
+			}
+
+		}
+
+		std::sort(results.begin(), results.end());
+
+		return results;
+
+	}
+
+}
+
+TEST(ComponentTypeIdsAreDense){
+
+	auto base = Component::GetTypeId<BaseComponent>();
+	auto derived = Component::GetTypeId<DerivedComponent>();
+	auto aspect = Component::GetTypeId<AspectLikeComponent<0>>();
+
+	CHECK(base != derived);
+	CHECK(base != aspect);
+	CHECK(derived != aspect);
+
+	// Ids are stable and assigned in sequence
+
+	CHECK(Component::GetTypeId<BaseComponent>() == base);
+
+	CHECK(Component::GetTypeId<AspectLikeComponent<1>>() == std::max(std::max(base, derived), aspect) + 1);
+
+}
+
+TEST(ComponentGetTypesDoesNotAllocate){
+
+	ComponentAllocator allocator;
+
+	auto component = Component::CreateIn<DerivedComponent>(allocator);
+
+	component->GetTypes();		// The list of each type is built the first time
+
+	auto allocations = GetAllocationCount();
+
+	auto types = component->GetTypes();
+
+	CHECK(GetAllocationCount() == allocations);
+
+	vector<ComponentTypeId> expected{ Component::GetTypeId<Component>(),
+									  Component::GetTypeId<BaseComponent>(),
+									  Component::GetTypeId<DerivedComponent>() };
+
+	CHECK(vector<ComponentTypeId>(types.begin(), types.end()) == expected);
+
+	component->Dispose();
+
+}
+
+TEST(ComponentLookupIsPolymorphic){
+
+	ComponentAllocator allocator;
+
+	auto entity = Component::CreateIn<AspectLikeComponent<0>>(allocator);
+
+	auto base = entity->AddComponent<BaseComponent>();
+	auto derived = entity->AddComponent<DerivedComponent>();
+
+	CHECK(entity->GetComponent<AspectLikeComponent<0>>() == entity);
+	CHECK(derived->GetComponent<DerivedComponent>() == derived);
+	CHECK(base->GetComponent<AspectLikeComponent<1>>() == nullptr);		// Type never added
+
+	// Derived components respond to their base types too
+
+	CHECK(Count(entity->GetComponents<BaseComponent>()) == 2);
+	CHECK(Count(entity->GetComponents<DerivedComponent>()) == 1);
+	CHECK(Count(entity->GetComponents<Component>()) == 3);
+
+	auto first = entity->GetComponent<BaseComponent>();
+
+	CHECK(first == base || first == derived);
+
+	// Lookups don't allocate
+
+	auto allocations = GetAllocationCount();
+
+	size_t found = 0;
+
+	for (auto&& component : entity->GetComponents<BaseComponent>()){
+
+		found += (&component == base || &component == derived) ? 1 : 0;
+
+	}
+
+	CHECK(entity->GetComponent<DerivedComponent>() == derived);
+
+	CHECK(GetAllocationCount() == allocations);
+
+	CHECK(found == 2);
+
+	entity->Dispose();
+
+}
+
+TEST(ComponentRemoval){
+
+	ComponentAllocator allocator;
+
+	auto entity = Component::CreateIn<AspectLikeComponent<0>>(allocator);
+
+	auto base = entity->AddComponent<BaseComponent>();
+	auto derived = entity->AddComponent<DerivedComponent>();
+
+	Component* removed = nullptr;
+
+	auto listener = derived->OnRemoved().Subscribe([&removed](Listener&, Component::OnRemovedEventArgs& args){
+
+		removed = args.component;
+
+	});
+
+	derived->RemoveComponent();
+
+	CHECK(removed == derived);
+
+	CHECK(entity->GetComponent<DerivedComponent>() == nullptr);
+	CHECK(entity->GetComponent<BaseComponent>() == base);
+	CHECK(Count(entity->GetComponents<Component>()) == 2);
+
+	// The component was returned to the pool of its type
+
+	CHECK(allocator.GetStatistics<DerivedComponent>().live_count == 0);
+	CHECK(allocator.GetStatistics<BaseComponent>().live_count == 1);
+
+	base->RemoveComponent();
+
+	CHECK(entity->GetComponent<BaseComponent>() == nullptr);
+	CHECK(Count(entity->GetComponents<Component>()) == 1);
+
+	// Slots of removed types can be filled again
+
+	auto added = entity->AddComponent<DerivedComponent>();
+
+	CHECK(entity->GetComponent<BaseComponent>() == added);
+
+	entity->Dispose();
+
+	CHECK(allocator.GetStatistics<AspectLikeComponent<0>>().live_count == 0);
+	CHECK(allocator.GetEntityStatistics().live_count == 0);
+
+}
+
+TEST(ComponentTypeInfoIsThreadSafe){
+
+	const size_t kThreads = 8;
+
+	vector<ComponentTypeId> base_types{ Component::GetTypeId<Component>() };
+
+	vector<ComponentTypeId> type_ids(kThreads);
+
+	vector<const ComponentTypeId*> type_lists(kThreads);
+
+	atomic<bool> start(false);
+
+	vector<thread> threads;
+
+	for (size_t index = 0; index < kThreads; ++index){
+
+		threads.push_back(thread([&, index](){
+
+			while (!start){
+
+				this_thread::yield();
+
+			}
+
+			type_ids[index] = Component::GetTypeId<RacingComponent<0>>();
+
+			auto types = RacingComponent<0>::Derive(Component::TypeSet(base_types.cbegin(),
+																	   base_types.cend()));
+
+			type_lists[index] = &(*types.begin());
+
+		}));
+
+	}
+
+	start = true;
+
+	for (auto& worker : threads){
+
+		worker.join();
+
+	}
+
+	// Every thread agrees on the same id and on the same list
+
+	CHECK(static_cast<size_t>(std::count(type_ids.begin(), type_ids.end(), type_ids[0])) == kThreads);
+
+	CHECK(static_cast<size_t>(std::count(type_lists.begin(), type_lists.end(), type_lists[0])) == kThreads);
+
+	auto types = RacingComponent<0>::Derive(Component::TypeSet(base_types.cbegin(),
+															   base_types.cend()));
+
+	vector<ComponentTypeId> expected{ Component::GetTypeId<Component>(),
+									  type_ids[0] };
+
+	CHECK(vector<ComponentTypeId>(types.begin(), types.end()) == expected);
+
+	// The id does not collide with any other id
+
+	CHECK(Component::GetTypeId<RacingComponent<1>>() != type_ids[0]);
+
+}
+
+TEST(ArchetypeStorageRelocatesEntities){
+
+	ComponentAllocator allocator;
+
+	vector<Component*> entities;
+
+	{
+
+		ArchetypeStorage storage;
+
+		for (int index = 0; index < 300; ++index){
+
+			auto entity = Component::CreateIn<AspectLikeComponent<0>>(allocator);
+
+			if (index % 2 == 0){
+
+				entity->AddComponent<BaseComponent>();
+
+			}
+
+			if (index % 3 == 0){
+
+				entity->AddComponent<DerivedComponent>();
+
+			}
+
+			storage.AddEntity(*entity);
+
+			storage.AddEntity(*entity);		// Adding twice does nothing
+
+			entities.push_back(entity);
+
+		}
+
+		// Derived components match their base types too. Entities with two base components are visited once.
+
+		CHECK((storage.Query<AspectLikeComponent<0>, Component>().GetSize() == 300));
+		CHECK((storage.Query<AspectLikeComponent<0>, BaseComponent>().GetSize() == 200));
+		CHECK((storage.Query<AspectLikeComponent<0>, DerivedComponent>().GetSize() == 100));
+
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<0>, BaseComponent>()) == GetExpectedResults<AspectLikeComponent<0>, BaseComponent>(entities)));
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<0>, DerivedComponent>()) == GetExpectedResults<AspectLikeComponent<0>, DerivedComponent>(entities)));
+
+		auto archetypes = storage.GetArchetypeCount();
+
+		// Adding and removing components moves the entities across archetypes
+
+		for (size_t index = 0; index < entities.size(); index += 5){
+
+			if (auto derived = entities[index]->GetComponent<DerivedComponent>()){
+
+				derived->RemoveComponent();
+
+			}
+			else{
+
+				entities[index]->AddComponent<DerivedComponent>();
+
+			}
+
+			entities[index]->AddComponent<AspectLikeComponent<1>>();
+
+		}
+
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<0>, BaseComponent>()) == GetExpectedResults<AspectLikeComponent<0>, BaseComponent>(entities)));
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<0>, DerivedComponent>()) == GetExpectedResults<AspectLikeComponent<0>, DerivedComponent>(entities)));
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<1>, BaseComponent>()) == GetExpectedResults<AspectLikeComponent<1>, BaseComponent>(entities)));
+
+		CHECK((storage.Query<AspectLikeComponent<1>, Component>().GetSize() == 60));
+
+		CHECK(storage.GetArchetypeCount() > archetypes);
+
+		// Disposed entities leave their archetype
+
+		for (size_t index = 0; index < entities.size(); index += 2){
+
+			entities[index]->Dispose();
+
+			entities[index] = nullptr;
+
+		}
+
+		entities.erase(std::remove(entities.begin(), entities.end(), nullptr),
+					   entities.end());
+
+		CHECK((storage.Query<AspectLikeComponent<0>, Component>().GetSize() == 150));
+
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<0>, BaseComponent>()) == GetExpectedResults<AspectLikeComponent<0>, BaseComponent>(entities)));
+		CHECK((GetQueryResults(storage.Query<AspectLikeComponent<1>, DerivedComponent>()) == GetExpectedResults<AspectLikeComponent<1>, DerivedComponent>(entities)));
+
+		// Entities whose last component is removed leave the storage
+
+		vector<Component*> remaining;
+
+		for (auto&& entity : entities){
+
+			auto aspect = entity->GetComponent<AspectLikeComponent<0>>();
+
+			for (auto&& component : entity->GetComponents<Component>()){
+
+				if (&component != aspect){
+
+					remaining.push_back(&component);
+
+					break;
+
+				}
+
+			}
+
+			aspect->RemoveComponent();
+
+		}
+
+		entities = std::move(remaining);
+
+		CHECK((storage.Query<AspectLikeComponent<0>, Component>().GetSize() == 0));
+
+		CHECK((storage.Query<Component, Component>().GetSize() == entities.size()));
+
+		CHECK((GetQueryResults(storage.Query<BaseComponent, Component>()) == GetExpectedResults<BaseComponent, Component>(entities)));
+
+		CHECK(allocator.GetEntityStatistics().live_count == entities.size());
+
+	}
+
+	// Entities outlive the storage they belonged to
+
+	for (auto&& entity : entities){
+
+		entity->AddComponent<AspectLikeComponent<2>>();
+
+		entity->Dispose();
+
+	}
+
+	CHECK(allocator.GetEntityStatistics().live_count == 0);
+
+}
+
+BENCHMARK(ComponentLookup){
+
+	// Entities shaped like the nodes of a scene: the renderer walks the aspects of each visible node
+
+	const size_t kEntities = 10000;
+
+	const int kFrames = 100;
+
+	ComponentAllocator allocator;
+
+	vector<Component*> entities;
+
+	for (size_t index = 0; index < kEntities; ++index){
+
+		auto entity = Component::CreateIn<AspectLikeComponent<0>>(allocator);
+
+		entity->AddComponent<AspectLikeComponent<1>>();
+		entity->AddComponent<AspectLikeComponent<2>>();
+		entity->AddComponent<DerivedComponent>();
+
+		if (index % 2 == 1){
+
+			entity->AddComponent<DerivedComponent>();
+
+		}
+
+		entities.push_back(entity->AddComponent<AspectLikeComponent<3>>());
+
+	}
+
+	size_t found = 0;
+
+	Timer timer;
+
+	auto allocations = GetAllocationCount();
+
+	for (int frame = 0; frame < kFrames; ++frame){
+
+		for (auto&& entity : entities){
+
+			found += entity->GetComponent<AspectLikeComponent<1>>() ? 1 : 0;
+
+			found += Count(entity->GetComponents<BaseComponent>());
+
+		}
+
+	}
+
+	allocations = GetAllocationCount() - allocations;
+
+	auto time = timer.GetTime().GetDeltaSeconds();
+
+	Report("Lookups per entity", 1000000000.0 * time / (kFrames * kEntities), "ns");
+
+	Report("Allocations", static_cast<double>(allocations), "allocations");
+
+	CHECK(found == kFrames * (kEntities + kEntities + kEntities / 2));
+
+	timer.GetTime();		// Restart the delta
+
+	size_t types = 0;
+
+	for (int frame = 0; frame < kFrames; ++frame){
+
+		for (auto&& entity : entities){
+
+			types += Count(entity->GetComponent<DerivedComponent>()->GetTypes());
+
+		}
+
+	}
+
+	Report("GetTypes per call", 1000000000.0 * timer.GetTime().GetDeltaSeconds() / (kFrames * kEntities), "ns");
+
+	CHECK(types == kFrames * kEntities * 3);
+
+	for (auto&& entity : entities){
+
+		entity->Dispose();
+
+	}
+
+}
@@ -0,0 +1,194 @@
+#include "test.h"
+
+#include <vector>
+#include <fstream>
+#include <cwchar>
+
+#include "core.h"
+#include "derived_data_cache.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Directory storing the blobs of the tests.
+	const wchar_t kCacheDirectory[] = L"derived_data_cache_test_cache/";
+
+	/// \brief Delete the blobs stored by previous runs.
+	void ClearCache(){
+
+		auto& file_system = FileSystem::GetInstance();
+
+		file_system.MakeDirectory(kCacheDirectory);
+
+		vector<FileEntry> files;
+
+		file_system.EnumerateFiles(kCacheDirectory, L"", files);
+
+		for (auto&& file : files){
+
+			file_system.Remove(kCacheDirectory + file.name);
+
+		}
+
+	}
+
+	/// \brief Create the key of a blob.
+	DerivedDataKey MakeKey(int index){
+
+		DerivedDataKey key("DerivedDataCacheTest", 1);
+
+		key.AddValue(index);
+
+		return key;
+
+	}
+
+	/// \brief Count the files inside the cache directory having the given extension.
+	size_t CountFiles(const wstring& extension){
+
+		vector<FileEntry> files;
+
+		FileSystem::GetInstance().EnumerateFiles(kCacheDirectory, extension, files);
+
+		return files.size();
+
+	}
+
+}
+
+TEST(DerivedDataCacheReplaceKeepsSize){
+
+	ClearCache();
+
+	vector<char> content(1000, 'a');
+
+	DerivedDataCache cache(kCacheDirectory, 1 << 20);
+
+	CHECK(cache.Put(MakeKey(0), content.data(), content.size()));
+
+	auto blob_size = cache.GetSize();
+
+	CHECK(blob_size > content.size());
+
+	// Replacing a blob doesn't count it twice
+
+	for (int put = 0; put < 10; ++put){
+
+		CHECK(cache.Put(MakeKey(0), content.data(), content.size()));
+
+	}
+
+	CHECK(cache.GetSize() == blob_size);
+
+	// A smaller blob shrinks the size
+
+	CHECK(cache.Put(MakeKey(0), content.data(), content.size() / 2));
+
+	CHECK(cache.GetSize() == blob_size - content.size() / 2);
+
+	CHECK(cache.Put(MakeKey(1), content.data(), content.size()));
+
+	CHECK(cache.GetSize() == 2 * blob_size - content.size() / 2);
+
+	// The estimate agrees with the directory
+
+	auto size = cache.GetSize();
+
+	cache.Trim();
+
+	CHECK(cache.GetSize() == size);
+
+	ClearCache();
+
+}
+
+TEST(DerivedDataCacheReplaceDoesNotTrim){
+
+	ClearCache();
+
+	vector<char> content(1000, 'a');
+
+	DerivedDataCache cache(kCacheDirectory, 2500);
+
+	CHECK(cache.Put(MakeKey(0), content.data(), content.size()));
+
+	CHECK(cache.Put(MakeKey(1), content.data(), content.size()));
+
+	// Both blobs fit: replacing one of them many times must not evict the other
+
+	for (int put = 0; put < 10; ++put){
+
+		CHECK(cache.Put(MakeKey(1), content.data(), content.size()));
+
+	}
+
+	vector<char> data;
+
+	CHECK(cache.Get(MakeKey(0), data));
+
+	CHECK(data == content);
+
+	CHECK(cache.Get(MakeKey(1), data));
+
+	ClearCache();
+
+}
+
+TEST(DerivedDataCacheTrimsTemporaryFiles){
+
+	ClearCache();
+
+	vector<char> content(1000, 'a');
+
+	{
+		DerivedDataCache cache(kCacheDirectory, 2500);
+
+		CHECK(cache.Put(MakeKey(0), content.data(), content.size()));
+
+	}
+
+	auto directory = string(kCacheDirectory, kCacheDirectory + wcslen(kCacheDirectory));
+
+	// Left behind by a writer which died
+
+	{
+		ofstream stale_file(directory + "stale.tmp", ios::binary | ios::trunc);
+
+		stale_file.write(content.data(), content.size());
+
+	}
+
+	// Still being written: it cannot be deleted
+
+	ofstream open_file(directory + "open.tmp", ios::binary | ios::trunc);
+
+	open_file.write(content.data(), content.size());
+
+	open_file.write(content.data(), content.size());
+
+	open_file.flush();
+
+	DerivedDataCache cache(kCacheDirectory, 2500);
+
+	CHECK(CountFiles(L".tmp") == 1);
+
+	// The open file counts towards the capacity, so the blob is evicted
+
+	CHECK(CountFiles(L".ddc") == 0);
+
+	CHECK(cache.GetSize() == 2 * content.size());
+
+	open_file.close();
+
+	cache.Trim();
+
+	CHECK(CountFiles(L".tmp") == 0);
+
+	CHECK(cache.GetSize() == 0);
+
+	ClearCache();
+
+}
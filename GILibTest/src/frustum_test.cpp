@@ -0,0 +1,422 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <random>
+
+#include "gimath.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Half-extent of the domain of the test volumes.
+	const float kDomain = 1000.0f;
+
+	/// \brief Distance from a plane below which the SIMD and the scalar tests may disagree because of rounding.
+	const float kTolerance = 0.01f;
+
+	/// \brief Number of volumes of the streams. Not a multiple of the SIMD width, so that the scalar tail is exercised as well.
+	const size_t kStreamSize = 10003;
+
+	/// \brief Check whether the i-th bit of a bitmask is set.
+	bool IsSet(const unsigned int* bitmask, size_t index){
+
+		return (bitmask[index >> 5] & (1u << (index & 31))) != 0;
+
+	}
+
+	/// \brief Create a random frustum looking at the domain.
+	Frustum MakeRandomFrustum(mt19937& generator){
+
+		uniform_real_distribution<float> position(-kDomain, kDomain);
+
+		uniform_real_distribution<float> field_of_view(0.3f, 1.5f);
+
+		Vector3f forward(position(generator), 0.5f * position(generator), position(generator));
+
+		return MakeFrustum(Vector3f(position(generator), position(generator), position(generator)),
+						   forward.normalized(),
+						   field_of_view(generator),
+						   1.0f,
+						   2.0f * kDomain);
+
+	}
+
+	/// \brief Grow or shrink a box by the given amount.
+	AABB Grow(const AABB& aabb, float amount){
+
+		return AABB{ aabb.center, aabb.half_extents + Vector3f::Constant(amount) };
+
+	}
+
+	/// \brief Grow or shrink a sphere by the given amount.
+	Sphere Grow(const Sphere& sphere, float amount){
+
+		return Sphere{ sphere.center, sphere.radius + amount };
+
+	}
+
+	/// \brief Check whether a volume lies so close to a plane that the outcome of the test depends on rounding.
+	template <typename TVolume>
+	bool IsBorderline(const Frustum& frustum, const TVolume& volume, unsigned int plane_mask){
+
+		auto grown_mask = plane_mask;
+
+		auto shrunk_mask = plane_mask;
+
+		return frustum.Intersect(Grow(volume, kTolerance), grown_mask) != frustum.Intersect(Grow(volume, -kTolerance), shrunk_mask) ||
+			   grown_mask != shrunk_mask;
+
+	}
+
+	/// \brief Check that the outcome of a stream test matches the scalar test of each volume of the stream.
+	/// \param begin Index of the first volume of the stream that was tested.
+	/// \param end Index past the last volume of the stream that was tested.
+	template <typename TStream>
+	void CheckStream(const Frustum& frustum, const TStream& stream, size_t begin, size_t end, unsigned int plane_mask, const unsigned int* visibility, const unsigned int* containment){
+
+		for (size_t index = begin; index < end; ++index){
+
+			auto volume = stream.Get(index);
+
+			auto volume_mask = plane_mask;
+
+			auto intersection = frustum.Intersect(volume, volume_mask);
+
+			if (IsBorderline(frustum, volume, plane_mask)){
+
+				continue;
+
+			}
+
+			CHECK(IsSet(visibility, index - begin) == (intersection && IntersectionType::kIntersect));
+			CHECK(IsSet(containment, index - begin) == (intersection && IntersectionType::kInside));
+
+		}
+
+	}
+
+	/// \brief Create a stream of random boxes.
+	AABBStream CreateAABBStream(size_t count, unsigned int seed){
+
+		AABBStream stream;
+
+		for (auto&& box : CreateBoxes(count, kDomain, 100.0f, seed)){
+
+			stream.PushBack(box->GetBoundingBox());
+
+			box->Dispose();
+
+		}
+
+		return stream;
+
+	}
+
+	/// \brief Create a stream of random spheres.
+	SphereStream CreateSphereStream(size_t count, unsigned int seed){
+
+		mt19937 generator(seed);
+
+		uniform_real_distribution<float> position(-kDomain, kDomain);
+
+		uniform_real_distribution<float> radius(1.0f, 100.0f);
+
+		SphereStream stream;
+
+		for (size_t index = 0; index < count; ++index){
+
+			stream.PushBack(Sphere{ Vector3f(position(generator), position(generator), position(generator)), radius(generator) });
+
+		}
+
+		return stream;
+
+	}
+
+}
+
+TEST(FrustumAABBStreamMatchesScalar){
+
+	auto aabbs = CreateAABBStream(kStreamSize, 1);
+
+	mt19937 generator(2);
+
+	uniform_int_distribution<unsigned int> plane_mask(0, Frustum::kAllPlanes);
+
+	vector<unsigned int> visibility;
+
+	vector<unsigned int> containment;
+
+	for (int query = 0; query < 20; ++query){
+
+		auto frustum = MakeRandomFrustum(generator);
+
+		frustum.Intersect(aabbs, visibility);
+
+		frustum.Intersect(aabbs, Frustum::kAllPlanes, visibility, containment);
+
+		CheckStream(frustum, aabbs, 0, aabbs.GetSize(), Frustum::kAllPlanes, visibility.data(), containment.data());
+
+		// Subsets of planes
+
+		auto mask = plane_mask(generator);
+
+		frustum.Intersect(aabbs, mask, visibility, containment);
+
+		CheckStream(frustum, aabbs, 0, aabbs.GetSize(), mask, visibility.data(), containment.data());
+
+	}
+
+}
+
+TEST(FrustumSphereStreamMatchesScalar){
+
+	auto spheres = CreateSphereStream(kStreamSize, 3);
+
+	mt19937 generator(4);
+
+	uniform_int_distribution<unsigned int> plane_mask(0, Frustum::kAllPlanes);
+
+	vector<unsigned int> visibility;
+
+	vector<unsigned int> containment;
+
+	for (int query = 0; query < 20; ++query){
+
+		auto frustum = MakeRandomFrustum(generator);
+
+		frustum.Intersect(spheres, Frustum::kAllPlanes, visibility, containment);
+
+		CheckStream(frustum, spheres, 0, spheres.GetSize(), Frustum::kAllPlanes, visibility.data(), containment.data());
+
+		auto mask = plane_mask(generator);
+
+		frustum.Intersect(spheres, mask, visibility, containment);
+
+		CheckStream(frustum, spheres, 0, spheres.GetSize(), mask, visibility.data(), containment.data());
+
+	}
+
+}
+
+TEST(FrustumStreamRangeMatchesScalar){
+
+	auto aabbs = CreateAABBStream(kStreamSize, 5);
+
+	auto spheres = CreateSphereStream(kStreamSize, 6);
+
+	mt19937 generator(7);
+
+	uniform_int_distribution<size_t> range(0, kStreamSize);
+
+	vector<unsigned int> visibility((kStreamSize + 31) / 32);
+
+	vector<unsigned int> containment((kStreamSize + 31) / 32);
+
+	for (int query = 0; query < 20; ++query){
+
+		auto frustum = MakeRandomFrustum(generator);
+
+		auto begin = range(generator);
+
+		auto end = range(generator);
+
+		if (begin > end){
+
+			swap(begin, end);
+
+		}
+
+		frustum.Intersect(aabbs, begin, end, Frustum::kAllPlanes, visibility.data(), containment.data());
+
+		CheckStream(frustum, aabbs, begin, end, Frustum::kAllPlanes, visibility.data(), containment.data());
+
+		frustum.Intersect(spheres, begin, end, Frustum::kAllPlanes, visibility.data(), containment.data());
+
+		CheckStream(frustum, spheres, begin, end, Frustum::kAllPlanes, visibility.data(), containment.data());
+
+	}
+
+}
+
+TEST(FrustumReportsContainment){
+
+	auto frustum = MakeFrustum(Vector3f::Zero(), Vector3f::UnitZ(), 1.0f, 1.0f, 100.0f);
+
+	auto plane_mask = Frustum::kAllPlanes;
+
+	// Fully inside
+
+	CHECK(frustum.Intersect(AABB{ Vector3f(0.0f, 0.0f, 50.0f), Vector3f::Ones() }, plane_mask) == (IntersectionType::kInside | IntersectionType::kIntersect));
+	CHECK(plane_mask == 0);
+
+	CHECK(frustum.Intersect(Sphere{ Vector3f(0.0f, 0.0f, 50.0f), 1.0f }) == (IntersectionType::kInside | IntersectionType::kIntersect));
+
+	// Crossing the far plane only
+
+	plane_mask = Frustum::kAllPlanes;
+
+	CHECK(frustum.Intersect(AABB{ Vector3f(0.0f, 0.0f, 100.0f), Vector3f::Ones() }, plane_mask) == IntersectionType::kIntersect);
+	CHECK(plane_mask == 2u);
+
+	// Outside
+
+	CHECK(frustum.Intersect(AABB{ Vector3f(0.0f, 0.0f, -50.0f), Vector3f::Ones() }) == IntersectionType::kNone);
+	CHECK(frustum.Intersect(Sphere{ Vector3f(0.0f, 0.0f, 150.0f), 1.0f }) == IntersectionType::kNone);
+
+	// Planes outside the mask are ignored
+
+	plane_mask = Frustum::kAllPlanes & ~2u;
+
+	CHECK(frustum.Intersect(AABB{ Vector3f(0.0f, 0.0f, 150.0f), Vector3f::Ones() }, plane_mask) == (IntersectionType::kInside | IntersectionType::kIntersect));
+
+}
+
+TEST(FrustumPlaneMaskPreservesOutcome){
+
+	// Planes containing a box contain every box inside it: testing the inner boxes against the remaining planes only must not change the outcome.
+
+	mt19937 generator(11);
+
+	uniform_real_distribution<float> position(-kDomain, kDomain);
+
+	uniform_real_distribution<float> size(10.0f, 300.0f);
+
+	uniform_real_distribution<float> fraction(0.0f, 1.0f);
+
+	size_t masked_children = 0;
+
+	for (int query = 0; query < 20; ++query){
+
+		auto frustum = MakeRandomFrustum(generator);
+
+		for (int parent_index = 0; parent_index < 100; ++parent_index){
+
+			AABB parent{ Vector3f(position(generator), position(generator), position(generator)),
+						 Vector3f(size(generator), size(generator), size(generator)) };
+
+			auto parent_mask = Frustum::kAllPlanes;
+
+			if (frustum.Intersect(parent, parent_mask) == IntersectionType::kNone){
+
+				continue;
+
+			}
+
+			for (int child_index = 0; child_index < 20; ++child_index){
+
+				Vector3f half_extents = parent.half_extents.cwiseProduct(Vector3f(fraction(generator), fraction(generator), fraction(generator)));
+
+				Vector3f slack = parent.half_extents - half_extents;
+
+				Vector3f offset = slack.cwiseProduct(Vector3f(2.0f * fraction(generator) - 1.0f, 2.0f * fraction(generator) - 1.0f, 2.0f * fraction(generator) - 1.0f));
+
+				AABB child{ parent.center + offset, half_extents };
+
+				if (IsBorderline(frustum, child, Frustum::kAllPlanes)){
+
+					continue;
+
+				}
+
+				auto child_mask = parent_mask;
+
+				CHECK(frustum.Intersect(child, child_mask) == frustum.Intersect(child));
+
+				if (parent_mask != Frustum::kAllPlanes){
+
+					++masked_children;
+
+				}
+
+			}
+
+		}
+
+	}
+
+	CHECK(masked_children > 0);
+
+}
+
+BENCHMARK(FrustumStreamVersusScalar){
+
+	// Whole-stream tests versus one test per volume
+
+	const size_t kVolumes = 100000;
+
+	const int kQueries = 100;
+
+	auto aabbs = CreateAABBStream(kVolumes, 8);
+
+	auto spheres = CreateSphereStream(kVolumes, 9);
+
+	vector<AABB> boxes;
+
+	for (size_t index = 0; index < kVolumes; ++index){
+
+		boxes.push_back(aabbs.Get(index));
+
+	}
+
+	mt19937 generator(10);
+
+	auto frustum = MakeRandomFrustum(generator);
+
+	vector<unsigned int> visibility;
+
+	vector<unsigned int> containment;
+
+	size_t visible = 0;
+
+	Timer timer;
+
+	for (int query = 0; query < kQueries; ++query){
+
+		for (auto&& box : boxes){
+
+			if (frustum.Intersect(box) && IntersectionType::kIntersect){
+
+				++visible;
+
+			}
+
+		}
+
+	}
+
+	auto scalar_time = timer.GetTime().GetDeltaSeconds();
+
+	for (int query = 0; query < kQueries; ++query){
+
+		frustum.Intersect(aabbs, Frustum::kAllPlanes, visibility, containment);
+
+		visible += visibility[0] & 1u;
+
+	}
+
+	auto aabb_stream_time = timer.GetTime().GetDeltaSeconds();
+
+	for (int query = 0; query < kQueries; ++query){
+
+		frustum.Intersect(spheres, Frustum::kAllPlanes, visibility, containment);
+
+		visible += visibility[0] & 1u;
+
+	}
+
+	auto sphere_stream_time = timer.GetTime().GetDeltaSeconds();
+
+	Report("Scalar AABB test, per volume", 1e9 * scalar_time / (kQueries * kVolumes), "ns");
+
+	Report("AABB stream test, per volume", 1e9 * aabb_stream_time / (kQueries * kVolumes), "ns");
+
+	Report("Sphere stream test, per volume", 1e9 * sphere_stream_time / (kQueries * kVolumes), "ns");
+
+	Report("Visible volumes, total", static_cast<double>(visible), "volumes");
+
+}
@@ -0,0 +1,228 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <random>
+#include <algorithm>
+
+#include "loose_octree.h"
+#include "scope_guard.h"
+#include "exceptions.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Create an empty loose octree covering the domain of the test scenes.
+	unique_ptr<LooseOctree> MakeLooseOctree(){
+
+		return make_unique<LooseOctree>(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, 5);
+
+	}
+
+}
+
+TEST(LooseOctreeRelocatesMovedVolumes){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto octree = MakeLooseOctree();
+
+	for (auto&& box : boxes){
+
+		octree->AddVolume(box);
+
+	}
+
+	octree->Commit();
+
+	CheckQueries(*octree, boxes, 2);
+
+	// Small movements mostly stay inside the same cell, large ones cross cells and levels. Each box is moved twice.
+
+	mt19937 generator(3);
+
+	unsigned int moved = 0;
+
+	for (size_t index = 0; index < boxes.size(); index += 3){
+
+		auto distance = (index % 2 == 0) ? 5.0f : 1000.0f;
+
+		MoveBox(*boxes[index], generator, distance);
+		MoveBox(*boxes[index], generator, distance);
+
+		++moved;
+
+	}
+
+	// Outside the domain
+
+	boxes[1]->SetBounds(AABB{ Vector3f::Ones() * 2.0f * kSceneDomain, Vector3f::Ones() * 10.0f });
+
+	++moved;
+
+	octree->Commit();
+
+	auto stats = octree->GetStats();
+
+	CHECK(stats.changes == 2 * moved - 1);
+	CHECK(stats.relocations == moved);
+	CHECK(stats.coalesced == moved - 1);
+
+	CheckQueries(*octree, boxes, 4);
+
+	CHECK(octree->GetIntersections(AABB{ Vector3f::Ones() * 2.0f * kSceneDomain, Vector3f::Ones() }) == vector<VolumeComponent*>{ boxes[1] });
+
+	// Nothing changed
+
+	octree->Commit();
+
+	stats = octree->GetStats();
+
+	CHECK(stats.changes == 0);
+	CHECK(stats.relocations == 0);
+
+	for (auto&& box : boxes){
+
+		octree->RemoveVolume(box);
+
+	}
+
+}
+
+TEST(LooseOctreeRemovesVolumes){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 5);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto octree = MakeLooseOctree();
+
+	for (auto&& box : boxes){
+
+		octree->AddVolume(box);
+
+	}
+
+	octree->Commit();
+
+	mt19937 generator(6);
+
+	// Moved and then removed before the commit: the pending change is dropped along with the volume
+
+	vector<BoxVolume*> removed;
+
+	vector<BoxVolume*> kept;
+
+	for (size_t index = 0; index < boxes.size(); ++index){
+
+		if (index % 2 == 0){
+
+			MoveBox(*boxes[index], generator, 1000.0f);
+
+			octree->RemoveVolume(boxes[index]);
+
+			CHECK(boxes[index]->GetHierarchySlot() == VolumeComponent::kNoSlot);
+
+			removed.push_back(boxes[index]);
+
+		}
+		else{
+
+			kept.push_back(boxes[index]);
+
+		}
+
+	}
+
+	// Removing twice does nothing
+
+	octree->RemoveVolume(removed.front());
+
+	octree->Commit();
+
+	CHECK(octree->GetStats().relocations == 0);
+
+	CheckQueries(*octree, kept, 7);
+
+	// Removed volumes are free to join another octree, whose changes don't reach the first one
+
+	auto other_octree = MakeLooseOctree();
+
+	for (auto&& box : removed){
+
+		other_octree->AddVolume(box);
+
+		MoveBox(*box, generator, 1000.0f);
+
+	}
+
+	octree->Commit();
+
+	other_octree->Commit();
+
+	CHECK(octree->GetStats().changes == 0);
+
+	CHECK(other_octree->GetStats().relocations == removed.size());
+
+	CheckQueries(*octree, kept, 8);
+
+	CheckQueries(*other_octree, removed, 9);
+
+	// A volume can't be stored by two octrees at once
+
+	auto rejected = false;
+
+	try{
+
+		octree->AddVolume(removed.front());
+
+	}
+	catch (const gi_lib::Exception&){
+
+		rejected = true;
+
+	}
+
+	CHECK(rejected);
+
+	CHECK(other_octree->GetIntersections(removed.front()->GetBoundingBox()).size() > 0);
+
+	octree->Commit();
+
+	CheckQueries(*octree, kept, 10);
+
+	// Freed slots are reused
+
+	for (auto&& box : removed){
+
+		other_octree->RemoveVolume(box);
+
+		octree->AddVolume(box);
+
+	}
+
+	for (auto&& box : kept){
+
+		MoveBox(*box, generator, 1000.0f);
+
+	}
+
+	octree->Commit();
+
+	CHECK(octree->GetStats().relocations == kept.size());
+
+	CheckQueries(*octree, boxes, 11);
+
+	for (auto&& box : boxes){
+
+		octree->RemoveVolume(box);
+
+	}
+
+	CheckQueries(*octree, vector<BoxVolume*>{}, 12);
+
+}
@@ -0,0 +1,312 @@
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "object.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Number of threads used by the contended tests.
+	const int kThreadCount = 4;
+
+	/// \brief Object counting its destructions.
+	class CountedObject : public Object{
+
+	public:
+
+		/// \brief Create a new object.
+		/// \param policy Policy used to count the references of the object.
+		/// \param destructions Incremented when the object is destroyed.
+		CountedObject(RefCountPolicy policy, atomic<int>& destructions) :
+			Object(policy),
+			destructions_(destructions),
+			alive_(true){}
+
+		virtual ~CountedObject(){
+
+			alive_ = false;
+
+			++destructions_;
+
+		}
+
+		/// \brief Check whether the object was not destroyed yet.
+		bool IsAlive() const{
+
+			return alive_;
+
+		}
+
+	private:
+
+		atomic<int>& destructions_;			///< \brief Number of destructions.
+
+		volatile bool alive_;				///< \brief Whether the object was not destroyed yet.
+
+	};
+
+	/// \brief Run a function on several threads at once.
+	template <typename TFunction>
+	void RunThreads(int thread_count, TFunction function){
+
+		vector<thread> threads;
+
+		for (int index = 0; index < thread_count; ++index){
+
+			threads.emplace_back(function, index);
+
+		}
+
+		for (auto&& worker : threads){
+
+			worker.join();
+
+		}
+
+	}
+
+	/// \brief Copy and destroy a pointer repeatedly.
+	/// \return Returns the number of copies whose object was alive.
+	size_t CopyRepeatedly(const ObjectPtr<CountedObject>& pointer, int count){
+
+		size_t alive = 0;
+
+		for (int copy = 0; copy < count; ++copy){
+
+			ObjectPtr<CountedObject> copied(pointer);
+
+			alive += copied->IsAlive() ? 1 : 0;
+
+		}
+
+		return alive;
+
+	}
+
+}
+
+TEST(ObjectPtrCountsReferences){
+
+	for (auto policy : { RefCountPolicy::kSingleThread, RefCountPolicy::kAtomic }){
+
+		atomic<int> destructions(0);
+
+		ObjectWeakPtr<CountedObject> weak;
+
+		{
+			ObjectPtr<CountedObject> first(new CountedObject(policy, destructions));
+
+			CHECK(first->GetRefCountPolicy() == policy);
+
+			auto second = first;
+
+			ObjectPtr<CountedObject> third(std::move(second));
+
+			CHECK(!second);
+
+			CHECK(third == first);
+
+			weak = first;
+
+			CHECK(weak.Lock() == first);
+
+			first.Release();
+
+			CHECK(destructions == 0);
+
+			CHECK(weak.IsValid());
+
+		}
+
+		// The weak pointer outlives the object
+
+		CHECK(destructions == 1);
+
+		CHECK(!weak.IsValid());
+
+		CHECK(!weak.Lock());
+
+	}
+
+}
+
+TEST(ObjectPtrAllocatesOnlyWeakBlocks){
+
+	atomic<int> destructions(0);
+
+	auto allocations = GetAllocationCount();
+
+	ObjectPtr<CountedObject> object(new CountedObject(RefCountPolicy::kSingleThread, destructions));
+
+	CHECK(GetAllocationCount() - allocations == 1);		// The counter lives inside the object
+
+	vector<ObjectPtr<CountedObject>> copies(100);
+
+	allocations = GetAllocationCount();
+
+	for (auto&& copy : copies){
+
+		copy = object;
+
+	}
+
+	CHECK(GetAllocationCount() == allocations);
+
+	// The control block is created along with the first weak reference only
+
+	ObjectWeakPtr<CountedObject> first_weak(object);
+
+	ObjectWeakPtr<CountedObject> second_weak(object);
+
+	CHECK(GetAllocationCount() - allocations == 1);
+
+}
+
+TEST(ObjectWeakPtrLockRacesRelease){
+
+	// Threads lock a weak pointer while the last strong reference is released: each lock either fails or returns a live object.
+
+	for (int round = 0; round < 200; ++round){
+
+		atomic<int> destructions(0);
+
+		ObjectPtr<CountedObject> object(new CountedObject(RefCountPolicy::kAtomic, destructions));
+
+		ObjectWeakPtr<CountedObject> weak(object);
+
+		atomic<int> started(0);
+
+		atomic<bool> dead_object(false);
+
+		RunThreads(kThreadCount,
+				   [&](int index){
+
+					   ++started;
+
+					   while (started < kThreadCount){
+
+						   this_thread::yield();
+
+					   }
+
+					   if (index == 0){
+
+						   object.Release();
+
+						   return;
+
+					   }
+
+					   for (int lock = 0; lock < 1000; ++lock){
+
+						   auto locked = weak.Lock();
+
+						   if (locked && !locked->IsAlive()){
+
+							   dead_object = true;
+
+						   }
+
+					   }
+
+				   });
+
+		CHECK(!dead_object);
+
+		CHECK(destructions == 1);
+
+		CHECK(!weak.Lock());
+
+	}
+
+}
+
+TEST(ObjectPtrAtomicStress){
+
+	// Threads copy and destroy pointers to the same object, the last one is released by whatever thread finishes last.
+
+	const int kCopies = 100000;
+
+	atomic<int> destructions(0);
+
+	atomic<size_t> alive(0);
+
+	{
+		ObjectPtr<CountedObject> object(new CountedObject(RefCountPolicy::kAtomic, destructions));
+
+		vector<ObjectPtr<CountedObject>> pointers(kThreadCount, object);
+
+		object.Release();
+
+		RunThreads(kThreadCount,
+				   [&](int index){
+
+					   ObjectWeakPtr<CountedObject> weak(pointers[index]);
+
+					   alive += CopyRepeatedly(pointers[index], kCopies);
+
+					   alive += weak.Lock() ? 1 : 0;
+
+					   pointers[index].Release();
+
+				   });
+
+		CHECK(destructions == 1);
+
+	}
+
+	CHECK(alive == static_cast<size_t>(kThreadCount) * (kCopies + 1));
+
+}
+
+BENCHMARK(ObjectPtrCopy){
+
+	const int kCopies = 10000000;
+
+	atomic<int> destructions(0);
+
+	// Single thread
+
+	for (auto policy : { RefCountPolicy::kSingleThread, RefCountPolicy::kAtomic }){
+
+		ObjectPtr<CountedObject> object(new CountedObject(policy, destructions));
+
+		Timer timer;
+
+		CopyRepeatedly(object, kCopies);
+
+		auto name = string(policy == RefCountPolicy::kAtomic ? "Atomic" : "Single-thread") + " policy, copy and destroy";
+
+		Report(name, 1000000000.0 * timer.GetTime().GetDeltaSeconds() / kCopies, "ns");
+
+	}
+
+	// Every thread copies the same object
+
+	for (int thread_count : { 1, 2, 4 }){
+
+		ObjectPtr<CountedObject> object(new CountedObject(RefCountPolicy::kAtomic, destructions));
+
+		Timer timer;
+
+		RunThreads(thread_count,
+				   [&](int){
+
+					   ObjectPtr<CountedObject> pointer(object);
+
+					   CopyRepeatedly(pointer, kCopies / thread_count);
+
+				   });
+
+		Report(to_string(thread_count) + " threads sharing an atomic object, copy and destroy", 1000000000.0 * timer.GetTime().GetDeltaSeconds() / kCopies, "ns");
+
+	}
+
+}
@@ -0,0 +1,473 @@
+#include "test.h"
+
+#include <string>
+
+#include "observable.h"
+#include "exceptions.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Subscribe a listener appending a tag to a log each time it is notified.
+	unique_ptr<Listener> SubscribeLogger(Event<int>& event, string& log, char tag){
+
+		return event.Subscribe([&log, tag](Listener&, int&){
+
+			log += tag;
+
+		});
+
+	}
+
+}
+
+TEST(ObservableNotifiesInSubscriptionOrder){
+
+	Event<int> event;
+
+	string log;
+
+	auto a = SubscribeLogger(event, log, 'a');
+	auto b = SubscribeLogger(event, log, 'b');
+	auto c = SubscribeLogger(event, log, 'c');
+
+	int argument = 0;
+
+	event.Notify(argument);
+
+	CHECK(log == "abc");
+
+	// Released slots are recycled by later subscriptions
+
+	b = nullptr;
+
+	auto d = SubscribeLogger(event, log, 'd');
+
+	log.clear();
+
+	event.Notify(argument);
+
+	CHECK(log == "adc");
+
+}
+
+TEST(ObservableUnsubscribeDuringNotification){
+
+	Event<int> event;
+
+	string log;
+
+	unique_ptr<Listener> b;
+	unique_ptr<Listener> c;
+
+	// The first listener removes itself and the last one, the second one destroys itself
+
+	auto a = event.Subscribe([&](Listener& listener, int&){
+
+		log += 'a';
+
+		listener.Unsubscribe();
+
+		c = nullptr;
+
+	});
+
+	b = event.Subscribe([&](Listener&, int&){
+
+		log += 'b';
+
+		b = nullptr;		// Destroys the callback being executed
+
+	});
+
+	c = SubscribeLogger(event, log, 'c');
+
+	int argument = 0;
+
+	event.Notify(argument);
+
+	CHECK(log == "ab");
+
+	log.clear();
+
+	event.Notify(argument);
+
+	CHECK(log.empty());
+
+	// The slots were released once the notification ended
+
+	auto d = SubscribeLogger(event, log, 'd');
+
+	event.Notify(argument);
+
+	CHECK(log == "d");
+
+}
+
+TEST(ObservableSubscribeDuringNotification){
+
+	Event<int> event;
+
+	string log;
+
+	vector<unique_ptr<Listener>> subscribed;
+
+	auto a = event.Subscribe([&](Listener&, int&){
+
+		log += 'a';
+
+		subscribed.push_back(SubscribeLogger(event, log, 'n'));
+
+	});
+
+	// A free slot exists: it must not be recycled while notifying
+
+	auto b = SubscribeLogger(event, log, 'b');
+	auto c = SubscribeLogger(event, log, 'c');
+
+	b = nullptr;
+
+	int argument = 0;
+
+	event.Notify(argument);
+
+	CHECK(log == "ac");
+
+	log.clear();
+
+	event.Notify(argument);
+
+	CHECK(log == "acn");
+
+}
+
+TEST(ObservableIgnoresStaleListeners){
+
+	Event<int> event;
+
+	string log;
+
+	auto a = SubscribeLogger(event, log, 'a');
+
+	a = nullptr;
+
+	auto b = SubscribeLogger(event, log, 'b');		// Same slot, newer generation
+
+	// A listener of the older generation cannot unsubscribe the new one
+
+	Listener stale(&event, Unique<ListenerTag>::MakeUnique(), 0, 0);
+
+	stale.Unsubscribe();
+
+	int argument = 0;
+
+	event.Notify(argument);
+
+	CHECK(log == "b");
+
+	// Listeners outliving their subject are invalidated
+
+	unique_ptr<Listener> orphan;
+
+	{
+		Event<int> temporary;
+
+		orphan = temporary.Subscribe([](Listener&, int&){});
+
+	}
+
+	CHECK(orphan->GetId() == Unique<ListenerTag>::kNull);
+
+	orphan->Unsubscribe();
+
+}
+
+TEST(ObservableRecoversFromThrowingCallbacks){
+
+	Event<int> event;
+
+	string log;
+
+	bool fail = true;
+
+	auto a = event.Subscribe([&](Listener&, int&){
+
+		log += 'a';
+
+		if (fail){
+
+			THROW(L"Callback failure.");
+
+		}
+
+	});
+
+	auto b = SubscribeLogger(event, log, 'b');
+	auto c = SubscribeLogger(event, log, 'c');
+
+	int argument = 0;
+
+	auto thrown = false;
+
+	try{
+
+		event.Notify(argument);
+
+	}
+	catch (const gi_lib::Exception&){
+
+		thrown = true;
+
+	}
+
+	CHECK(thrown);
+
+	CHECK(log == "a");
+
+	// The notification is over: the slot is released at once and recycled by the next subscription
+
+	fail = false;
+
+	b = nullptr;
+
+	auto d = SubscribeLogger(event, log, 'd');
+
+	log.clear();
+
+	event.Notify(argument);
+
+	CHECK(log == "adc");
+
+}
+
+TEST(ObservableNotifyDoesNotAllocate){
+
+	Event<int> event;
+
+	int sum = 0;
+
+	vector<unique_ptr<Listener>> listeners;
+
+	for (int index = 0; index < 64; ++index){
+
+		listeners.push_back(event.Subscribe([&sum](Listener&, int& argument){
+
+			sum += argument;
+
+		}));
+
+	}
+
+	int argument = 1;
+
+	auto allocations = GetAllocationCount();
+
+	for (int notification = 0; notification < 100; ++notification){
+
+		event.Notify(argument);
+
+	}
+
+	CHECK(GetAllocationCount() == allocations);
+
+	CHECK(sum == 6400);
+
+}
+
+TEST(EventQueueCoalescesNotifications){
+
+	EventQueue queue;
+
+	Event<int> first;
+	Event<int> second;
+	Event<int> third;
+
+	first.SetQueue(&queue);
+	second.SetQueue(&queue);
+	third.SetQueue(&queue);
+
+	string log;
+
+	auto on_first = first.Subscribe([&log](Listener&, int& argument){ log += "1:" + to_string(argument) + " "; });
+	auto on_second = second.Subscribe([&log](Listener&, int& argument){ log += "2:" + to_string(argument) + " "; });
+	auto on_third = third.Subscribe([&log](Listener&, int& argument){ log += "3:" + to_string(argument) + " "; });
+
+	for (int argument : { 1, 2, 3 }){
+
+		second.Notify(argument);
+		first.Notify(argument);
+		third.Notify(argument);
+
+	}
+
+	CHECK(log.empty());
+
+	CHECK(queue.GetPendingCount() == 3);
+
+	// One callback per event, with the last argument, in the order the events were first enqueued
+
+	third.SetQueue(&queue);		// Discards the pending notification
+
+	queue.Flush();
+
+	CHECK(log == "2:3 1:3 ");
+
+	CHECK(queue.GetPendingCount() == 0);
+
+	// Events enqueued during the flush are delivered by the same flush
+
+	auto chained = first.Subscribe([&second](Listener&, int&){
+
+		int argument = 4;
+
+		second.Notify(argument);
+
+	});
+
+	log.clear();
+
+	int argument = 5;
+
+	first.Notify(argument);
+
+	queue.Flush();
+
+	CHECK(log == "1:5 2:4 ");
+
+	// Events not bound to any queue notify immediately
+
+	first.SetQueue(nullptr);
+
+	log.clear();
+
+	first.Notify(argument);
+
+	CHECK(log == "1:5 ");
+
+	CHECK(queue.GetPendingCount() == 1);
+
+	queue.Flush();
+
+}
+
+TEST(EventQueueDefersRedeliveredEvents){
+
+	EventQueue queue;
+
+	Event<int> first;
+	Event<int> second;
+
+	first.SetQueue(&queue);
+	second.SetQueue(&queue);
+
+	string log;
+
+	// Each event notifies itself and the other one: every flush delivers each of them once.
+	// Events enqueued for the first time during the flush are delivered by the same flush.
+
+	auto on_first = first.Subscribe([&log, &first, &second](Listener&, int& argument){
+
+		log += "1:" + to_string(argument) + " ";
+
+		int next = argument + 1;
+
+		first.Notify(next);
+		second.Notify(next);
+
+	});
+
+	auto on_second = second.Subscribe([&log, &first](Listener&, int& argument){
+
+		log += "2:" + to_string(argument) + " ";
+
+		int next = argument + 10;
+
+		first.Notify(next);
+
+	});
+
+	int argument = 0;
+
+	first.Notify(argument);
+
+	queue.Flush();
+
+	CHECK(log == "1:0 2:1 ");
+
+	CHECK(queue.GetPendingCount() == 1);
+
+	log.clear();
+
+	queue.Flush();
+
+	CHECK(log == "1:11 2:12 ");
+
+	CHECK(queue.GetPendingCount() == 1);
+
+	// Deferred events can still be canceled
+
+	first.SetQueue(nullptr);
+
+	CHECK(queue.GetPendingCount() == 0);
+
+	log.clear();
+
+	queue.Flush();
+
+	CHECK(log.empty());
+
+}
+
+BENCHMARK(ObservableNotify){
+
+	const int kNotifications = 1000000;
+
+	for (int listener_count : { 0, 1, 4, 64 }){
+
+		Event<int> event;
+
+		int sum = 0;
+
+		vector<unique_ptr<Listener>> listeners;
+
+		for (int index = 0; index < listener_count; ++index){
+
+			listeners.push_back(event.Subscribe([&sum](Listener&, int& argument){
+
+				sum += argument;
+
+			}));
+
+		}
+
+		int argument = 1;
+
+		Timer timer;
+
+		auto allocations = GetAllocationCount();
+
+		for (int notification = 0; notification < kNotifications; ++notification){
+
+			event.Notify(argument);
+
+		}
+
+		allocations = GetAllocationCount() - allocations;
+
+		auto time = timer.GetTime().GetDeltaSeconds();
+
+		auto name = to_string(listener_count) + " listeners";
+
+		Report(name + ", per notification", 1000000000.0 * time / kNotifications, "ns");
+
+		Report(name + ", allocations", static_cast<double>(allocations), "allocations");
+
+		CHECK(sum == listener_count * kNotifications);
+
+	}
+
+}
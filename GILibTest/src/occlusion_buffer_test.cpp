@@ -0,0 +1,325 @@
+#include "test.h"
+
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "occlusion_buffer.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Distance from a triangle edge, in pixels, below which the coverage of a pixel depends on rounding.
+	const double kEdgeTolerance = 1e-3;
+
+	/// \brief Create a perspective transform looking down the z axis from the origin. The w component of the clip space is the view-space depth.
+	Matrix4f MakeViewProjection(float field_of_view, float aspect_ratio){
+
+		auto scale = 1.0f / std::tan(0.5f * field_of_view);
+
+		Matrix4f view_projection = Matrix4f::Zero();
+
+		view_projection(0, 0) = scale / aspect_ratio;
+		view_projection(1, 1) = scale;
+		view_projection(2, 2) = 1.0f;
+		view_projection(2, 3) = -1.0f;
+		view_projection(3, 2) = 1.0f;
+
+		return view_projection;
+
+	}
+
+	/// \brief Create an unindexed list of random triangles in front of the camera.
+	vector<Vector3f> CreateTriangles(size_t count, unsigned int seed){
+
+		mt19937 generator(seed);
+
+		uniform_real_distribution<float> depth(5.0f, 50.0f);
+
+		uniform_real_distribution<float> spread(-0.6f, 0.6f);
+
+		uniform_real_distribution<float> size(0.5f, 5.0f);
+
+		vector<Vector3f> positions;
+
+		for (size_t triangle = 0; triangle < count; ++triangle){
+
+			auto z = depth(generator);
+
+			Vector3f center(spread(generator) * z, spread(generator) * z, z);
+
+			auto extent = size(generator);
+
+			for (int vertex = 0; vertex < 3; ++vertex){
+
+				positions.push_back(center + Vector3f(spread(generator), spread(generator), spread(generator)) * extent);
+
+			}
+
+		}
+
+		return positions;
+
+	}
+
+	/// \brief Indices generated for meshes built without indices: one per vertex.
+	vector<unsigned int> MakeIdentityIndices(size_t count){
+
+		vector<unsigned int> indices(count);
+
+		for (unsigned int index = 0; index < indices.size(); ++index){
+
+			indices[index] = index;
+
+		}
+
+		return indices;
+
+	}
+
+	/// \brief Depth of a pixel computed by a straightforward rasterizer.
+	struct ReferencePixel{
+
+		float depth;				///< \brief Reciprocal of the closest view-space depth. 0 if no triangle covers the pixel.
+
+		bool borderline;			///< \brief Whether the pixel center lies on the edge of some triangle.
+
+	};
+
+	/// \brief Rasterize a triangle list one pixel at a time, in double precision.
+	vector<ReferencePixel> Rasterize(const vector<Vector3f>& positions, const Matrix4f& view_projection, unsigned int width, unsigned int height){
+
+		vector<ReferencePixel> pixels(width * height, ReferencePixel{ 0.0f, false });
+
+		for (size_t triangle = 0; triangle + 2 < positions.size(); triangle += 3){
+
+			double x[3], y[3], z[3];
+
+			auto projected = true;
+
+			for (int vertex = 0; vertex < 3; ++vertex){
+
+				Vector4f clip = view_projection * Math::ToHomogeneous(positions[triangle + vertex]);
+
+				projected = projected && clip(3) > 1e-4f;
+
+				x[vertex] = (clip(0) / clip(3) * 0.5 + 0.5) * width;
+				y[vertex] = (0.5 - clip(1) / clip(3) * 0.5) * height;
+				z[vertex] = 1.0 / clip(3);
+
+			}
+
+			auto area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+			if (!projected || std::fabs(area) <= 1e-6){
+
+				continue;
+
+			}
+
+			for (unsigned int row = 0; row < height; ++row){
+
+				for (unsigned int column = 0; column < width; ++column){
+
+					auto px = column + 0.5;
+					auto py = row + 0.5;
+
+					// Signed distance of the pixel center from each edge, positive inside
+
+					double distance[3];
+
+					for (int edge = 0; edge < 3; ++edge){
+
+						auto from = edge;
+						auto to = (edge + 1) % 3;
+
+						auto length = std::sqrt((x[to] - x[from]) * (x[to] - x[from]) + (y[to] - y[from]) * (y[to] - y[from]));
+
+						distance[edge] = ((x[to] - x[from]) * (py - y[from]) - (y[to] - y[from]) * (px - x[from])) / length * (area > 0.0 ? 1.0 : -1.0);
+
+					}
+
+					auto inside = distance[0] >= 0.0 && distance[1] >= 0.0 && distance[2] >= 0.0;
+
+					auto& pixel = pixels[row * width + column];
+
+					if (std::min(std::min(distance[0], distance[1]), distance[2]) > -kEdgeTolerance &&
+						std::min(std::min(std::fabs(distance[0]), std::fabs(distance[1])), std::fabs(distance[2])) < kEdgeTolerance){
+
+						pixel.borderline = true;
+
+					}
+
+					if (inside){
+
+						// Barycentric interpolation of the reciprocal of the depth
+
+						auto w1 = ((px - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (py - y[0])) / area;
+						auto w2 = ((x[1] - x[0]) * (py - y[0]) - (px - x[0]) * (y[1] - y[0])) / area;
+
+						auto depth = z[0] + w1 * (z[1] - z[0]) + w2 * (z[2] - z[0]);
+
+						pixel.depth = std::max(pixel.depth, static_cast<float>(depth));
+
+					}
+
+				}
+
+			}
+
+		}
+
+		return pixels;
+
+	}
+
+}
+
+TEST(OcclusionBufferMatchesReferenceDepth){
+
+	// Unindexed triangle lists, as built for meshes without indices
+
+	OcclusionBuffer buffer(100, 75);		// Width not multiple of the SIMD width
+
+	auto view_projection = MakeViewProjection(1.2f, 4.0f / 3.0f);
+
+	auto positions = CreateTriangles(200, 1);
+
+	auto indices = MakeIdentityIndices(positions.size());
+
+	buffer.Clear(view_projection);
+
+	buffer.DrawOccluder(positions, indices, 0, indices.size(), Affine3f::Identity());
+
+	auto reference = Rasterize(positions, view_projection, buffer.GetWidth(), buffer.GetHeight());
+
+	auto& depth = buffer.GetDepth();
+
+	CHECK(depth.size() == reference.size());
+
+	size_t covered = 0;
+
+	for (size_t pixel = 0; pixel < depth.size(); ++pixel){
+
+		if (reference[pixel].borderline){
+
+			continue;
+
+		}
+
+		CHECK(std::fabs(depth[pixel] - reference[pixel].depth) <= 1e-4f * reference[pixel].depth + 1e-6f);
+
+		if (reference[pixel].depth > 0.0f){
+
+			++covered;
+
+		}
+
+	}
+
+	CHECK(covered > depth.size() / 10);
+
+}
+
+TEST(OcclusionBufferDrawsWholeIndexRange){
+
+	// The count of an unindexed subset is expressed in triangles: the occluder must be drawn with three indices per triangle.
+
+	OcclusionBuffer buffer(64, 64);
+
+	auto positions = CreateTriangles(90, 2);
+
+	auto indices = MakeIdentityIndices(positions.size());
+
+	auto triangle_count = positions.size() / 3;
+
+	buffer.Clear(MakeViewProjection(1.2f, 1.0f));
+
+	buffer.DrawOccluder(positions, indices, 0, triangle_count * 3, Affine3f::Identity());
+
+	auto whole_range = buffer.GetTriangleCount();
+
+	buffer.Clear(MakeViewProjection(1.2f, 1.0f));
+
+	buffer.DrawOccluder(positions, indices, 0, triangle_count, Affine3f::Identity());
+
+	CHECK(buffer.GetTriangleCount() < whole_range);
+
+	CHECK(whole_range > 2 * triangle_count / 3);
+
+}
+
+TEST(OcclusionBufferCullsHiddenBoxes){
+
+	OcclusionBuffer buffer(64, 64);
+
+	buffer.Clear(MakeViewProjection(1.2f, 1.0f));
+
+	// A wall at depth 10, covering most of the screen
+
+	vector<Vector3f> positions{ Vector3f(-8.0f, -8.0f, 10.0f), Vector3f(8.0f, -8.0f, 10.0f), Vector3f(8.0f, 8.0f, 10.0f),
+								Vector3f(-8.0f, -8.0f, 10.0f), Vector3f(8.0f, 8.0f, 10.0f), Vector3f(-8.0f, 8.0f, 10.0f) };
+
+	auto indices = MakeIdentityIndices(positions.size());
+
+	buffer.DrawOccluder(positions, indices, 0, indices.size(), Affine3f::Identity());
+
+	CHECK(buffer.GetTriangleCount() == 2);
+
+	CHECK(!buffer.IsVisible(AABB{ Vector3f(0.0f, 0.0f, 20.0f), Vector3f::Ones() }));		// Behind the wall
+
+	CHECK(buffer.IsVisible(AABB{ Vector3f(0.0f, 0.0f, 5.0f), Vector3f::Ones() }));			// In front of the wall
+
+	CHECK(buffer.IsVisible(AABB{ Vector3f(0.0f, 0.0f, 10.0f), Vector3f::Ones() }));			// Crossing the wall
+
+	CHECK(buffer.IsVisible(AABB{ Vector3f(30.0f, 0.0f, 20.0f), Vector3f::Ones() }));		// Beside the wall
+
+	CHECK(buffer.IsVisible(AABB{ Vector3f(0.0f, 0.0f, 0.0f), Vector3f::Ones() }));			// Crossing the near plane
+
+	// The world transform moves the occluder
+
+	Affine3f world = Affine3f::Identity();
+
+	world.translate(Vector3f(0.0f, 0.0f, 20.0f));
+
+	buffer.Clear(MakeViewProjection(1.2f, 1.0f));
+
+	buffer.DrawOccluder(positions, indices, 0, indices.size(), world);
+
+	CHECK(buffer.IsVisible(AABB{ Vector3f(0.0f, 0.0f, 20.0f), Vector3f::Ones() }));
+
+	CHECK(!buffer.IsVisible(AABB{ Vector3f(0.0f, 0.0f, 40.0f), Vector3f::Ones() }));
+
+}
+
+BENCHMARK(OcclusionBufferRasterization){
+
+	const int kFrames = 100;
+
+	OcclusionBuffer buffer(320, 180);
+
+	auto view_projection = MakeViewProjection(1.2f, 16.0f / 9.0f);
+
+	auto positions = CreateTriangles(10000, 3);
+
+	auto indices = MakeIdentityIndices(positions.size());
+
+	Timer timer;
+
+	for (int frame = 0; frame < kFrames; ++frame){
+
+		buffer.Clear(view_projection);
+
+		buffer.DrawOccluder(positions, indices, 0, indices.size(), Affine3f::Identity());
+
+	}
+
+	auto time = timer.GetTime().GetDeltaSeconds();
+
+	Report("Rasterization of 10k triangles", 1000.0 * time / kFrames, "ms");
+
+}
@@ -0,0 +1,771 @@
+#include "test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "graphics.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Resource without any content.
+	class EmptyResource : public IResource{
+
+	public:
+
+		/// \brief Arguments used to load the resource.
+		struct Args{
+
+			USE_CACHE;
+
+			/// \brief Get the cache key associated to the arguments.
+			size_t GetCacheKey() const{
+
+				return key;
+
+			}
+
+			size_t key;			///< \brief Identifies the resource.
+
+		};
+
+		virtual size_t GetSize() const override{
+
+			return 0;
+
+		}
+
+	};
+
+	/// \brief Resource of a given size, which tracks how many of its kind are alive.
+	class SizedResource : public IResource{
+
+	public:
+
+		/// \brief Arguments used to load the resource.
+		struct Args{
+
+			USE_CACHE;
+
+			/// \brief Get the cache key associated to the arguments.
+			size_t GetCacheKey() const{
+
+				return key;
+
+			}
+
+			size_t key;			///< \brief Identifies the resource.
+
+			size_t size;		///< \brief Size of the resource, in bytes.
+
+		};
+
+		/// \brief Create a new resource.
+		/// \param size Size of the resource, in bytes.
+		/// \param live_count Number of resources alive, incremented until the resource is destroyed.
+		/// \param category Category of the memory used by the resource.
+		SizedResource(size_t size, atomic<int>& live_count, MemoryCategory category = MemoryCategory::kOther) :
+			size_(size),
+			live_count_(live_count),
+			category_(category){
+
+			++live_count_;
+
+		}
+
+		virtual ~SizedResource(){
+
+			--live_count_;
+
+		}
+
+		virtual size_t GetSize() const override{
+
+			return size_;
+
+		}
+
+		/// \brief Change the size of the resource.
+		/// \param size New size of the resource, in bytes.
+		void SetSize(size_t size){
+
+			size_ = size;
+
+		}
+
+		virtual MemoryCategory GetMemoryCategory() const override{
+
+			return category_;
+
+		}
+
+	private:
+
+		size_t size_;						///< \brief Size of the resource, in bytes.
+
+		atomic<int>& live_count_;			///< \brief Number of resources alive.
+
+		MemoryCategory category_;			///< \brief Category of the memory used by the resource.
+
+	};
+
+	/// \brief Resource manager counting the loads which reached the "disk".
+	class CountingResources : public Resources{
+
+	public:
+
+		/// \brief Create a new resource manager.
+		CountingResources() :
+			load_count_(0),
+			live_count_(0){}
+
+		virtual ~CountingResources(){
+
+			StopLoaders();
+
+		}
+
+		/// \brief Get the number of resources loaded so far.
+		int GetLoadCount() const{
+
+			return load_count_;
+
+		}
+
+		/// \brief Get the number of resources alive.
+		int GetLiveCount() const{
+
+			return live_count_;
+
+		}
+
+		/// \brief Load a resource synchronously.
+		ObjectPtr<SizedResource> LoadSized(size_t key, size_t size){
+
+			return Resources::Load<SizedResource, SizedResource::Args>({ key, size });
+
+		}
+
+		/// \brief Load a resource synchronously and release it immediately.
+		void Touch(size_t key, size_t size){
+
+			LoadSized(key, size);
+
+		}
+
+	protected:
+
+		virtual ObjectPtr<IResource> Load(const type_index&, const type_index&, const void* args) const override{
+
+			++load_count_;
+
+			return new SizedResource(static_cast<const SizedResource::Args*>(args)->size,
+									 live_count_);
+
+		}
+
+	private:
+
+		mutable atomic<int> load_count_;			///< \brief Number of resources loaded so far.
+
+		mutable atomic<int> live_count_;			///< \brief Number of resources alive.
+
+	};
+
+	/// \brief Get the memory used by a category of a snapshot.
+	const MemoryUsage& GetUsage(const MemorySnapshot& snapshot, MemoryCategory category){
+
+		return snapshot.categories[static_cast<size_t>(category)];
+
+	}
+
+	/// \brief Get the position of a resource among the top consumers of a snapshot.
+	/// \return Returns the position of the resource, or the number of top consumers if the resource is not among them.
+	size_t FindConsumer(const MemorySnapshot& snapshot, const IResource* resource){
+
+		return std::find_if(snapshot.top_consumers.begin(),
+							snapshot.top_consumers.end(),
+							[resource](const MemoryConsumer& consumer){
+
+								return consumer.resource == resource;
+
+							}) - snapshot.top_consumers.begin();
+
+	}
+
+	/// \brief Resource manager whose loader threads wait for a gate to open before preparing each load.
+	class GatedResources : public Resources{
+
+	public:
+
+		/// \brief Create a new resource manager with a closed gate.
+		GatedResources() :
+			open_(false),
+			prepared_(0){}
+
+		virtual ~GatedResources(){
+
+			Open();
+
+			StopLoaders();		// The loaders call PrepareLoad
+
+		}
+
+		/// \brief Let the loader threads prepare the loads.
+		void Open(){
+
+			{
+				lock_guard<mutex> lock(mutex_);
+
+				open_ = true;
+
+			}
+
+			gate_.notify_all();
+
+		}
+
+		/// \brief Get the number of loads prepared by the loader threads.
+		int GetPreparedCount() const{
+
+			return prepared_;
+
+		}
+
+	protected:
+
+		virtual ObjectPtr<IResource> Load(const type_index&, const type_index&, const void*) const override{
+
+			return new EmptyResource();
+
+		}
+
+		virtual function<ObjectPtr<IResource>()> PrepareLoad(const type_index& resource_type, const type_index& args_type, const void* args) const override{
+
+			{
+				unique_lock<mutex> lock(mutex_);
+
+				gate_.wait(lock,
+						   [this](){
+
+							   return open_;
+
+						   });
+
+			}
+
+			++prepared_;
+
+			return Resources::PrepareLoad(resource_type,
+										  args_type,
+										  args);
+
+		}
+
+	private:
+
+		mutable mutex mutex_;						///< \brief Guards the gate.
+
+		mutable condition_variable gate_;			///< \brief Signaled when the gate opens.
+
+		bool open_;									///< \brief Whether the gate is open.
+
+		mutable atomic<int> prepared_;				///< \brief Number of loads prepared by the loader threads.
+
+	};
+
+}
+
+TEST(ResourcesFlushAfterStopLoaders){
+
+	const size_t kLoads = 64;
+
+	GatedResources resources;
+
+	vector<AsyncResource<EmptyResource>> handles;
+
+	size_t continuations = 0;
+
+	for (size_t index = 0; index < kLoads; ++index){
+
+		handles.push_back(resources.LoadAsync<EmptyResource, EmptyResource::Args>({ index }));
+
+		handles.back().Then([&continuations](const ObjectPtr<EmptyResource>&){
+
+			++continuations;
+
+		});
+
+	}
+
+	CHECK(resources.GetPendingCount() == kLoads);
+
+	// Open the gate while the loaders are being stopped: the loads being prepared complete, the others are discarded
+
+	thread opener([&resources](){
+
+		this_thread::sleep_for(chrono::milliseconds(50));
+
+		resources.Open();
+
+	});
+
+	resources.StopLoaders();
+
+	opener.join();
+
+	resources.Flush();		// Must not wait for the discarded loads
+
+	CHECK(resources.GetPendingCount() == 0);
+
+	CHECK(continuations == kLoads);
+
+	size_t loaded = 0;
+
+	for (auto&& handle : handles){
+
+		CHECK(handle.IsReady());
+
+		loaded += handle.Get() ? 1 : 0;
+
+	}
+
+	CHECK(loaded == static_cast<size_t>(resources.GetPreparedCount()));
+
+	CHECK(loaded < kLoads);
+
+	// Discarded loads are not cached: requesting them again restarts the loaders
+
+	auto reloaded = resources.LoadAsync<EmptyResource, EmptyResource::Args>({ kLoads - 1 });
+
+	resources.Flush();
+
+	CHECK(reloaded.IsReady());
+
+	CHECK(reloaded.Get());
+
+}
+
+TEST(ResourcesRetainRecentlyUsedResources){
+
+	CountingResources resources;
+
+	// Retention is disabled by default
+
+	resources.Touch(0, 100);
+	resources.Touch(0, 100);
+
+	CHECK(resources.GetLoadCount() == 2);
+	CHECK(resources.GetLiveCount() == 0);
+	CHECK(resources.GetRetainedSize() == 0);
+
+	resources.SetRetentionBudget(300);
+
+	// Released resources are kept alive as long as they fit the budget
+
+	resources.Touch(1, 100);
+	resources.Touch(2, 100);
+	resources.Touch(3, 100);
+
+	CHECK(resources.GetLoadCount() == 5);
+	CHECK(resources.GetLiveCount() == 3);
+	CHECK(resources.GetRetainedSize() == 300);
+
+	// Using a resource moves it to the front: the least recently used one is evicted first
+
+	resources.Touch(1, 100);
+
+	CHECK(resources.GetLoadCount() == 5);
+
+	resources.Touch(4, 100);
+
+	CHECK(resources.GetLoadCount() == 6);
+	CHECK(resources.GetLiveCount() == 3);
+	CHECK(resources.GetRetainedSize() == 300);
+
+	resources.Touch(4, 100);
+	resources.Touch(1, 100);
+	resources.Touch(3, 100);
+
+	CHECK(resources.GetLoadCount() == 6);
+
+	resources.Touch(2, 100);		// Evicted: loaded again, evicting the resource 4
+
+	CHECK(resources.GetLoadCount() == 7);
+
+	resources.Touch(4, 100);
+
+	CHECK(resources.GetLoadCount() == 8);
+
+	// Resources larger than the whole budget are never retained and never evict the other ones
+
+	resources.Touch(5, 400);
+
+	CHECK(resources.GetLoadCount() == 9);
+	CHECK(resources.GetLiveCount() == 3);
+	CHECK(resources.GetRetainedSize() == 300);
+
+	// Larger resources evict as many resources as needed. The order is now 4, 2, 3.
+
+	resources.Touch(6, 250);
+
+	CHECK(resources.GetLiveCount() == 1);
+	CHECK(resources.GetRetainedSize() == 250);
+
+	resources.Touch(6, 250);
+
+	CHECK(resources.GetLoadCount() == 10);
+
+	// Resources in use are retained too, but outlive their eviction
+
+	auto in_use = resources.LoadSized(7, 50);
+
+	CHECK(resources.GetRetainedSize() == 300);
+
+	resources.Touch(8, 50);
+
+	CHECK(resources.GetLiveCount() == 2);
+	CHECK(resources.GetRetainedSize() == 100);
+
+	resources.Touch(7, 50);
+
+	CHECK(resources.GetLoadCount() == 12);
+
+	// Shrinking the budget evicts the least recently used resources. The order is now 7, 8.
+
+	resources.SetRetentionBudget(60);
+
+	CHECK(resources.GetRetentionBudget() == 60);
+	CHECK(resources.GetRetainedSize() == 50);
+	CHECK(resources.GetLiveCount() == 1);
+
+	resources.Touch(7, 50);
+
+	CHECK(resources.GetLoadCount() == 12);
+
+	resources.SetRetentionBudget(0);
+
+	CHECK(resources.GetRetainedSize() == 0);
+	CHECK(resources.GetLiveCount() == 1);
+
+	in_use = nullptr;
+
+	CHECK(resources.GetLiveCount() == 0);
+
+}
+
+TEST(ResourcesBoundZeroSizeRetainedResources){
+
+	const size_t kResources = 1000;
+
+	CountingResources resources;
+
+	// Retention is disabled by default, whatever the size
+
+	resources.Touch(0, 0);
+	resources.Touch(0, 0);
+
+	CHECK(resources.GetLoadCount() == 2);
+	CHECK(resources.GetLiveCount() == 0);
+	CHECK(resources.GetRetainedSize() == 0);
+
+	// Resources reporting no size are still charged to the budget
+
+	resources.SetRetentionBudget(300);
+
+	for (size_t key = 1; key <= kResources; ++key){
+
+		resources.Touch(key, 0);
+
+	}
+
+	CHECK(resources.GetLiveCount() > 0);
+	CHECK(resources.GetLiveCount() < 300);
+	CHECK(resources.GetRetainedSize() > 0);
+	CHECK(resources.GetRetainedSize() <= 300);
+
+	resources.Touch(kResources, 0);
+
+	CHECK(resources.GetLoadCount() == 2 + kResources);
+
+	resources.SetRetentionBudget(0);
+
+	CHECK(resources.GetRetainedSize() == 0);
+	CHECK(resources.GetLiveCount() == 0);
+
+}
+
+TEST(ResourcesReloadRetainedResourcesWithoutLoading){
+
+	CountingResources resources;
+
+	resources.SetRetentionBudget(1000);
+
+	auto first = resources.LoadAsync<SizedResource, SizedResource::Args>({ 1, 100 });
+
+	resources.Flush();
+
+	CHECK(first.IsReady());
+	CHECK(first.Get());
+	CHECK(resources.GetLoadCount() == 1);
+
+	auto resource = first.Get().Get();
+
+	first = AsyncResource<SizedResource>();
+
+	CHECK(resources.GetLiveCount() == 1);
+
+	// The retained resource is served immediately, without reaching the loaders
+
+	auto reloaded = resources.LoadAsync<SizedResource, SizedResource::Args>({ 1, 100 });
+
+	CHECK(reloaded.IsReady());
+	CHECK(reloaded.Get().Get() == resource);
+	CHECK(resources.GetPendingCount() == 0);
+	CHECK(resources.GetLoadCount() == 1);
+
+	bool continued = false;
+
+	reloaded.Then([&continued, resource](const ObjectPtr<SizedResource>& loaded){
+
+		continued = (loaded.Get() == resource);
+
+	});
+
+	CHECK(continued);
+
+	// Evicted resources are loaded again
+
+	reloaded = AsyncResource<SizedResource>();
+
+	resources.SetRetentionBudget(0);
+
+	CHECK(resources.GetLiveCount() == 0);
+
+	auto evicted = resources.LoadAsync<SizedResource, SizedResource::Args>({ 1, 100 });
+
+	resources.Flush();
+
+	CHECK(evicted.Get());
+	CHECK(resources.GetLoadCount() == 2);
+
+}
+
+TEST(MemoryAccountingTracksCategories){
+
+	auto baseline = MemoryAccounting::GetSnapshot(0);
+
+	atomic<int> live_count(0);
+
+	ObjectPtr<SizedResource> small_texture = new SizedResource(1000, live_count, MemoryCategory::kTexture);
+	ObjectPtr<SizedResource> large_texture = new SizedResource(3000, live_count, MemoryCategory::kTexture);
+	ObjectPtr<SizedResource> mesh = new SizedResource(2000, live_count, MemoryCategory::kMesh);
+	ObjectPtr<SizedResource> other = new SizedResource(500, live_count);
+
+	for (auto&& resource : { small_texture, large_texture, mesh, other }){
+
+		MemoryAccounting::Add(*resource);
+
+	}
+
+	MemoryAccounting::Add(*mesh);		// Accounted already
+
+	// Per-category totals and peaks
+
+	auto snapshot = MemoryAccounting::GetSnapshot(0);
+
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kTexture) == GetUsage(baseline, MemoryCategory::kTexture).size + 4000);
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kMesh) == GetUsage(baseline, MemoryCategory::kMesh).size + 2000);
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kOther) == GetUsage(baseline, MemoryCategory::kOther).size + 500);
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kBuffer) == GetUsage(baseline, MemoryCategory::kBuffer).size);
+	CHECK(MemoryAccounting::GetSize() == baseline.total.size + 6500);
+
+	CHECK(GetUsage(snapshot, MemoryCategory::kTexture).count == GetUsage(baseline, MemoryCategory::kTexture).count + 2);
+	CHECK(GetUsage(snapshot, MemoryCategory::kMesh).count == GetUsage(baseline, MemoryCategory::kMesh).count + 1);
+	CHECK(snapshot.total.count == baseline.total.count + 4);
+
+	CHECK(GetUsage(snapshot, MemoryCategory::kTexture).peak == std::max(GetUsage(baseline, MemoryCategory::kTexture).peak, GetUsage(baseline, MemoryCategory::kTexture).size + 4000));
+	CHECK(snapshot.total.peak == std::max(baseline.total.peak, baseline.total.size + 6500));
+
+	// Top consumers, largest first
+
+	snapshot = MemoryAccounting::GetSnapshot(baseline.total.count + 4);
+
+	CHECK(snapshot.top_consumers.size() == baseline.total.count + 4);
+
+	CHECK(std::is_sorted(snapshot.top_consumers.begin(),
+						 snapshot.top_consumers.end(),
+						 [](const MemoryConsumer& first, const MemoryConsumer& second){
+
+							 return first.size > second.size;
+
+						 }));
+
+	auto large_texture_index = FindConsumer(snapshot, large_texture.Get());
+	auto mesh_index = FindConsumer(snapshot, mesh.Get());
+	auto small_texture_index = FindConsumer(snapshot, small_texture.Get());
+	auto other_index = FindConsumer(snapshot, other.Get());
+
+	CHECK(large_texture_index < mesh_index);
+	CHECK(mesh_index < small_texture_index);
+	CHECK(small_texture_index < other_index);
+	CHECK(other_index < snapshot.top_consumers.size());
+
+	auto& consumer = snapshot.top_consumers[mesh_index];
+
+	CHECK(consumer.type == type_index(typeid(SizedResource)));
+	CHECK(consumer.category == MemoryCategory::kMesh);
+	CHECK(consumer.size == 2000);
+
+	CHECK(MemoryAccounting::GetSnapshot(1).top_consumers.size() == 1);
+
+	// Destroyed resources leave the accounting, peaks don't
+
+	const IResource* destroyed = large_texture.Get();
+
+	large_texture = nullptr;
+
+	snapshot = MemoryAccounting::GetSnapshot(baseline.total.count + 4);
+
+	CHECK(live_count == 3);
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kTexture) == GetUsage(baseline, MemoryCategory::kTexture).size + 1000);
+	CHECK(GetUsage(snapshot, MemoryCategory::kTexture).peak == std::max(GetUsage(baseline, MemoryCategory::kTexture).peak, GetUsage(baseline, MemoryCategory::kTexture).size + 4000));
+	CHECK(snapshot.top_consumers.size() == baseline.total.count + 3);
+	CHECK(FindConsumer(snapshot, destroyed) == snapshot.top_consumers.size());
+
+	small_texture = nullptr;
+	mesh = nullptr;
+	other = nullptr;
+
+	CHECK(live_count == 0);
+	CHECK(MemoryAccounting::GetSize() == baseline.total.size);
+
+}
+
+TEST(MemoryAccountingRefreshesResizedResources){
+
+	auto baseline = MemoryAccounting::GetSnapshot(0);
+
+	atomic<int> live_count(0);
+
+	ObjectPtr<SizedResource> mesh = new SizedResource(2000, live_count, MemoryCategory::kMesh);
+	ObjectPtr<SizedResource> unaccounted = new SizedResource(100, live_count, MemoryCategory::kMesh);
+
+	MemoryAccounting::Add(*mesh);
+
+	// The size read when the resource was accounted is kept until the resource is refreshed
+
+	mesh->SetSize(3000);
+
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kMesh) == GetUsage(baseline, MemoryCategory::kMesh).size + 2000);
+
+	MemoryAccounting::Refresh(*mesh);
+
+	auto snapshot = MemoryAccounting::GetSnapshot(baseline.total.count + 1);
+
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kMesh) == GetUsage(baseline, MemoryCategory::kMesh).size + 3000);
+	CHECK(snapshot.total.count == baseline.total.count + 1);
+
+	auto mesh_index = FindConsumer(snapshot, mesh.Get());
+
+	CHECK(mesh_index < snapshot.top_consumers.size() &&
+		  snapshot.top_consumers[mesh_index].size == 3000);
+
+	mesh->SetSize(500);
+
+	MemoryAccounting::Refresh(*mesh);
+
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kMesh) == GetUsage(baseline, MemoryCategory::kMesh).size + 500);
+
+	// Resources which were not accounted are ignored
+
+	MemoryAccounting::Refresh(*unaccounted);
+
+	CHECK(MemoryAccounting::GetSize() == baseline.total.size + 500);
+
+	mesh = nullptr;
+	unaccounted = nullptr;
+
+	CHECK(live_count == 0);
+	CHECK(MemoryAccounting::GetSize() == baseline.total.size);
+
+}
+
+TEST(MemoryAccountingRemovesOnAnyThread){
+
+	const int kThreads = 4;
+
+	const int kResources = 2000;
+
+	auto baseline = MemoryAccounting::GetSnapshot(0);
+
+	atomic<int> live_count(0);
+
+	// Resources are accounted here and destroyed by other threads, while they account resources of their own
+
+	vector<vector<ObjectPtr<SizedResource>>> batches(kThreads);
+
+	for (auto&& batch : batches){
+
+		for (int index = 0; index < kResources; ++index){
+
+			batch.push_back(ObjectPtr<SizedResource>(new SizedResource(index + 1, live_count, MemoryCategory::kBuffer)));
+
+			MemoryAccounting::Add(*batch.back());
+
+		}
+
+	}
+
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kBuffer) == GetUsage(baseline, MemoryCategory::kBuffer).size + kThreads * kResources * (kResources + 1) / 2);
+
+	vector<thread> threads;
+
+	for (auto&& batch : batches){
+
+		threads.push_back(thread([&batch, &live_count](){
+
+			for (int index = 0; index < kResources; ++index){
+
+				ObjectPtr<SizedResource> resource = new SizedResource(10, live_count, MemoryCategory::kShader);
+
+				MemoryAccounting::Add(*resource);
+
+				batch[index] = nullptr;
+
+			}
+
+			batch.clear();
+
+		}));
+
+	}
+
+	for (auto&& worker : threads){
+
+		worker.join();
+
+	}
+
+	auto snapshot = MemoryAccounting::GetSnapshot(baseline.total.count + 1);
+
+	CHECK(live_count == 0);
+
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kBuffer) == GetUsage(baseline, MemoryCategory::kBuffer).size);
+	CHECK(MemoryAccounting::GetSize(MemoryCategory::kShader) == GetUsage(baseline, MemoryCategory::kShader).size);
+	CHECK(MemoryAccounting::GetSize() == baseline.total.size);
+
+	CHECK(snapshot.total.count == baseline.total.count);
+	CHECK(snapshot.top_consumers.size() == baseline.total.count);
+
+	CHECK(GetUsage(snapshot, MemoryCategory::kBuffer).peak >= GetUsage(baseline, MemoryCategory::kBuffer).size + kThreads * kResources * (kResources + 1) / 2);
+
+}
@@ -0,0 +1,1050 @@
+#include "test.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+#include "core.h"
+#include "scene.h"
+#include "scene_snapshot.h"
+#include "bvh_tree.h"
+#include "graphics.h"
+#include "derived_data_cache.h"
+#include "wavefront/wavefront_obj.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace gi_lib::wavefront;
+using namespace std;
+
+namespace{
+
+	/// \brief Name of the snapshot file written by the tests.
+	const wchar_t kSnapshotFile[] = L"./scene_snapshot_test.snapshot";
+
+	/// \brief Directory storing the snapshots cached by the tests.
+	const wchar_t kCacheDirectory[] = L"scene_snapshot_test_cache/";
+
+	/// \brief Name of the OBJ file imported by the tests.
+	const char kObjFile[] = "./scene_snapshot_test.obj";
+
+	/// \brief Name of the MTL file referenced by the OBJ file, relative to the directory of the OBJ file.
+	const char kMtlFile[] = "scene_snapshot_test.mtl";
+
+	/// \brief Name of the MTL file.
+	const char kMtlPath[] = "./scene_snapshot_test.mtl";
+
+	/// \brief Write a text file.
+	void WriteFile(const string& file_name, const string& content){
+
+		ofstream file(file_name, ios::binary | ios::trunc);
+
+		file << content;
+
+	}
+
+	/// \brief Create an OBJ file with two objects sharing a material, and its MTL file.
+	/// \param first_x X coordinate of the first vertex of the file.
+	/// \param diffuse Diffuse color of the shared material.
+	void WriteScene(const string& first_x, const string& diffuse){
+
+		WriteFile(kObjFile,
+				  string("mtllib ") + kMtlFile + "\n"
+				  "o Floor\n"
+				  "v " + first_x + " 0.0 -1.0\nv 1.0 0.0 -1.0\nv 1.0 0.0 1.0\nv -1.0 0.0 1.0\n"
+				  "vt 0.0 0.0\nvt 1.0 0.0\nvt 1.0 1.0\nvt 0.0 1.0\n"
+				  "vn 0.0 1.0 0.0\n"
+				  "usemtl Stone\n"
+				  "f 1/1/1 2/2/1 3/3/1\n"
+				  "usemtl Wood\n"
+				  "f 1/1/1 3/3/1 4/4/1\n"
+				  "o Wall\n"
+				  "v -1.0 0.0 -1.0\nv 1.0 0.0 -1.0\nv 1.0 2.0 -1.0\n"
+				  "vn 0.0 0.0 1.0\n"
+				  "usemtl Stone\n"
+				  "f 5/1/2 6/2/2 7/3/2\n");
+
+		WriteFile(kMtlPath,
+				  "newmtl Stone\n"
+				  "Kd " + diffuse + "\n"
+				  "map_Kd stone.png\n"
+				  "newmtl Wood\n"
+				  "Kd 0.6 0.4 0.2\n");
+
+	}
+
+	/// \brief Delete the snapshot file written by the tests.
+	void DeleteSnapshotFile(){
+
+		std::remove(string(kSnapshotFile, kSnapshotFile + std::wcslen(kSnapshotFile)).c_str());
+
+	}
+
+	/// \brief Delete the snapshots cached by previous runs.
+	void ClearCache(){
+
+		auto& file_system = FileSystem::GetInstance();
+
+		file_system.MakeDirectory(kCacheDirectory);
+
+		vector<FileEntry> files;
+
+		file_system.EnumerateFiles(kCacheDirectory, L"", files);
+
+		for (auto&& file : files){
+
+			file_system.Remove(kCacheDirectory + file.name);
+
+		}
+
+	}
+
+	/// \brief Static mesh which keeps the vertices it was created with.
+	class RecordedStaticMesh : public IStaticMesh{
+
+	public:
+
+		/// \brief Create a mesh from a list of vertices.
+		RecordedStaticMesh(const FromVertices<VertexFormatNormalTextured>& bundle) :
+			vertices_(bundle.vertices),
+			subsets_(bundle.subsets),
+			subset_names_(bundle.subsets.size()),
+			flags_(MeshFlags::kNone){
+
+			Vector3f minimum = Vector3f::Ones() * std::numeric_limits<float>::max();
+			Vector3f maximum = -minimum;
+
+			for (auto&& vertex : vertices_){
+
+				positions_.push_back(vertex.position);
+
+				minimum = minimum.cwiseMin(vertex.position);
+				maximum = maximum.cwiseMax(vertex.position);
+
+			}
+
+			bounding_box_ = AABB{ 0.5f * (minimum + maximum), 0.5f * (maximum - minimum) };
+
+		}
+
+		virtual size_t GetSize() const override{ return vertices_.size() * sizeof(VertexFormatNormalTextured); }
+
+		virtual size_t GetVertexCount() const override{ return vertices_.size(); }
+
+		virtual size_t GetPolygonCount() const override{ return vertices_.size() / 3; }
+
+		virtual size_t GetLODCount() const override{ return 1; }
+
+		virtual const AABB& GetBoundingBox() const override{ return bounding_box_; }
+
+		virtual const vector<Vector3f>& GetPositions() const override{ return positions_; }
+
+		virtual const vector<unsigned int>& GetIndices() const override{ return indices_; }
+
+		virtual size_t GetSubsetCount() const override{ return subsets_.size(); }
+
+		virtual const MeshSubset& GetSubset(unsigned int subset_index) const override{ return subsets_[subset_index]; }
+
+		virtual size_t GetIndexCount(unsigned int subset_index) const override{ return subsets_[subset_index].count * 3; }
+
+		virtual MeshFlags GetFlags(unsigned int) const override{ return flags_; }
+
+		virtual void SetFlags(unsigned int, MeshFlags) override{}
+
+		virtual MeshFlags GetFlags() const override{ return flags_; }
+
+		virtual void SetFlags(MeshFlags flags) override{ flags_ = flags; }
+
+		virtual void SetName(const wstring& name) override{ name_ = name; }
+
+		virtual const wstring& GetName() const override{ return name_; }
+
+		virtual void SetSubsetName(size_t subset_index, const wstring& name) override{ subset_names_[subset_index] = name; }
+
+		virtual const wstring& GetSubsetName(size_t subset_index) const override{ return subset_names_[subset_index]; }
+
+		/// \brief Get the vertices the mesh was created with.
+		const vector<VertexFormatNormalTextured>& GetVertices() const{ return vertices_; }
+
+	private:
+
+		vector<VertexFormatNormalTextured> vertices_;		///< \brief Vertices of the mesh.
+
+		vector<Vector3f> positions_;						///< \brief Position of each vertex.
+
+		vector<unsigned int> indices_;						///< \brief Always empty.
+
+		vector<MeshSubset> subsets_;						///< \brief Subsets of the mesh.
+
+		vector<wstring> subset_names_;						///< \brief Name of each subset.
+
+		wstring name_;										///< \brief Name of the mesh.
+
+		AABB bounding_box_;									///< \brief Bounds of the vertices.
+
+		MeshFlags flags_;									///< \brief Flags of the mesh.
+
+	};
+
+	/// \brief Resources creating meshes which keep their vertices.
+	class RecordingResources : public Resources{
+
+	protected:
+
+		virtual ObjectPtr<IResource> Load(const type_index& resource_type, const type_index& args_type, const void* load_args) const override{
+
+			if (resource_type != type_index(typeid(IStaticMesh)) ||
+				args_type != type_index(typeid(IStaticMesh::FromVertices<VertexFormatNormalTextured>))){
+
+				return nullptr;
+
+			}
+
+			return ObjectPtr<IResource>(new RecordedStaticMesh(*static_cast<const IStaticMesh::FromVertices<VertexFormatNormalTextured>*>(load_args)));
+
+		}
+
+	};
+
+	/// \brief Material importer recording the materials of each imported mesh as text.
+	class RecordingMaterialImporter : public IMtlMaterialImporter{
+
+	public:
+
+		virtual void OnImportMaterial(const wstring&, const MtlMaterialCollection& material_collection, MeshComponent&) override{
+
+			for (auto&& material : material_collection){
+
+				if (!material){
+
+					log += "none;";
+
+					continue;
+
+				}
+
+				string diffuse_map;
+
+				Vector3f diffuse = Vector3f::Zero();
+
+				auto map_property = (*material)["map_Kd"];
+				auto diffuse_property = (*material)["Kd"];
+
+				if (map_property){
+
+					map_property->Read(diffuse_map);
+
+				}
+
+				if (diffuse_property){
+
+					diffuse_property->Read(diffuse);
+
+				}
+
+				log += material->GetName() + "," + to_string(diffuse.x()) + " " + to_string(diffuse.y()) + " " + to_string(diffuse.z()) + "," + diffuse_map + ";";
+
+			}
+
+			log += "\n";
+
+		}
+
+		string log;			///< \brief Materials of every mesh imported so far.
+
+	};
+
+	/// \brief Check whether two imported hierarchies have the same nodes, transforms and meshes.
+	bool IsSameHierarchy(TransformComponent& first, TransformComponent& second){
+
+		if (first.GetComponent<NodeComponent>()->GetName() != second.GetComponent<NodeComponent>()->GetName() ||
+			!first.GetLocalTransform().isApprox(second.GetLocalTransform())){
+
+			return false;
+
+		}
+
+		// Meshes
+
+		auto first_mesh = first.GetComponent<MeshComponent>();
+		auto second_mesh = second.GetComponent<MeshComponent>();
+
+		if ((first_mesh == nullptr) != (second_mesh == nullptr)){
+
+			return false;
+
+		}
+
+		if (first_mesh){
+
+			auto& first_static_mesh = static_cast<const RecordedStaticMesh&>(*first_mesh->GetMesh());
+			auto& second_static_mesh = static_cast<const RecordedStaticMesh&>(*second_mesh->GetMesh());
+
+			auto& first_vertices = first_static_mesh.GetVertices();
+			auto& second_vertices = second_static_mesh.GetVertices();
+
+			if (first_static_mesh.GetName() != second_static_mesh.GetName() ||
+				first_vertices.size() != second_vertices.size() ||
+				std::memcmp(first_vertices.data(), second_vertices.data(), first_vertices.size() * sizeof(VertexFormatNormalTextured)) != 0 ||
+				first_static_mesh.GetSubsetCount() != second_static_mesh.GetSubsetCount()){
+
+				return false;
+
+			}
+
+			for (unsigned int subset_index = 0; subset_index < first_static_mesh.GetSubsetCount(); ++subset_index){
+
+				if (first_static_mesh.GetSubset(subset_index).start_index != second_static_mesh.GetSubset(subset_index).start_index ||
+					first_static_mesh.GetSubset(subset_index).count != second_static_mesh.GetSubset(subset_index).count ||
+					first_static_mesh.GetSubsetName(subset_index) != second_static_mesh.GetSubsetName(subset_index)){
+
+					return false;
+
+				}
+
+			}
+
+			if (!first_mesh->GetBoundingBox().center.isApprox(second_mesh->GetBoundingBox().center) ||
+				!first_mesh->GetBoundingBox().half_extents.isApprox(second_mesh->GetBoundingBox().half_extents)){
+
+				return false;
+
+			}
+
+		}
+
+		// Children, in order
+
+		auto first_children = first.GetChildren();
+		auto second_children = second.GetChildren();
+
+		auto first_child = first_children.begin();
+		auto second_child = second_children.begin();
+
+		for (; first_child != first_children.end() && second_child != second_children.end(); ++first_child, ++second_child){
+
+			if (!IsSameHierarchy(**first_child, **second_child)){
+
+				return false;
+
+			}
+
+		}
+
+		return first_child == first_children.end() &&
+			   second_child == second_children.end();
+
+	}
+
+	/// \brief Create the description of a small scene: a root node with a mesh and a child node without one.
+	SceneSnapshot::Description MakeDescription(){
+
+		SceneSnapshot::Description description;
+
+		SceneSnapshot::Description::Mesh mesh;
+
+		mesh.name = L"Floor";
+
+		for (int index = 0; index < 6; ++index){
+
+			VertexFormatNormalTextured vertex;
+
+			vertex.position = Vector3f(index * 1.0f, index * 2.0f, -index * 1.0f);
+			vertex.normal = Vector3f::UnitY();
+			vertex.tex_coord = Vector2f(index * 0.1f, 0.5f);
+			vertex.tangent = Vector3f::UnitX();
+			vertex.binormal = Vector3f::UnitZ();
+
+			mesh.vertices.push_back(vertex);
+
+		}
+
+		mesh.subsets.push_back(SceneSnapshot::Description::Subset{ L"Stone", MeshSubset{ 0, 1 }, 0 });
+		mesh.subsets.push_back(SceneSnapshot::Description::Subset{ L"Bare", MeshSubset{ 3, 1 }, SceneSnapshot::kNone });
+
+		description.meshes.push_back(mesh);
+
+		SceneSnapshot::Description::Material material;
+
+		material.name = "Stone";
+
+		material.properties.push_back(SceneSnapshot::Description::Property{ "Kd", "0.5 0.5 0.5" });
+		material.properties.push_back(SceneSnapshot::Description::Property{ "map_Kd", "stone.png" });
+
+		description.materials.push_back(material);
+
+		description.nodes.push_back(SceneSnapshot::Description::Node{ L"Floor",
+																	  SceneSnapshot::kNone,
+																	  0,
+																	  Translation3f(Vector3f(1.0f, 2.0f, 3.0f)),
+																	  Quaternionf(AngleAxisf(0.5f, Vector3f::UnitY())),
+																	  AlignedScaling3f(Vector3f::Ones() * 2.0f) });
+
+		description.nodes.push_back(SceneSnapshot::Description::Node{ L"Lamp",
+																	  0,
+																	  SceneSnapshot::kNone,
+																	  Translation3f(Vector3f::Zero()),
+																	  Quaternionf::Identity(),
+																	  AlignedScaling3f(Vector3f::Ones()) });
+
+		return description;
+
+	}
+
+	/// \brief Convert a string stored inside a snapshot.
+	template <typename TChar>
+	basic_string<TChar> ToString(const SnapshotArray<TChar>& array){
+
+		return basic_string<TChar>(array.begin(), array.end());
+
+	}
+
+	/// \brief Check whether a snapshot stores exactly the content of a description.
+	bool Matches(const SceneSnapshot& snapshot, const SceneSnapshot::Description& description){
+
+		if (snapshot.GetNodes().size != description.nodes.size() ||
+			snapshot.GetMeshes().size != description.meshes.size() ||
+			snapshot.GetMaterials().size != description.materials.size()){
+
+			return false;
+
+		}
+
+		for (size_t index = 0; index < description.nodes.size(); ++index){
+
+			auto& node = snapshot.GetNodes()[index];
+			auto& expected = description.nodes[index];
+
+			if (ToString(node.name) != expected.name ||
+				node.parent != expected.parent ||
+				node.mesh != expected.mesh ||
+				!Vector3f(node.translation).isApprox(expected.translation.vector()) ||
+				!Vector4f(node.rotation).isApprox(expected.rotation.coeffs()) ||
+				!Vector3f(node.scale).isApprox(expected.scale.diagonal())){
+
+				return false;
+
+			}
+
+		}
+
+		for (size_t index = 0; index < description.meshes.size(); ++index){
+
+			auto& mesh = snapshot.GetMeshes()[index];
+			auto& expected = description.meshes[index];
+
+			if (ToString(mesh.name) != expected.name ||
+				mesh.vertices.size != expected.vertices.size() ||
+				std::memcmp(mesh.vertices.begin(), expected.vertices.data(), expected.vertices.size() * sizeof(VertexFormatNormalTextured)) != 0 ||
+				mesh.subsets.size != expected.subsets.size()){
+
+				return false;
+
+			}
+
+			for (size_t subset_index = 0; subset_index < expected.subsets.size(); ++subset_index){
+
+				auto& subset = mesh.subsets[subset_index];
+				auto& expected_subset = expected.subsets[subset_index];
+
+				if (ToString(subset.name) != expected_subset.name ||
+					subset.start_index != expected_subset.range.start_index ||
+					subset.count != expected_subset.range.count ||
+					subset.material != expected_subset.material){
+
+					return false;
+
+				}
+
+			}
+
+		}
+
+		for (size_t index = 0; index < description.materials.size(); ++index){
+
+			auto& material = snapshot.GetMaterials()[index];
+			auto& expected = description.materials[index];
+
+			if (ToString(material.name) != expected.name ||
+				material.properties.size != expected.properties.size()){
+
+				return false;
+
+			}
+
+			for (size_t property_index = 0; property_index < expected.properties.size(); ++property_index){
+
+				if (ToString(material.properties[property_index].name) != expected.properties[property_index].name ||
+					ToString(material.properties[property_index].value) != expected.properties[property_index].value){
+
+					return false;
+
+				}
+
+			}
+
+		}
+
+		return true;
+
+	}
+
+	/// \brief Read a binary file.
+	string ReadFile(const wstring& file_name){
+
+		ifstream file(string(file_name.begin(), file_name.end()), ios::binary);
+
+		return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+	}
+
+	/// \brief Count the nodes below a root.
+	size_t CountDescendants(TransformComponent& root){
+
+		size_t count = 0;
+
+		for (auto&& child : root.GetChildren()){
+
+			count += 1 + CountDescendants(*child);
+
+		}
+
+		return count;
+
+	}
+
+	/// \brief Get the x coordinate of the first vertex of the first mesh below a root.
+	float GetFirstX(TransformComponent& root){
+
+		auto& mesh = static_cast<const RecordedStaticMesh&>(*(*root.GetChildren().begin())->GetComponent<MeshComponent>()->GetMesh());
+
+		return mesh.GetVertices()[0].position.x();
+
+	}
+
+}
+
+TEST(SceneSnapshotRoundTrip){
+
+	auto description = MakeDescription();
+
+	SceneSnapshot snapshot(description);
+
+	CHECK(Matches(snapshot, description));
+
+	// Mesh bounds are computed from the vertices
+
+	auto& bounds = snapshot.GetMeshes()[0].bounds;
+
+	CHECK(bounds.center.isApprox(Vector3f(2.5f, 5.0f, -2.5f)));
+	CHECK(bounds.half_extents.isApprox(Vector3f(2.5f, 5.0f, 2.5f)));
+
+	// Written and read back as it is
+
+	CHECK(snapshot.Save(kSnapshotFile));
+
+	auto loaded = SceneSnapshot::Load(kSnapshotFile);
+
+	CHECK(loaded != nullptr);
+
+	CHECK(loaded->GetSize() == snapshot.GetSize());
+
+	CHECK(Matches(*loaded, description));
+
+	CHECK(loaded->GetMeshes()[0].bounds.center.isApprox(bounds.center));
+
+	// Saving a loaded snapshot writes the same file
+
+	auto content = ReadFile(kSnapshotFile);
+
+	CHECK(loaded->Save(kSnapshotFile));
+
+	CHECK(ReadFile(kSnapshotFile) == content);
+
+}
+
+TEST(SceneSnapshotRejectsMalformedFiles){
+
+	SceneSnapshot snapshot(MakeDescription());
+
+	CHECK(snapshot.Save(kSnapshotFile));
+
+	auto content = ReadFile(kSnapshotFile);
+
+	auto file_name = string(kSnapshotFile, kSnapshotFile + std::wcslen(kSnapshotFile));
+
+	// Truncated
+
+	WriteFile(file_name, content.substr(0, content.size() / 2));
+
+	CHECK(SceneSnapshot::Load(kSnapshotFile) == nullptr);
+
+	// Different version, stored right after the magic number
+
+	auto other_version = content;
+
+	other_version[4] = static_cast<char>(SceneSnapshot::kVersion + 1);
+
+	WriteFile(file_name, other_version);
+
+	CHECK(SceneSnapshot::Load(kSnapshotFile) == nullptr);
+
+	// Missing
+
+	CHECK(SceneSnapshot::Load(L"./scene_snapshot_test.missing") == nullptr);
+
+}
+
+TEST(SceneSnapshotImportsObjScene){
+
+	WriteScene("-1.0", "0.5 0.5 0.5");
+
+	RecordingResources resources;
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	// The importer goes through a snapshot of the parsed file
+
+	RecordingMaterialImporter materials;
+
+	auto root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+	CHECK(ObjImporter(resources).ImportScene(root_name, *root, materials));
+
+	CHECK(CountDescendants(*root) == 2);
+
+	auto& floor = static_cast<const RecordedStaticMesh&>(*(*root->GetChildren().begin())->GetComponent<MeshComponent>()->GetMesh());
+
+	CHECK(floor.GetVertexCount() == 6);
+
+	size_t triangles = 0;
+
+	for (unsigned int subset_index = 0; subset_index < floor.GetSubsetCount(); ++subset_index){
+
+		triangles += floor.GetSubset(subset_index).count;
+
+	}
+
+	CHECK(triangles == 2);
+
+	CHECK(floor.GetVertices()[0].position.x() == -1.0f);
+
+	CHECK(materials.log.find("Stone,0.500000 ") != string::npos);
+
+	CHECK(materials.log.find(",stone.png;") != string::npos);
+
+}
+
+TEST(SceneSnapshotImportReusesSnapshotFile){
+
+	WriteScene("-1.0", "0.5 0.5 0.5");
+
+	DeleteSnapshotFile();
+
+	RecordingResources resources;
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	auto import_scene = [&]() -> float{
+
+		RecordingMaterialImporter materials;
+
+		auto root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+		CHECK(ObjImporter(resources).ImportScene(root_name, kSnapshotFile, *root, materials));
+
+		CHECK(CountDescendants(*root) == 2);
+
+		CHECK(materials.log.find("Stone,0.500000 ") != string::npos);
+
+		auto& floor = static_cast<const RecordedStaticMesh&>(*(*root->GetChildren().begin())->GetComponent<MeshComponent>()->GetMesh());
+
+		return floor.GetVertices()[0].position.x();
+
+	};
+
+	// The first import parses the OBJ file and writes the snapshot
+
+	CHECK(import_scene() == -1.0f);
+
+	CHECK(SceneSnapshot::Load(kSnapshotFile) != nullptr);
+
+	// The following imports load the snapshot and never read the OBJ file, which is not checked for changes
+
+	WriteScene("-2.0", "0.5 0.5 0.5");
+
+	CHECK(import_scene() == -1.0f);
+
+	// Deleting the snapshot picks the changes up
+
+	DeleteSnapshotFile();
+
+	CHECK(import_scene() == -2.0f);
+
+	// Malformed snapshots are replaced
+
+	WriteFile(string(kSnapshotFile, kSnapshotFile + std::wcslen(kSnapshotFile)), "not a snapshot");
+
+	WriteScene("-3.0", "0.5 0.5 0.5");
+
+	CHECK(import_scene() == -3.0f);
+
+	CHECK(SceneSnapshot::Load(kSnapshotFile) != nullptr);
+
+}
+
+TEST(SceneSnapshotCacheRoundTrip){
+
+	ClearCache();
+
+	WriteScene("-1.0", "0.5 0.5 0.5");
+
+	RecordingResources resources;
+
+	DerivedDataCache cache(kCacheDirectory, 1 << 20);
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	// Parsed from the OBJ and MTL files
+
+	RecordingMaterialImporter parsed_materials;
+
+	auto parsed_root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+	CHECK(ObjImporter(resources).ImportScene(root_name, *parsed_root, parsed_materials));
+
+	// Parsed, then written to the cache
+
+	ObjImporter cached_importer(resources, &cache);
+
+	RecordingMaterialImporter stored_materials;
+
+	auto stored_root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+	CHECK(cached_importer.ImportScene(root_name, *stored_root, stored_materials));
+
+	CHECK(cache.GetSize() > 0);
+
+	auto cache_size = cache.GetSize();
+
+	// Instantiated from the snapshot
+
+	RecordingMaterialImporter loaded_materials;
+
+	auto loaded_root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+	CHECK(cached_importer.ImportScene(root_name, *loaded_root, loaded_materials));
+
+	CHECK(cache.GetSize() == cache_size);		// Nothing written
+
+	CHECK(CountDescendants(*parsed_root) == 2);
+
+	CHECK(IsSameHierarchy(*parsed_root, *stored_root));
+
+	CHECK(IsSameHierarchy(*parsed_root, *loaded_root));
+
+	CHECK(parsed_materials.log.find("Stone,") != string::npos);
+
+	CHECK(parsed_materials.log == stored_materials.log);
+
+	CHECK(parsed_materials.log == loaded_materials.log);
+
+}
+
+TEST(SceneSnapshotDetectsChangedSources){
+
+	ClearCache();
+
+	WriteScene("-1.0", "0.5 0.5 0.5");
+
+	RecordingResources resources;
+
+	DerivedDataCache cache(kCacheDirectory, 1 << 20);
+
+	ObjImporter importer(resources, &cache);
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	auto Import = [&](RecordingMaterialImporter& materials){
+
+		auto root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+		CHECK(importer.ImportScene(root_name, *root, materials));
+
+		return root;
+
+	};
+
+	RecordingMaterialImporter original_materials;
+
+	auto original = Import(original_materials);
+
+	CHECK(GetFirstX(*original) == -1.0f);
+
+	// Same OBJ file, different MTL file
+
+	WriteScene("-1.0", "0.9 0.5 0.5");
+
+	RecordingMaterialImporter edited_materials;
+
+	Import(edited_materials);
+
+	CHECK(original_materials.log.find("Stone,0.500000 ") != string::npos);
+
+	CHECK(edited_materials.log.find("Stone,0.900000 ") != string::npos);
+
+	CHECK(edited_materials.log.find("Stone,0.500000 ") == string::npos);
+
+	// OBJ file edited without changing its size
+
+	WriteScene("-2.0", "0.9 0.5 0.5");
+
+	RecordingMaterialImporter materials;
+
+	CHECK(GetFirstX(*Import(materials)) == -2.0f);
+
+	CHECK(materials.log == edited_materials.log);
+
+}
+
+TEST(SceneSnapshotHashesEveryMaterialLibrary){
+
+	ClearCache();
+
+	WriteScene("-1.0", "0.5 0.5 0.5");
+
+	// Indented directive referencing two libraries. The second one defines no material used by the scene.
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	auto content = ReadFile(root_name);
+
+	auto directive = string("mtllib ") + kMtlFile + "\n";
+
+	content.replace(content.find(directive), directive.size(), string("\t  mtllib ") + kMtlFile + " scene_snapshot_test_extra.mtl\n");
+
+	WriteFile(kObjFile, content);
+
+	WriteFile("./scene_snapshot_test_extra.mtl", "newmtl Extra\nKd 0.1 0.1 0.1\n");
+
+	RecordingResources resources;
+
+	DerivedDataCache cache(kCacheDirectory, 1 << 20);
+
+	ObjImporter importer(resources, &cache);
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto Import = [&](){
+
+		RecordingMaterialImporter materials;
+
+		auto root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+		CHECK(importer.ImportScene(root_name, *root, materials));
+
+		CHECK(materials.log.find("Stone,0.500000 ") != string::npos);
+
+	};
+
+	Import();
+
+	auto cache_size = cache.GetSize();
+
+	CHECK(cache_size > 0);
+
+	Import();
+
+	CHECK(cache.GetSize() == cache_size);		// Hit
+
+	// Editing the second library misses the cache
+
+	WriteFile("./scene_snapshot_test_extra.mtl", "newmtl Extra\nKd 0.2 0.1 0.1\n");
+
+	Import();
+
+	CHECK(cache.GetSize() > cache_size);
+
+	cache_size = cache.GetSize();
+
+	// A library which cannot be read is never cached: the scene is parsed every time
+
+	std::remove("./scene_snapshot_test_extra.mtl");
+
+	Import();
+
+	Import();
+
+	CHECK(cache.GetSize() == cache_size);
+
+}
+
+BENCHMARK(SceneSnapshotLoad){
+
+	// Import from a snapshot versus import of the OBJ file it describes. Both create the same nodes and meshes.
+
+	const int kLoads = 20;
+
+	const int kObjects = 200;
+
+	string content = string("mtllib ") + kMtlFile + "\n";
+
+	for (int object = 0; object < kObjects; ++object){
+
+		content += "o Object" + to_string(object) + "\nusemtl Stone\n";
+
+		for (int quad = 0; quad < 100; ++quad){
+
+			auto x = to_string(object) + "." + to_string(quad);
+
+			content += "v " + x + " 0.0 0.0\nv " + x + " 1.0 0.0\nv " + x + " 1.0 1.0\nv " + x + " 0.0 1.0\n";
+
+			content += "vt 0.0 0.0\nvt 1.0 0.0\nvt 1.0 1.0\nvt 0.0 1.0\nvn 1.0 0.0 0.0\n";
+
+			auto base = (object * 100 + quad) * 4;
+
+			auto index = [base](int vertex){ return to_string(base + vertex) + "/" + to_string(base + vertex) + "/" + to_string(base / 4 + 1); };
+
+			content += "f " + index(1) + " " + index(2) + " " + index(3) + "\nf " + index(1) + " " + index(3) + " " + index(4) + "\n";
+
+		}
+
+	}
+
+	WriteFile(kObjFile, content);
+
+	WriteFile(kMtlPath, "newmtl Stone\nKd 0.5 0.5 0.5\n");
+
+	DeleteSnapshotFile();
+
+	RecordingResources resources;
+
+	RecordingMaterialImporter materials;
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	auto import_scene = [&](bool snapshot) -> bool{
+
+		auto root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+		return snapshot ?
+			   ObjImporter(resources).ImportScene(root_name, kSnapshotFile, *root, materials) :
+			   ObjImporter(resources).ImportScene(root_name, *root, materials);
+
+	};
+
+	// Writes the snapshot
+
+	CHECK(import_scene(true));
+
+	Timer timer;
+
+	for (int load = 0; load < kLoads; ++load){
+
+		import_scene(false);
+
+	}
+
+	auto import_time = timer.GetTime().GetDeltaSeconds();
+
+	for (int load = 0; load < kLoads; ++load){
+
+		import_scene(true);
+
+	}
+
+	auto load_time = timer.GetTime().GetDeltaSeconds();
+
+	CHECK(load_time < import_time);
+
+	Report("Import from the OBJ file", 1000.0 * import_time / kLoads, "ms");
+
+	Report("Import from the snapshot", 1000.0 * load_time / kLoads, "ms");
+
+	Report("Snapshot size", SceneSnapshot::Load(kSnapshotFile)->GetSize() / 1024.0, "KB");
+
+}
+
+BENCHMARK(SceneSnapshotImport){
+
+	// Import of a scene parsed from an OBJ file versus instantiated from its snapshot
+
+	const int kImports = 20;
+
+	const int kObjects = 200;
+
+	ClearCache();
+
+	string content = string("mtllib ") + kMtlFile + "\n";
+
+	for (int object = 0; object < kObjects; ++object){
+
+		content += "o Object" + to_string(object) + "\nusemtl Stone\n";
+
+		for (int quad = 0; quad < 100; ++quad){
+
+			auto x = to_string(object) + "." + to_string(quad);
+
+			content += "v " + x + " 0.0 0.0\nv " + x + " 1.0 0.0\nv " + x + " 1.0 1.0\nv " + x + " 0.0 1.0\n";
+
+			content += "vt 0.0 0.0\nvt 1.0 0.0\nvt 1.0 1.0\nvt 0.0 1.0\nvn 1.0 0.0 0.0\n";
+
+			auto base = (object * 100 + quad) * 4;
+
+			auto index = [base](int vertex){ return to_string(base + vertex) + "/" + to_string(base + vertex) + "/" + to_string(base / 4 + 1); };
+
+			content += "f " + index(1) + " " + index(2) + " " + index(3) + "\nf " + index(1) + " " + index(3) + " " + index(4) + "\n";
+
+		}
+
+	}
+
+	WriteFile(kObjFile, content);
+
+	WriteFile(kMtlPath, "newmtl Stone\nKd 0.5 0.5 0.5\n");
+
+	RecordingResources resources;
+
+	DerivedDataCache cache(kCacheDirectory, 1 << 28);
+
+	auto root_name = wstring(kObjFile, kObjFile + std::strlen(kObjFile));
+
+	for (auto use_cache : { false, true }){
+
+		ObjImporter importer(resources, use_cache ? &cache : nullptr);
+
+		RecordingMaterialImporter materials;
+
+		Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+		// The first import writes the snapshot
+
+		importer.ImportScene(root_name, *scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones())), materials);
+
+		Timer timer;
+
+		for (int import = 0; import < kImports; ++import){
+
+			auto root = scene.CreateNode(L"Root", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+			importer.ImportScene(root_name, *root, materials);
+
+		}
+
+		Report(use_cache ? "Import from the snapshot" : "Import from the OBJ file", 1000.0 * timer.GetTime().GetDeltaSeconds() / kImports, "ms");
+
+	}
+
+}
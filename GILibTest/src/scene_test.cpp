@@ -0,0 +1,234 @@
+#include "test.h"
+
+#include <algorithm>
+
+#include "scene.h"
+#include "bvh_tree.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Component used to tag some nodes of a scene.
+	class TagComponent : public Component{
+
+	public:
+
+		virtual TypeSet GetTypes() const override{
+
+			return DeriveTypes<TagComponent>(Component::GetTypes());
+
+		}
+
+	protected:
+
+		virtual void Initialize() override{}
+
+		virtual void Finalize() override{}
+
+	};
+
+	/// \brief Component listening to an event until it is finalized.
+	class ListeningComponent : public Component{
+
+	public:
+
+		/// \brief Create a new component.
+		/// \param event Event to listen to.
+		/// \param finalize_count Incremented when the component is finalized.
+		ListeningComponent(Event<int>& event, int& finalize_count) :
+		event_(event),
+		finalize_count_(finalize_count){}
+
+		virtual TypeSet GetTypes() const override{
+
+			return DeriveTypes<ListeningComponent>(Component::GetTypes());
+
+		}
+
+	protected:
+
+		virtual void Initialize() override{
+
+			listener_ = event_.Subscribe([](Listener&, int& argument){ ++argument; });
+
+		}
+
+		virtual void Finalize() override{
+
+			++finalize_count_;
+
+		}
+
+	private:
+
+		Event<int>& event_;					///< \brief Event to listen to.
+
+		int& finalize_count_;				///< \brief Incremented when the component is finalized.
+
+		unique_ptr<Listener> listener_;		///< \brief Listener of the event, released by the destructor.
+
+	};
+
+	/// \brief Get the nodes visited by a query, sorted.
+	template <typename TComponent>
+	vector<NodeComponent*> GetQueryResults(const Scene& scene){
+
+		vector<NodeComponent*> nodes;
+
+		scene.Query<NodeComponent, TComponent>().ForEach([&nodes](NodeComponent& node, TComponent& component){
+
+			if (node.GetComponent<TComponent>() == &component){
+
+				nodes.push_back(&node);
+
+			}
+
+		});
+
+		std::sort(nodes.begin(), nodes.end());
+
+		return nodes;
+
+	}
+
+	/// \brief Get the nodes of a scene exposing a component type, sorted.
+	template <typename TComponent>
+	vector<NodeComponent*> GetExpectedResults(Scene& scene){
+
+		vector<NodeComponent*> nodes;
+
+		for (auto&& node : scene.GetNodes()){
+
+			if (node->GetComponent<TComponent>()){
+
+				nodes.push_back(node);
+
+			}
+
+		}
+
+		std::sort(nodes.begin(), nodes.end());
+
+		return nodes;
+
+	}
+
+}
+
+TEST(SceneQueryFollowsNodeComponents){
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	for (int index = 0; index < 200; ++index){
+
+		if (index % 2 == 0){
+
+			scene.CreateNode(L"Transform", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+		}
+		else{
+
+			scene.CreateNode(L"Node");
+
+		}
+
+	}
+
+	CHECK((scene.Query<NodeComponent, NodeComponent>().GetSize() == 200));
+	CHECK((scene.Query<NodeComponent, TransformComponent>().GetSize() == 100));
+	CHECK((scene.Query<NodeComponent, TagComponent>().GetSize() == 0));
+
+	CHECK(GetQueryResults<TransformComponent>(scene) == GetExpectedResults<TransformComponent>(scene));
+
+	// Nodes gaining or losing a component are visited by the matching queries only
+
+	auto& nodes = scene.GetNodes();
+
+	for (size_t index = 0; index < nodes.size(); index += 3){
+
+		nodes[index]->AddComponent<TagComponent>();
+
+	}
+
+	CHECK((scene.Query<NodeComponent, TagComponent>().GetSize() == 67));
+	CHECK((scene.Query<TransformComponent, TagComponent>().GetSize() == 34));
+
+	CHECK(GetQueryResults<TagComponent>(scene) == GetExpectedResults<TagComponent>(scene));
+	CHECK(GetQueryResults<TransformComponent>(scene) == GetExpectedResults<TransformComponent>(scene));
+
+	for (size_t index = 0; index < nodes.size(); index += 6){
+
+		nodes[index]->GetComponent<TagComponent>()->RemoveComponent();
+
+	}
+
+	CHECK((scene.Query<NodeComponent, TagComponent>().GetSize() == 33));
+	CHECK((scene.Query<TransformComponent, TagComponent>().GetSize() == 0));
+
+	CHECK(GetQueryResults<TagComponent>(scene) == GetExpectedResults<TagComponent>(scene));
+	CHECK(GetQueryResults<TransformComponent>(scene) == GetExpectedResults<TransformComponent>(scene));
+
+	CHECK((scene.Query<NodeComponent, NodeComponent>().GetSize() == 200));
+
+}
+
+TEST(SceneReleasesNodesInBulk){
+
+	const int kNodes = 5000;
+
+	Event<int> event;
+
+	int finalize_count = 0;
+
+	auto listeners = Listener::GetStatistics().live_count;
+
+	{
+
+		Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+		for (int index = 0; index < kNodes; ++index){
+
+			scene.CreateNode(L"Node")->AddComponent<ListeningComponent>(event, finalize_count);
+
+		}
+
+		// Components of the same type are packed in a few slabs
+
+		auto& allocator = scene.GetAllocator();
+
+		auto statistics = allocator.GetStatistics<ListeningComponent>();
+
+		CHECK(statistics.live_count == kNodes);
+		auto slab_blocks = SlabPool::kSlabSize / statistics.block_size;
+
+		CHECK(statistics.slab_count == (kNodes + slab_blocks - 1) / slab_blocks);
+
+		CHECK(allocator.GetStatistics<NodeComponent>().live_count == kNodes);
+		CHECK(allocator.GetEntityStatistics().live_count == kNodes);
+
+		CHECK(Listener::GetStatistics().live_count == listeners + kNodes);
+
+		int argument = 0;
+
+		event.Notify(argument);
+
+		CHECK(argument == kNodes);
+
+	}
+
+	// Destroying the scene still finalizes and destroys every component before the slabs are dropped
+
+	CHECK(finalize_count == kNodes);
+
+	CHECK(Listener::GetStatistics().live_count == listeners);
+
+	int argument = 0;
+
+	event.Notify(argument);
+
+	CHECK(argument == 0);
+
+}
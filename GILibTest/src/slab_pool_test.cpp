@@ -0,0 +1,120 @@
+#include "test.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "slab_pool.h"
+#include "observable.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+TEST(SlabPoolReusesFreedBlocks){
+
+	SlabPool pool(24);
+
+	CHECK(pool.GetStatistics().block_size == 32);		// Rounded up to the alignment
+
+	// Blocks are aligned and distinct, slabs are reserved only when the previous ones are full
+
+	vector<void*> blocks;
+
+	auto slab_blocks = SlabPool::kSlabSize / 32;
+
+	for (size_t index = 0; index < slab_blocks + 10; ++index){
+
+		auto block = pool.Allocate();
+
+		CHECK(reinterpret_cast<uintptr_t>(block) % SlabPool::kAlignment == 0);
+
+		blocks.push_back(block);
+
+	}
+
+	CHECK(pool.GetStatistics().slab_count == 2);
+	CHECK(pool.GetStatistics().live_count == blocks.size());
+
+	auto sorted = blocks;
+
+	std::sort(sorted.begin(), sorted.end());
+
+	CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+
+	// Freed blocks are handed out again before any new slab is reserved
+
+	vector<void*> freed;
+
+	for (size_t index = 0; index < blocks.size(); index += 2){
+
+		pool.Free(blocks[index]);
+
+		freed.push_back(blocks[index]);
+
+	}
+
+	pool.Free(nullptr);		// Does nothing
+
+	CHECK(pool.GetStatistics().live_count == blocks.size() - freed.size());
+
+	vector<void*> reused;
+
+	for (size_t index = 0; index < freed.size(); ++index){
+
+		reused.push_back(pool.Allocate());
+
+	}
+
+	std::sort(freed.begin(), freed.end());
+
+	std::sort(reused.begin(), reused.end());
+
+	CHECK(reused == freed);
+
+	auto& statistics = pool.GetStatistics();
+
+	CHECK(statistics.slab_count == 2);
+	CHECK(statistics.reserved_bytes >= 2 * slab_blocks * 32);
+	CHECK(statistics.live_count == blocks.size());
+	CHECK(statistics.peak_count == blocks.size());
+	CHECK(statistics.allocation_count == blocks.size() + freed.size());
+
+	for (auto&& block : blocks){
+
+		pool.Free(block);
+
+	}
+
+	CHECK(pool.GetStatistics().live_count == 0);
+
+}
+
+TEST(ListenerPoolReusesFreedBlocks){
+
+	Event<int> event;
+
+	auto baseline = Listener::GetStatistics();
+
+	for (int round = 0; round < 3; ++round){
+
+		vector<unique_ptr<Listener>> listeners;
+
+		for (int index = 0; index < 1000; ++index){
+
+			listeners.push_back(event.Subscribe([](Listener&, int&){}));
+
+		}
+
+		CHECK(Listener::GetStatistics().live_count == baseline.live_count + 1000);
+
+	}
+
+	// Listeners destroyed by each round make room for the next one
+
+	auto statistics = Listener::GetStatistics();
+
+	CHECK(statistics.live_count == baseline.live_count);
+	CHECK(statistics.allocation_count == baseline.allocation_count + 3000);
+	CHECK(statistics.reserved_bytes - baseline.reserved_bytes <= 1000 * statistics.block_size + SlabPool::kSlabSize);
+
+}
@@ -0,0 +1,205 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <algorithm>
+
+#include "split_hierarchy.h"
+#include "bvh_tree.h"
+#include "scene.h"
+#include "scope_guard.h"
+#include "task_pool.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Index of the static hierarchy inside the partitions.
+	const unsigned int kStaticHierarchy = 1;
+
+	/// \brief Split hierarchy exposing its partitions.
+	class PartitionedSplitHierarchy : public SplitHierarchy{
+
+	public:
+
+		/// \brief Create a split hierarchy whose dynamic volumes are stored inside a BVH.
+		PartitionedSplitHierarchy() :
+			SplitHierarchy(make_unique<BVHTree>()){}
+
+		using SplitHierarchy::GetPartitions;
+
+	};
+
+	/// \brief Create some boxes attached to static nodes of a scene.
+	vector<BoxVolume*> CreateStaticBoxes(Scene& scene, size_t count, unsigned int seed){
+
+		auto boxes = CreateBoxes(count, kSceneDomain, 30.0f, seed);
+
+		vector<BoxVolume*> static_boxes;
+
+		for (auto&& box : boxes){
+
+			auto node = scene.CreateStaticNode(L"Static", Translation3f(Vector3f::Zero()), Quaternionf::Identity(), AlignedScaling3f(Vector3f::Ones()));
+
+			static_boxes.push_back(node->AddComponent<BoxVolume>(box->GetBoundingBox()));
+
+		}
+
+		DisposeBoxes(boxes);
+
+		return static_boxes;
+
+	}
+
+}
+
+TEST(SplitHierarchySharesPartitions){
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto dynamic_boxes = CreateBoxes(900, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&dynamic_boxes](){ DisposeBoxes(dynamic_boxes); });
+
+	auto static_boxes = CreateStaticBoxes(scene, 100, 2);
+
+	PartitionedSplitHierarchy hierarchy;
+
+	for (auto&& box : dynamic_boxes){
+
+		hierarchy.AddVolume(box);
+
+	}
+
+	for (auto&& box : static_boxes){
+
+		hierarchy.AddVolume(box);
+
+	}
+
+	hierarchy.Commit();
+
+	for (size_t count : { 1, 2, 4, 8, 16, 32 }){
+
+		vector<HierarchyPartition> partitions;
+
+		hierarchy.GetPartitions(count, partitions);
+
+		auto static_count = static_cast<size_t>(std::count_if(partitions.begin(),
+															   partitions.end(),
+															   [](const HierarchyPartition& partition){
+
+																   return partition.hierarchy == kStaticHierarchy;
+
+															   }));
+
+		// Each child may overshoot its share slightly, but the budget is not given to both children in full
+
+		CHECK(partitions.size() <= count + count / 4 + 4);
+
+		// Both children are covered, the one with most volumes gets most partitions
+
+		CHECK(static_count > 0);
+
+		CHECK(static_count < partitions.size());
+
+		CHECK(partitions.size() - static_count >= static_count);
+
+	}
+
+	// The partitions still yield the volumes of the sequential queries, in the same order
+
+	auto boxes = dynamic_boxes;
+
+	boxes.insert(boxes.end(), static_boxes.begin(), static_boxes.end());
+
+	for (auto thread_count : { 1u, 2u, 3u, 8u }){
+
+		TaskPool pool(thread_count);
+
+		for (int query = 0; query < 10; ++query){
+
+			auto center = Vector3f::Ones() * (query * 400.0f - 2000.0f);
+
+			auto frustum = MakeFrustum(center, Vector3f(1.0f, 0.1f, 0.2f).normalized(), 1.0f, 1.0f, 2000.0f);
+
+			vector<VolumeComponent*> intersections;
+
+			hierarchy.GetIntersections(frustum, intersections, pool);
+
+			CHECK(intersections == hierarchy.GetIntersections(frustum));
+
+			CHECK(Sorted(intersections) == GetIntersections(boxes, frustum));
+
+		}
+
+	}
+
+}
+
+TEST(SplitHierarchyIgnoresUnknownVolumes){
+
+	Scene scene(make_unique<BVHTree>(), make_unique<BVHTree>());
+
+	auto dynamic_boxes = CreateBoxes(100, kSceneDomain, 30.0f, 3);
+
+	auto dispose_boxes = make_scope_guard([&dynamic_boxes](){ DisposeBoxes(dynamic_boxes); });
+
+	auto static_boxes = CreateStaticBoxes(scene, 2, 4);
+
+	PartitionedSplitHierarchy hierarchy;
+
+	for (auto&& box : dynamic_boxes){
+
+		hierarchy.AddVolume(box);
+
+	}
+
+	hierarchy.AddVolume(static_boxes[0]);
+
+	hierarchy.Commit();
+
+	// Neither a volume removed twice nor a volume never added is counted
+
+	hierarchy.RemoveVolume(static_boxes[0]);
+
+	hierarchy.RemoveVolume(static_boxes[0]);
+
+	hierarchy.RemoveVolume(static_boxes[1]);
+
+	hierarchy.Commit();
+
+	vector<HierarchyPartition> partitions;
+
+	hierarchy.GetPartitions(8, partitions);
+
+	CHECK(!partitions.empty());
+
+	CHECK(std::none_of(partitions.begin(),
+					   partitions.end(),
+					   [](const HierarchyPartition& partition){
+
+						   return partition.hierarchy == kStaticHierarchy;
+
+					   }));
+
+	// The static hierarchy is still found once it stores a volume again
+
+	hierarchy.AddVolume(static_boxes[1]);
+
+	hierarchy.Commit();
+
+	partitions.clear();
+
+	hierarchy.GetPartitions(8, partitions);
+
+	CHECK(std::any_of(partitions.begin(),
+					  partitions.end(),
+					  [](const HierarchyPartition& partition){
+
+						  return partition.hierarchy == kStaticHierarchy;
+
+					  }));
+
+}
@@ -0,0 +1,171 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "static_tree.h"
+#include "loose_octree.h"
+#include "scope_guard.h"
+#include "exceptions.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+TEST(StaticTreeRemovesVolumes){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	StaticTree tree;
+
+	for (size_t index = 0; index < 4000; ++index){
+
+		tree.AddVolume(boxes[index]);
+
+	}
+
+	tree.Commit();
+
+	CheckQueries(tree, vector<BoxVolume*>(boxes.begin(), boxes.begin() + 4000), 2);
+
+	// Stored volumes leave a hole, pending volumes are dropped before the next build
+
+	for (size_t index = 4000; index < boxes.size(); ++index){
+
+		tree.AddVolume(boxes[index]);
+
+	}
+
+	vector<BoxVolume*> removed;
+
+	vector<BoxVolume*> kept;
+
+	for (size_t index = 0; index < boxes.size(); ++index){
+
+		if (index % 3 == 0){
+
+			tree.RemoveVolume(boxes[index]);
+
+			CHECK(boxes[index]->GetHierarchySlot() == VolumeComponent::kNoSlot);
+
+			removed.push_back(boxes[index]);
+
+		}
+		else{
+
+			kept.push_back(boxes[index]);
+
+		}
+
+	}
+
+	// Pending volumes are not visible before the commit
+
+	vector<BoxVolume*> stored;
+
+	std::copy_if(kept.begin(), kept.end(), std::back_inserter(stored), [](BoxVolume* box){ return box->GetHierarchySlot() != VolumeComponent::kNoSlot; });
+
+	CHECK(stored.size() == 4000 - 4000 / 3 - 1);
+
+	CheckQueries(tree, stored, 3);
+
+	tree.Commit();
+
+	CheckQueries(tree, kept, 4);
+
+	// Volumes stored inside another hierarchy are not inside this tree, whatever their slot
+
+	LooseOctree octree(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, 5);
+
+	for (auto&& box : removed){
+
+		octree.AddVolume(box);
+
+	}
+
+	for (auto&& box : removed){
+
+		tree.RemoveVolume(box);
+
+	}
+
+	tree.Commit();
+
+	CheckQueries(tree, kept, 5);
+
+	CheckQueries(octree, removed, 6);
+
+}
+
+TEST(StaticTreeRejectsVolumesOfOtherHierarchies){
+
+	auto boxes = CreateBoxes(100, kSceneDomain, 30.0f, 7);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	StaticTree tree;
+
+	LooseOctree octree(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, 5);
+
+	// A volume stored inside another hierarchy cannot be added
+
+	octree.AddVolume(boxes[0]);
+
+	bool rejected = false;
+
+	try{
+
+		tree.AddVolume(boxes[0]);
+
+	}
+	catch (const gi_lib::Exception&){
+
+		rejected = true;
+
+	}
+
+	CHECK(rejected);
+
+	// A pending volume stored inside another hierarchy before the commit cannot be stored
+
+	tree.AddVolume(boxes[1]);
+
+	octree.AddVolume(boxes[1]);
+
+	rejected = false;
+
+	try{
+
+		tree.Commit();
+
+	}
+	catch (const gi_lib::Exception&){
+
+		rejected = true;
+
+	}
+
+	CHECK(rejected);
+
+	// The tree is left as it was
+
+	tree.RemoveVolume(boxes[1]);
+
+	for (size_t index = 2; index < boxes.size(); ++index){
+
+		tree.AddVolume(boxes[index]);
+
+	}
+
+	tree.Commit();
+
+	octree.Commit();
+
+	CheckQueries(tree, vector<BoxVolume*>(boxes.begin() + 2, boxes.end()), 8);
+
+	CheckQueries(octree, vector<BoxVolume*>(boxes.begin(), boxes.begin() + 2), 9);
+
+}
@@ -0,0 +1,178 @@
+#include "test.h"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <exception>
+#include <algorithm>
+
+#include "task_pool.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Thread counts the pool is tested with.
+	const unsigned int kThreadCounts[] = { 1, 2, 4, 8 };
+
+	/// \brief Execute a task for each index of a range and count how many times each index was executed.
+	/// \param pool Pool executing the tasks.
+	/// \param count Number of indices.
+	/// \param task Task to execute for each index, after the index has been counted.
+	/// \param exception Exception thrown by ParallelFor, if any. Output.
+	/// \return Returns the number of times each index was executed.
+	vector<int> CountExecutions(TaskPool& pool, size_t count, const TaskPool::Task& task, exception_ptr& exception){
+
+		unique_ptr<atomic<int>[]> executions(new atomic<int>[count]);
+
+		for (size_t index = 0; index < count; ++index){
+
+			executions[index] = 0;
+
+		}
+
+		exception = nullptr;
+
+		try{
+
+			pool.ParallelFor(count,
+							 [&](size_t index){
+
+								 ++executions[index];
+
+								 task(index);
+
+							 });
+
+		}
+		catch (...){
+
+			exception = current_exception();
+
+		}
+
+		vector<int> result(count);
+
+		for (size_t index = 0; index < count; ++index){
+
+			result[index] = executions[index];
+
+		}
+
+		return result;
+
+	}
+
+	/// \brief Check whether every index was executed exactly once.
+	bool IsExecutedOnce(const vector<int>& executions){
+
+		return std::all_of(executions.begin(),
+						   executions.end(),
+						   [](int execution){
+
+								return execution == 1;
+
+						   });
+
+	}
+
+}
+
+TEST(TaskPoolRunsEveryIndexOnce){
+
+	for (auto thread_count : kThreadCounts){
+
+		TaskPool pool(thread_count);
+
+		CHECK(pool.GetThreadCount() == thread_count);
+
+		for (size_t count : { 0, 1, 2, 7, 1000, 100003 }){
+
+			exception_ptr exception;
+
+			CHECK(IsExecutedOnce(CountExecutions(pool, count, [](size_t){}, exception)));
+
+			CHECK(!exception);
+
+		}
+
+	}
+
+	CHECK(TaskPool(0).GetThreadCount() == 1);
+
+}
+
+TEST(TaskPoolPropagatesExceptions){
+
+	for (auto thread_count : kThreadCounts){
+
+		TaskPool pool(thread_count);
+
+		for (int job = 0; job < 10; ++job){
+
+			exception_ptr exception;
+
+			auto executions = CountExecutions(pool,
+											  10000,
+											  [](size_t index){
+
+												  if (index % 1000 == 999){
+
+													  throw runtime_error("task failure");
+
+												  }
+
+											  },
+											  exception);
+
+			// Every task ran to completion before the exception reached the caller
+
+			CHECK(exception != nullptr);
+
+			CHECK(IsExecutedOnce(executions));
+
+		}
+
+		// The pool is still usable
+
+		exception_ptr exception;
+
+		CHECK(IsExecutedOnce(CountExecutions(pool, 1000, [](size_t){}, exception)));
+
+		CHECK(!exception);
+
+	}
+
+}
+
+TEST(TaskPoolRethrowsTheTaskException){
+
+	TaskPool pool(4);
+
+	auto message = string();
+
+	try{
+
+		pool.ParallelFor(100,
+						 [](size_t index){
+
+							 if (index == 50){
+
+								 throw runtime_error("task failure");
+
+							 }
+
+						 });
+
+	}
+	catch (const runtime_error& exception){
+
+		message = exception.what();
+
+	}
+
+	CHECK(message == "task failure");
+
+}
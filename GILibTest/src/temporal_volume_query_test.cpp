@@ -0,0 +1,394 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <random>
+#include <algorithm>
+
+#include "temporal_volume_query.h"
+#include "loose_octree.h"
+#include "scope_guard.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Distance the query volumes can move by before the hierarchy is traversed again.
+	const float kTolerance = 50.0f;
+
+	/// \brief Create an empty loose octree covering the domain of the test scenes.
+	unique_ptr<LooseOctree> MakeLooseOctree(){
+
+		return make_unique<LooseOctree>(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, 5);
+
+	}
+
+	/// \brief Get the volumes found by the last update of a temporal query, sorted.
+	vector<VolumeComponent*> GetIntersections(const TemporalVolumeQuery& query){
+
+		auto intersections = query.GetIntersections();
+
+		return Sorted(vector<VolumeComponent*>(intersections.begin(), intersections.end()));
+
+	}
+
+	/// \brief Check whether every volume of the first sorted list is inside the second one.
+	bool Includes(const vector<VolumeComponent*>& subset, const vector<VolumeComponent*>& superset){
+
+		return std::includes(superset.begin(), superset.end(),
+							 subset.begin(), subset.end());
+
+	}
+
+}
+
+TEST(TemporalQueryReusesResultsWithinTolerance){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto octree = MakeLooseOctree();
+
+	for (auto&& box : boxes){
+
+		octree->AddVolume(box);
+
+	}
+
+	octree->Commit();
+
+	TemporalVolumeQuery sphere_query(kTolerance);
+
+	TemporalVolumeQuery aabb_query(kTolerance);
+
+	TemporalVolumeQuery frustum_query(kTolerance);
+
+	Vector3f forward = Vector3f(1.0f, 0.2f, 0.3f).normalized();
+
+	Vector3f position(-300.0f, 100.0f, 200.0f);
+
+	// The first update traverses the hierarchy with the inflated volumes
+
+	sphere_query.GetIntersections(*octree, Sphere{ position, 400.0f });
+	aabb_query.GetIntersections(*octree, AABB{ position, Vector3f::Ones() * 300.0f });
+	frustum_query.GetIntersections(*octree, MakeFrustum(position, forward, 1.0f, 1.0f, 1500.0f));
+
+	CHECK(sphere_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+	CHECK(aabb_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+	CHECK(frustum_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	auto sphere_results = GetIntersections(boxes, Sphere{ position, 400.0f + kTolerance });
+	auto aabb_results = GetIntersections(boxes, AABB{ position, Vector3f::Ones() * (300.0f + kTolerance) });
+	auto frustum_results = GetIntersections(boxes, MakeFrustum(position, forward, 1.0f, 1.0f, 1500.0f).Inflate(kTolerance));
+
+	CHECK(GetIntersections(sphere_query) == sphere_results);
+	CHECK(GetIntersections(aabb_query) == aabb_results);
+	CHECK(GetIntersections(frustum_query) == frustum_results);
+
+	// Moving within the tolerance keeps the same results, which still contain the exact ones
+
+	for (int step = 1; step <= 4; ++step){
+
+		Vector3f moved = position + forward * (5.0f * step);
+
+		sphere_query.GetIntersections(*octree, Sphere{ moved, 400.0f });
+		aabb_query.GetIntersections(*octree, AABB{ moved, Vector3f::Ones() * 300.0f });
+		frustum_query.GetIntersections(*octree, MakeFrustum(moved, forward, 1.0f, 1.0f, 1500.0f));
+
+		CHECK(sphere_query.GetLastUpdate() == TemporalQueryUpdate::kReused);
+		CHECK(aabb_query.GetLastUpdate() == TemporalQueryUpdate::kReused);
+		CHECK(frustum_query.GetLastUpdate() == TemporalQueryUpdate::kReused);
+
+		CHECK(GetIntersections(sphere_query) == sphere_results);
+		CHECK(GetIntersections(aabb_query) == aabb_results);
+		CHECK(GetIntersections(frustum_query) == frustum_results);
+
+		CHECK(Includes(GetIntersections(boxes, Sphere{ moved, 400.0f }), sphere_results));
+		CHECK(Includes(GetIntersections(boxes, AABB{ moved, Vector3f::Ones() * 300.0f }), aabb_results));
+		CHECK(Includes(GetIntersections(boxes, MakeFrustum(moved, forward, 1.0f, 1.0f, 1500.0f)), frustum_results));
+
+	}
+
+	// Moving beyond the tolerance traverses the hierarchy again around the new position
+
+	position += forward * (2.0f * kTolerance);
+
+	sphere_query.GetIntersections(*octree, Sphere{ position, 400.0f });
+	aabb_query.GetIntersections(*octree, AABB{ position, Vector3f::Ones() * 300.0f });
+	frustum_query.GetIntersections(*octree, MakeFrustum(position, forward, 1.0f, 1.0f, 1500.0f));
+
+	CHECK(sphere_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+	CHECK(aabb_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+	CHECK(frustum_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	CHECK(GetIntersections(sphere_query) == GetIntersections(boxes, Sphere{ position, 400.0f + kTolerance }));
+	CHECK(GetIntersections(aabb_query) == GetIntersections(boxes, AABB{ position, Vector3f::Ones() * (300.0f + kTolerance) }));
+	CHECK(GetIntersections(frustum_query) == GetIntersections(boxes, MakeFrustum(position, forward, 1.0f, 1.0f, 1500.0f).Inflate(kTolerance)));
+
+	// Rotating the camera traverses the hierarchy again, however small the rotation
+
+	Vector3f rotated = (forward + Vector3f(0.0f, 0.01f, 0.0f)).normalized();
+
+	frustum_query.GetIntersections(*octree, MakeFrustum(position, rotated, 1.0f, 1.0f, 1500.0f));
+
+	CHECK(frustum_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	CHECK(GetIntersections(frustum_query) == GetIntersections(boxes, MakeFrustum(position, rotated, 1.0f, 1.0f, 1500.0f).Inflate(kTolerance)));
+
+	// Deferred updates match the immediate ones
+
+	TemporalVolumeQuery batch_query(kTolerance);
+
+	VolumeQueryBatch batch;
+
+	batch_query.Update(*octree, Sphere{ position, 400.0f }, batch);
+
+	CHECK(batch_query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	octree->GetIntersections(batch);
+
+	batch_query.Resolve(batch);
+
+	CHECK(GetIntersections(batch_query) == GetIntersections(sphere_query));
+
+	batch.Clear();
+
+	batch_query.Update(*octree, Sphere{ position + forward * 10.0f, 400.0f }, batch);
+
+	CHECK(batch_query.GetLastUpdate() == TemporalQueryUpdate::kReused);
+
+	CHECK(batch.GetQueryCount() == 0);
+
+	batch_query.Resolve(batch);
+
+	CHECK(GetIntersections(batch_query) == GetIntersections(sphere_query));
+
+	for (auto&& box : boxes){
+
+		octree->RemoveVolume(box);
+
+	}
+
+}
+
+TEST(TemporalQueryPatchesHierarchyChanges){
+
+	auto boxes = CreateBoxes(2000, kSceneDomain, 30.0f, 2);		// Every change below fits the log, up to the overflow
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto octree = MakeLooseOctree();
+
+	for (auto&& box : boxes){
+
+		octree->AddVolume(box);
+
+	}
+
+	octree->Commit();
+
+	TemporalVolumeQuery query(kTolerance);
+
+	Vector3f center(200.0f, -100.0f, 300.0f);
+
+	Sphere sphere{ center, 800.0f };
+
+	Sphere inflated{ center, 800.0f + kTolerance };
+
+	query.GetIntersections(*octree, sphere);
+
+	CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	// Volumes moving in and out of the query, some of them more than once between two updates
+
+	mt19937 generator(3);
+
+	for (int frame = 0; frame < 5; ++frame){
+
+		for (size_t index = frame; index < boxes.size(); index += 35){
+
+			MoveBox(*boxes[index], generator, 1000.0f);
+
+			if (index % 2 == 0){
+
+				MoveBox(*boxes[index], generator, 1000.0f);
+
+			}
+
+		}
+
+		octree->Commit();
+
+		query.GetIntersections(*octree, sphere);
+
+		CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kPatched);
+
+		CHECK(GetIntersections(query) == GetIntersections(boxes, inflated));
+
+	}
+
+	// Removed volumes disappear, added ones are tested
+
+	vector<BoxVolume*> kept;
+
+	for (size_t index = 0; index < boxes.size(); ++index){
+
+		if (index % 3 == 0){
+
+			octree->RemoveVolume(boxes[index]);
+
+		}
+		else{
+
+			kept.push_back(boxes[index]);
+
+		}
+
+	}
+
+	octree->Commit();
+
+	query.GetIntersections(*octree, sphere);
+
+	CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kPatched);
+
+	CHECK(GetIntersections(query) == GetIntersections(kept, inflated));
+
+	for (size_t index = 0; index < boxes.size(); index += 3){
+
+		octree->AddVolume(boxes[index]);
+
+	}
+
+	octree->Commit();
+
+	query.GetIntersections(*octree, sphere);
+
+	CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kPatched);
+
+	CHECK(GetIntersections(query) == GetIntersections(boxes, inflated));
+
+	// Nothing changed
+
+	query.GetIntersections(*octree, sphere);
+
+	CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kReused);
+
+	// More changes than the log retains: the hierarchy is traversed again
+
+	auto revision = octree->GetChangeLog().GetRevision();
+
+	for (auto&& box : boxes){
+
+		MoveBox(*box, generator, 20.0f);
+
+	}
+
+	octree->Commit();
+
+	CHECK(octree->GetChangeLog().GetOldestRevision() > revision);
+
+	query.GetIntersections(*octree, sphere);
+
+	CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	CHECK(GetIntersections(query) == GetIntersections(boxes, inflated));
+
+	// Querying another hierarchy discards the cached results
+
+	auto other_octree = MakeLooseOctree();
+
+	query.GetIntersections(*other_octree, sphere);
+
+	CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kTraversed);
+
+	CHECK(GetIntersections(query).empty());
+
+	for (auto&& box : boxes){
+
+		octree->RemoveVolume(box);
+
+	}
+
+}
+
+TEST(TemporalQueryPatchesReusedAddresses){
+
+	// Slab allocators hand out the memory of a disposed component to the next one: the change log refers to both by the same address
+
+	ComponentAllocator allocator;
+
+	auto octree = MakeLooseOctree();
+
+	Vector3f center = Vector3f::Zero();
+
+	Sphere sphere{ center, 100.0f };
+
+	Sphere inflated{ center, 100.0f + kTolerance };
+
+	AABB inside{ center, Vector3f::Ones() * 10.0f };
+
+	AABB outside{ Vector3f::Ones() * 1000.0f, Vector3f::Ones() * 10.0f };
+
+	vector<BoxVolume*> boxes{ Component::CreateIn<BoxVolume>(allocator, inside),
+							  Component::CreateIn<BoxVolume>(allocator, outside) };
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	for (auto&& box : boxes){
+
+		octree->AddVolume(box);
+
+	}
+
+	octree->Commit();
+
+	TemporalVolumeQuery query(kTolerance);
+
+	query.GetIntersections(*octree, sphere);
+
+	CHECK(GetIntersections(query) == GetIntersections(boxes, inflated));
+
+	// A volume inside the query is replaced by a new one outside of it, and vice versa
+
+	for (int swap = 0; swap < 2; ++swap){
+
+		for (auto&& box : boxes){
+
+			auto address = box;
+
+			auto bounds = box->GetBoundingBox();
+
+			octree->RemoveVolume(box);
+
+			box->Dispose();
+
+			box = Component::CreateIn<BoxVolume>(allocator, bounds.center == inside.center ? outside : inside);
+
+			CHECK(box == address);
+
+			octree->AddVolume(box);
+
+		}
+
+		octree->Commit();
+
+		query.GetIntersections(*octree, sphere);
+
+		CHECK(query.GetLastUpdate() == TemporalQueryUpdate::kPatched);
+
+		CHECK(GetIntersections(query) == GetIntersections(boxes, inflated));
+
+		CHECK(GetIntersections(query).size() == 1);
+
+	}
+
+	for (auto&& box : boxes){
+
+		octree->RemoveVolume(box);
+
+	}
+
+}
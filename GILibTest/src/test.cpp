@@ -0,0 +1,212 @@
+#include "test.h"
+
+#include <iostream>
+#include <sstream>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <exception>
+
+#include "exceptions.h"
+
+using namespace gi_test;
+using namespace std;
+
+namespace{
+
+	/// \brief Number of heap allocations performed by the process.
+	atomic<size_t> allocation_count(0);
+
+	/// \brief Get the registered test cases.
+	vector<TestCase>& GetRegistry(){
+
+		static vector<TestCase> test_cases;
+
+		return test_cases;
+
+	}
+
+	/// \brief Run a single test case.
+	/// \return Returns true if the test case succeeded, returns false otherwise.
+	bool Run(const TestCase& test_case){
+
+		cout << "[ RUN  ] " << test_case.name << endl;
+
+		string failure;
+
+		try{
+
+			test_case.function();
+
+			cout << "[  OK  ] " << test_case.name << endl;
+
+			return true;
+
+		}
+		catch (const TestFailure& exception){
+
+			failure = exception.GetMessage();
+
+		}
+		catch (const gi_lib::Exception& exception){
+
+			failure = "unexpected exception: " + string(exception.GetError().begin(), exception.GetError().end());
+
+		}
+		catch (const std::exception& exception){
+
+			failure = string("unexpected exception: ") + exception.what();
+
+		}
+		catch (...){
+
+			failure = "unexpected exception";
+
+		}
+
+		cout << "[ FAIL ] " << test_case.name << ": " << failure << endl;
+
+		return false;
+
+	}
+
+}
+
+/////////////////////////////////// TEST FAILURE ///////////////////////////////////
+
+TestFailure::TestFailure(const string& message) :
+message_(message){}
+
+const string& TestFailure::GetMessage() const{
+
+	return message_;
+
+}
+
+/////////////////////////////////// FRAMEWORK ///////////////////////////////////
+
+int gi_test::Register(const TestCase& test_case){
+
+	auto& test_cases = GetRegistry();
+
+	test_cases.push_back(test_case);
+
+	return static_cast<int>(test_cases.size());
+
+}
+
+const vector<TestCase>& gi_test::GetTestCases(){
+
+	return GetRegistry();
+
+}
+
+void gi_test::Check(bool condition, const char* expression, const char* file, int line){
+
+	if (!condition){
+
+		stringstream message;
+
+		message << file << "(" << line << "): CHECK(" << expression << ") failed";
+
+		throw TestFailure(message.str());
+
+	}
+
+}
+
+void gi_test::Report(const string& label, double value, const char* unit){
+
+	cout << "           " << label << ": " << value << " " << unit << endl;
+
+}
+
+size_t gi_test::GetAllocationCount(){
+
+	return allocation_count.load();
+
+}
+
+/////////////////////////////////// ALLOCATIONS ///////////////////////////////////
+
+// Replaces the global allocation functions, so that the tests can count the allocations. The array forms forward here by default.
+
+void* operator new(size_t size){
+
+	allocation_count.fetch_add(1, memory_order_relaxed);
+
+	if (auto pointer = malloc(size > 0 ? size : 1)){
+
+		return pointer;
+
+	}
+
+	throw bad_alloc();
+
+}
+
+void operator delete(void* pointer) throw(){
+
+	free(pointer);
+
+}
+
+/////////////////////////////////// MAIN ///////////////////////////////////
+
+/// \brief Run the registered test cases.
+/// Usage: GILibTest [--benchmark] [filter]
+/// Benchmarks are run only if "--benchmark" is specified. The filter, if any, selects the test cases whose name contains it.
+/// \return Returns the number of failed test cases.
+int main(int argc, char* argv[]){
+
+	auto benchmark = false;
+
+	string filter;
+
+	for (int index = 1; index < argc; ++index){
+
+		if (strcmp(argv[index], "--benchmark") == 0){
+
+			benchmark = true;
+
+		}
+		else{
+
+			filter = argv[index];
+
+		}
+
+	}
+
+	int passed = 0;
+
+	int failed = 0;
+
+	for (auto&& test_case : GetTestCases()){
+
+		if ((test_case.kind == TestKind::kBenchmark && !benchmark) ||
+			string(test_case.name).find(filter) == string::npos){
+
+			continue;
+
+		}
+
+		if (Run(test_case)){
+
+			++passed;
+
+		}
+		else{
+
+			++failed;
+
+		}
+
+	}
+
+	cout << passed << " passed, " << failed << " failed" << endl;
+
+	return failed;
+
+}
@@ -0,0 +1,196 @@
+#include "test_scene.h"
+#include "test.h"
+
+#include <random>
+#include <algorithm>
+#include <atomic>
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Number of frustum tests performed against any box.
+	atomic<size_t> frustum_test_count(0);
+
+	/// \brief Number of times the bounds of any box were computed again.
+	atomic<size_t> bounds_update_count(0);
+
+}
+
+/////////////////////////////////// BOX VOLUME ///////////////////////////////////
+
+BoxVolume::BoxVolume(const AABB& bounds) :
+bounds_(bounds){}
+
+void BoxVolume::SetBounds(const AABB& bounds){
+
+	bounds_ = bounds;
+
+	NotifyChange();
+
+}
+
+IntersectionType BoxVolume::TestAgainst(const Frustum& frustum) const{
+
+	frustum_test_count.fetch_add(1, memory_order_relaxed);
+
+	return frustum.Intersect(bounds_);
+
+}
+
+IntersectionType BoxVolume::TestAgainst(const AABB& box) const{
+
+	return bounds_.Intersect(box);
+
+}
+
+IntersectionType BoxVolume::TestAgainst(const Sphere& sphere) const{
+
+	return bounds_.Intersect(sphere);
+
+}
+
+AABB BoxVolume::GetBoundingBox() const{
+
+	return bounds_;
+
+}
+
+size_t BoxVolume::GetFrustumTestCount(){
+
+	return frustum_test_count.load();
+
+}
+
+size_t BoxVolume::GetBoundsUpdateCount(){
+
+	return bounds_update_count.load();
+
+}
+
+void BoxVolume::Initialize(){}
+
+void BoxVolume::Finalize(){}
+
+void BoxVolume::UpdateBounds(){
+
+	bounds_update_count.fetch_add(1, memory_order_relaxed);
+
+}
+
+/////////////////////////////////// HELPERS ///////////////////////////////////
+
+vector<BoxVolume*> gi_test::CreateBoxes(size_t count, float domain, float max_size, unsigned int seed){
+
+	mt19937 generator(seed);
+
+	uniform_real_distribution<float> position(-domain, domain);
+
+	uniform_real_distribution<float> size(0.1f * max_size, max_size);
+
+	vector<BoxVolume*> boxes;
+
+	boxes.reserve(count);
+
+	for (size_t index = 0; index < count; ++index){
+
+		auto center = Vector3f(position(generator), position(generator), position(generator));
+
+		auto half_extents = Vector3f(size(generator), size(generator), size(generator));
+
+		boxes.push_back(Component::Create<BoxVolume>(AABB{ center, half_extents }));
+
+	}
+
+	return boxes;
+
+}
+
+void gi_test::DisposeBoxes(vector<BoxVolume*>& boxes){
+
+	for (auto&& box : boxes){
+
+		box->Dispose();
+
+	}
+
+	boxes.clear();
+
+}
+
+void gi_test::MoveBox(BoxVolume& box, const Vector3f& offset){
+
+	auto bounds = box.GetBoundingBox();
+
+	bounds.center += offset;
+
+	box.SetBounds(bounds);
+
+}
+
+void gi_test::MoveBox(BoxVolume& box, mt19937& generator, float distance){
+
+	uniform_real_distribution<float> offset(-distance, distance);
+
+	MoveBox(box, Vector3f(offset(generator), offset(generator), offset(generator)));
+
+}
+
+Frustum gi_test::MakeFrustum(const Vector3f& position, const Vector3f& forward, float field_of_view, float near_plane, float far_plane){
+
+	Vector3f right = forward.cross(Vector3f::UnitY()).normalized();
+
+	Vector3f up = right.cross(forward).normalized();
+
+	// Side planes are rotated from the forward direction by half the field of view
+
+	auto cosine = std::cos(0.5f * field_of_view);
+
+	auto sine = std::sin(0.5f * field_of_view);
+
+	vector<Vector4f> planes;
+
+	planes.push_back(Math::MakePlane(forward, position + forward * near_plane));
+	planes.push_back(Math::MakePlane(-forward, position + forward * far_plane));
+	planes.push_back(Math::MakePlane((right * cosine + forward * sine).normalized(), position));
+	planes.push_back(Math::MakePlane((-right * cosine + forward * sine).normalized(), position));
+	planes.push_back(Math::MakePlane((up * cosine + forward * sine).normalized(), position));
+	planes.push_back(Math::MakePlane((-up * cosine + forward * sine).normalized(), position));
+
+	return Frustum(planes);
+
+}
+
+vector<VolumeComponent*> gi_test::Sorted(vector<VolumeComponent*> volumes){
+
+	std::sort(volumes.begin(), volumes.end());
+
+	return volumes;
+
+}
+
+void gi_test::CheckQueries(const IVolumeHierarchy& hierarchy, const vector<BoxVolume*>& boxes, unsigned int seed){
+
+	mt19937 generator(seed);
+
+	uniform_real_distribution<float> position(-kSceneDomain, kSceneDomain);
+
+	for (int query = 0; query < 50; ++query){
+
+		Vector3f center(position(generator), position(generator), position(generator));
+
+		AABB aabb{ center, Vector3f::Ones() * 300.0f };
+
+		Sphere sphere{ center, 400.0f };
+
+		auto frustum = MakeFrustum(center, Vector3f(1.0f, 0.2f, 0.3f).normalized(), 1.0f, 1.0f, 1500.0f);
+
+		CHECK(Sorted(hierarchy.GetIntersections(aabb)) == GetIntersections(boxes, aabb));
+		CHECK(Sorted(hierarchy.GetIntersections(sphere)) == GetIntersections(boxes, sphere));
+		CHECK(Sorted(hierarchy.GetIntersections(frustum)) == GetIntersections(boxes, frustum));
+
+	}
+
+}
@@ -0,0 +1,704 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <random>
+#include <algorithm>
+
+#include "scene.h"
+#include "bvh_tree.h"
+#include "task_pool.h"
+#include "timer.h"
+#include "scope_guard.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Transform evaluated recursively and lazily, without any transform system.
+	struct ReferenceTransform{
+
+		int parent;						///< \brief Index of the parent transform. -1 for roots.
+
+		Translation3f translation;		///< \brief Local translation.
+
+		Quaternionf rotation;			///< \brief Local rotation.
+
+		AlignedScaling3f scale;			///< \brief Local scale.
+
+	};
+
+	/// \brief Compute the world matrix of a reference transform by walking up the hierarchy.
+	Affine3f GetWorldTransform(const vector<ReferenceTransform>& transforms, int index){
+
+		auto& transform = transforms[index];
+
+		Affine3f local = transform.translation * transform.rotation * transform.scale;
+
+		return transform.parent < 0 ?
+			   local :
+			   GetWorldTransform(transforms, transform.parent) * local;
+
+	}
+
+	/// \brief Transforms evaluated lazily and marked dirty recursively, one subtree at a time, as transform components were before the transform system.
+	struct LazyTransforms{
+
+		/// \brief Mirror a set of reference transforms.
+		LazyTransforms(const vector<ReferenceTransform>& transforms);
+
+		/// \brief Mark a transform and its subtree dirty. Subtrees dirty already are skipped.
+		void SetDirty(size_t index);
+
+		/// \brief Get the world matrix of a transform, evaluating it and its dirty ancestors first.
+		const Affine3f& GetWorldTransform(size_t index);
+
+		const vector<ReferenceTransform>& transforms;		///< \brief Local transforms.
+
+		vector<vector<size_t>> children;					///< \brief Children of each transform.
+
+		vector<Affine3f> world_transforms;					///< \brief Cached world matrix of each transform.
+
+		vector<bool> dirty;									///< \brief Whether the cached world matrix is out-of-date.
+
+	};
+
+	LazyTransforms::LazyTransforms(const vector<ReferenceTransform>& transforms) :
+	transforms(transforms),
+	children(transforms.size()),
+	world_transforms(transforms.size(), Affine3f::Identity()),
+	dirty(transforms.size(), true){
+
+		for (size_t index = 0; index < transforms.size(); ++index){
+
+			if (transforms[index].parent >= 0){
+
+				children[transforms[index].parent].push_back(index);
+
+			}
+
+		}
+
+	}
+
+	void LazyTransforms::SetDirty(size_t index){
+
+		if (dirty[index]){
+
+			return;
+
+		}
+
+		dirty[index] = true;
+
+		for (auto&& child : children[index]){
+
+			SetDirty(child);
+
+		}
+
+	}
+
+	const Affine3f& LazyTransforms::GetWorldTransform(size_t index){
+
+		if (dirty[index]){
+
+			auto& transform = transforms[index];
+
+			Affine3f local = transform.translation * transform.rotation * transform.scale;
+
+			world_transforms[index] = transform.parent < 0 ?
+									  local :
+									  GetWorldTransform(transform.parent) * local;
+
+			dirty[index] = false;
+
+		}
+
+		return world_transforms[index];
+
+	}
+
+	/// \brief Shape of a test hierarchy.
+	enum class HierarchyShape{
+
+		kDeep,			///< \brief Long chains of transforms.
+		kWide,			///< \brief Every transform is the child of a random preceding transform.
+
+	};
+
+	/// \brief Scene made of a random hierarchy of transforms, mirrored by reference transforms.
+	struct TransformScene{
+
+		/// \brief Create the hierarchy.
+		/// \param count Number of transforms.
+		/// \param shape Shape of the hierarchy.
+		/// \param seed Seed of the random generator.
+		TransformScene(size_t count, HierarchyShape shape, unsigned int seed);
+
+		/// \brief Move a random subset of transforms.
+		/// \param count Number of transforms to move.
+		/// \return Returns the index of each transform moved.
+		vector<size_t> Animate(size_t count);
+
+		/// \brief Check whether every world matrix matches the reference one.
+		bool IsConsistent() const;
+
+		Scene scene;								///< \brief Scene containing the transforms.
+
+		vector<TransformComponent*> nodes;			///< \brief Transforms of the scene.
+
+		vector<ReferenceTransform> reference;		///< \brief Reference transform of each node.
+
+		mt19937 generator;							///< \brief Generator used to create and animate the hierarchy.
+
+	};
+
+	TransformScene::TransformScene(size_t count, HierarchyShape shape, unsigned int seed) :
+	scene(make_unique<BVHTree>(), make_unique<BVHTree>()),
+	generator(seed){
+
+		uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+		for (size_t index = 0; index < count; ++index){
+
+			Translation3f translation(Vector3f(offset(generator), offset(generator), offset(generator)));
+
+			Quaternionf rotation(AngleAxisf(offset(generator), Vector3f(offset(generator), 1.0f, offset(generator)).normalized()));
+
+			AlignedScaling3f scale(Vector3f::Ones() * (1.0f + 0.1f * offset(generator)));
+
+			auto parent = -1;
+
+			if (index > 0){
+
+				parent = (shape == HierarchyShape::kDeep) ?
+						 ((index % 1000 == 0) ? -1 : static_cast<int>(index) - 1) :		// Chains of 1000 transforms
+						 static_cast<int>(generator() % index);
+
+			}
+
+			auto node = scene.CreateNode(L"Node", translation, rotation, scale);
+
+			if (parent >= 0){
+
+				node->SetParent(nodes[parent]);
+
+			}
+
+			nodes.push_back(node);
+
+			reference.push_back(ReferenceTransform{ parent, translation, rotation, scale });
+
+		}
+
+	}
+
+	vector<size_t> TransformScene::Animate(size_t count){
+
+		uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+		vector<size_t> moved;
+
+		for (size_t move = 0; move < count; ++move){
+
+			auto index = generator() % nodes.size();
+
+			Translation3f translation(Vector3f(offset(generator), offset(generator), offset(generator)));
+
+			nodes[index]->SetTranslation(translation);
+
+			reference[index].translation = translation;
+
+			moved.push_back(index);
+
+		}
+
+		return moved;
+
+	}
+
+	/// \brief Counts the notifications sent by a set of transforms.
+	struct NotificationCounter{
+
+		/// \brief Listen to the notifications of a set of transforms.
+		NotificationCounter(const vector<TransformComponent*>& transforms);
+
+		size_t count;									///< \brief Number of notifications received.
+
+		vector<unique_ptr<Listener>> listeners;			///< \brief Listener of each transform.
+
+	};
+
+	NotificationCounter::NotificationCounter(const vector<TransformComponent*>& transforms) :
+	count(0){
+
+		for (auto&& transform : transforms){
+
+			listeners.push_back(transform->OnTransformChanged().Subscribe([this](Listener&, TransformComponent::OnTransformChangedEventArgs&){
+
+				++count;
+
+			}));
+
+		}
+
+	}
+
+	bool TransformScene::IsConsistent() const{
+
+		for (size_t index = 0; index < nodes.size(); ++index){
+
+			if (!nodes[index]->GetWorldTransform().isApprox(GetWorldTransform(reference, static_cast<int>(index)), 1e-3f)){
+
+				return false;
+
+			}
+
+		}
+
+		return true;
+
+	}
+
+}
+
+TEST(TransformSystemMatchesRecursiveEvaluation){
+
+	for (auto shape : { HierarchyShape::kDeep, HierarchyShape::kWide }){
+
+		TransformScene scene(3000, shape, 1);
+
+		auto& system = scene.scene.GetTransformSystem();
+
+		system.Update();
+
+		CHECK(scene.IsConsistent());
+
+		for (int frame = 0; frame < 5; ++frame){
+
+			scene.Animate(50);
+
+			system.Update();
+
+			CHECK(scene.IsConsistent());
+
+		}
+
+		// World matrices read before the update are evaluated lazily
+
+		scene.Animate(50);
+
+		CHECK(scene.IsConsistent());
+
+		system.Update();
+
+		// Parallel sweep
+
+		TaskPool pool(4);
+
+		scene.Animate(50);
+
+		system.Update(pool);
+
+		CHECK(scene.IsConsistent());
+
+	}
+
+}
+
+TEST(TransformSystemFollowsReparenting){
+
+	TransformScene scene(1000, HierarchyShape::kWide, 2);
+
+	auto& system = scene.scene.GetTransformSystem();
+
+	system.Update();
+
+	// Move subtrees under later transforms, so that children come before their parents in creation order
+
+	for (int move = 0; move < 20; ++move){
+
+		auto child = 1 + scene.generator() % 200;
+
+		auto parent = 800 + scene.generator() % 200;
+
+		// Skip moves which would create a cycle
+
+		auto ancestor = static_cast<int>(parent);
+
+		while (ancestor >= 0 && ancestor != static_cast<int>(child)){
+
+			ancestor = scene.reference[ancestor].parent;
+
+		}
+
+		if (ancestor >= 0){
+
+			continue;
+
+		}
+
+		scene.nodes[child]->SetParent(scene.nodes[parent]);
+
+		scene.reference[child].parent = static_cast<int>(parent);
+
+	}
+
+	system.Update();
+
+	CHECK(scene.IsConsistent());
+
+	// Detached transforms become roots
+
+	scene.nodes[5]->SetParent(nullptr);
+
+	scene.reference[5].parent = -1;
+
+	system.Update();
+
+	CHECK(scene.IsConsistent());
+
+}
+
+TEST(TransformNotificationsFollowHierarchyOrder){
+
+	// Parents are notified before their children, and every world matrix is up-to-date when a notification is sent.
+
+	TransformScene scene(500, HierarchyShape::kWide, 3);
+
+	auto& system = scene.scene.GetTransformSystem();
+
+	system.Update();
+
+	vector<TransformComponent*> notified;
+
+	auto consistent = true;
+
+	vector<unique_ptr<Listener>> listeners;
+
+	for (auto&& node : scene.nodes){
+
+		listeners.push_back(node->OnTransformChanged().Subscribe([&](Listener&, TransformComponent::OnTransformChangedEventArgs& args){
+
+			notified.push_back(args.transform);
+
+			auto index = std::find(scene.nodes.begin(), scene.nodes.end(), args.transform) - scene.nodes.begin();
+
+			consistent = consistent && args.transform->GetWorldTransform().isApprox(GetWorldTransform(scene.reference, static_cast<int>(index)), 1e-3f);
+
+		}));
+
+	}
+
+	// Move the root: every transform changes
+
+	scene.nodes[0]->SetTranslation(Translation3f(Vector3f(10.0f, 0.0f, 0.0f)));
+
+	scene.reference[0].translation = Translation3f(Vector3f(10.0f, 0.0f, 0.0f));
+
+	CHECK(notified.empty());			// Nothing is notified before the update
+
+	system.Update();
+
+	CHECK(consistent);
+
+	CHECK(notified.size() == scene.nodes.size());
+
+	CHECK(system.GetUpdateCount() == scene.nodes.size());
+
+	for (size_t index = 1; index < scene.nodes.size(); ++index){
+
+		auto parent = scene.nodes[scene.reference[index].parent];
+
+		auto child_position = std::find(notified.begin(), notified.end(), scene.nodes[index]);
+
+		auto parent_position = std::find(notified.begin(), notified.end(), parent);
+
+		CHECK(parent_position < child_position);
+
+	}
+
+	// Nothing changed, nothing is notified
+
+	notified.clear();
+
+	system.Update();
+
+	CHECK(notified.empty());
+
+	CHECK(system.GetUpdateCount() == 0);
+
+}
+
+TEST(TransformSetTRSNotifiesOnce){
+
+	TransformScene scene(100, HierarchyShape::kDeep, 5);		// A single chain
+
+	auto& system = scene.scene.GetTransformSystem();
+
+	system.Update();
+
+	auto boxes = CreateBoxes(scene.nodes.size(), 100.0f, 1.0f, 6);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	for (size_t index = 0; index < boxes.size(); ++index){
+
+		scene.nodes[index]->AttachVolume(*boxes[index]);
+
+	}
+
+	NotificationCounter notifications(scene.nodes);
+
+	// Every transform below the 50th changes once, no matter how many times
+
+	Translation3f translation(Vector3f(1.0f, 2.0f, 3.0f));
+
+	Quaternionf rotation(AngleAxisf(0.5f, Vector3f::UnitY()));
+
+	AlignedScaling3f scale(Vector3f::Ones() * 2.0f);
+
+	scene.nodes[50]->SetTRS(translation, rotation, scale);
+
+	scene.nodes[50]->SetTranslation(translation);
+
+	scene.reference[50].translation = translation;
+	scene.reference[50].rotation = rotation;
+	scene.reference[50].scale = scale;
+
+	auto bounds_updates = BoxVolume::GetBoundsUpdateCount();
+
+	system.Update();
+
+	CHECK(scene.IsConsistent());
+
+	CHECK(notifications.count == 50);
+
+	CHECK(system.GetChangeCount() == 50);
+
+	CHECK(system.GetUpdateCount() == 50);
+
+	CHECK(BoxVolume::GetBoundsUpdateCount() - bounds_updates == 50);
+
+	for (size_t index = 0; index < boxes.size(); ++index){
+
+		scene.nodes[index]->DetachVolume(*boxes[index]);
+
+	}
+
+}
+
+TEST(TransformEditMarksSubtreesOnClose){
+
+	TransformScene scene(1000, HierarchyShape::kWide, 7);
+
+	auto& system = scene.scene.GetTransformSystem();
+
+	system.Update();
+
+	NotificationCounter notifications(scene.nodes);
+
+	auto edited = 0;
+
+	{
+		TransformEdit edit(system);
+
+		{
+			TransformEdit nested_edit(system);
+
+			// Edit a transform and some of its descendants, more than once
+
+			for (auto index : { 0, 1, 2, 3, 10, 100 }){
+
+				Translation3f translation(Vector3f(index * 1.0f, 0.0f, 0.0f));
+
+				scene.nodes[index]->SetTRS(translation, scene.reference[index].rotation, scene.reference[index].scale);
+
+				scene.nodes[index]->SetTranslation(translation);
+
+				scene.reference[index].translation = translation;
+
+				++edited;
+
+			}
+
+		}
+
+		CHECK(notifications.count == 0);
+
+		// The edited transforms are up-to-date
+
+		CHECK(scene.nodes[0]->GetWorldTransform().isApprox(GetWorldTransform(scene.reference, 0), 1e-3f));
+
+	}
+
+	CHECK(edited == 6);
+
+	system.Update();
+
+	CHECK(scene.IsConsistent());
+
+	// The root moved: every transform changed exactly once
+
+	CHECK(notifications.count == scene.nodes.size());
+
+	CHECK(system.GetChangeCount() == scene.nodes.size());
+
+}
+
+BENCHMARK(TransformEdits){
+
+	// Orbiting lights and animated nodes, moved one component at a time or via SetTRS inside an edit
+
+	const int kFrames = 100;
+
+	const size_t kNodes = 10000;
+
+	for (auto coalesced : { false, true }){
+
+		TransformScene scene(kNodes, HierarchyShape::kWide, 8);
+
+		auto& system = scene.scene.GetTransformSystem();
+
+		auto boxes = CreateBoxes(kNodes, 100.0f, 1.0f, 9);
+
+		auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+		for (size_t index = 0; index < kNodes; ++index){
+
+			scene.nodes[index]->AttachVolume(*boxes[index]);
+
+		}
+
+		system.Update();
+
+		NotificationCounter notifications(scene.nodes);
+
+		auto bounds_updates = BoxVolume::GetBoundsUpdateCount();
+
+		Timer timer;
+
+		for (int frame = 0; frame < kFrames; ++frame){
+
+			auto angle = 0.01f * frame;
+
+			Translation3f translation(Vector3f(std::cos(angle), 0.0f, std::sin(angle)));
+
+			Quaternionf rotation(AngleAxisf(angle, Vector3f::UnitY()));
+
+			AlignedScaling3f scale(Vector3f::Ones());
+
+			if (coalesced){
+
+				TransformEdit edit(system);
+
+				for (size_t index = 0; index < kNodes; index += 10){
+
+					scene.nodes[index]->SetTRS(translation, rotation, scale);
+
+				}
+
+			}
+			else{
+
+				for (size_t index = 0; index < kNodes; index += 10){
+
+					scene.nodes[index]->SetTranslation(translation);
+					scene.nodes[index]->SetRotation(rotation);
+					scene.nodes[index]->SetScale(scale);
+
+				}
+
+			}
+
+			system.Update();
+
+		}
+
+		auto time = timer.GetTime().GetDeltaSeconds();
+
+		string name = coalesced ? "SetTRS inside an edit" : "One component at a time";
+
+		Report(name + ", time per frame", 1000.0 * time / kFrames, "ms");
+
+		Report(name + ", notifications per frame", static_cast<double>(notifications.count) / kFrames, "notifications");
+
+		Report(name + ", bounds computed per frame", static_cast<double>(BoxVolume::GetBoundsUpdateCount() - bounds_updates) / kFrames, "bounds");
+
+		for (size_t index = 0; index < kNodes; ++index){
+
+			scene.nodes[index]->DetachVolume(*boxes[index]);
+
+		}
+
+	}
+
+}
+
+BENCHMARK(TransformPropagation){
+
+	// Linear sweep of the transform system versus recursive dirty marking and lazy evaluation, on deep and wide hierarchies
+
+	const int kFrames = 20;
+
+	const size_t kTransforms = 100000;
+
+	for (auto shape : { HierarchyShape::kDeep, HierarchyShape::kWide }){
+
+		TransformScene scene(kTransforms, shape, 4);
+
+		LazyTransforms lazy_transforms(scene.reference);
+
+		auto& system = scene.scene.GetTransformSystem();
+
+		system.Update();
+
+		double system_time = 0.0;
+
+		double lazy_time = 0.0;
+
+		size_t updates = 0;
+
+		for (int frame = 0; frame < kFrames; ++frame){
+
+			auto moved = scene.Animate(kTransforms / 100);
+
+			Timer timer;
+
+			system.Update();
+
+			system_time += timer.GetTime().GetDeltaSeconds();
+
+			updates += system.GetUpdateCount();
+
+			for (auto&& index : moved){
+
+				lazy_transforms.SetDirty(index);
+
+			}
+
+			for (size_t index = 0; index < kTransforms; ++index){
+
+				lazy_transforms.GetWorldTransform(index);
+
+			}
+
+			lazy_time += timer.GetTime().GetDeltaSeconds();
+
+		}
+
+		CHECK(scene.nodes[kTransforms - 1]->GetWorldTransform().isApprox(lazy_transforms.GetWorldTransform(kTransforms - 1), 1e-3f));
+
+		string name = (shape == HierarchyShape::kDeep) ? "Deep" : "Wide";
+
+		Report(name + " hierarchy, transform system per frame", 1000.0 * system_time / kFrames, "ms");
+
+		Report(name + " hierarchy, world matrices computed per frame", static_cast<double>(updates) / kFrames, "matrices");
+
+		Report(name + " hierarchy, recursive lazy evaluation per frame", 1000.0 * lazy_time / kFrames, "ms");
+
+	}
+
+}
@@ -0,0 +1,238 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include <random>
+
+#include "uniform_tree.h"
+#include "timer.h"
+#include "scope_guard.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Create a uniform tree covering the domain of the test scenes and containing the specified boxes.
+	unique_ptr<UniformTree> MakeUniformTree(const vector<BoxVolume*>& boxes){
+
+		auto tree = make_unique<UniformTree>(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) },
+											 Vector3i::Ones() * 3);
+
+		for (auto&& box : boxes){
+
+			tree->AddVolume(box);
+
+		}
+
+		tree->Commit();
+
+		return tree;
+
+	}
+
+}
+
+TEST(UniformTreeSkipsVolumesOfContainedSpaces){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto tree = MakeUniformTree(boxes);
+
+	// A frustum containing the whole domain
+
+	auto frustum = MakeFrustum(Vector3f(0.0f, 0.0f, -20000.0f), Vector3f::UnitZ(), 1.0f, 1.0f, 40000.0f);
+
+	auto frustum_tests = BoxVolume::GetFrustumTestCount();
+
+	auto intersections = tree->GetIntersections(frustum);
+
+	CHECK(BoxVolume::GetFrustumTestCount() == frustum_tests);
+
+	CHECK(Sorted(intersections) == GetIntersections(boxes, frustum));
+
+	CHECK(intersections.size() == boxes.size());
+
+}
+
+TEST(UniformTreeMatchesBruteForce){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 2);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto tree = MakeUniformTree(boxes);
+
+	mt19937 generator(3);
+
+	uniform_real_distribution<float> position(-kSceneDomain, kSceneDomain);
+
+	for (int query = 0; query < 50; ++query){
+
+		Vector3f forward(position(generator), 0.5f * position(generator), position(generator));
+
+		auto frustum = MakeFrustum(Vector3f(position(generator), position(generator), position(generator)), forward.normalized(), 1.0f, 1.0f, 3000.0f);
+
+		auto expected = GetIntersections(boxes, frustum);
+
+		// Volumes inside fully visible spaces are not tested at all
+
+		auto frustum_tests = BoxVolume::GetFrustumTestCount();
+
+		auto intersections = tree->GetIntersections(frustum);
+
+		CHECK(BoxVolume::GetFrustumTestCount() - frustum_tests <= expected.size());
+
+		CHECK(Sorted(intersections) == expected);
+
+	}
+
+}
+
+TEST(UniformTreeCoalescesChangesUntilCommit){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 5);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto tree = MakeUniformTree(boxes);
+
+	// Each of the first 100 boxes moves three times, far enough to change subspace
+
+	for (int edit = 0; edit < 3; ++edit){
+
+		for (size_t index = 0; index < 100; ++index){
+
+			MoveBox(*boxes[index], Vector3f(edit == 1 ? -1000.0f : 500.0f, 0.0f, 0.0f));
+
+		}
+
+	}
+
+	tree->Commit();
+
+	auto stats = tree->GetStats();
+
+	CHECK(stats.changes == 300);
+	CHECK(stats.relocations == 100);
+	CHECK(stats.coalesced == 200);
+
+	CheckQueries(*tree, boxes, 6);
+
+	// Removing a volume neither commits the others nor overwrites the statistics
+
+	MoveBox(*boxes[100], Vector3f(0.0f, 2000.0f, 0.0f));
+	MoveBox(*boxes[101], Vector3f(0.0f, 2000.0f, 0.0f));
+	MoveBox(*boxes[101], Vector3f(0.0f, -4000.0f, 0.0f));
+	MoveBox(*boxes[102], Vector3f(0.0f, 0.0f, 2000.0f));
+
+	tree->RemoveVolume(boxes[101]);		// Pending
+	tree->RemoveVolume(boxes[200]);		// Not pending
+
+	stats = tree->GetStats();
+
+	CHECK(stats.changes == 300);
+	CHECK(stats.relocations == 100);
+
+	tree->Commit();
+
+	stats = tree->GetStats();
+
+	CHECK(stats.changes == 4);
+	CHECK(stats.relocations == 2);
+	CHECK(stats.coalesced == 2);
+
+	vector<BoxVolume*> stored;
+
+	for (auto&& box : boxes){
+
+		if (box != boxes[101] && box != boxes[200]){
+
+			stored.push_back(box);
+
+		}
+
+	}
+
+	CheckQueries(*tree, stored, 7);
+
+	// Removed volumes are no longer tracked
+
+	MoveBox(*boxes[101], Vector3f(0.0f, 2000.0f, 0.0f));
+	MoveBox(*boxes[200], Vector3f(0.0f, 2000.0f, 0.0f));
+
+	tree->Commit();
+
+	CHECK(tree->GetStats().changes == 0);
+
+	// Removing every volume empties the tree, even if half of them are still waiting to be relocated
+
+	for (size_t index = 0; index < stored.size(); index += 2){
+
+		MoveBox(*stored[index], Vector3f(0.0f, 0.0f, -1000.0f));
+
+	}
+
+	for (auto&& box : stored){
+
+		tree->RemoveVolume(box);
+
+	}
+
+	tree->Commit();
+
+	CHECK(tree->GetStats().relocations == 0);
+
+	CheckQueries(*tree, vector<BoxVolume*>{}, 8);
+
+	CHECK(tree->GetIntersections(MakeFrustum(Vector3f(0.0f, 0.0f, -20000.0f), Vector3f::UnitZ(), 1.0f, 1.0f, 40000.0f)).empty());
+
+}
+
+BENCHMARK(UniformTreeCameraPath){
+
+	// A camera flying through a synthetic scene, counting the per-volume tests of each frame
+
+	const int kFrames = 120;
+
+	auto boxes = CreateBoxes(100000, kSceneDomain, 30.0f, 4);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	auto tree = MakeUniformTree(boxes);
+
+	vector<VolumeComponent*> intersections;
+
+	size_t visible = 0;
+
+	auto frustum_tests = BoxVolume::GetFrustumTestCount();
+
+	Timer timer;
+
+	for (int frame = 0; frame < kFrames; ++frame){
+
+		auto angle = Math::kPi * 2.0f * frame / kFrames;
+
+		Vector3f position(std::cos(angle) * 0.5f * kSceneDomain, 0.0f, std::sin(angle) * 0.5f * kSceneDomain);
+
+		Vector3f forward(-std::sin(angle), 0.0f, std::cos(angle));
+
+		intersections.clear();
+
+		tree->GetIntersections(MakeFrustum(position, forward, 1.2f, 1.0f, 2000.0f), intersections);
+
+		visible += intersections.size();
+
+	}
+
+	auto time = timer.GetTime().GetDeltaSeconds();
+
+	Report("Time per frame", 1000.0 * time / kFrames, "ms");
+
+	Report("Visible volumes per frame", static_cast<double>(visible) / kFrames, "volumes");
+
+	Report("Volume tests per frame", static_cast<double>(BoxVolume::GetFrustumTestCount() - frustum_tests) / kFrames, "tests");
+
+}
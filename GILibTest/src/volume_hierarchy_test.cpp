@@ -0,0 +1,410 @@
+#include "test.h"
+#include "test_scene.h"
+
+#include "bvh_tree.h"
+#include "uniform_tree.h"
+#include "loose_octree.h"
+#include "static_tree.h"
+#include "scope_guard.h"
+#include "task_pool.h"
+#include "timer.h"
+
+using namespace gi_test;
+using namespace gi_lib;
+using namespace std;
+
+namespace{
+
+	/// \brief Add every box to a hierarchy and commit it.
+	void AddBoxes(IVolumeHierarchy& hierarchy, const vector<BoxVolume*>& boxes){
+
+		for (auto&& box : boxes){
+
+			hierarchy.AddVolume(box);
+
+		}
+
+		hierarchy.Commit();
+
+	}
+
+	/// \brief Number of queries of each kind per frame.
+	const int kQueries = 10;
+
+	/// \brief Get the point the queries of a frame are centered at.
+	Vector3f GetQueryCenter(int query){
+
+		return Vector3f::Ones() * (query * 400.0f - 2000.0f);
+
+	}
+
+	/// \brief Run the queries of a frame, reusing the output vector and the visitor of the previous frames.
+	/// \param frustums Frustums to query, one per query. Created once since creating a frustum allocates.
+	/// \return Returns the number of volumes found.
+	size_t RunFrame(const IVolumeHierarchy& hierarchy, const Frustum* frustums, vector<VolumeComponent*>& intersections, const VolumeVisitor& visitor){
+
+		size_t count = 0;
+
+		for (int query = 0; query < kQueries; ++query){
+
+			auto offset = GetQueryCenter(query);
+
+			intersections.clear();
+
+			hierarchy.GetIntersections(frustums[query], intersections);
+			hierarchy.GetIntersections(Sphere{ offset, 500.0f }, intersections);
+			hierarchy.GetIntersections(AABB{ offset, Vector3f::Ones() * 500.0f }, intersections);
+
+			count += intersections.size();
+
+			hierarchy.VisitIntersections(frustums[query], visitor);
+			hierarchy.VisitIntersections(Sphere{ offset, 500.0f }, visitor);
+			hierarchy.VisitIntersections(AABB{ offset, Vector3f::Ones() * 500.0f }, visitor);
+
+		}
+
+		return count;
+
+	}
+
+	/// \brief Check that, once the buffers have grown, a frame of queries performs no allocation at all.
+	void CheckSteadyStateAllocations(const IVolumeHierarchy& hierarchy){
+
+		vector<Frustum> frustums;
+
+		for (int query = 0; query < kQueries; ++query){
+
+			frustums.push_back(MakeFrustum(GetQueryCenter(query), Vector3f(1.0f, 0.1f, 0.2f).normalized(), 1.0f, 1.0f, 2000.0f));
+
+		}
+
+		vector<VolumeComponent*> intersections;
+
+		size_t visited = 0;
+
+		VolumeVisitor visitor = [&visited](VolumeComponent*){
+
+			++visited;
+
+			return true;
+
+		};
+
+		auto count = RunFrame(hierarchy, frustums.data(), intersections, visitor);		// Warm-up
+
+		CHECK(count > 0);
+
+		CHECK(visited > 0);
+
+		auto allocations = GetAllocationCount();
+
+		CHECK(RunFrame(hierarchy, frustums.data(), intersections, visitor) == count);
+
+		CHECK(GetAllocationCount() == allocations);
+
+		// The overloads returning a new vector allocate it
+
+		CHECK(hierarchy.GetIntersections(frustums[0]).size() > 0);
+
+		CHECK(GetAllocationCount() > allocations);
+
+	}
+
+	/// \brief Check that a visitor returning false stops the traversal.
+	void CheckEarlyOut(const IVolumeHierarchy& hierarchy){
+
+		size_t visited = 0;
+
+		VolumeVisitor visitor = [&visited](VolumeComponent*){
+
+			++visited;
+
+			return false;
+
+		};
+
+		auto whole_domain = AABB{ Vector3f::Zero(), Vector3f::Ones() * kSceneDomain };
+
+		CHECK(!hierarchy.VisitIntersections(whole_domain, visitor));
+
+		CHECK(visited == 1);
+
+		// A visitor that never stops visits every volume returned by GetIntersections
+
+		visited = 0;
+
+		VolumeVisitor counter = [&visited](VolumeComponent*){
+
+			++visited;
+
+			return true;
+
+		};
+
+		CHECK(hierarchy.VisitIntersections(whole_domain, counter));
+
+		CHECK(visited == hierarchy.GetIntersections(whole_domain).size());
+
+	}
+
+	/// \brief Check that the queries of a batch find the same volumes of the same queries issued one at a time.
+	/// \param query_count Number of queries of the batch. Queries beyond the size of a group require additional groups.
+	void CheckBatchQueries(const IVolumeHierarchy& hierarchy, size_t query_count){
+
+		VolumeQueryBatch batch;
+
+		vector<vector<VolumeComponent*>> expected;
+
+		for (size_t query = 0; query < query_count; ++query){
+
+			auto center = GetQueryCenter(static_cast<int>(query % kQueries)) + Vector3f(query * 7.0f, query * -3.0f, 0.0f);
+
+			switch (query % 3){
+
+			case 0:
+			{
+				auto frustum = MakeFrustum(center, Vector3f(1.0f, 0.1f, 0.2f).normalized(), 1.0f, 1.0f, 500.0f + query * 20.0f);
+
+				CHECK(batch.AddQuery(frustum) == query);
+
+				expected.push_back(Sorted(hierarchy.GetIntersections(frustum)));
+
+				break;
+			}
+			case 1:
+			{
+				Sphere sphere{ center, 100.0f + query * 10.0f };
+
+				CHECK(batch.AddQuery(sphere) == query);
+
+				expected.push_back(Sorted(hierarchy.GetIntersections(sphere)));
+
+				break;
+			}
+			default:
+			{
+				AABB aabb{ center, Vector3f::Ones() * (100.0f + query * 10.0f) };
+
+				CHECK(batch.AddQuery(aabb) == query);
+
+				expected.push_back(Sorted(hierarchy.GetIntersections(aabb)));
+
+				break;
+			}
+
+			}
+
+		}
+
+		CHECK(batch.GetQueryCount() == query_count);
+
+		CHECK(batch.GetGroupCount() == (query_count + VolumeQueryBatch::kGroupSize - 1) / VolumeQueryBatch::kGroupSize);
+
+		// Resolving the batch twice replaces the results of the first traversal
+
+		for (int traversal = 0; traversal < 2; ++traversal){
+
+			hierarchy.GetIntersections(batch);
+
+			size_t found = 0;
+
+			for (size_t query = 0; query < query_count; ++query){
+
+				auto intersections = batch.GetIntersections(query);
+
+				CHECK(batch.GetIntersectionCount(query) == expected[query].size());
+
+				CHECK(Sorted(vector<VolumeComponent*>(intersections.begin(), intersections.end())) == expected[query]);
+
+				found += expected[query].size();
+
+			}
+
+			CHECK(found > 0);
+
+		}
+
+		// A query finding nothing
+
+		batch.Clear();
+
+		batch.AddQuery(Sphere{ Vector3f::Ones() * 10.0f * kSceneDomain, 1.0f });
+
+		hierarchy.GetIntersections(batch);
+
+		CHECK(batch.GetIntersectionCount(0) == 0);
+
+	}
+
+	/// \brief Check that the parallel queries return the same volumes, in the same order, of the sequential ones.
+	void CheckParallelQueries(const IVolumeHierarchy& hierarchy){
+
+		for (auto thread_count : { 1u, 2u, 3u, 8u }){
+
+			TaskPool pool(thread_count);
+
+			for (int query = 0; query < kQueries; ++query){
+
+				auto center = GetQueryCenter(query);
+
+				auto frustum = MakeFrustum(center, Vector3f(1.0f, 0.1f, 0.2f).normalized(), 1.0f, 1.0f, 2000.0f);
+
+				vector<VolumeComponent*> intersections;
+
+				hierarchy.GetIntersections(frustum, intersections, pool);
+
+				CHECK(Sorted(intersections) == Sorted(hierarchy.GetIntersections(frustum)));
+
+				// The order depends on the hierarchy only, not on the scheduling
+
+				vector<VolumeComponent*> repeated;
+
+				hierarchy.GetIntersections(frustum, repeated, pool);
+
+				CHECK(repeated == intersections);
+
+				intersections.clear();
+
+				hierarchy.GetIntersections(Sphere{ center, 500.0f }, intersections, pool);
+
+				CHECK(Sorted(intersections) == Sorted(hierarchy.GetIntersections(Sphere{ center, 500.0f })));
+
+				intersections.clear();
+
+				hierarchy.GetIntersections(AABB{ center, Vector3f::Ones() * 500.0f }, intersections, pool);
+
+				CHECK(Sorted(intersections) == Sorted(hierarchy.GetIntersections(AABB{ center, Vector3f::Ones() * 500.0f })));
+
+			}
+
+		}
+
+	}
+
+}
+
+TEST(UniformTreeQueryOverloads){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 1);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	UniformTree tree(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, Vector3i::Ones() * 3);
+
+	AddBoxes(tree, boxes);
+
+	CheckSteadyStateAllocations(tree);
+
+	CheckEarlyOut(tree);
+
+	CheckParallelQueries(tree);
+
+	CheckBatchQueries(tree, 5);
+
+	CheckBatchQueries(tree, 2 * VolumeQueryBatch::kGroupSize + 6);
+
+}
+
+TEST(BVHTreeQueryOverloads){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 2);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	BVHTree tree;
+
+	AddBoxes(tree, boxes);
+
+	tree.Rebuild();
+
+	CheckSteadyStateAllocations(tree);
+
+	CheckEarlyOut(tree);
+
+	CheckParallelQueries(tree);
+
+	CheckBatchQueries(tree, 5);
+
+	CheckBatchQueries(tree, 2 * VolumeQueryBatch::kGroupSize + 6);
+
+}
+
+TEST(LooseOctreeQueryOverloads){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 3);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	LooseOctree tree(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, 5);
+
+	AddBoxes(tree, boxes);
+
+	CheckSteadyStateAllocations(tree);
+
+	CheckEarlyOut(tree);
+
+	CheckParallelQueries(tree);
+
+	CheckBatchQueries(tree, 5);
+
+	CheckBatchQueries(tree, 2 * VolumeQueryBatch::kGroupSize + 6);
+
+}
+
+TEST(StaticTreeQueryOverloads){
+
+	auto boxes = CreateBoxes(5000, kSceneDomain, 30.0f, 4);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	StaticTree tree;
+
+	AddBoxes(tree, boxes);
+
+	CheckEarlyOut(tree);
+
+	CheckParallelQueries(tree);
+
+	CheckBatchQueries(tree, 5);
+
+	CheckBatchQueries(tree, 2 * VolumeQueryBatch::kGroupSize + 6);
+
+}
+
+BENCHMARK(ParallelQueriesScaling){
+
+	// Frustum queries split among 1 to 8 threads
+
+	const int kFrames = 20;
+
+	auto boxes = CreateBoxes(100000, kSceneDomain, 30.0f, 4);
+
+	auto dispose_boxes = make_scope_guard([&boxes](){ DisposeBoxes(boxes); });
+
+	UniformTree tree(AABB{ Vector3f::Zero(), Vector3f::Ones() * (kSceneDomain + 100.0f) }, Vector3i::Ones() * 3);
+
+	AddBoxes(tree, boxes);
+
+	auto frustum = MakeFrustum(Vector3f(0.0f, 0.0f, -kSceneDomain), Vector3f::UnitZ(), 1.2f, 1.0f, 2.0f * kSceneDomain);
+
+	vector<VolumeComponent*> intersections;
+
+	for (auto thread_count : { 1u, 2u, 4u, 8u }){
+
+		TaskPool pool(thread_count);
+
+		Timer timer;
+
+		for (int frame = 0; frame < kFrames; ++frame){
+
+			intersections.clear();
+
+			tree.GetIntersections(frustum, intersections, pool);
+
+		}
+
+		Report(std::to_string(thread_count) + " threads, per frustum query", 1000.0 * timer.GetTime().GetDeltaSeconds() / kFrames, "ms");
+
+	}
+
+}